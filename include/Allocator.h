@@ -0,0 +1,83 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+// Allocation policies for matrix storage. A policy is any type with
+//     static void* allocate(size_t bytes);           // nullptr on failure
+//     static void deallocate(void* ptr, size_t bytes);
+// Matrix<T>::__alloc/__dealloc route through MatrixAllocator<T>::type,
+// which can be specialized to plug in a different policy.
+
+// Unpooled, ALIGN-byte aligned allocation
+template <size_t ALIGN = 64>
+struct AlignedAllocator {
+    static void* allocate(size_t bytes) {
+        // aligned_alloc requires a multiple of the alignment
+        return std::aligned_alloc(ALIGN, (bytes + ALIGN - 1) / ALIGN * ALIGN);
+    }
+    static void deallocate(void* ptr, size_t /*bytes*/) {
+        std::free(ptr);
+    }
+};
+
+// 64-byte aligned allocations served from size-class free lists.
+//
+// Requests are rounded up to one of four size classes per power of two.
+// Freed blocks go to a per-thread cache and overflow to a shared free
+// list, so allocating and freeing the same shapes in a loop stops
+// reaching the system allocator after the first iteration. Requests
+// above MAXPOOLED bytes bypass the free lists. Blocks may be freed from
+// any thread.
+struct PoolAllocator {
+    static constexpr size_t ALIGN = 64;
+    static constexpr size_t MAXPOOLED = size_t(1) << 26;  // 64 MiB
+
+    static void* allocate(size_t bytes);
+    static void deallocate(void* ptr, size_t bytes);
+
+    // Return the shared free lists to the system
+    static void trim();
+};
+
+// Scoped arena for PoolAllocator.
+//
+// While an arena is alive, PoolAllocator requests from the constructing
+// thread are bump-allocated from it, deallocate() on them is a no-op, and
+// everything is released at once when the arena is destroyed. Arenas nest.
+//
+// Warning:
+//     Matrices allocated inside the scope must not outlive it.
+//
+// Example:
+//     for (int step = 0; step < steps; step++) {
+//         ScopedArena arena;
+//         Matrix<REF> C = A * B;  // Served from arena
+//     }                           // Released in bulk
+class ScopedArena {
+ public:
+    // Bytes reserved up front; the arena grows in chunks of this size
+    explicit ScopedArena(size_t bytes = size_t(1) << 20);
+    ~ScopedArena();
+
+    ScopedArena(const ScopedArena&) = delete;
+    ScopedArena& operator=(const ScopedArena&) = delete;
+
+    // Innermost arena on the calling thread, nullptr if none
+    static ScopedArena* current();
+
+    // Bump-allocate a 64-byte aligned block
+    void* allocate(size_t bytes);
+
+    // Bytes handed out so far
+    size_t used() const { return _used; }
+
+ private:
+    struct Chunk;
+    Chunk* _chunks = nullptr;
+    size_t _chunkSize;
+    size_t _used = 0;
+    ScopedArena* _prev;
+};
@@ -0,0 +1,217 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "OperatorSet.h"
+
+// Asynchronous operations ordered by their operands
+//
+// Each *_async call (and async::submit) returns immediately with an
+// Event and runs on a pool of async workers, separate from the ThreadPool
+// that splits a single kernel across cores. An operation waits only for
+// the earlier ones it has a hazard with: it reads what they write (RAW),
+// writes what they read (WAR) or writes what they write (WAW). Hazards
+// are found by comparing the address range of each operand, from its
+// first element to its last, so disjoint row blocks of a matrix run
+// concurrently while interleaved column blocks are serialized.
+//
+// Warning:
+//     Operands are used in place, not copied. Their storage must stay
+//     alive (no move or reallocation) until the operation's Event
+//     completes, and must not be accessed synchronously meanwhile. The
+//     matrix or view objects themselves may go out of scope.
+//
+// Errors thrown by an operation (e.g. throw(1) on mismatched shapes) are
+// rethrown by Event::wait(), and by the wait() of every operation that
+// depended on it, which are skipped. An operation must not wait on
+// another Event, the workers may all be blocked.
+//
+// Example:
+//     async::Event h = mprod_async(W1, x1, &h1);   // Request 1
+//     async::Event g = mprod_async(W2, x2, &h2);   // Request 2, concurrent
+//     tanh_async(&h1);                             // After h (RAW)
+//     async::wait();
+namespace async {
+
+// Bytes [begin, end) an operation reads or writes
+struct Range {
+    const void* begin;
+    const void* end;
+};
+
+// Range of a matrix or view, first element to one past the last
+template <typename T>
+Range range(const OperatorSet<T>& A) {
+    const auto* data = static_cast<typename OperatorSet<T>::Scalar*>(A);
+    if (data == nullptr || numel(A) == 0) return {nullptr, nullptr};
+    return {data, data + (A.rows() - 1) * A.ld() + A.cols()};
+}
+
+// Range of n values at p
+template <typename S>
+Range range(const S* p, ptrdiff_t n = 1) {
+    return {p, p + n};
+}
+
+// Non-owning handle to A's storage, captured by value so that the
+// operation does not refer to A itself, e.g. a temporary view
+template <typename T>
+typename T::View handle(const OperatorSet<T>& A) {
+    using S = typename OperatorSet<T>::Scalar;
+    return typename T::View(static_cast<S*>(A), A.rows(), A.cols(), A.ld());
+}
+
+// Completion of an asynchronous operation. A default Event is complete.
+class Event {
+ public:
+    Event() = default;
+
+    // Block until the operation has run, rethrowing its error
+    void wait() const;
+
+    // True once the operation has run
+    bool ready() const;
+
+    struct Node;
+
+ private:
+    explicit Event(std::shared_ptr<Node> node) : _node(std::move(node)) {}
+    friend Event submit(const std::vector<Range>&, const std::vector<Range>&,
+                        std::function<void()>);
+
+    std::shared_ptr<Node> _node;
+};
+
+// Run f on the async workers once the earlier operations it has a hazard
+// with, through the ranges it reads and writes, are complete
+Event submit(const std::vector<Range>& reads,
+             const std::vector<Range>& writes, std::function<void()> f);
+
+// Block until every submitted operation has run
+void wait();
+
+// Number of async workers, MATRIX_ASYNC_THREADS or the hardware
+// concurrency by default. Resizing waits for submitted operations.
+int workers();
+void workers(int n);
+
+}  // namespace async
+
+// C = A * B
+template <typename T>
+async::Event mprod_async(const OperatorSet<T>& A, const OperatorSet<T>& B,
+                         OperatorSet<T>* C) {
+    typename T::View a = async::handle(A);
+    typename T::View b = async::handle(B);
+    typename T::View c = async::handle(*C);
+    return async::submit({async::range(A), async::range(B)},
+                         {async::range(*C)}, [=]() mutable {
+        mprod(a, b, &c);
+    });
+}
+
+// C = alpha * op(A) * op(B) + beta * C
+template <typename T>
+async::Event mprod_async(const bool transA, const bool transB,
+                         const double alpha, const OperatorSet<T>& A,
+                         const OperatorSet<T>& B, const double beta,
+                         OperatorSet<T>* C) {
+    typename T::View a = async::handle(A);
+    typename T::View b = async::handle(B);
+    typename T::View c = async::handle(*C);
+    return async::submit({async::range(A), async::range(B)},
+                         {async::range(*C)}, [=]() mutable {
+        mprod(transA, transB, alpha, a, b, beta, &c);
+    });
+}
+
+// B += alpha * A
+template <typename T>
+async::Event maxpy_async(const double alpha, const OperatorSet<T>& A,
+                         OperatorSet<T>* B) {
+    typename T::View a = async::handle(A);
+    typename T::View b = async::handle(*B);
+    return async::submit({async::range(A)}, {async::range(*B)},
+                         [=]() mutable { maxpy(alpha, a, 1, &b); });
+}
+
+// A += alpha * x * y^T
+template <typename T>
+async::Event mger_async(const double alpha, const OperatorSet<T>& x,
+                        const OperatorSet<T>& y, OperatorSet<T>* A) {
+    typename T::View px = async::handle(x);
+    typename T::View py = async::handle(y);
+    typename T::View a = async::handle(*A);
+    return async::submit({async::range(x), async::range(y)},
+                         {async::range(*A)}, [=]() mutable {
+        mger(alpha, px, py, &a);
+    });
+}
+
+// C = A .* B
+template <typename T>
+async::Event hprod_async(const OperatorSet<T>& A, const OperatorSet<T>& B,
+                         OperatorSet<T>* C) {
+    typename T::View a = async::handle(A);
+    typename T::View b = async::handle(B);
+    typename T::View c = async::handle(*C);
+    return async::submit({async::range(A), async::range(B)},
+                         {async::range(*C)}, [=]() mutable {
+        hprod(a, b, &c);
+    });
+}
+
+// C = A - B
+template <typename T>
+async::Event msub_async(const OperatorSet<T>& A, const OperatorSet<T>& B,
+                        OperatorSet<T>* C) {
+    typename T::View a = async::handle(A);
+    typename T::View b = async::handle(B);
+    typename T::View c = async::handle(*C);
+    return async::submit({async::range(A), async::range(B)},
+                         {async::range(*C)}, [=]() mutable {
+        msub(a, b, &c);
+    });
+}
+
+// B = A
+template <typename T>
+async::Event mcopy_async(const OperatorSet<T>& A, OperatorSet<T>* B) {
+    typename T::View a = async::handle(A);
+    typename T::View b = async::handle(*B);
+    return async::submit({async::range(A)}, {async::range(*B)},
+                         [=]() mutable { mcopy(a, &b); });
+}
+
+// A = tanh(A), see VMath.h for the accuracy modes
+template <typename T>
+async::Event tanh_async(OperatorSet<T>* A,
+                        const vmath::Accuracy mode = vmath::HIGH) {
+    typename T::View a = async::handle(*A);
+    return async::submit({}, {async::range(*A)},
+                         [=]() mutable { tanh(&a, mode); });
+}
+
+// *d = dot(A, B)
+template <typename T>
+async::Event dot_async(const OperatorSet<T>& A, const OperatorSet<T>& B,
+                       double* d) {
+    typename T::View a = async::handle(A);
+    typename T::View b = async::handle(B);
+    return async::submit({async::range(A), async::range(B)},
+                         {async::range(d)}, [=] { *d = dot(a, b); });
+}
+
+// *n = norm(A)
+template <typename T>
+async::Event norm_async(const OperatorSet<T>& A, double* n) {
+    typename T::View a = async::handle(A);
+    return async::submit({async::range(A)}, {async::range(n)}, [=] {
+        *n = norm(a);
+    });
+}
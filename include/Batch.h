@@ -0,0 +1,114 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <algorithm>
+#include <utility>
+
+#include "Gemm.h"
+#include "Matrix.h"
+
+// Batch of equally-shaped (m x n) matrices in an interleaved (structure
+// of arrays) layout: groups of gemm::LANES matrices are stored element by
+// element, so that one SIMD instruction updates the same element of a
+// whole group. See gemm::dgemmInterleaved. Keeping tiny matrices in this
+// layout avoids the per-product call overhead that dominates mprod below
+// ~16 x 16.
+//
+// Example:
+//     Batch<T> A(count, 4, 4), B(count, 4, 4), C(count, 4, 4);
+//     A(b, i, j) = ...;                // or A.set(b, Matrix<T>)
+//     mprod_batched(A, B, &C);         // C[b] = A[b] * B[b]
+//     C.get(b, &D);                    // Matrix<T> D(4, 4)
+template <BLAS T>
+class Batch {
+ public:
+    // count zero-filled (m x n) matrices
+    Batch(ptrdiff_t count, ptrdiff_t m, ptrdiff_t n)
+        : _count(count), _m(m), _n(n) {
+        if (count < 0 || m < 0 || n < 0) throw(1);
+        if (bytes() > 0) {
+            _data = static_cast<double*>(
+                MatrixAllocator<T>::type::allocate(bytes()));
+            if (_data == nullptr) throw(1);
+            std::fill(_data, _data + bytes() / sizeof(double), 0.0);
+        }
+    }
+
+    Batch(Batch&& B)
+        : _count(B._count), _m(B._m), _n(B._n), _data(B._data) {
+        B._data = nullptr;
+    }
+
+    ~Batch() {
+        if (_data) MatrixAllocator<T>::type::deallocate(_data, bytes());
+    }
+
+    Batch(const Batch&) = delete;
+    Batch& operator=(const Batch&) = delete;
+    Batch& operator=(Batch&&) = delete;
+
+    ptrdiff_t size() const { return _count; }
+    ptrdiff_t rows() const { return _m; }
+    ptrdiff_t cols() const { return _n; }
+    double* data() const { return _data; }
+
+    // Element (i, j) of matrix b
+    double& operator()(ptrdiff_t b, ptrdiff_t i, ptrdiff_t j) {
+        return _data[index(b, i, j)];
+    }
+    double operator()(ptrdiff_t b, ptrdiff_t i, ptrdiff_t j) const {
+        return _data[index(b, i, j)];
+    }
+
+    // Matrix b = A
+    void set(ptrdiff_t b, const Matrix<T>& A) {
+        if (b < 0 || b >= _count) throw(1);
+        if (A.rows() != _m || A.cols() != _n) throw(1);
+        for (ptrdiff_t i = 0; i < _m; i++)
+            for (ptrdiff_t j = 0; j < _n; j++)
+                (*this)(b, i, j) = A[i][j];
+    }
+
+    // A = Matrix b
+    void get(ptrdiff_t b, Matrix<T>* A) const {
+        if (b < 0 || b >= _count) throw(1);
+        if (A->rows() != _m || A->cols() != _n) throw(1);
+        for (ptrdiff_t i = 0; i < _m; i++)
+            for (ptrdiff_t j = 0; j < _n; j++)
+                (*A)[i][j] = (*this)(b, i, j);
+    }
+
+ private:
+    ptrdiff_t index(ptrdiff_t b, ptrdiff_t i, ptrdiff_t j) const {
+        const ptrdiff_t L = gemm::LANES;
+        return (b / L)*_m*_n*L + (i*_n + j)*L + b % L;
+    }
+
+    size_t bytes() const {
+        return gemm::groups(_count) * gemm::LANES * _m * _n * sizeof(double);
+    }
+
+    ptrdiff_t _count, _m, _n;
+    double* _data = nullptr;
+};
+
+// Batched Matrix Product: C[b] = alpha * op(A[b]) * op(B[b])
+template <BLAS T>
+void mprod_batched(const bool transA, const bool transB, const double alpha,
+                   const Batch<T>& A, const Batch<T>& B, Batch<T>* C) {
+    const ptrdiff_t m = transA ? A.cols() : A.rows();
+    const ptrdiff_t k = transA ? A.rows() : A.cols();
+    if (A.size() != B.size() || A.size() != C->size()) throw(1);
+    if (k != (transB ? B.cols() : B.rows())) throw(1);
+    if (m != C->rows()) throw(1);
+    if (C->cols() != (transB ? B.rows() : B.cols())) throw(1);
+    gemm::dgemmInterleaved(transA, transB, m, C->cols(), k, alpha,
+                           A.data(), B.data(), 0, C->data(), C->size());
+}
+
+// Batched Matrix Product: C[b] = A[b] * B[b]
+template <BLAS T>
+void mprod_batched(const Batch<T>& A, const Batch<T>& B, Batch<T>* C) {
+    mprod_batched(false, false, 1.0, A, B, C);
+}
@@ -0,0 +1,35 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+
+// Serial kernels for element-wise operations between a matrix and a
+// broadcast vector, one row segment at a time
+//
+// The operation is selected once per segment, so each loop is a plain
+// streaming loop the compiler vectorizes. c may be a (in place). Matrix<T>
+// splits the rows across the ThreadPool (see badd(), bsub(), ...).
+namespace broadcast {
+
+// c = a op v
+enum Op { ADD, SUB, MUL, DIV };
+
+// How the vector v spans an (m x n) matrix, as gemm::Epilogue's bias
+//     ROW : v[i*incv] applies to every element of row i, v has m elements
+//     COL : v[j] applies to every element of column j, v has n elements
+enum Axis { ROW, COL };
+
+// c[j] = a[j] op v[j], j < n
+void vector(const Op op, const ptrdiff_t n, const double* a, const double* v,
+            double* c);
+void vector(const Op op, const ptrdiff_t n, const float* a, const float* v,
+            float* c);
+
+// c[j] = a[j] op s, j < n
+void scalar(const Op op, const ptrdiff_t n, const double* a, const double s,
+            double* c);
+void scalar(const Op op, const ptrdiff_t n, const float* a, const float s,
+            float* c);
+
+}  // namespace broadcast
@@ -0,0 +1,71 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+enum BLAS : int;
+
+// Runtime backend selection for Matrix<AUTO, S>
+//
+// Each kernel of a Matrix<AUTO, S> forwards to the REF, ACC, OPB or MKL
+// implementation chosen from a table keyed by operation, precision and
+// size class, the bit width of the operation's size:
+//     GEMM  : cbrt(m * n * k)
+//     GEMV  : sqrt(m * n)
+//     other : number of elements
+// The table is filled by calibrate(), which times every linked backend
+// on each size class, and saved to / loaded from a cache file so a
+// dispatch is only an array lookup. Without a cache the defaults use REF
+// for small problems and the preferred BLAS (MKL, ACC, OPB) above.
+//
+// Example:
+//     dispatch::calibrate();
+//     dispatch::save();             // Reused by later processes
+//     Matrix<AUTO> C = A * B;       // REF at 4x4, BLAS at 256x256
+namespace dispatch {
+
+// Dispatched operations, __norm uses DOT and __dger uses GER
+enum Op { GEMM, GEMV, GER, DOT, AXPY, COPY, SCALE, OPS };
+
+// Size classes, sizes of 2^(CLASSES-1) and above share the last one
+constexpr int CLASSES = 32;
+
+// Size class of a size: 0 for 0, otherwise 1 + floor(log2(size))
+int sizeClass(ptrdiff_t size);
+
+// Backend for op at a size class, S is double (single = false) or float
+BLAS select(Op op, bool single, int sizeClass);
+
+// Override the backend for op at a size class
+void set(Op op, bool single, int sizeClass, BLAS backend);
+
+// Backends linked into this build, REF first
+const std::vector<BLAS>& backends();
+
+// Restore the uncalibrated defaults
+void reset();
+
+// Time every backend on each size class up to maxDim (GEMM dimension,
+// 4 * maxDim for GEMV, maxDim^2 elements otherwise) for at least seconds
+// per measurement, keeping the fastest. Larger classes keep the winner
+// of the largest one measured.
+void calibrate(double seconds = 1e-2, ptrdiff_t maxDim = 1024);
+
+// Cache file: MATRIX_DISPATCH_CACHE, else $HOME/.matrix_dispatch
+std::string cachePath();
+
+// Write the table, returns false if the file cannot be written
+bool save(const std::string& path = cachePath());
+
+// Read a table written by save(). Returns false, leaving the table
+// unchanged, if the file is missing or malformed. Entries naming a
+// backend that is not linked fall back to the defaults.
+bool load(const std::string& path = cachePath());
+
+// Name of an operation, e.g. "gemm"
+const char* name(Op op);
+
+}  // namespace dispatch
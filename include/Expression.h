@@ -0,0 +1,190 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <utility>  // std::declval
+
+#include "ThreadPool.h"
+
+template <typename T>
+class OperatorSet;
+
+// Lazy element-wise expressions over OperatorSet<T> operands.
+//
+// Chains of +, -, scalar *, hprod and tanh build a tree of expression
+// nodes instead of temporaries. The tree is evaluated in a single fused
+// loop when assigned to a matrix, so that
+//     Matrix<T> D = alpha * hprod(A, B) + C;
+// allocates D once and reads A, B and C once.
+//
+// Nodes reference their matrix operands, which must outlive the
+// expression. Evaluate expressions in the statement that builds them.
+// Nodes compute in their operands' element type.
+template <typename E>
+class MatrixExpression {
+ public:
+    const E& self() const { return static_cast<const E&>(*this); }
+
+    ptrdiff_t rows() const { return self().rows(); }
+    ptrdiff_t cols() const { return self().cols(); }
+
+    // True if every operand is contiguous, the tree may then be indexed
+    // as a single row: e(0, j) for j < rows() * cols()
+    bool contiguous() const { return self().contiguous(); }
+};
+
+namespace expression {
+
+// Matrix operand with elements of type S
+template <typename S>
+class Leaf : public MatrixExpression<Leaf<S>> {
+ public:
+    template <typename T>
+    explicit Leaf(const OperatorSet<T>& A)
+        : _data(static_cast<S*>(A)), _m(A.rows()), _n(A.cols()),
+          _ld(A.ld()), _contiguous(A.contiguous()) {}
+
+    ptrdiff_t rows() const { return _m; }
+    ptrdiff_t cols() const { return _n; }
+    bool contiguous() const { return _contiguous; }
+    S operator()(ptrdiff_t i, ptrdiff_t j) const {
+        return _data[i*_ld + j];
+    }
+
+ private:
+    const S* _data;
+    ptrdiff_t _m, _n, _ld;
+    bool _contiguous;
+};
+
+// Element-wise op(l(i, j), r(i, j))
+template <typename L, typename R, typename Op>
+class Binary : public MatrixExpression<Binary<L, R, Op>> {
+ public:
+    Binary(const L& l, const R& r) : _l(l), _r(r) {
+        if (l.rows() != r.rows() || l.cols() != r.cols()) throw(1);
+    }
+
+    ptrdiff_t rows() const { return _l.rows(); }
+    ptrdiff_t cols() const { return _l.cols(); }
+    bool contiguous() const { return _l.contiguous() && _r.contiguous(); }
+    auto operator()(ptrdiff_t i, ptrdiff_t j) const {
+        return Op::apply(_l(i, j), _r(i, j));
+    }
+
+ private:
+    L _l;
+    R _r;
+};
+
+// Element-wise op(e(i, j))
+template <typename E, typename Op>
+class Unary : public MatrixExpression<Unary<E, Op>> {
+ public:
+    explicit Unary(const E& e, Op op = Op()) : _e(e), _op(op) {}
+
+    ptrdiff_t rows() const { return _e.rows(); }
+    ptrdiff_t cols() const { return _e.cols(); }
+    bool contiguous() const { return _e.contiguous(); }
+    auto operator()(ptrdiff_t i, ptrdiff_t j) const { return _op(_e(i, j)); }
+
+ private:
+    E _e;
+    Op _op;
+};
+
+struct Add { static auto apply(auto a, auto b) { return a + b; } };
+struct Sub { static auto apply(auto a, auto b) { return a - b; } };
+struct Mul { static auto apply(auto a, auto b) { return a * b; } };
+
+struct Scale {
+    double alpha;
+    template <typename S>
+    S operator()(S a) const { return static_cast<S>(alpha) * a; }
+};
+
+struct Tanh {
+    template <typename S>
+    S operator()(S a) const { return std::tanh(a); }
+};
+
+// Matrix operands become leaves, expressions pass through
+template <typename T>
+auto wrap(const OperatorSet<T>& A) {
+    return Leaf<typename OperatorSet<T>::Scalar>(A);
+}
+
+template <typename E>
+const E& wrap(const MatrixExpression<E>& e) { return e.self(); }
+
+template <typename X>
+using Node = std::decay_t<decltype(wrap(std::declval<const X&>()))>;
+
+template <typename X>
+concept Expression = requires(const X& x) { wrap(x); };
+
+template <typename X>
+concept Lazy = Expression<X> && std::derived_from<X, MatrixExpression<X>>;
+
+}  // namespace expression
+
+// Evaluate e into the (rows x cols) array dst with leading dimension
+// ldd in one pass
+template <typename E, typename S>
+void evaluate(const MatrixExpression<E>& expr, S* dst, ptrdiff_t ldd) {
+    const E& e = expr.self();
+    const ptrdiff_t m = e.rows(), n = e.cols();
+    parallel_rows(m, n, e.contiguous() && (ldd == n || m <= 1),
+                  ThreadPool::grain(),
+        [&e, dst, ldd](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            for (ptrdiff_t j = j0; j < j1; j++) {
+                dst[i*ldd + j] = e(i, j);
+            }
+        });
+}
+
+// Lazy operand: alpha * lazy(A) + B leaves A unmodified, whereas
+// alpha * A scales A in place
+template <typename T>
+auto lazy(const OperatorSet<T>& A) {
+    return expression::wrap(A);
+}
+
+// Add: A + B (lazy), at least one operand is an expression
+template <expression::Expression L, expression::Expression R>
+    requires expression::Lazy<L> || expression::Lazy<R>
+auto operator+(const L& l, const R& r) {
+    using namespace expression;  // NOLINT [build/namespaces]
+    return Binary<Node<L>, Node<R>, Add>(wrap(l), wrap(r));
+}
+
+// Subtract: A - B (lazy), at least one operand is an expression
+template <expression::Expression L, expression::Expression R>
+    requires expression::Lazy<L> || expression::Lazy<R>
+auto operator-(const L& l, const R& r) {
+    using namespace expression;  // NOLINT [build/namespaces]
+    return Binary<Node<L>, Node<R>, Sub>(wrap(l), wrap(r));
+}
+
+// Hadamard Product: hprod(A, B) (lazy)
+template <expression::Expression L, expression::Expression R>
+auto hprod(const L& l, const R& r) {
+    using namespace expression;  // NOLINT [build/namespaces]
+    return Binary<Node<L>, Node<R>, Mul>(wrap(l), wrap(r));
+}
+
+// Scalar Multiply: alpha * (A + B) (lazy)
+template <typename E>
+auto operator*(const double alpha, const MatrixExpression<E>& e) {
+    using namespace expression;  // NOLINT [build/namespaces]
+    return Unary<E, Scale>(e.self(), Scale{alpha});
+}
+
+// Hyperbolic Tangent: tanh(A + B) (lazy)
+template <expression::Expression E>
+auto tanh(const E& e) {
+    using namespace expression;  // NOLINT [build/namespaces]
+    return Unary<Node<E>, Tanh>(wrap(e));
+}
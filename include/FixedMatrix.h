@@ -0,0 +1,301 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <algorithm>  // std::copy
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>  // std::integer_sequence
+
+#include "OperatorSet.h"
+
+namespace fixed {
+
+// f(0), f(1), ..., f(N - 1) without a loop
+template <ptrdiff_t N, typename F>
+inline void unroll(F&& f) {
+    [&]<ptrdiff_t... I>(std::integer_sequence<ptrdiff_t, I...>) {
+        (f(I), ...);
+    }(std::make_integer_sequence<ptrdiff_t, N>{});
+}
+
+// sum of f(0), ..., f(N - 1) without a loop
+template <ptrdiff_t N, typename F>
+inline double sum(F&& f) {
+    return [&]<ptrdiff_t... I>(std::integer_sequence<ptrdiff_t, I...>) {
+        return (0.0 + ... + f(I));
+    }(std::make_integer_sequence<ptrdiff_t, N>{});
+}
+
+}  // namespace fixed
+
+// Compile-Time Fixed-Size (M x N) Matrix
+//
+// Dimensions are template parameters and the elements live inline, so a
+// FixedMatrix never touches the allocator and every kernel is unrolled
+// over constant bounds. Intended for the small matrices of geometry and
+// physics code (3 x 3 rotations, 4 x 4 transforms) where Matrix<T> spends
+// more time in allocation and dispatch than in arithmetic.
+//
+// Unlike Matrix<T> it is a value type: copies are cheap and allowed, and
+// A + B, A - B, alpha * A and A * B return a new FixedMatrix instead of
+// reusing an operand. Operations that change the shape (products,
+// transpose, mger) check dimensions at compile time:
+//     FixedMatrix<3, 4> A;
+//     FixedMatrix<4, 2> B;
+//     FixedMatrix<3, 2> C = A * B;     // OK
+//     A * A;                           // does not compile
+// The remaining OperatorSet operations (dot, norm, hprod, maxpy, ...)
+// still apply and their runtime shape checks fold to constants.
+template <ptrdiff_t M, ptrdiff_t N>
+class FixedMatrix : public OperatorSet<FixedMatrix<M, N>> {
+    static_assert(M > 0 && N > 0, "FixedMatrix dimensions must be positive");
+
+ public:
+    static constexpr ptrdiff_t ROWS = M;
+    static constexpr ptrdiff_t COLS = N;
+
+    // Zero-filled
+    FixedMatrix() : OperatorSet<FixedMatrix>(EMPTY) {
+        bind();
+    }
+
+    // Row-major elements: FixedMatrix<2, 2> A{1, 2,
+    //                                         3, 4};
+    FixedMatrix(std::initializer_list<double> values)
+        : OperatorSet<FixedMatrix>(EMPTY) {
+        if (static_cast<ptrdiff_t>(values.size()) != M*N) throw(1);
+        bind();
+        std::copy(values.begin(), values.end(), _storage);
+    }
+
+    // Runtime-shaped construction used by the shared OperatorSet paths
+    // (e.g. operator>>), throw(1) unless (m x n) == (M x N)
+    FixedMatrix(ptrdiff_t m, ptrdiff_t n) : FixedMatrix() {
+        if (m != M || n != N) throw(1);
+    }
+
+    FixedMatrix(const FixedMatrix& B) : FixedMatrix() {
+        __copy(B, 1, N);
+    }
+
+    // Storage is inline, so a move is a copy
+    FixedMatrix(FixedMatrix&& B) : FixedMatrix(B) {}  // NOLINT
+
+    // Evaluate Expression: FixedMatrix<M, N> C = A + B;
+    template <typename E>
+    FixedMatrix(const MatrixExpression<E>& e)  // NOLINT [runtime/explicit]
+        : FixedMatrix() {
+        *this = e;
+    }
+
+    FixedMatrix& operator=(const FixedMatrix& B) {
+        __copy(B, 1, N);
+        return *this;
+    }
+
+    FixedMatrix& operator=(FixedMatrix&& B) {  // NOLINT
+        return *this = B;
+    }
+
+    template <typename E>
+    FixedMatrix& operator=(const MatrixExpression<E>& expr) {
+        const E& e = expr.self();
+        if (e.rows() != M || e.cols() != N) throw(1);
+        fixed::unroll<M*N>([&](ptrdiff_t k) {
+            _storage[k] = e(k / N, k % N);
+        });
+        return *this;
+    }
+
+    // Dimensions, known at compile time
+    static constexpr ptrdiff_t rows() { return M; }
+    static constexpr ptrdiff_t cols() { return N; }
+    static constexpr ptrdiff_t ld() { return N; }
+    static constexpr bool contiguous() { return true; }
+
+    // Element (i, j)
+    double& operator()(ptrdiff_t i, ptrdiff_t j) { return _storage[i*N + j]; }
+    double operator()(ptrdiff_t i, ptrdiff_t j) const {
+        return _storage[i*N + j];
+    }
+
+    // A[i][j], or A[i] for an (M x 1)-vector
+    typename OperatorSet<FixedMatrix>::TPtr operator[](ptrdiff_t i) {
+        return typename OperatorSet<FixedMatrix>::TPtr(_storage + i*N);
+    }
+    const typename OperatorSet<FixedMatrix>::TPtr operator[](
+            ptrdiff_t i) const {
+        return typename OperatorSet<FixedMatrix>::TPtr(
+            const_cast<double*>(_storage) + i*N);
+    }
+
+    void fill(double value) {
+        fixed::unroll<M*N>([&](ptrdiff_t k) { _storage[k] = value; });
+    }
+
+    static FixedMatrix identity() {
+        static_assert(M == N, "identity() needs a square FixedMatrix");
+        FixedMatrix I;
+        fixed::unroll<M>([&](ptrdiff_t i) { I._storage[i*N + i] = 1.0; });
+        return I;
+    }
+
+    // Matrix Product: C = A * B, inner dimensions checked at compile time
+    template <ptrdiff_t K>
+    friend void mprod(const FixedMatrix<M, K>& A, const FixedMatrix<K, N>& B,
+                      FixedMatrix* C) {
+        const double* a = A;
+        const double* b = B;
+        double c[M*N];  // A or B may alias C
+        // Row i of C accumulates a(i, p) * row p of B in registers, the
+        // innermost statements are independent and vectorize across j
+        fixed::unroll<M>([&](ptrdiff_t i) {
+            double r[N] = {};
+            fixed::unroll<K>([&](ptrdiff_t p) {
+                const double aip = a[i*K + p];
+                fixed::unroll<N>([&](ptrdiff_t j) {
+                    r[j] += aip * b[p*N + j];
+                });
+            });
+            fixed::unroll<N>([&](ptrdiff_t j) { c[i*N + j] = r[j]; });
+        });
+        fixed::unroll<M*N>([&](ptrdiff_t k) { C->_storage[k] = c[k]; });
+    }
+
+    // Multiplication Operator: A*B
+    template <ptrdiff_t P>
+    FixedMatrix<M, P> operator*(const FixedMatrix<N, P>& B) const {
+        FixedMatrix<M, P> C;
+        mprod(*this, B, &C);
+        return C;
+    }
+
+    // Matrix Transpose
+    friend FixedMatrix<N, M> transpose(const FixedMatrix& X) {
+        FixedMatrix<N, M> Y;
+        double* y = Y;
+        fixed::unroll<M*N>([&](ptrdiff_t k) {
+            y[(k % N)*M + k / N] = X._storage[k];
+        });
+        return Y;
+    }
+
+    // MGER: A += alpha * x * y^T
+    friend void mger(const double alpha, const FixedMatrix<M, 1>& x,
+                     const FixedMatrix<N, 1>& y, FixedMatrix* A) {
+        const double* xd = x;
+        const double* yd = y;
+        fixed::unroll<M*N>([&](ptrdiff_t k) {
+            A->_storage[k] += alpha * xd[k / N] * yd[k % N];
+        });
+    }
+
+    // Element-wise operators return a new FixedMatrix (no lazy expression,
+    // an unrolled pass over M*N elements is already optimal)
+    friend FixedMatrix operator+(const FixedMatrix& A, const FixedMatrix& B) {
+        FixedMatrix C(A);
+        C.__daxpy(1.0, B, 1, N);
+        return C;
+    }
+
+    friend FixedMatrix operator-(const FixedMatrix& A, const FixedMatrix& B) {
+        FixedMatrix C;
+        A.__sub(B, &C);
+        return C;
+    }
+
+    friend FixedMatrix operator*(const double alpha, const FixedMatrix& A) {
+        FixedMatrix C(A);
+        C.__mult(alpha);
+        return C;
+    }
+
+    // Deep Copy: *this = A
+    int __copy(const double* A, const ptrdiff_t inca, const ptrdiff_t lda) {
+        fixed::unroll<M*N>([&](ptrdiff_t k) {
+            _storage[k] = A[(k / N)*lda + (k % N)*inca];
+        });
+        return 0;
+    }
+
+    // DAXPY: A = A + alpha * B
+    int __daxpy(const double alpha, const double* B, const ptrdiff_t incb,
+                const ptrdiff_t ldb) {
+        fixed::unroll<M*N>([&](ptrdiff_t k) {
+            _storage[k] += alpha * B[(k / N)*ldb + (k % N)*incb];
+        });
+        return 0;
+    }
+
+    // Storage is inline
+    int __alloc() { return 0; }
+    int __dealloc() { return 0; }
+
+    // Dot Product
+    int __dot(const FixedMatrix& B, double* d) const {
+        *d = fixed::sum<M*N>([&](ptrdiff_t k) {
+            return _storage[k] * B._storage[k];
+        });
+        return 0;
+    }
+
+    // Hadamard Product
+    int __hprod(const FixedMatrix& B, FixedMatrix* C) const {
+        fixed::unroll<M*N>([&](ptrdiff_t k) {
+            C->_storage[k] = _storage[k] * B._storage[k];
+        });
+        return 0;
+    }
+
+    // Scalar-Matrix Multiply: *this = alpha * (*this)
+    int __mult(const double alpha) {
+        fixed::unroll<M*N>([&](ptrdiff_t k) { _storage[k] *= alpha; });
+        return 0;
+    }
+
+    // Frobenius Matrix Norm
+    int __norm(double* n) const {
+        __dot(*this, n);
+        *n = std::sqrt(*n);
+        return 0;
+    }
+
+    // Subtraction: C = *this - B
+    int __sub(const FixedMatrix& B, FixedMatrix* C) const {
+        fixed::unroll<M*N>([&](ptrdiff_t k) {
+            C->_storage[k] = _storage[k] - B._storage[k];
+        });
+        return 0;
+    }
+
+    // Hyperbolic Tangent tanh(&A, mode)
+    int __tanh(const vmath::Accuracy mode) {
+        if (mode == vmath::HIGH) {
+            fixed::unroll<M*N>([&](ptrdiff_t k) {
+                _storage[k] = std::tanh(_storage[k]);
+            });
+        } else {
+            vmath::tanh(M*N, _storage, _storage, mode);
+        }
+        return 0;
+    }
+
+ private:
+    template <ptrdiff_t, ptrdiff_t> friend class FixedMatrix;
+
+    // Point the OperatorSet fields at the inline storage
+    void bind() {
+        this->_m = M;
+        this->_n = N;
+        this->_ld = N;
+        this->_data = _storage;
+    }
+
+    double _storage[M*N] = {};
+};
+
+// Fixed-size column vector
+template <ptrdiff_t N>
+using FixedVector = FixedMatrix<N, 1>;
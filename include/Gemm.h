@@ -0,0 +1,242 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#include "VMath.h"
+
+// Reference General Matrix-Matrix Multiply (row-major)
+//     C = alpha * op(A) * op(B) + beta * C
+//
+// op(A) is (m x k) and op(B) is (k x n). A and B are packed into
+// contiguous MR- and NR-wide panels, blocked to fit the L1/L2/L3 caches,
+// and each MR x NR tile of C is computed by a register-tiled microkernel
+// selected at runtime from the host's SIMD extensions. Single precision
+// (sgemm) has its own microkernels with twice the columns per register.
+namespace gemm {
+
+// Element-wise pass fused into dgemm
+//     C(i, j) = act(C(i, j) + bias)
+// Applied to each strip of C once its last k panel is accumulated, while
+// the strip is still in L1, instead of as separate passes over C.
+struct Epilogue {
+    // Bias added before the activation
+    //     NONE : no bias
+    //     ROW  : b[i*incb] added to row i, b has m elements
+    //     COL  : b[j*incb] added to column j, b has n elements
+    // b holds elements of C's type (double for dgemm, float for sgemm)
+    enum Bias { NONE, ROW, COL };
+
+    // Activation
+    //     IDENTITY : none
+    //     RELU     : max(x, 0)
+    //     TANH     : vmath::tanh with the given accuracy
+    //     CUSTOM   : fn(x, len, context) overwrites x[0:len] in place,
+    //                the float overload is used by sgemm
+    enum Activation { IDENTITY, RELU, TANH, CUSTOM };
+
+    Bias bias = NONE;
+    const void* b = nullptr;
+    ptrdiff_t incb = 1;
+
+    Activation activation = IDENTITY;
+    vmath::Accuracy accuracy = vmath::HIGH;
+    void (*fn)(double* x, ptrdiff_t len, void* context) = nullptr;
+    void (*fnf)(float* x, ptrdiff_t len, void* context) = nullptr;
+    void* context = nullptr;
+
+    static Epilogue relu() {
+        Epilogue e;
+        e.activation = RELU;
+        return e;
+    }
+
+    static Epilogue tanh(const vmath::Accuracy mode = vmath::HIGH) {
+        Epilogue e;
+        e.activation = TANH;
+        e.accuracy = mode;
+        return e;
+    }
+
+    static Epilogue custom(void (*fn)(double*, ptrdiff_t, void*),
+                           void* context = nullptr) {
+        Epilogue e;
+        e.activation = CUSTOM;
+        e.fn = fn;
+        e.context = context;
+        return e;
+    }
+
+    static Epilogue custom(void (*fn)(float*, ptrdiff_t, void*),
+                           void* context = nullptr) {
+        Epilogue e;
+        e.activation = CUSTOM;
+        e.fnf = fn;
+        e.context = context;
+        return e;
+    }
+
+    // True if a CUSTOM activation has a callback for elements of type S
+    template <typename S>
+    bool callable() const {
+        if constexpr (std::is_same_v<S, float>) return fnf != nullptr;
+        else
+            return fn != nullptr;
+    }
+
+    // True when the epilogue leaves C unchanged
+    bool empty() const { return bias == NONE && activation == IDENTITY; }
+};
+
+void dgemm(const bool transA, const bool transB,
+           const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+           const double alpha,
+           const double* A, const ptrdiff_t lda,
+           const double* B, const ptrdiff_t ldb,
+           const double beta,
+           double* C, const ptrdiff_t ldc);
+
+// C = act(alpha * op(A) * op(B) + beta * C + bias)
+void dgemm(const bool transA, const bool transB,
+           const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+           const double alpha,
+           const double* A, const ptrdiff_t lda,
+           const double* B, const ptrdiff_t ldb,
+           const double beta,
+           double* C, const ptrdiff_t ldc,
+           const Epilogue& epilogue);
+
+// Single precision: C = act(alpha * op(A) * op(B) + beta * C + bias)
+void sgemm(const bool transA, const bool transB,
+           const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+           const float alpha,
+           const float* A, const ptrdiff_t lda,
+           const float* B, const ptrdiff_t ldb,
+           const float beta,
+           float* C, const ptrdiff_t ldc,
+           const Epilogue& epilogue = Epilogue());
+
+// dgemm or sgemm by element type, for callers templated on it
+inline void gemm(const bool transA, const bool transB,
+                 const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+                 const double alpha,
+                 const double* A, const ptrdiff_t lda,
+                 const double* B, const ptrdiff_t ldb,
+                 const double beta,
+                 double* C, const ptrdiff_t ldc,
+                 const Epilogue& epilogue) {
+    dgemm(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc,
+          epilogue);
+}
+
+inline void gemm(const bool transA, const bool transB,
+                 const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+                 const double alpha,
+                 const float* A, const ptrdiff_t lda,
+                 const float* B, const ptrdiff_t ldb,
+                 const double beta,
+                 float* C, const ptrdiff_t ldc,
+                 const Epilogue& epilogue) {
+    sgemm(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc,
+          epilogue);
+}
+
+// General Matrix-Vector Multiply (row-major)
+//     y = alpha * op(A) * x + beta * y
+// A is (m x n), x and y have strides incx and incy (negative strides
+// follow the BLAS convention). y is not read when beta == 0. A is read
+// once, four rows at a time: y = A * x keeps two SIMD accumulators per
+// row, y = A^T * x updates each slice of y once per four rows. Rows of
+// A (or slices of y) are split across the ThreadPool.
+void dgemv(const bool trans, const ptrdiff_t m, const ptrdiff_t n,
+           const double alpha, const double* A, const ptrdiff_t lda,
+           const double* x, const ptrdiff_t incx,
+           const double beta, double* y, const ptrdiff_t incy);
+void sgemv(const bool trans, const ptrdiff_t m, const ptrdiff_t n,
+           const float alpha, const float* A, const ptrdiff_t lda,
+           const float* x, const ptrdiff_t incx,
+           const float beta, float* y, const ptrdiff_t incy);
+
+// dgemv or sgemv by element type
+inline void gemv(const bool trans, const ptrdiff_t m, const ptrdiff_t n,
+                 const double alpha, const double* A, const ptrdiff_t lda,
+                 const double* x, const ptrdiff_t incx,
+                 const double beta, double* y, const ptrdiff_t incy) {
+    dgemv(trans, m, n, alpha, A, lda, x, incx, beta, y, incy);
+}
+
+inline void gemv(const bool trans, const ptrdiff_t m, const ptrdiff_t n,
+                 const double alpha, const float* A, const ptrdiff_t lda,
+                 const float* x, const ptrdiff_t incx,
+                 const double beta, float* y, const ptrdiff_t incy) {
+    sgemv(trans, m, n, alpha, A, lda, x, incx, beta, y, incy);
+}
+
+// C = act(C + bias) as a single parallel pass over the (m x n) matrix C,
+// for backends whose GEMM cannot run the epilogue itself
+void epilogue(const Epilogue& e, const ptrdiff_t m, const ptrdiff_t n,
+              double* C, const ptrdiff_t ldc);
+void epilogue(const Epilogue& e, const ptrdiff_t m, const ptrdiff_t n,
+              float* C, const ptrdiff_t ldc);
+
+// Matrices per group of an interleaved batch
+constexpr ptrdiff_t LANES = 8;
+
+// Groups of LANES holding count matrices, the last one zero-padded
+inline ptrdiff_t groups(const ptrdiff_t count) {
+    return (count + LANES - 1) / LANES;
+}
+
+// Batched GEMM over an interleaved (structure of arrays) batch
+//     C[b] = alpha * op(A[b]) * op(B[b]) + beta * C[b],  b < count
+//
+// Each group of LANES matrices is stored element by element with the
+// matrices innermost, so element (i, j) of matrix b of an (r x c) operand
+// X is at
+//     X[(b / LANES)*r*c*LANES + (i*c + j)*LANES + b % LANES]
+// and the microkernel vectorizes across the batch. Operands hold
+// groups(count) full groups; padding lanes are computed but never read.
+void dgemmInterleaved(const bool transA, const bool transB,
+                      const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+                      const double alpha, const double* A, const double* B,
+                      const double beta, double* C, const ptrdiff_t count);
+
+// Largest dimension for which a batch of separate matrices is worth
+// interleaving, above it each product runs dgemm on its own
+constexpr ptrdiff_t INTERLEAVE_MAX = 8;
+
+// Y = interleaved copy of count (m x n) matrices X[b] with leading
+// dimension ldx, padding lanes are zeroed
+void interleave(const ptrdiff_t count, const ptrdiff_t m, const ptrdiff_t n,
+                const double* const* X, const ptrdiff_t ldx, double* Y);
+
+// X[b] = matrix b of the interleaved Y
+void deinterleave(const ptrdiff_t count, const ptrdiff_t m, const ptrdiff_t n,
+                  const double* Y, double* const* X, const ptrdiff_t ldx);
+
+// Register tile and cache blocks of a microkernel
+//     mr x nr : register tile of C, fixed by the microkernel
+//     mc x kc : block of op(A) kept in L2
+//     kc x nc : block of op(B) kept in L3
+struct Blocking {
+    ptrdiff_t mr, nr;
+    ptrdiff_t mc, kc, nc;
+};
+
+// Blocking of the active dgemm (single = false) or sgemm microkernel
+Blocking blocking(const bool single = false);
+
+// Override mc, kc and nc of the active microkernel, rounding mc and nc up
+// to multiples of mr and nr. Zeros restore the microkernel's defaults.
+// Set at load time from the tuning cache or the cache sizes, see Tuning.h.
+void blocking(const Blocking& b, const bool single = false);
+
+// Name of the active microkernel: "avx512", "avx2" or "generic"
+const char* kernel();
+
+// Force a microkernel by name, returns false if unsupported by the host
+bool kernel(const char* name);
+
+}  // namespace gemm
@@ -0,0 +1,651 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "Gemm.h"
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include "VMath.h"
+
+// Record-and-replay of a fixed sequence of operations
+//
+// A Graph records operations on Values, handles to external matrices
+// and to temporaries, instead of running them. compile() optimizes the
+// sequence once:
+//     - a transpose consumed only by products becomes their op() flag
+//     - a product consumed only by tanh applies it in its epilogue
+//     - chains of element-wise operations (hprod, add, msub, scale,
+//       tanh) ending in a temporary, maxpy or mcopy run as one pass
+//     - unused temporaries are dropped, and those that are not live at
+//       the same time share storage in one arena (see pack())
+// The resulting Plan allocates the arena once and replays the sequence
+// with no allocation.
+//
+// External matrices are used in place and must outlive the plan without
+// reallocating. Operands of element-wise operations must be contiguous.
+//
+// Example:
+//     graph::Graph<Matrix<T>> g;
+//     graph::Value w = g.input(&W), x = g.input(&X), y = g.input(&Y);
+//     graph::Value h = g.tanh(g.mprod(w, x));        // Fused epilogue
+//     graph::Value e = g.msub(h, y);                 // Fused with hprod
+//     g.mprod(false, false, -lr, g.hprod(e, h), g.transpose(x), 1.0, w);
+//     graph::Plan<Matrix<T>> plan = g.compile();
+//     for (int step = 0; step < steps; step++) plan.run();
+namespace graph {
+
+// Handle to a matrix recorded in a Graph
+struct Value {
+    int id = -1;
+};
+
+// Storage of a temporary live from step first to step last, inclusive
+struct Interval {
+    ptrdiff_t bytes;
+    ptrdiff_t first, last;
+};
+
+// Place buffers at 64-byte aligned offsets so that buffers live at the
+// same step do not overlap, largest first at the lowest free offset.
+// Returns the arena size in bytes.
+ptrdiff_t pack(const std::vector<Interval>& buffers,
+               std::vector<ptrdiff_t>* offsets);
+
+template <typename T>
+class Plan;
+
+template <typename T>
+class Graph {
+ public:
+    // External matrix, read or written in place when the plan runs
+    Value input(T* A) {
+        Node node(INPUT, A->rows(), A->cols());
+        node.external = A;
+        return add(node);
+    }
+
+    // op(A) * op(B) * alpha, a new temporary
+    Value mprod(const bool transA, const bool transB, const double alpha,
+                Value A, Value B) {
+        const Node &a = at(A), &b = at(B);
+        const ptrdiff_t k = transA ? a.m : a.n;
+        if (k != (transB ? b.n : b.m)) throw(1);
+        Node node(MPROD, transA ? a.n : a.m, transB ? b.m : b.n);
+        node.a = A.id;
+        node.b = B.id;
+        node.alpha = alpha;
+        node.transA = transA;
+        node.transB = transB;
+        return add(node);
+    }
+
+    Value mprod(Value A, Value B) { return mprod(false, false, 1.0, A, B); }
+
+    // C = alpha * op(A) * op(B) + beta * C, in place
+    void mprod(const bool transA, const bool transB, const double alpha,
+               Value A, Value B, const double beta, Value C) {
+        const Node &a = at(A), &b = at(B), &c = at(C);
+        if ((transA ? a.m : a.n) != (transB ? b.n : b.m)) throw(1);
+        if (c.m != (transA ? a.n : a.m)) throw(1);
+        if (c.n != (transB ? b.m : b.n)) throw(1);
+        Node node(MPRODINTO, 0, 0);
+        node.a = A.id;
+        node.b = B.id;
+        node.c = C.id;
+        node.alpha = alpha;
+        node.beta = beta;
+        node.transA = transA;
+        node.transB = transB;
+        add(node);
+    }
+
+    // X^T, a new temporary
+    Value transpose(Value X) {
+        Node node(TRANSPOSE, at(X).n, at(X).m);
+        node.a = X.id;
+        return add(node);
+    }
+
+    // Element-wise, new temporaries
+    Value hprod(Value A, Value B) { return binary(HPROD, A, B); }
+    Value add(Value A, Value B) { return binary(ADD, A, B); }
+    Value msub(Value A, Value B) { return binary(SUB, A, B); }
+
+    Value scale(const double alpha, Value A) {
+        Node node(SCALE, at(A).m, at(A).n);
+        node.a = A.id;
+        node.alpha = alpha;
+        return add(node);
+    }
+
+    Value tanh(Value A, const vmath::Accuracy mode = vmath::HIGH) {
+        Node node(TANH, at(A).m, at(A).n);
+        node.a = A.id;
+        node.mode = mode;
+        return add(node);
+    }
+
+    // B += alpha * A, in place
+    void maxpy(const double alpha, Value A, Value B) {
+        if (at(A).m != at(B).m || at(A).n != at(B).n) throw(1);
+        Node node(AXPY, 0, 0);
+        node.a = A.id;
+        node.c = B.id;
+        node.alpha = alpha;
+        add(node);
+    }
+
+    // A += alpha * x * y^T, in place
+    void mger(const double alpha, Value x, Value y, Value A) {
+        if (at(x).m * at(x).n != at(A).m) throw(1);
+        if (at(y).m * at(y).n != at(A).n) throw(1);
+        Node node(GER, 0, 0);
+        node.a = x.id;
+        node.b = y.id;
+        node.c = A.id;
+        node.alpha = alpha;
+        add(node);
+    }
+
+    // B = A, in place
+    void mcopy(Value A, Value B) {
+        if (at(A).m != at(B).m || at(A).n != at(B).n) throw(1);
+        Node node(COPY, 0, 0);
+        node.a = A.id;
+        node.c = B.id;
+        add(node);
+    }
+
+    // Keep the temporary after run(), see Plan::view()
+    void output(Value v) { at(v).output = true; }
+
+    ptrdiff_t rows(Value v) const { return at(v).m; }
+    ptrdiff_t cols(Value v) const { return at(v).n; }
+
+    Plan<T> compile() const { return Plan<T>(_nodes); }
+
+ private:
+    friend class Plan<T>;
+
+    enum Kind { INPUT, MPROD, TRANSPOSE, HPROD, ADD, SUB, SCALE, TANH,
+                AXPY, GER, COPY, MPRODINTO };
+
+    // A recorded operation. Values are the nodes of kinds INPUT through
+    // TANH, identified by their index; the others write operand c.
+    struct Node {
+        Node(Kind kind, ptrdiff_t m, ptrdiff_t n) : kind(kind), m(m), n(n) {}
+
+        Kind kind;
+        ptrdiff_t m, n;          // Shape of the value
+        int a = -1, b = -1, c = -1;
+        double alpha = 1, beta = 0;
+        bool transA = false, transB = false;
+        bool tanh = false;       // Product epilogue, set by compile()
+        vmath::Accuracy mode = vmath::HIGH;
+        T* external = nullptr;
+        bool output = false;
+    };
+
+    Value add(const Node& node) {
+        _nodes.push_back(node);
+        return Value{static_cast<int>(_nodes.size()) - 1};
+    }
+
+    Value binary(Kind kind, Value A, Value B) {
+        if (at(A).m != at(B).m || at(A).n != at(B).n) throw(1);
+        Node node(kind, at(A).m, at(A).n);
+        node.a = A.id;
+        node.b = B.id;
+        return add(node);
+    }
+
+    Node& at(Value v) {
+        if (v.id < 0 || v.id >= static_cast<int>(_nodes.size())) throw(1);
+        if (_nodes[v.id].kind > TANH) throw(1);
+        return _nodes[v.id];
+    }
+    const Node& at(Value v) const {
+        return const_cast<Graph*>(this)->at(v);
+    }
+
+    std::vector<Node> _nodes;
+};
+
+// Element-wise program over contiguous arrays of n elements, evaluated
+// in blocks that stay in L1. Instruction r writes register r; operands
+// are registers (>= 0) or leaf arrays (-1 - leaf). The last instruction
+// stores to out, or is accumulated as out += alpha * r.
+template <typename S>
+struct Program {
+    static constexpr int REGISTERS = 8;
+    static constexpr ptrdiff_t BLOCK = 256;
+    static constexpr int NONE = -0x7fffffff;
+
+    enum Op { HPROD, ADD, SUB, SCALE, TANH };
+
+    struct Instruction {
+        Op op;
+        int a, b;
+        S alpha;
+        vmath::Accuracy mode;
+    };
+
+    std::vector<Instruction> code;
+    std::vector<const S*> leaves;
+    S* out = nullptr;
+    bool accumulate = false;
+    S alpha = 1;
+    ptrdiff_t n = 0;
+
+    void run() const {
+        const ptrdiff_t blocks = (n + BLOCK - 1) / BLOCK;
+        const ptrdiff_t grain =
+            std::max<ptrdiff_t>(1, ThreadPool::grain() / BLOCK);
+        parallel_for(blocks, grain, [&](ptrdiff_t b0, ptrdiff_t b1) {
+            alignas(64) S registers[REGISTERS][BLOCK];
+            for (ptrdiff_t b = b0; b < b1; b++) block(b, registers);
+        });
+    }
+
+ private:
+    void block(const ptrdiff_t b, S (*registers)[BLOCK]) const {
+        const ptrdiff_t i0 = b * BLOCK, len = std::min(BLOCK, n - i0);
+        const int last = static_cast<int>(code.size()) - 1;
+        auto operand = [&](int r) -> const S* {
+            return r >= 0 ? registers[r] : leaves[-1 - r] + i0;
+        };
+        for (int r = 0; r <= last; r++) {
+            const Instruction& in = code[r];
+            const S* x = operand(in.a);
+            const S* y = in.b == NONE ? nullptr : operand(in.b);
+            S* z = (r == last && !accumulate) ? out + i0 : registers[r];
+            switch (in.op) {
+                case HPROD:
+                    for (ptrdiff_t i = 0; i < len; i++) z[i] = x[i] * y[i];
+                    break;
+                case ADD:
+                    for (ptrdiff_t i = 0; i < len; i++) z[i] = x[i] + y[i];
+                    break;
+                case SUB:
+                    for (ptrdiff_t i = 0; i < len; i++) z[i] = x[i] - y[i];
+                    break;
+                case SCALE:
+                    for (ptrdiff_t i = 0; i < len; i++) z[i] = in.alpha * x[i];
+                    break;
+                case TANH:
+                    vmath::tanh(len, x, z, in.mode);
+                    break;
+            }
+        }
+        if (accumulate) {
+            const S* r = registers[last];
+            S* z = out + i0;
+            for (ptrdiff_t i = 0; i < len; i++) z[i] += alpha * r[i];
+        }
+    }
+};
+
+// Compiled Graph: replays the recorded operations with no allocation
+template <typename T>
+class Plan {
+ public:
+    using Scalar = typename T::Scalar;
+    using View = typename T::View;
+
+    Plan(Plan&&) = default;
+    Plan(const Plan&) = delete;
+    Plan& operator=(const Plan&) = delete;
+
+    // Run every operation once, in recorded order
+    void run() {
+        for (const std::function<void()>& step : _steps) step();
+    }
+
+    // Storage of an input, or of a value marked as an output
+    const View& view(Value v) const {
+        if (v.id < 0 || v.id >= static_cast<int>(_alias.size())) throw(1);
+        const int id = _alias[v.id];
+        if (!_kept[id]) throw(1);
+        return _views[id];
+    }
+
+    // Operations run per replay, after folding and fusion
+    size_t steps() const { return _steps.size(); }
+
+    // Bytes of the shared arena, and of the temporaries without sharing
+    ptrdiff_t arenaBytes() const { return _arenaBytes; }
+    ptrdiff_t temporaryBytes() const { return _temporaryBytes; }
+
+ private:
+    friend class Graph<T>;
+    using G = Graph<T>;
+    using Node = typename G::Node;
+
+    explicit Plan(std::vector<Node> nodes);
+
+    static bool elementwise(const Node& node) {
+        return node.kind >= G::HPROD && node.kind <= G::TANH;
+    }
+
+    // Values a node reads; in-place updates also read their destination
+    static std::vector<int> reads(const Node& node) {
+        std::vector<int> r;
+        if (node.a >= 0) r.push_back(node.a);
+        if (node.b >= 0) r.push_back(node.b);
+        if (node.kind == G::AXPY || node.kind == G::GER ||
+            (node.kind == G::MPRODINTO && node.beta != 0)) {
+            r.push_back(node.c);
+        }
+        return r;
+    }
+
+    // True if a live node in (first, last) writes v's storage in place
+    bool written(int v, int first, int last) const {
+        for (int k = first + 1; k < last; k++) {
+            const int c = _nodes[k].c;
+            if (!_dead[k] && c >= 0 && same(c, v)) return true;
+        }
+        return false;
+    }
+
+    // True if u and v are stored in the same matrix
+    bool same(int u, int v) const {
+        if (_alias[u] == _alias[v]) return true;
+        const T* a = _nodes[_alias[u]].external;
+        return a != nullptr && a == _nodes[_alias[v]].external;
+    }
+
+    // Live nodes reading v
+    std::vector<int> consumers(int v) const {
+        std::vector<int> c;
+        for (int k = v + 1; k < static_cast<int>(_nodes.size()); k++) {
+            if (_dead[k]) continue;
+            const std::vector<int> r = reads(_nodes[k]);
+            if (std::find(r.begin(), r.end(), v) != r.end()) c.push_back(k);
+        }
+        return c;
+    }
+
+    // Operands of v's fused group that are not inlined into it
+    void leaves(int v, std::vector<int>* out) const {
+        for (int o : {_nodes[v].a, _nodes[v].b}) {
+            if (o < 0) continue;
+            if (_inlined[o]) {
+                leaves(o, out);
+            } else {
+                out->push_back(o);
+            }
+        }
+    }
+
+    // Earliest node of v's fused group
+    int earliest(int v) const {
+        int first = v;
+        for (int o : {_nodes[v].a, _nodes[v].b}) {
+            if (o >= 0 && _inlined[o]) first = std::min(first, earliest(o));
+        }
+        return first;
+    }
+
+    // Append the group computing v to p, returns v's operand index
+    int emit(int v, bool root, Program<Scalar>* p) const {
+        if (!root && !_inlined[v]) {
+            p->leaves.push_back(_views[v]);
+            return -static_cast<int>(p->leaves.size());
+        }
+        const Node& node = _nodes[v];
+        typename Program<Scalar>::Instruction in;
+        in.a = emit(node.a, false, p);
+        in.b = node.b >= 0 ? emit(node.b, false, p) : Program<Scalar>::NONE;
+        in.alpha = node.alpha;
+        in.mode = node.mode;
+        switch (node.kind) {
+            case G::HPROD: in.op = Program<Scalar>::HPROD; break;
+            case G::ADD: in.op = Program<Scalar>::ADD; break;
+            case G::SUB: in.op = Program<Scalar>::SUB; break;
+            case G::SCALE: in.op = Program<Scalar>::SCALE; break;
+            default: in.op = Program<Scalar>::TANH; break;
+        }
+        p->code.push_back(in);
+        return static_cast<int>(p->code.size()) - 1;
+    }
+
+    // Program of a fused step rooted at node k
+    Program<Scalar> program(int k) const {
+        const Node& node = _nodes[k];
+        Program<Scalar> p;
+        std::vector<int> operands;
+        if (elementwise(node)) {
+            emit(k, true, &p);
+            p.out = _views[k];
+            p.n = node.m * node.n;
+            leaves(k, &operands);
+            operands.push_back(k);
+        } else {
+            emit(node.a, true, &p);
+            p.out = _views[node.c];
+            p.n = numel(_views[node.c]);
+            p.accumulate = node.kind == G::AXPY;
+            p.alpha = node.alpha;
+            leaves(node.a, &operands);
+            operands.push_back(node.c);
+        }
+        for (int o : operands) {
+            if (!_views[o].contiguous()) throw(1);
+        }
+        return p;
+    }
+
+    std::vector<Node> _nodes;       // After folding and fusion
+    std::vector<bool> _dead;        // Folded, fused into a product, unused
+    std::vector<bool> _inlined;     // Evaluated inside its consumer
+    std::vector<int> _alias;        // Value whose storage holds a value
+    std::vector<bool> _kept;        // Inputs and outputs
+    std::vector<View> _views;       // Per value, empty if not stored
+    std::vector<std::function<void()>> _steps;
+    T _arena;
+    ptrdiff_t _arenaBytes = 0, _temporaryBytes = 0;
+};
+
+template <typename T>
+Plan<T>::Plan(std::vector<Node> nodes) : _nodes(std::move(nodes)),
+                                         _arena(EMPTY) {
+    const int N = _nodes.size();
+    _dead.assign(N, false);
+    _inlined.assign(N, false);
+    _alias.resize(N);
+    for (int v = 0; v < N; v++) _alias[v] = v;
+
+    // A transpose read only as a product operand becomes its op() flag,
+    // unless the product writes the transposed matrix
+    for (int t = 0; t < N; t++) {
+        if (_nodes[t].kind != G::TRANSPOSE || _nodes[t].output) continue;
+        const int x = _nodes[t].a;
+        const std::vector<int> uses = consumers(t);
+        bool fold = !written(t, t, N);
+        for (int k : uses) {
+            const Node& node = _nodes[k];
+            fold = fold && (node.kind == G::MPROD || node.kind == G::MPRODINTO)
+                        && node.c != t && (node.c < 0 || !same(node.c, x))
+                        && !written(x, t, k);
+        }
+        if (!fold) continue;
+        for (int k : uses) {
+            if (_nodes[k].a == t) {
+                _nodes[k].a = x;
+                _nodes[k].transA = !_nodes[k].transA;
+            }
+            if (_nodes[k].b == t) {
+                _nodes[k].b = x;
+                _nodes[k].transB = !_nodes[k].transB;
+            }
+        }
+        _dead[t] = true;
+    }
+
+    // A product read only by tanh applies it in its epilogue
+    for (int p = 0; p < N; p++) {
+        if (_dead[p] || _nodes[p].kind != G::MPROD || _nodes[p].output)
+            continue;
+        const std::vector<int> uses = consumers(p);
+        if (uses.size() != 1 || _nodes[uses[0]].kind != G::TANH) continue;
+        if (written(p, p, N)) continue;
+        const int u = uses[0];
+        _nodes[p].tanh = true;
+        _nodes[p].mode = _nodes[u].mode;
+        _nodes[p].output = _nodes[u].output;
+        for (int k = u + 1; k < N; k++) {
+            if (_nodes[k].a == u) _nodes[k].a = p;
+            if (_nodes[k].b == u) _nodes[k].b = p;
+            if (_nodes[k].c == u) _nodes[k].c = p;
+        }
+        _dead[u] = true;
+        _alias[u] = p;
+    }
+
+    // Drop values nothing reads, and writes to temporaries nothing reads
+    // afterwards
+    for (int v = N - 1; v >= 0; v--) {
+        const Node& node = _nodes[v];
+        if (_dead[v] || node.kind == G::INPUT) continue;
+        if (node.kind > G::TANH) {
+            const Node& c = _nodes[node.c];
+            if (c.kind == G::INPUT || c.output) continue;
+            const std::vector<int> uses = consumers(node.c);
+            if (std::upper_bound(uses.begin(), uses.end(), v) == uses.end())
+                _dead[v] = true;
+            continue;
+        }
+        if (!node.output && consumers(v).empty()) _dead[v] = true;
+    }
+
+    // An element-wise value read once, by an element-wise operation,
+    // maxpy or mcopy, is evaluated inside it when nothing writes the
+    // value or its group's leaves in between and the registers suffice
+    std::vector<int> size(N, 0);
+    for (int k = 0; k < N; k++) {
+        const Node& node = _nodes[k];
+        if (_dead[k]) continue;
+        if (!elementwise(node) && node.kind != G::AXPY && node.kind != G::COPY)
+            continue;
+        size[k] = elementwise(node);
+        for (int o : {node.a, elementwise(node) ? node.b : -1}) {
+            if (o < 0 || _inlined[o] || !elementwise(_nodes[o])) continue;
+            if (_nodes[o].output || consumers(o).size() != 1) continue;
+            if (size[k] + size[o] > Program<Scalar>::REGISTERS) continue;
+            std::vector<int> group;
+            leaves(o, &group);
+            group.push_back(o);
+            bool safe = true;
+            for (int g : group) safe = safe && !written(g, earliest(o), k);
+            if (!safe) continue;
+            _inlined[o] = true;
+            size[k] += size[o];
+        }
+    }
+
+    // One step per live node not inlined into another. Inlined nodes
+    // run at the step of their consumer.
+    std::vector<int> step(N, -1), order;
+    for (int k = 0; k < N; k++) {
+        if (_dead[k] || _inlined[k] || _nodes[k].kind == G::INPUT) continue;
+        step[k] = order.size();
+        order.push_back(k);
+    }
+    for (int k = N - 1; k >= 0; k--) {
+        if (!_dead[k] && _inlined[k]) step[k] = step[consumers(k)[0]];
+    }
+
+    // Temporaries live from their step to the last step using them
+    std::vector<int> stored;
+    std::vector<Interval> intervals;
+    for (int v = 0; v < N; v++) {
+        const Node& node = _nodes[v];
+        if (step[v] < 0 || _inlined[v] || node.kind > G::TANH) continue;
+        Interval interval{static_cast<ptrdiff_t>(node.m * node.n *
+                                                 sizeof(Scalar)),
+                          step[v], step[v]};
+        for (int k : consumers(v))
+            interval.last = std::max<ptrdiff_t>(interval.last, step[k]);
+        for (int k = v + 1; k < N; k++) {
+            if (!_dead[k] && _nodes[k].c == v)
+                interval.last = std::max<ptrdiff_t>(interval.last, step[k]);
+        }
+        if (node.output) interval.last = order.size();
+        stored.push_back(v);
+        intervals.push_back(interval);
+        _temporaryBytes += interval.bytes;
+    }
+    std::vector<ptrdiff_t> offsets;
+    _arenaBytes = pack(intervals, &offsets);
+    _arena = T(_arenaBytes / sizeof(Scalar), 1);
+
+    std::vector<Scalar*> data(N, nullptr);
+    for (size_t i = 0; i < stored.size(); i++) {
+        data[stored[i]] = static_cast<Scalar*>(_arena)
+                        + offsets[i] / sizeof(Scalar);
+    }
+    _kept.assign(N, false);
+    _views.reserve(N);
+    for (int v = 0; v < N; v++) {
+        const Node& node = _nodes[v];
+        if (node.kind == G::INPUT) {
+            const T& A = *node.external;
+            _views.emplace_back(A, A.rows(), A.cols(), A.ld());
+            _kept[v] = true;
+        } else if (data[v] != nullptr) {
+            _views.emplace_back(data[v], node.m, node.n, node.n);
+            _kept[v] = node.output;
+        } else {
+            _views.emplace_back(nullptr, 0, 0, 0);
+        }
+    }
+
+    // Steps capture views by address, which moving the plan preserves
+    View* views = _views.data();
+    for (int k : order) {
+        const Node node = _nodes[k];
+        const bool fused = node.kind == G::AXPY || node.kind == G::COPY ?
+                           _inlined[node.a] : elementwise(node);
+        if (fused) {
+            const Program<Scalar> p = program(k);
+            _steps.push_back([p] { p.run(); });
+            continue;
+        }
+        const View* a = node.a >= 0 ? views + node.a : nullptr;
+        const View* b = node.b >= 0 ? views + node.b : nullptr;
+        View* c = views + (node.c >= 0 ? node.c : k);
+        switch (node.kind) {
+            case G::MPROD:
+            case G::MPRODINTO: {
+                const gemm::Epilogue epilogue = node.tanh ?
+                    gemm::Epilogue::tanh(node.mode) : gemm::Epilogue();
+                _steps.push_back([=] {
+                    mprod(node.transA, node.transB, node.alpha, *a, *b,
+                          node.beta, c, epilogue);
+                });
+                break;
+            }
+            case G::TRANSPOSE:
+                _steps.push_back([=] { transpose(*a, c); });
+                break;
+            case G::AXPY:
+                _steps.push_back([=] { maxpy(node.alpha, *a, 1, c); });
+                break;
+            case G::GER:
+                _steps.push_back([=] { mger(node.alpha, *a, *b, c); });
+                break;
+            case G::COPY:
+                _steps.push_back([=] { mcopy(*a, c); });
+                break;
+            default:
+                throw(1);
+        }
+    }
+}
+
+}  // namespace graph
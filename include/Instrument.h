@@ -0,0 +1,94 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+enum BLAS : int;
+
+// Allocation and memory traffic of Matrix<T, S>
+//
+// Matrix<T, S>::__alloc, __dealloc and __copy report to the counters
+// below, per backend (AUTO allocations count as AUTO, its copies as the
+// backend they are forwarded to) and per thread. Event counting is opt-in
+// (enable(), MATRIX_INSTRUMENT=1 in the environment, or a Scope on the
+// calling thread). The live and peak byte gauges are always kept, so
+// production code can scrape them with write(); while counting is off an
+// allocation hook still costs two relaxed fetch_adds and a peak
+// compare-exchange on shared atomics.
+//
+// Example:
+//     instrument::Scope scope;      // Counts on this thread while alive
+//     Matrix<T> C = A + B;
+//     scope.delta().allocations     // 1
+namespace instrument {
+
+// Backends counted, indexed by BLAS
+constexpr int BACKENDS = 5;
+
+// Events, zero-initialized
+struct Counters {
+    int64_t allocations = 0;    // __alloc of at least one element
+    int64_t deallocations = 0;  // __dealloc of owned storage
+    int64_t bytes = 0;          // Allocated
+    int64_t freedBytes = 0;     // Deallocated
+    int64_t copies = 0;         // Deep copies, __copy
+    int64_t copiedBytes = 0;    // Written by __copy
+
+    Counters& operator+=(const Counters& c);
+    Counters operator-(const Counters& c) const;
+};
+
+// Process-wide event counting, off unless MATRIX_INSTRUMENT is set to a
+// nonzero value. enabled() is also true on a thread inside a Scope.
+void enable(bool on = true);
+bool enabled();
+
+// Events since the last reset(): process-wide or on the calling thread,
+// for one backend or summed over all
+Counters counters();
+Counters counters(BLAS backend);
+Counters threadCounters();
+Counters threadCounters(BLAS backend);
+
+// Zero the process-wide events and the calling thread's, and restart the
+// peaks at the live bytes
+void reset();
+
+// Bytes held by live matrices, and the most held at once since reset()
+int64_t liveBytes();
+int64_t liveBytes(BLAS backend);
+int64_t peakBytes();
+int64_t peakBytes(BLAS backend);
+
+// Gauges and process-wide events, one line per counter and backend in
+// the Prometheus text format, e.g.
+//     matrix_live_bytes{backend="REF"} 8192
+void write(std::ostream& os);
+
+// Counting on the calling thread for the lifetime of a scope, other
+// threads are unaffected. Nested scopes each see their own delta.
+class Scope {
+ public:
+    Scope();
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    // Events on this thread since construction
+    Counters delta() const;
+    Counters delta(BLAS backend) const;
+
+ private:
+    Counters _start[BACKENDS];
+};
+
+// Hooks called by Matrix<T, S>
+void allocated(int backend, size_t bytes);
+void deallocated(int backend, size_t bytes);
+void copied(int backend, size_t bytes);
+
+}  // namespace instrument
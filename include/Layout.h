@@ -0,0 +1,51 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+
+// Memory layout kernels (row-major)
+//
+// Transposes recurse on the larger dimension down to block() x block()
+// tiles that fit in L1 together with their destination, and each tile moves as
+// W x W register blocks transposed with SIMD shuffles, W = 8 (avx512),
+// 4 (avx2, generic) in double precision and W = 8 (avx512, avx2), 4
+// (generic) in single precision. Large transposes split into row panels
+// across the ThreadPool.
+namespace layout {
+
+// Tile edge of the cache-oblivious recursion, 32 by default. Set at load
+// time from the tuning cache or the L1 size, see Tuning.h.
+ptrdiff_t block();
+
+// Set the tile edge, rounded down to a multiple of 8 (at least 8)
+void block(ptrdiff_t n);
+
+// B = A^T, A is (m x n) with leading dimension lda, B is (n x m) with
+// leading dimension ldb. A and B must not overlap.
+void transpose(const ptrdiff_t m, const ptrdiff_t n,
+               const double* A, const ptrdiff_t lda,
+               double* B, const ptrdiff_t ldb);
+void transpose(const ptrdiff_t m, const ptrdiff_t n,
+               const float* A, const ptrdiff_t lda,
+               float* B, const ptrdiff_t ldb);
+
+// A = A^T in place, A is (n x n) with leading dimension lda. Tiles above
+// the diagonal are swapped with their mirror tiles, so no buffer is used.
+void transposeSquare(const ptrdiff_t n, double* A, const ptrdiff_t lda);
+void transposeSquare(const ptrdiff_t n, float* A, const ptrdiff_t lda);
+
+// A = A^T in place, A is a contiguous (m x n) array that becomes a
+// contiguous (n x m) array. Elements are moved along the cycles of the
+// permutation k -> k*m mod (m*n - 1), with one bit per element to mark
+// visited positions (1/64 of the matrix). Serial.
+void transposeInPlace(const ptrdiff_t m, const ptrdiff_t n, double* A);
+void transposeInPlace(const ptrdiff_t m, const ptrdiff_t n, float* A);
+
+// Name of the active SIMD kernel: "avx512", "avx2" or "generic"
+const char* kernel();
+
+// Force a SIMD kernel by name, returns false if unsupported by the host
+bool kernel(const char* name);
+
+}  // namespace layout
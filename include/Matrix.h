@@ -2,112 +2,209 @@
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
-#include <random>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "Allocator.h"
+#include "Dispatch.h"
+#include "Gemm.h"
+#include "Instrument.h"
 #include "OperatorSet.h"
+#include "Random.h"
+#include "ThreadPool.h"
 
 // BLAS Libraries
 // REF : Reference Implementation
 // ACC : Apple Accelerate Framework
 // OPB : OpenBLAS
 // MKL : Intel's Math Kernel Library
-enum BLAS { REF, ACC, OPB, MKL };
+// AUTO: Per operation and size, whichever of the above is fastest (see
+//       Dispatch.h)
+enum BLAS : int { REF, ACC, OPB, MKL, AUTO };
+
+// Storage policy for Matrix<T>, see Allocator.h.
+// Specialize to change how a backend allocates, e.g.
+//     template <> struct MatrixAllocator<MKL> { using type = MyPolicy; };
+template <BLAS T>
+struct MatrixAllocator {
+    using type = PoolAllocator;
+};
 
 // Maps BLAS::MKL to "MKL"
 std::ostream& operator<<(std::ostream& os, BLAS type);
 
+// Matrix<T, S> holds elements of type S, double (default) or float. Every
+// backend dispatches to the matching BLAS precision (e.g. dgemm / sgemm).
+template <BLAS T, Real S = double>
+class Matrix;
+
+template <BLAS T, Real S>
+struct ScalarType<Matrix<T, S>> {
+    using type = S;
+};
+
+template <BLAS T, Real S>
+struct BackendType<Matrix<T, S>> {
+    static constexpr int value = T;
+};
+
+// Process-wide thread count for the REF pool and the OPB/MKL backends.
+// Defaults to MATRIX_NUM_THREADS, or the hardware concurrency if unset.
+void setNumThreads(int n);
+int getNumThreads();
+
 // Matrix Library
-template <BLAS T>
-class Matrix : public OperatorSet<Matrix<T>> {
+template <BLAS T, Real S>
+class Matrix : public OperatorSet<Matrix<T, S>> {
  public:
     // Access Parent Constructors
-    using OperatorSet<Matrix<T>>::OperatorSet;
+    using OperatorSet<Matrix<T, S>>::OperatorSet;
 
     // Deep Copy Constructor: MatrixMKL A(B);
-    explicit Matrix<T>(const Matrix<T>& B)
-            : OperatorSet<Matrix<T>>(B) {}
+    explicit Matrix(const Matrix<T, S>& B)
+            : OperatorSet<Matrix<T, S>>(B) {}
 
     // Move Constructor: MatrixMKL(std::move(B));
     // Needed for Return Value Optimization
-    Matrix(Matrix<T>&& B)
-        : OperatorSet<Matrix<T>>(std::move(B)) {}
+    Matrix(Matrix<T, S>&& B)
+        : OperatorSet<Matrix<T, S>>(std::move(B)) {}
 
-    using OperatorSet<Matrix<T>>::operator=;
+    using OperatorSet<Matrix<T, S>>::operator=;
 
     // Deep Copy Assignment: A = B
     // Disabled to avoid accidental copy assignment
     // Use copy operator instead (e.g. A = Matrix(B))
-    Matrix<T>& operator=(const Matrix<T>& B) = delete;
+    Matrix<T, S>& operator=(const Matrix<T, S>& B) = delete;
 
-    // Random matrix generator
-    static Matrix<T> randn(ptrdiff_t m, ptrdiff_t n = 1) {
-        Matrix<T> A(m, n);
-        for (ptrdiff_t i = 0; i < numel(A); i++) {
-            static_cast<double*>(A)[i] = Matrix<T>::randn();
-        }
+    // Random matrix generator, elements ~ N(0, 1) from the process-wide
+    // generator (see Random.h, MATRIX_SEED)
+    static Matrix<T, S> randn(ptrdiff_t m, ptrdiff_t n = 1) {
+        return randn(m, n, rng::global());
+    }
+
+    // Reproducible: the same seed, stream and draws give the same matrix
+    // for any thread count
+    static Matrix<T, S> randn(ptrdiff_t m, ptrdiff_t n, rng::Generator& g) {
+        Matrix<T, S> A(m, n);
+        A.__randn(&g);
         return A;
     }
 
     // Random number generator
     static double randn() {
-        static std::random_device rd {};
-        static std::mt19937 gen {rd()};
-        static std::normal_distribution<> d{0, 1};
-        return d(gen);
+        return rng::global().normal();
     }
 
+    // Thread Count: forwards setNumThreads() to the backend's own pool
+    static int __threads(const int n);
+
     // Matrix Pointer -> Ctor / Dtor Does Not Allocate / Deallocate 
     class Ptr;
 
     // Allocate Memory
     int __alloc();
 
+    // Absolute Sum: *s = sum(|A|)
+    int __asum(double* s) const;
+
+    // Broadcast: C = *this op v, v spans the rows or columns (see
+    // broadcast::Axis), v[i*incv] for ROW. C may be *this.
+    int __broadcast(const broadcast::Op op, const broadcast::Axis axis,
+                    const S* v, const ptrdiff_t incv, Matrix<T, S>* C) const;
+
+    // Matrix over a memory-mapped file, see MatrixFile.h
+    class Mapped;
+
+    // Strided, Non-Owning Window: A.block(i, j, m, n)
+    class View;
+
+    // Deep Copy of a temporary View: Matrix<T> A(X.colBlock(0, 3));
+    Matrix(View&& V);
+
+    // Deep Copy Assignment of a temporary View: A = X.row(i);
+    Matrix<T, S>& operator=(View&& V);
+
     // Deep Copy: *this = A
-    int __copy(double* A, const ptrdiff_t inca);
+    // Element (i, j) of A is A[i*lda + j*inca]
+    int __copy(const S* A, const ptrdiff_t inca, const ptrdiff_t lda);
 
     // DAXPY: A = A + alpha * B
-    int __daxpy(const double alpha, const double* B, const ptrdiff_t incb);
+    // Element (i, j) of B is B[i*ldb + j*incb]
+    int __daxpy(const double alpha, const S* B, const ptrdiff_t incb,
+                const ptrdiff_t ldb);
 
     // DGER: A += x * y^T
-    int __dger(const double alpha, const Matrix<T>& x, const Matrix<T>& y);
+    int __dger(const double alpha, const Matrix<T, S>& x,
+               const Matrix<T, S>& y);
 
     // Deallocate Memory
     int __dealloc();
 
     // Doc Product
-    int __dot(const Matrix<T>& B, double* d) const;
+    int __dot(const Matrix<T, S>& B, double* d) const;
 
     // Hadamard Product
-    int __hprod(const Matrix<T>& B, Matrix<T>* C) const;
+    int __hprod(const Matrix<T, S>& B, Matrix<T, S>* C) const;
+
+    // Absolute Maximum: *i = row-major position of the first largest |A|
+    int __iamax(ptrdiff_t* i) const;
 
-    // Matrix-Matrix Multiply: C = *this * B
+    // Matrix-Matrix Multiply: C = act(alpha * op(*this) * op(B) + beta * C
+    // + bias), see gemm::Epilogue
     int __mult(const bool transA, const bool transB, const double alpha,
-               const Matrix<T>& B, Matrix<T>* C) const;
+               const Matrix<T, S>& B, const double beta, Matrix<T, S>* C,
+               const gemm::Epilogue& epilogue) const;
 
     // Scalar-Matrix Multiply: *this = alpha * (*this)
     int __mult(const double alpha);
 
+    // Matrix-Vector Multiply: y = alpha * op(*this) * x + beta * y
+    // x and y have strides incx and incy
+    int __gemv(const bool trans, const double alpha, const S* x,
+               const ptrdiff_t incx, const double beta, S* y,
+               const ptrdiff_t incy) const;
+
+    // Batched Matrix-Matrix Multiply: C[b] = A[b] * B[b], b < count
+    static int __multBatched(const bool transA, const bool transB,
+                             const double alpha, const Matrix<T, S>* A,
+                             const Matrix<T, S>* B, Matrix<T, S>* C,
+                             const ptrdiff_t count);
+
     // Frobenius Matrix Norm
     int __norm(double* n) const;
 
+    // Normal Fill: *this ~ N(0, 1) from g's next counters
+    int __randn(rng::Generator* g);
+
+    // Row (rows) or Column Reduction: y[i] = op(row or column i), index[i]
+    // the position of ARGMAX / ARGMIN. y may be null for those.
+    int __reduce(const reduce::Op op, const bool rows, S* y,
+                 ptrdiff_t* index) const;
+
     // Subtraction: *this -= B
-    int __sub(const Matrix<T>& B, Matrix<T>* C) const;
+    int __sub(const Matrix<T, S>& B, Matrix<T, S>* C) const;
+
+    // Sum: *s = sum(A)
+    int __sum(double* s) const;
 
-    // Hyperbolic Tangent tanh(&A)
-    int __tanh();
+    // Hyperbolic Tangent tanh(&A, mode)
+    int __tanh(const vmath::Accuracy mode);
 };
 
 // Matrix Pointer -> Ctor / Dtor Does Not Allocate / Deallocate 
-template <BLAS T>
-class Matrix<T>::Ptr : public Matrix<T> {
+template <BLAS T, Real S>
+class Matrix<T, S>::Ptr : public Matrix<T, S> {
 public:
-    Ptr(double* data, ptrdiff_t m, ptrdiff_t n) {
+    Ptr(S* data, ptrdiff_t m, ptrdiff_t n) {
         // Skip Matrix() ctor to skip allocation
+        this->_view = true;
         this->_data = data;
         this->_m = m;
         this->_n = n;
+        this->_ld = n;
     }
 
     ~Ptr() {
@@ -115,110 +212,590 @@ public:
         this->_data = NULL;
         this->_m = 0;
         this->_n = 0;
+        this->_ld = 0;
     }
 };
 
+// Strided, non-owning (m x n) window whose rows are ld elements apart.
+// Views are accepted wherever a Matrix<T> is, and write through to the
+// viewed storage, which must outlive the view.
+//
+// Example:
+//     Matrix<T> X(100, 10);
+//     auto batch = X.rowBlock(32, 16);  // Rows 32..47
+//     auto y = Y.colBlock(0, 5);        // Columns 0..4
+//     mprod(batch, W, &y);              // Y[:, 0:5] = batch * W
+//
+// A Matrix<T> built or assigned from a temporary or moved-from View,
+// including the result of an rvalue operator such as 2.0 * X.row(i),
+// copies its elements, since the view does not own its storage.
+template <BLAS T, Real S>
+class Matrix<T, S>::View : public Matrix<T, S> {
+ public:
+    View(S* data, ptrdiff_t m, ptrdiff_t n, ptrdiff_t ld)
+            : Matrix<T, S>(EMPTY) {
+        this->_view = true;
+        this->_data = data;
+        this->_m = m;
+        this->_n = n;
+        this->_ld = ld;
+    }
+
+    // Views copy shallowly, both refer to the same storage
+    View(const View& V) : View(V._data, V._m, V._n, V._ld) {}
+
+    ~View() {
+        // Empty object so that ~Matrix() doesn't deallocate
+        this->_data = nullptr;
+        this->_m = 0;
+        this->_n = 0;
+        this->_ld = 0;
+    }
 
-template<BLAS T> int Matrix<T>::__alloc() {
+    // Expression Assignment: view = A + B (writes through)
+    // Throws if the shapes differ, a view cannot reallocate
+    template <typename E>
+    View& operator=(const MatrixExpression<E>& e) {
+        if (this->rows() != e.rows() || this->cols() != e.cols()) throw(1);
+        Matrix<T, S>::operator=(e);
+        return *this;
+    }
+
+    // [DELETED] Move Assignment, a view cannot adopt storage
+    View& operator=(Matrix<T, S>&& A) = delete;
+};
+
+template <BLAS T, Real S>
+Matrix<T, S>::Matrix(View&& V)
+        : Matrix<T, S>(static_cast<const Matrix<T, S>&>(V)) {}
+
+template <BLAS T, Real S>
+Matrix<T, S>& Matrix<T, S>::operator=(View&& V) {
+    return *this = Matrix<T, S>(static_cast<const Matrix<T, S>&>(V));
+}
+
+// Matrix opened directly over a memory-mapped matrix file, without
+// allocating or copying. Startup cost is the page faults on first touch.
+//
+// Example:
+//     std::ofstream("weights.bin") << W;
+//     Matrix<T>::Mapped V("weights.bin", MappedFile::READ_ONLY,
+//                         MappedFile::WILLNEED);
+//     Matrix<T> y = V * x;
+//
+// Warning:
+//     A READ_ONLY mapping must not be written to (e.g. as the output of
+//     mprod or by scaling in place). Use COPY_ON_WRITE to modify pages
+//     privately.
+template <BLAS T, Real S>
+class Matrix<T, S>::Mapped : public Matrix<T, S>::View {
+ public:
+    explicit Mapped(const char* path,
+                    MappedFile::Mode mode = MappedFile::READ_ONLY,
+                    MappedFile::Advice advice = MappedFile::NORMAL,
+                    bool verify = false)
+        : Mapped(MappedFile(path, mode, advice, verify)) {}
+
+    Mapped(const Mapped&) = delete;
+
+    // Underlying mapping, e.g. for V.file().advise(MappedFile::RANDOM)
+    MappedFile& file() { return _file; }
+
+    using View::operator=;
+
+ private:
+    // The mapped address does not move with the MappedFile
+    explicit Mapped(MappedFile&& F)
+        : View(F.template data<S>(), F.rows(), F.cols(), F.cols()),
+          _file(std::move(F)) {}
+
+    MappedFile _file;
+};
+
+// Row runs of an (m x n) operation: a single run of m*n elements when
+// every operand is contiguous, otherwise one run of n per row
+struct Runs {
+    ptrdiff_t count, len;
+    Runs(ptrdiff_t m, ptrdiff_t n, bool contiguous)
+        : count(contiguous ? (m*n > 0) : m), len(contiguous ? m*n : n) {}
+};
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__alloc() {
     ptrdiff_t n = this->rows() * this->cols();
     if (n > 0) {
-        this->_data = new double[n];
+        this->_data = static_cast<S*>(
+            MatrixAllocator<T>::type::allocate(n * sizeof(S)));
+        if (this->_data == nullptr) return 1;  // Out of Memory
+        instrument::allocated(T, n * sizeof(S));
     }
     return 0;  // Successful Allocation
 }
 
-template<BLAS T> int Matrix<T>::__copy(double* A, const ptrdiff_t inca) {
-    ptrdiff_t n = this->rows() * this->cols();
-    double* ptr = A;
-    for (ptrdiff_t i = 0; i < n; i++) {
-        this->_data[i] = *ptr;
-        ptr += inca;
-    }
-    // std::memcpy(this->_data, A, n*sizeof(double));
+template <BLAS T, Real S>
+int Matrix<T, S>::__copy(const S* A,
+                         const ptrdiff_t inca,
+                         const ptrdiff_t lda) {
+    S* data = this->_data;
+    const ptrdiff_t ld = this->_ld;
+    instrument::copied(T, numel(*this) * sizeof(S));
+    parallel_rows(this->_m, this->_n,
+                  this->contiguous() && lda == this->_n * inca,
+                  ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            for (ptrdiff_t j = j0; j < j1; j++) {
+                data[i*ld + j] = A[i*lda + j*inca];
+            }
+        });
     return 0;  // Successful Copy
 }
 
-template<BLAS T> int Matrix<T>::__daxpy(const double alpha, const double* B, const ptrdiff_t incb) {
-    for (ptrdiff_t i = 0; i < this->_m * this->_n; i++) {
-        this->_data[i] += alpha * B[i];
-    }
+template <BLAS T, Real S>
+int Matrix<T, S>::__daxpy(const double alpha,
+                          const S* B,
+                          const ptrdiff_t incb,
+                          const ptrdiff_t ldb) {
+    S* data = this->_data;
+    const S a = alpha;
+    const ptrdiff_t ld = this->_ld;
+    parallel_rows(this->_m, this->_n,
+                  this->contiguous() && ldb == this->_n * incb,
+                  ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            for (ptrdiff_t j = j0; j < j1; j++) {
+                data[i*ld + j] += a * B[i*ldb + j*incb];
+            }
+        });
     return 0;
 }
 
-template<BLAS T> int Matrix<T>::__dger(const double alpha, const Matrix<T>& x, const Matrix<T>& y) {
-    for (ptrdiff_t i = 0; i < this->_m; i++) {
-        for (ptrdiff_t j = 0; j< this->_n; j++) {
-            this->operator[](i)[j] += x._data[i] * y._data[j];
-        }
-    }
+template <BLAS T, Real S>
+int Matrix<T, S>::__dger(const double alpha,
+                         const Matrix<T, S>& x,
+                         const Matrix<T, S>& y) {
+    S* data = this->_data;
+    const S a = alpha;
+    const ptrdiff_t n = this->_n, ld = this->_ld;
+    const S* xd = x._data;
+    const S* yd = y._data;
+    const ptrdiff_t incx = x.inc(), incy = y.inc();
+    parallel_for(this->_m, ThreadPool::grain() / std::max<ptrdiff_t>(n, 1),
+        [=](ptrdiff_t i0, ptrdiff_t i1) {
+            for (ptrdiff_t i = i0; i < i1; i++) {
+                for (ptrdiff_t j = 0; j < n; j++) {
+                    data[i*ld + j] += a * xd[i*incx] * yd[j*incy];
+                }
+            }
+        });
     return 0;
 }
 
-template<BLAS T> int Matrix<T>::__dealloc() {
+template <BLAS T, Real S>
+int Matrix<T, S>::__asum(double* s) const {
+    const S* a = this->_data;
+    const ptrdiff_t ld = this->_ld;
+    *s = parallel_rows_reduce(this->_m, this->_n, this->contiguous(),
+                              ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            return reduce::asum(j1 - j0, a + i*ld + j0);
+        });
+    return 0;
+}
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__broadcast(const broadcast::Op op,
+        const broadcast::Axis axis,
+        const S* v,
+        const ptrdiff_t incv,
+        Matrix<T, S>* C) const {
+    const S* a = this->_data;
+    S* c = C->_data;
+    const ptrdiff_t lda = this->_ld, ldc = C->_ld;
+    // Whole rows per task, so that v[i] is known for each segment
+    parallel_rows(this->_m, this->_n, false, ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            if (axis == broadcast::ROW) {
+                broadcast::scalar(op, j1 - j0, a + i*lda + j0, v[i*incv],
+                                  c + i*ldc + j0);
+            } else {
+                broadcast::vector(op, j1 - j0, a + i*lda + j0, v + j0,
+                                  c + i*ldc + j0);
+            }
+        });
+    return 0;
+}
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__dealloc() {
     if (this->_data != nullptr) {
-        delete this->_data;
+        MatrixAllocator<T>::type::deallocate(
+            this->_data, numel(*this) * sizeof(S));
+        instrument::deallocated(T, numel(*this) * sizeof(S));
     }
     return 0;  // Successful Deallocation
 }
 
-template<BLAS T> int Matrix<T>::__dot(const Matrix<T>& B, double* d) const {
-    *d = 0;
-    for (ptrdiff_t i = 0; i < this->rows() * this->cols(); i++) {
-        *d += this->_data[i] * B._data[i];
-    }
+template <BLAS T, Real S>
+int Matrix<T, S>::__dot(const Matrix<T, S>& B, double* d) const {
+    const S* a = this->_data;
+    const S* b = B._data;
+    const ptrdiff_t lda = this->_ld, ldb = B._ld;
+    *d = parallel_rows_reduce(this->_m, this->_n,
+                              this->contiguous() && B.contiguous(),
+                              ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            return reduce::dot(j1 - j0, a + i*lda + j0, b + i*ldb + j0);
+        });
+    return 0;
+}
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__hprod(const Matrix<T, S>& B, Matrix<T, S>* C) const {
+    const S* a = this->_data;
+    const S* b = B._data;
+    S* c = C->_data;
+    const ptrdiff_t lda = this->_ld, ldb = B._ld, ldc = C->_ld;
+    parallel_rows(this->_m, this->_n,
+                  this->contiguous() && B.contiguous() && C->contiguous(),
+                  ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            for (ptrdiff_t j = j0; j < j1; j++) {
+                c[i*ldc + j] = a[i*lda + j] * b[i*ldb + j];
+            }
+        });
     return 0;
 }
 
-template<BLAS T> int Matrix<T>::__hprod(const Matrix<T>& B, Matrix<T>* C) const {
-    for (ptrdiff_t i=0; i< this->rows() * this->cols(); i++) {
-        C->_data[i] = this->_data[i] * B._data[i];
+template <BLAS T, Real S>
+int Matrix<T, S>::__iamax(ptrdiff_t* index) const {
+    const S* a = this->_data;
+    const ptrdiff_t n = this->_n, ld = this->_ld;
+    const Runs r(this->_m, n, this->contiguous());
+    *index = 0;
+    if (r.count == 0 || r.len == 0) return 0;
+    // Each segment, a row or a grain of a contiguous matrix, finds its own
+    // maximum. Segments are in row-major order, so the first of equal
+    // maxima is kept.
+    const ptrdiff_t seg = r.count == 1 ? ThreadPool::grain() : r.len;
+    const ptrdiff_t per = (r.len + seg - 1) / seg;
+    std::vector<double> amax(r.count * per);
+    std::vector<ptrdiff_t> at(r.count * per);
+    parallel_for(r.count * per,
+                 std::max<ptrdiff_t>(1, ThreadPool::grain() / seg),
+        [&](ptrdiff_t c0, ptrdiff_t c1) {
+            for (ptrdiff_t c = c0; c < c1; c++) {
+                const ptrdiff_t i = c / per, j0 = (c % per) * seg;
+                at[c] = i*n + j0 + reduce::iamax(std::min(seg, r.len - j0),
+                                                 a + i*ld + j0, &amax[c]);
+            }
+        });
+    ptrdiff_t best = 0;
+    for (ptrdiff_t c = 1; c < r.count * per; c++) {
+        if (amax[c] > amax[best]) best = c;
     }
+    *index = at[best];
     return 0;
 }
 
-template<BLAS T> int Matrix<T>::__mult(const bool transA,
+template <BLAS T, Real S>
+int Matrix<T, S>::__mult(const bool transA,
+        const bool transB,
+        const double alpha,
+        const Matrix<T, S>& B,
+        const double beta,
+        Matrix<T, S>* C,
+        const gemm::Epilogue& epilogue) const {
+    gemm::gemm(transA,                           // transa
+               transB,                           // transb
+               C->_m,                            // m
+               transB ? B._m : B._n,             // n
+               transB ? B._n : B._m,             // k
+               alpha,                            // alpha
+               this->_data,                      // a
+               this->_ld,                        // lda
+               B._data,                          // b
+               B._ld,                            // ldb
+               beta,                             // beta
+               C->_data,                         // c
+               C->_ld,                           // ldc
+               epilogue);                        // epilogue
+    return 0;  // Successful Multiply
+}
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__multBatched(const bool transA,
         const bool transB,
-        const double alpha, 
-        const Matrix<T>& B,
-        Matrix<T>* C) const {
-    double a, b;
-    for (ptrdiff_t i = 0; i < this->_m; i++) {
-        for (ptrdiff_t j = 0; j < B._n; j++) {
-            (*C)[i][j] = 0;
-            for (ptrdiff_t k = 0; k < this->_n; k++) {
-                a = transA ? this->operator[](k)[i] : this->operator[](i)[k];
-                b = transB ? B[j][k] : B[k][j];
-                (*C)[i][j] += a * b;
+        const double alpha,
+        const Matrix<T, S>* A,
+        const Matrix<T, S>* B,
+        Matrix<T, S>* C,
+        const ptrdiff_t count) {
+    const ptrdiff_t m = C->_m, n = C->_n, k = transA ? A->_m : A->_n;
+    bool contiguous = true;
+    for (ptrdiff_t b = 0; b < count; b++) {
+        contiguous = contiguous && A[b].contiguous() && B[b].contiguous()
+                                && C[b].contiguous();
+    }
+    // Tiny products: interleave the batch, multiply across it, and scatter
+    // the results back. The interleaved kernels are double precision.
+    if constexpr (std::is_same_v<S, double>) {
+        if (contiguous && std::max({m, n, k}) <= gemm::INTERLEAVE_MAX) {
+            std::vector<const double*> pa(count), pb(count);
+            std::vector<double*> pc(count);
+            for (ptrdiff_t b = 0; b < count; b++) {
+                pa[b] = A[b]._data;
+                pb[b] = B[b]._data;
+                pc[b] = C[b]._data;
             }
-            (*C)[i][j] *= alpha;
+            const ptrdiff_t groups = gemm::groups(count) * gemm::LANES;
+            Matrix<T, S> a(groups, numel(*A)), bb(groups, numel(*B)),
+                         c(groups, m*n);
+            gemm::interleave(count, A->_m, A->_n, pa.data(), A->_n, a._data);
+            gemm::interleave(count, B->_m, B->_n, pb.data(), B->_n, bb._data);
+            gemm::dgemmInterleaved(transA, transB, m, n, k, alpha, a._data,
+                                   bb._data, 0, c._data, count);
+            gemm::deinterleave(count, m, n, c._data, pc.data(), n);
+            return 0;
         }
     }
-    return 0;  // Successful Multiply    
+    for (ptrdiff_t b = 0; b < count; b++) {
+        if (A[b].__mult(transA, transB, alpha, B[b], 0, &C[b],
+                        gemm::Epilogue())) return 1;
+    }
+    return 0;  // Successful Multiply
 }
 
-template<BLAS T> int Matrix<T>::__mult(const double alpha) {
-    for (ptrdiff_t i = 0; i < this->_m*this->_n; i++) {
-        this->_data[i] *= alpha;
-    }
+template <BLAS T, Real S>
+int Matrix<T, S>::__mult(const double alpha) {
+    S* data = this->_data;
+    const S a = alpha;
+    const ptrdiff_t ld = this->_ld;
+    parallel_rows(this->_m, this->_n, this->contiguous(), ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            for (ptrdiff_t j = j0; j < j1; j++) {
+                data[i*ld + j] *= a;
+            }
+        });
+    return 0;  // Successful Multiply
+}
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__gemv(const bool trans,
+        const double alpha,
+        const S* x,
+        const ptrdiff_t incx,
+        const double beta,
+        S* y,
+        const ptrdiff_t incy) const {
+    gemm::gemv(trans,                            // trans
+               this->_m,                         // m
+               this->_n,                         // n
+               alpha,                            // alpha
+               this->_data,                      // a
+               this->_ld,                        // lda
+               x,                                // x
+               incx,                             // incx
+               beta,                             // beta
+               y,                                // y
+               incy);                            // incy
     return 0;  // Successful Multiply
 }
 
-template<BLAS T> int Matrix<T>::__norm(double* n) const {
-    this->__dot(*this, n);
-    *n = std::sqrt(*n);
+// One pass over the squares, unless their sum overflowed or may have
+// lost the smallest elements to underflow. Then the elements are scaled
+// by a power of two near the largest |A| first, as in BLAS dnrm2.
+template <BLAS T, Real S>
+int Matrix<T, S>::__norm(double* n) const {
+    double ssq;
+    this->__dot(*this, &ssq);
+    if (!std::isinf(ssq) && !(ssq < 0x1p-900)) {
+        *n = std::sqrt(ssq);
+        return 0;
+    }
+    if (numel(*this) == 0) {
+        *n = 0;
+        return 0;
+    }
+    ptrdiff_t k;
+    this->__iamax(&k);
+    const S* a = this->_data;
+    const ptrdiff_t ld = this->_ld;
+    const double amax = std::fabs(a[k / this->_n * ld + k % this->_n]);
+    if (amax == 0 || std::isinf(amax)) {
+        *n = amax;
+        return 0;
+    }
+    const int e = std::clamp(-std::ilogb(amax), -1000, 1000);
+    const double scale = std::ldexp(1.0, e);
+    ssq = parallel_rows_reduce(this->_m, this->_n, this->contiguous(),
+                               ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            return reduce::sumsq(j1 - j0, a + i*ld + j0, scale);
+        });
+    *n = std::ldexp(std::sqrt(ssq), -e);
+    return 0;
+}
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__randn(rng::Generator* g) {
+    g->normal(numel(*this), this->_data);  // Freshly allocated, contiguous
     return 0;
 }
 
-template<BLAS T> int Matrix<T>::__sub(const Matrix<T>& B, Matrix<T>* C) const {
-    for (ptrdiff_t i = 0; i < this->_m*this->_n; i++) {
-        C->_data[i] = this->_data[i] - B._data[i];
+template <BLAS T, Real S>
+int Matrix<T, S>::__reduce(const reduce::Op op, const bool rows, S* y,
+                           ptrdiff_t* index) const {
+    const S* a = this->_data;
+    const ptrdiff_t m = this->_m, n = this->_n, ld = this->_ld;
+    if (rows) {
+        parallel_for(m, std::max<ptrdiff_t>(1, ThreadPool::grain() /
+                                               std::max<ptrdiff_t>(n, 1)),
+            [=](ptrdiff_t i0, ptrdiff_t i1) {
+                reduce::rows(op, i1 - i0, n, a + i0*ld, ld,
+                             y == nullptr ? nullptr : y + i0,
+                             index == nullptr ? nullptr : index + i0);
+            });
+    } else {
+        // Whole columns per task, so each result is summed in row order
+        // whatever the thread count. At least a cache line of columns.
+        parallel_for(n, std::max<ptrdiff_t>(64 / sizeof(S),
+                            ThreadPool::grain() / std::max<ptrdiff_t>(m, 1)),
+            [=](ptrdiff_t j0, ptrdiff_t j1) {
+                reduce::cols(op, m, j1 - j0, a + j0, ld,
+                             y == nullptr ? nullptr : y + j0,
+                             index == nullptr ? nullptr : index + j0);
+            });
     }
+    return 0;
+}
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__sub(const Matrix<T, S>& B, Matrix<T, S>* C) const {
+    const S* a = this->_data;
+    const S* b = B._data;
+    S* c = C->_data;
+    const ptrdiff_t lda = this->_ld, ldb = B._ld, ldc = C->_ld;
+    parallel_rows(this->_m, this->_n,
+                  this->contiguous() && B.contiguous() && C->contiguous(),
+                  ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            for (ptrdiff_t j = j0; j < j1; j++) {
+                c[i*ldc + j] = a[i*lda + j] - b[i*ldb + j];
+            }
+        });
     return 0;  // Successful Subtraction
 }
 
-template<BLAS T> int Matrix<T>::__tanh() {
-    for (ptrdiff_t i = 0; i < this->rows() * this->cols(); i++) {
-        this->_data[i] = std::tanh(this->_data[i]);
-    }
-    return 0; 
-}
\ No newline at end of file
+template <BLAS T, Real S>
+int Matrix<T, S>::__sum(double* s) const {
+    const S* a = this->_data;
+    const ptrdiff_t ld = this->_ld;
+    *s = parallel_rows_reduce(this->_m, this->_n, this->contiguous(),
+                              ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            return reduce::sum(j1 - j0, a + i*ld + j0);
+        });
+    return 0;
+}
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__tanh(const vmath::Accuracy mode) {
+    S* data = this->_data;
+    const ptrdiff_t ld = this->_ld;
+    // tanh costs ~20x an add, so split at a finer grain
+    parallel_rows(this->_m, this->_n, this->contiguous(),
+                  ThreadPool::grain() / 16,
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            vmath::tanh(j1 - j0, data + i*ld + j0, data + i*ld + j0, mode);
+        });
+    return 0;
+}
+
+template <BLAS T, Real S>
+int Matrix<T, S>::__threads(const int /*n*/) {
+    return 0;  // REF runs on ThreadPool, sized by setNumThreads()
+}
+
+// Matrix<AUTO, S> forwards these kernels to the backend chosen by
+// dispatch::select(), see MatrixAUTO.cpp. The others run the REF code.
+template <> int Matrix<AUTO, double>::__asum(double*) const;
+template <> int Matrix<AUTO, double>::__broadcast(const broadcast::Op,
+    const broadcast::Axis, const double*, const ptrdiff_t,
+    Matrix<AUTO, double>*) const;
+template <> int Matrix<AUTO, double>::__copy(const double*, const ptrdiff_t,
+    const ptrdiff_t);
+template <> int Matrix<AUTO, double>::__daxpy(const double, const double*,
+    const ptrdiff_t, const ptrdiff_t);
+template <> int Matrix<AUTO, double>::__dger(const double,
+    const Matrix<AUTO, double>&, const Matrix<AUTO, double>&);
+template <> int Matrix<AUTO, double>::__dot(const Matrix<AUTO, double>&,
+    double*) const;
+template <> int Matrix<AUTO, double>::__iamax(ptrdiff_t*) const;
+template <> int Matrix<AUTO, double>::__mult(const bool, const bool,
+    const double, const Matrix<AUTO, double>&, const double,
+    Matrix<AUTO, double>*, const gemm::Epilogue&) const;
+template <> int Matrix<AUTO, double>::__mult(const double);
+template <> int Matrix<AUTO, double>::__gemv(const bool, const double,
+    const double*, const ptrdiff_t, const double, double*,
+    const ptrdiff_t) const;
+template <> int Matrix<AUTO, double>::__norm(double*) const;
+template <> int Matrix<AUTO, float>::__asum(double*) const;
+template <> int Matrix<AUTO, float>::__broadcast(const broadcast::Op,
+    const broadcast::Axis, const float*, const ptrdiff_t,
+    Matrix<AUTO, float>*) const;
+template <> int Matrix<AUTO, float>::__copy(const float*, const ptrdiff_t,
+    const ptrdiff_t);
+template <> int Matrix<AUTO, float>::__daxpy(const double, const float*,
+    const ptrdiff_t, const ptrdiff_t);
+template <> int Matrix<AUTO, float>::__dger(const double,
+    const Matrix<AUTO, float>&, const Matrix<AUTO, float>&);
+template <> int Matrix<AUTO, float>::__dot(const Matrix<AUTO, float>&,
+    double*) const;
+template <> int Matrix<AUTO, float>::__iamax(ptrdiff_t*) const;
+template <> int Matrix<AUTO, float>::__mult(const bool, const bool,
+    const double, const Matrix<AUTO, float>&, const double,
+    Matrix<AUTO, float>*, const gemm::Epilogue&) const;
+template <> int Matrix<AUTO, float>::__mult(const double);
+template <> int Matrix<AUTO, float>::__gemv(const bool, const double,
+    const float*, const ptrdiff_t, const double, float*,
+    const ptrdiff_t) const;
+template <> int Matrix<AUTO, float>::__norm(double*) const;
+
+#if OPB_FOUND
+// Level-1 reductions through cblas_?asum and cblas_i?amax, see
+// MatrixOPB.cpp and MatrixMKL.cpp
+template <> int Matrix<OPB, double>::__asum(double*) const;
+template <> int Matrix<OPB, double>::__iamax(ptrdiff_t*) const;
+template <> int Matrix<OPB, float>::__asum(double*) const;
+template <> int Matrix<OPB, float>::__iamax(ptrdiff_t*) const;
+#endif
+
+#if ACC_FOUND
+// Broadcasts through vDSP's vector and vector-scalar routines, see
+// MatrixACC.cpp
+template <> int Matrix<ACC, double>::__broadcast(const broadcast::Op,
+    const broadcast::Axis, const double*, const ptrdiff_t,
+    Matrix<ACC, double>*) const;
+template <> int Matrix<ACC, float>::__broadcast(const broadcast::Op,
+    const broadcast::Axis, const float*, const ptrdiff_t,
+    Matrix<ACC, float>*) const;
+#endif
+
+#if MKL_FOUND
+template <> int Matrix<MKL, double>::__asum(double*) const;
+template <> int Matrix<MKL, double>::__iamax(ptrdiff_t*) const;
+template <> int Matrix<MKL, float>::__asum(double*) const;
+template <> int Matrix<MKL, float>::__iamax(ptrdiff_t*) const;
+
+// Row vectors broadcast through VML's vdAdd, vdSub, vdMul and vdDiv
+template <> int Matrix<MKL, double>::__broadcast(const broadcast::Op,
+    const broadcast::Axis, const double*, const ptrdiff_t,
+    Matrix<MKL, double>*) const;
+template <> int Matrix<MKL, float>::__broadcast(const broadcast::Op,
+    const broadcast::Axis, const float*, const ptrdiff_t,
+    Matrix<MKL, float>*) const;
+
+// Normal fills through MKL VSL's Philox4x32-10, see MatrixMKL.cpp
+template <> int Matrix<MKL, double>::__randn(rng::Generator*);
+template <> int Matrix<MKL, float>::__randn(rng::Generator*);
+#endif
@@ -0,0 +1,141 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Versioned binary matrix format.
+//
+// A file is a 64-byte header followed, at header.offset, by rows*cols
+// elements in the header's dtype and layout:
+//
+//     [ Header | padding to alignment | data ]
+//
+// The data offset is a multiple of header.alignment (at least 64 bytes),
+// so a file mapped at a page boundary can be used in place without a copy.
+// Fields are stored in native byte order.
+namespace matrixfile {
+
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t ALIGN = 64;
+
+enum DType : uint32_t { FLOAT64 = 1, FLOAT32 = 2 };
+enum Layout : uint32_t { ROW_MAJOR = 0 };
+
+// DType of the element type S
+template <typename S>
+constexpr DType dtype() {
+    static_assert(std::is_same_v<S, double> || std::is_same_v<S, float>);
+    return std::is_same_v<S, double> ? FLOAT64 : FLOAT32;
+}
+
+// Bytes per element of dtype, 0 if unsupported
+constexpr uint64_t itemsize(uint32_t dtype) {
+    return dtype == FLOAT64 ? 8 : dtype == FLOAT32 ? 4 : 0;
+}
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t layout;
+    uint32_t alignment;
+    int64_t rows;
+    int64_t cols;
+    uint64_t offset;    // Bytes from the start of the file to the data
+    uint64_t checksum;  // checksum() of the data bytes
+    uint64_t reserved;
+
+    // Header for a rows x cols row major matrix
+    static Header make(int64_t rows, int64_t cols, uint64_t checksum,
+                       DType dtype = FLOAT64, uint32_t alignment = ALIGN);
+
+    // True if magic matches
+    bool recognized() const;
+
+    // True if recognized and every field is supported
+    bool valid() const;
+
+    // Size of the data in bytes
+    uint64_t bytes() const;
+};
+
+static_assert(sizeof(Header) == 64, "Header must be 64 bytes");
+
+// Streaming 64-bit checksum: four independent multiply-rotate lanes over
+// 8-byte words, so hashing keeps up with memory bandwidth
+class Checksum {
+ public:
+    void update(const void* data, size_t bytes);
+    uint64_t digest() const;
+
+ private:
+    void word(uint64_t w);
+
+    uint64_t _lanes[4] = {0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full,
+                          0x165667B19E3779F9ull, 0x85EBCA77C2B2AE63ull};
+    uint64_t _words = 0;
+    uint64_t _bytes = 0;
+    unsigned char _tail[8];
+    size_t _pending = 0;
+};
+
+uint64_t checksum(const void* data, size_t bytes);
+
+}  // namespace matrixfile
+
+// Read-only or copy-on-write mapping of a matrix file.
+//
+// READ_ONLY pages are shared with the page cache and must not be written.
+// COPY_ON_WRITE pages may be written; modified pages become private to
+// the process and never reach the file.
+//
+// Example:
+//     MappedFile F("weights.bin", MappedFile::READ_ONLY,
+//                  MappedFile::WILLNEED);
+//     double w = F.data()[0];   // F.data<float>() for a FLOAT32 file
+// or, to use the mapping as a matrix, see Matrix<T>::Mapped.
+class MappedFile {
+ public:
+    enum Mode { READ_ONLY, COPY_ON_WRITE };
+
+    // madvise hints; HUGEPAGE only takes effect on Linux
+    enum Advice { NORMAL, SEQUENTIAL, RANDOM, WILLNEED, HUGEPAGE };
+
+    // Maps path, throw(1) if it cannot be opened or is not a valid matrix
+    // file. verify = true checks the checksum, touching every page.
+    MappedFile(const char* path, Mode mode = READ_ONLY,
+               Advice advice = NORMAL, bool verify = false);
+    MappedFile(MappedFile&& F);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    // Apply a madvise hint to the data pages
+    void advise(Advice advice);
+
+    const matrixfile::Header& header() const;
+
+    // Start of the data, in the header's dtype
+    void* raw() const;
+
+    // Data as elements of type S, throw(1) unless S matches the dtype
+    template <typename S = double>
+    S* data() const {
+        if (header().dtype != matrixfile::dtype<S>()) throw(1);
+        return static_cast<S*>(raw());
+    }
+
+    ptrdiff_t rows() const { return header().rows; }
+    ptrdiff_t cols() const { return header().cols; }
+    Mode mode() const { return _mode; }
+
+ private:
+    void* _base = nullptr;
+    size_t _size = 0;
+    Mode _mode;
+};
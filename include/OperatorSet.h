@@ -2,24 +2,67 @@
 
 #pragma once
 
+#include <algorithm>  // std::fill
 #include <cmath>
+#include <concepts>
+#include <cstdlib>  // std::abs
+#include <cstring>  // std::memcpy
 
 #include <iostream>
 #include <memory>   // std::shared_ptr
+#include <type_traits>
 #include <utility>  // std::forward
+#include <vector>
+
+#include "Broadcast.h"
+#include "Expression.h"
+#include "Gemm.h"
+#include "Layout.h"
+#include "MatrixFile.h"
+#include "Reduce.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "VMath.h"
 
 class EmptyClass{};
 
 #define EMPTY (EmptyClass())
 
+// Types whose dimensions are template parameters (see FixedMatrix.h).
+// Their shape-changing operations are checked at compile time, so the
+// runtime-checked versions below are withheld from them.
+template <typename T>
+concept FixedShape = requires { T::ROWS; T::COLS; };
+
+// Element types a matrix may hold
+template <typename S>
+concept Real = std::same_as<S, double> || std::same_as<S, float>;
+
+// Element type of the matrix class T, specialized by templates that take
+// it as a parameter (see Matrix.h)
+template <typename T>
+struct ScalarType {
+    using type = double;
+};
+
+// Backend of the matrix class T as a BLAS value, REF unless specialized
+// (see Matrix.h). Labels traced operations, see Trace.h.
+template <typename T>
+struct BackendType {
+    static constexpr int value = 0;
+};
+
 // Defines a collection of matrix operations to be inherited by
 // a base class via the Curiously Recurring Template Pattern (CRTP)
 template <typename T>
 class OperatorSet{
  public:
+    // Element type: double or float
+    using Scalar = typename ScalarType<T>::type;
+
     OperatorSet() {}
 
-    OperatorSet(ptrdiff_t m, ptrdiff_t n) : _m(m), _n(n) {
+    OperatorSet(ptrdiff_t m, ptrdiff_t n) : _m(m), _n(n), _ld(n) {
         if (static_cast<T*>(this)->__alloc())
             throw(1);
     }
@@ -34,20 +77,37 @@ class OperatorSet{
 
     explicit OperatorSet<T>(const T& B)
         : OperatorSet<T>(B._m, B._n) {
-            if (static_cast<T*>(this)->__copy(B._data, 1))
+            if (static_cast<T*>(this)->__copy(B._data, 1, B._ld))
                 throw(1);
         }
 
+    // Move Constructor, copies a source that does not own its storage
+    // (e.g. a temporary View)
     OperatorSet(T&& B)
-        : OperatorSet<T>(0, 0) {
+        : OperatorSet<T>(B._view ? B._m : 0, B._view ? B._n : 0) {
+            if (B._view) {
+                if (static_cast<T*>(this)->__copy(B._data, 1, B._ld))
+                    throw(1);
+                return;
+            }
             _m = B._m;
             _n = B._n;
+            _ld = B._ld;
             _data = B._data;
             B._m = 0;
             B._n = 0;
+            B._ld = 0;
             B._data = nullptr;
         }
 
+    // Evaluate Expression: T C = A + B;
+    // Allocates once, fused single pass
+    template <typename E>
+    OperatorSet(const MatrixExpression<E>& e)  // NOLINT [runtime/explicit]
+        : OperatorSet<T>(e.rows(), e.cols()) {
+            evaluate(e, _data, _ld);
+        }
+
     // Custom pointer that ignores column/row indexing, enabling
     // double indexing for matrices by pointing to first element in
     // a row or vector access
@@ -57,17 +117,17 @@ class OperatorSet{
     class TPtr {
      public:
         // Constructor with address to point to
-        explicit TPtr(double* data):_data(data) {}
+        explicit TPtr(Scalar* data):_data(data) {}
 
         // Indexing operator
-        double& operator[](ptrdiff_t i) { return _data[i]; }
-        const double& operator[](ptrdiff_t i) const { return _data[i]; }
+        Scalar& operator[](ptrdiff_t i) { return _data[i]; }
+        const Scalar& operator[](ptrdiff_t i) const { return _data[i]; }
 
         // Assignment to point location, used to access vectors with
         // with a single index.
         // Example:
         //    A[i] = value;    // A is an (m x 1)-vector
-        TPtr& operator=(double a) {
+        TPtr& operator=(Scalar a) {
             _data[0] = a;
             return *this;
         }
@@ -77,16 +137,16 @@ class OperatorSet{
 
         // Conversion operator double a = x[0];
         // Throws exception if x is not a column matrix (_n==1)
-        operator double&() const {
+        operator Scalar&() const {
             return _data[0];
         }
 
      private:
-        double* _data = nullptr;
+        Scalar* _data = nullptr;
     };
 
     // Conversion to access private _data
-    operator double*() const {
+    operator Scalar*() const {
         return _data;
     }
 
@@ -100,16 +160,59 @@ class OperatorSet{
         return _m;
     }
 
+    // Leading dimension: distance between the starts of adjacent rows
+    const ptrdiff_t& ld() const {
+        return _ld;
+    }
+
+    // True if rows are stored back to back
+    bool contiguous() const {
+        return _ld == _n || _m <= 1;
+    }
+
+    // Element stride of a row or column vector
+    ptrdiff_t inc() const {
+        return _n == 1 ? _ld : 1;
+    }
+
     // Custom pointer to first element in i-th row
     TPtr operator[](ptrdiff_t i) {
-        double* ptr = static_cast<double*>(*this) + i*this->cols();
+        Scalar* ptr = static_cast<Scalar*>(*this) + i*this->ld();
         return TPtr(ptr);
     }
     const TPtr operator[](ptrdiff_t i) const {
-        double* ptr = static_cast<double*>(*this) + i*this->cols();
+        Scalar* ptr = static_cast<Scalar*>(*this) + i*this->ld();
         return TPtr(ptr);
     }
 
+    // Zero-copy (m x n) view starting at element (i, j)
+    auto block(ptrdiff_t i, ptrdiff_t j,
+               ptrdiff_t m, ptrdiff_t n) const {
+        if (i < 0 || j < 0 || m < 0 || n < 0) throw(1);
+        if (i + m > _m || j + n > _n) throw(1);
+        return typename T::View(_data + i*_ld + j, m, n, _ld);
+    }
+
+    // Zero-copy view of the i-th row (1 x n)
+    auto row(ptrdiff_t i) const {
+        return block(i, 0, 1, _n);
+    }
+
+    // Zero-copy view of the j-th column (m x 1)
+    auto col(ptrdiff_t j) const {
+        return block(0, j, _m, 1);
+    }
+
+    // Zero-copy view of m rows starting at row i, e.g. a minibatch
+    auto rowBlock(ptrdiff_t i, ptrdiff_t m) const {
+        return block(i, 0, m, _n);
+    }
+
+    // Zero-copy view of n columns starting at column j
+    auto colBlock(ptrdiff_t j, ptrdiff_t n) const {
+        return block(0, j, _m, n);
+    }
+
     // Equality Operator: A==B
     friend bool operator==(const T& A, const T& B) {
         // Verify dimensions match
@@ -118,8 +221,8 @@ class OperatorSet{
         }
 
         // Check that if one is empty, both are
-        double* Aptr = static_cast<double*>(A);
-        double* Bptr = static_cast<double*>(B);
+        Scalar* Aptr = static_cast<Scalar*>(A);
+        Scalar* Bptr = static_cast<Scalar*>(B);
         if (Aptr == nullptr) {
             return Bptr == nullptr;
         } else if (Bptr == nullptr) {
@@ -127,9 +230,11 @@ class OperatorSet{
         }
 
         // Element-wise comparison
-        for (ptrdiff_t i = 0; i < numel(A); i++) {
-            if (Aptr[i] != Bptr[i]) {
-                return false;
+        for (ptrdiff_t i = 0; i < A.rows(); i++) {
+            for (ptrdiff_t j = 0; j < A.cols(); j++) {
+                if (Aptr[i*A.ld() + j] != Bptr[i*B.ld() + j]) {
+                    return false;
+                }
             }
         }
         return true;
@@ -151,22 +256,100 @@ class OperatorSet{
 
     // Matrix Product: C = A * B
     // Does Not Allocate, Write In Place
-    friend void mprod(const T& A, const T& B, T* C) {
+    friend void mprod(const T& A, const T& B, T* C)
+            requires (!FixedShape<T>) {
         if (C->rows() != A.rows()) throw(1);
         if (A.cols() != B.rows()) throw(1);
         if (B.cols() != C->cols()) throw(1);
-        if (A.__mult(false, false, 1.0, B, C)) throw(1);
+        if (__product(false, false, 1.0, A, B, 0.0, C, gemm::Epilogue()))
+            throw(1);
+    }
+
+    // Batched Matrix Product: C[b] = alpha * op(A[b]) * op(B[b]) for
+    // b < count, over arrays of equally-shaped matrices
+    friend void mprod_batched(const bool transA, const bool transB,
+            const double alpha, const T* A, const T* B, T* C,
+            const ptrdiff_t count) requires (!FixedShape<T>) {
+        if (count <= 0) return;
+        const ptrdiff_t m = transA ? A->cols() : A->rows();
+        const ptrdiff_t k = transA ? A->rows() : A->cols();
+        if (k != (transB ? B->cols() : B->rows())) throw(1);
+        if (m != C->rows()) throw(1);
+        if (C->cols() != (transB ? B->rows() : B->cols())) throw(1);
+        for (ptrdiff_t b = 1; b < count; b++) {
+            if (A[b].rows() != A->rows() || A[b].cols() != A->cols()) throw(1);
+            if (B[b].rows() != B->rows() || B[b].cols() != B->cols()) throw(1);
+            if (C[b].rows() != C->rows() || C[b].cols() != C->cols()) throw(1);
+        }
+        MATRIX_TRACE_SPAN("mprod_batched", T, m, C->cols(), k,
+                          2. * m * C->cols() * k * count);
+        if (T::__multBatched(transA, transB, alpha, A, B, C, count)) throw(1);
+    }
+
+    // Batched Matrix Product: C[b] = A[b] * B[b], b < count
+    friend void mprod_batched(const T* A, const T* B, T* C,
+                              const ptrdiff_t count)
+            requires (!FixedShape<T>) {
+        mprod_batched(false, false, 1.0, A, B, C, count);
     }
 
-    friend void mprod(const T& A, const T& B, T* C, ptrdiff_t ldc) {
-        if (C->cols() != ldc) throw(1);
+    // Matrix Product: C[:, 0:B.cols()] = A * B
+    // Equivalent to mprod(A, B, &C->colBlock(0, B.cols()))
+    friend void mprod(const T& A, const T& B, T* C, ptrdiff_t ldc)
+            requires (!FixedShape<T>) {
+        if (C->ld() != ldc) throw(1);
         if (A.cols() != B.rows()) throw(1);
         if (B.cols() > C->cols()) throw(1);
-        if (A.__mult(false, false, 1.0, B, C)) throw(1);
+        typename T::View left = C->colBlock(0, B.cols());
+        mprod(A, B, &left);
     }
 
+    // General Matrix Product: C = alpha * op(A) * op(B)
     friend void mprod(const bool transA, const bool transB,
-            const double alpha, const T& A, const T& B, T* C) {
+            const double alpha, const T& A, const T& B, T* C)
+            requires (!FixedShape<T>) {
+        mprod(transA, transB, alpha, A, B, 0.0, C, gemm::Epilogue());
+    }
+
+    // General Matrix Product: C = alpha * op(A) * op(B) + beta * C
+    // C is only read when beta != 0
+    friend void mprod(const bool transA, const bool transB,
+            const double alpha, const T& A, const T& B, const double beta,
+            T* C) requires (!FixedShape<T>) {
+        mprod(transA, transB, alpha, A, B, beta, C, gemm::Epilogue());
+    }
+
+    // Fused Dense Layer: C = act(alpha * op(A) * op(B) + beta * C + bias)
+    // bias is an (m x 1) column, added to each row of C, or a (1 x n) row,
+    // added to each column. The activation of the epilogue (e.g.
+    // gemm::Epilogue::tanh()) runs in the same pass.
+    // Example:
+    //     mprod(false, false, 1.0, W, X, 0.0, &Y, b, gemm::Epilogue::tanh());
+    friend void mprod(const bool transA, const bool transB,
+            const double alpha, const T& A, const T& B, const double beta,
+            T* C, const T& bias, gemm::Epilogue epilogue = gemm::Epilogue())
+            requires (!FixedShape<T>) {
+        if (bias.cols() == 1 && bias.rows() == C->rows()) {
+            epilogue.bias = gemm::Epilogue::ROW;
+            epilogue.incb = bias.ld();
+        } else if (bias.rows() == 1 && bias.cols() == C->cols()) {
+            epilogue.bias = gemm::Epilogue::COL;
+            epilogue.incb = 1;
+        } else {
+            throw(1);
+        }
+        epilogue.b = bias;
+        mprod(transA, transB, alpha, A, B, beta, C, epilogue);
+    }
+
+    // General Matrix Product with an epilogue (see gemm::Epilogue)
+    //     C = act(alpha * op(A) * op(B) + beta * C + bias)
+    friend void mprod(const bool transA, const bool transB,
+            const double alpha, const T& A, const T& B, const double beta,
+            T* C, const gemm::Epilogue& epilogue) requires (!FixedShape<T>) {
+        if (epilogue.bias != gemm::Epilogue::NONE && !epilogue.b) throw(1);
+        if (epilogue.activation == gemm::Epilogue::CUSTOM
+            && !epilogue.template callable<Scalar>()) throw(1);
         // Case 1: No Transposes
         if (!transA && !transB) {
             if (A.rows() != C->rows()) throw (1);
@@ -191,7 +374,36 @@ class OperatorSet{
             if (A.rows() != B.cols()) throw(1);
             if (B.rows() != C->cols()) throw(1);            
         }
-        if (A.__mult(transA, transB, alpha, B, C)) throw(1);
+        if (__product(transA, transB, alpha, A, B, beta, C, epilogue))
+            throw(1);
+    }
+
+    // Matrix-Vector Product: y = alpha * op(A) * x + beta * y
+    // x and y are read as vectors with strides incx and incy (negative
+    // strides follow the BLAS convention), y is only read when beta != 0
+    // Example:
+    //     mgemv(false, 1.0, W, x, 1, 0.0, &y, 1);   // y = W * x
+    friend void mgemv(const bool trans, const double alpha, const T& A,
+            const T& x, const ptrdiff_t incx, const double beta, T* y,
+            const ptrdiff_t incy) requires (!FixedShape<T>) {
+        const ptrdiff_t lenx = trans ? A.rows() : A.cols();
+        const ptrdiff_t leny = trans ? A.cols() : A.rows();
+        if (!x.contiguous() || !y->contiguous()) throw(1);
+        if (incx == 0 || incy == 0) throw(1);
+        if (lenx > 0 && numel(x) < 1 + (lenx - 1) * std::abs(incx)) throw(1);
+        if (leny > 0 && numel(*y) < 1 + (leny - 1) * std::abs(incy)) throw(1);
+        MATRIX_TRACE_SPAN("mgemv", T, leny, 1, lenx, 2. * numel(A));
+        if (A.__gemv(trans, alpha, x, incx, beta, *y, incy)) throw(1);
+    }
+
+    // Matrix-Vector Product over raw vectors of the element type
+    friend void mgemv(const bool trans, const double alpha, const T& A,
+            const Scalar* x, const ptrdiff_t incx, const double beta,
+            Scalar* y, const ptrdiff_t incy) requires (!FixedShape<T>) {
+        if (incx == 0 || incy == 0) throw(1);
+        MATRIX_TRACE_SPAN("mgemv", T, trans ? A.cols() : A.rows(), 1,
+                          trans ? A.rows() : A.cols(), 2. * numel(A));
+        if (A.__gemv(trans, alpha, x, incx, beta, y, incy)) throw(1);
     }
 
     friend void msub(const T& A, const T& B, T* C) {
@@ -199,6 +411,7 @@ class OperatorSet{
         if (A.rows() != C->rows()) throw(1);
         if (A.cols() != B.cols()) throw(1);
         if (A.cols() != C->cols()) throw(1);
+        MATRIX_TRACE_SPAN("msub", T, A.rows(), A.cols(), 0, 1. * numel(A));
         if (A.__sub(B, C)) throw(1);
     }
 
@@ -206,6 +419,7 @@ class OperatorSet{
     friend void hprod(const T& A, const T& B, T* C) {
         if (A.rows() != B.rows() || B.rows() != C->rows()) throw(1);
         if (A.cols() != B.cols() || B.cols() != C->cols()) throw(1);
+        MATRIX_TRACE_SPAN("hprod", T, A.rows(), A.cols(), 0, 1. * numel(A));
         A.__hprod(B, C);
     }
 
@@ -214,36 +428,48 @@ class OperatorSet{
         if (A.rows() != B->rows()) throw(1);
         if (A.cols() != B->cols()) throw(1);
         if (inca != 1) throw(1);
-        B->__daxpy(alpha, A, 1);
+        MATRIX_TRACE_SPAN("maxpy", T, A.rows(), A.cols(), 0, 2. * numel(A));
+        B->__daxpy(alpha, A, 1, A.ld());
     }
 
-    friend void maxpy(const double alpha, double* A, const ptrdiff_t inca, T* B) {
-        B->__daxpy(alpha, A, inca);
+    // MAXPY: B += alpha * A, A is read as a contiguous (m x n) array
+    // with stride inca (inca = 0 broadcasts *A)
+    friend void maxpy(const double alpha, Scalar* A, const ptrdiff_t inca,
+                      T* B) {
+        MATRIX_TRACE_SPAN("maxpy", T, B->rows(), B->cols(), 0,
+                          2. * numel(*B));
+        B->__daxpy(alpha, A, inca, inca * B->cols());
     }
 
     // MGER: A += x * y^T
-    friend void mger(const double alpha, const T& x, const T& y, T* A) {
+    friend void mger(const double alpha, const T& x, const T& y, T* A)
+            requires (!FixedShape<T>) {
         if (numel(x) != A->rows()) throw(1);
         if (numel(y) != A->cols()) throw(1);
+        MATRIX_TRACE_SPAN("mger", T, A->rows(), A->cols(), 0,
+                          2. * numel(*A));
         A->__dger(alpha, x, y);
     }
 
     // MCOPY: B = A
-    friend void mcopy(double* A, const ptrdiff_t inca, T* B) {
+    friend void mcopy(Scalar* A, const ptrdiff_t inca, T* B) {
         if (inca != 0) throw(1);
-        B->__copy(A, inca);
+        MATRIX_TRACE_SPAN("mcopy", T, B->rows(), B->cols(), 0, 0);
+        B->__copy(A, inca, 0);
     }
 
     friend void mcopy(const T& A, T* B) {
         if (A.rows() != B->rows()) throw(1);
         if (A.cols() != B->cols()) throw(1);
-        B->__copy(A, 1);
+        MATRIX_TRACE_SPAN("mcopy", T, A.rows(), A.cols(), 0, 0);
+        B->__copy(A, 1, A.ld());
     }
 
     // Dot Product
     friend double dot(const T& A, const T& B) {
         if (A.rows() != B.rows()) throw(1);
         if (A.cols() != B.cols()) throw(1);
+        MATRIX_TRACE_SPAN("dot", T, A.rows(), A.cols(), 0, 2. * numel(A));
         double d;
         A.__dot(B, &d);
         return d;
@@ -251,14 +477,135 @@ class OperatorSet{
 
     // Frobenius Matrix Norm Computation
     friend double norm(const T& A) {
+        MATRIX_TRACE_SPAN("norm", T, A.rows(), A.cols(), 0, 2. * numel(A));
         double n;
         A.__norm(&n);
         return n;
     }
 
-    // Hyperbolic Tangent
-    friend void tanh(T* A) {
-        A->__tanh();
+    // Sum of the Elements
+    friend double sum(const T& A) {
+        MATRIX_TRACE_SPAN("sum", T, A.rows(), A.cols(), 0, 1. * numel(A));
+        double s;
+        A.__sum(&s);
+        return s;
+    }
+
+    // Sum of the Absolute Values (BLAS asum)
+    friend double asum(const T& A) {
+        MATRIX_TRACE_SPAN("asum", T, A.rows(), A.cols(), 0, 1. * numel(A));
+        double s;
+        A.__asum(&s);
+        return s;
+    }
+
+    // Position i*cols() + j of the first largest |A(i, j)| (BLAS iamax)
+    friend ptrdiff_t iamax(const T& A) {
+        MATRIX_TRACE_SPAN("iamax", T, A.rows(), A.cols(), 0, 1. * numel(A));
+        ptrdiff_t i;
+        A.__iamax(&i);
+        return i;
+    }
+
+    // Broadcasting: C = A op v, where v is an (m x 1) column, applied to
+    // every element of its row, or a (1 x n) row, applied to every element
+    // of its column (as mprod's bias). C may be A, v must not overlap C.
+    // Example:
+    //     badd(&Y, b);         // Y(i, j) += b(0, j), b is (1 x n)
+    //     bdiv(X, sd, &Z);     // Z(i, j) = X(i, j) / sd(i, 0), sd is (m x 1)
+    friend void badd(const T& A, const T& v, T* C) {
+        __broadcastOp("badd", broadcast::ADD, A, v, C);
+    }
+
+    friend void badd(T* A, const T& v) {
+        __broadcastOp("badd", broadcast::ADD, *A, v, A);
+    }
+
+    friend void bsub(const T& A, const T& v, T* C) {
+        __broadcastOp("bsub", broadcast::SUB, A, v, C);
+    }
+
+    friend void bsub(T* A, const T& v) {
+        __broadcastOp("bsub", broadcast::SUB, *A, v, A);
+    }
+
+    friend void bmul(const T& A, const T& v, T* C) {
+        __broadcastOp("bmul", broadcast::MUL, A, v, C);
+    }
+
+    friend void bmul(T* A, const T& v) {
+        __broadcastOp("bmul", broadcast::MUL, *A, v, A);
+    }
+
+    friend void bdiv(const T& A, const T& v, T* C) {
+        __broadcastOp("bdiv", broadcast::DIV, A, v, C);
+    }
+
+    friend void bdiv(T* A, const T& v) {
+        __broadcastOp("bdiv", broadcast::DIV, *A, v, A);
+    }
+
+    // Row and Column Reductions into preallocated vectors: y holds one
+    // value per row (rowSum, ...) or per column (colSum, ...), index one
+    // position. Ties go to the first element, NaNs are skipped by max/min.
+    // Example:
+    //     Matrix<T> mu(1, X.cols());
+    //     colMean(X, &mu);                    // mu(j) = mean of column j
+    //     std::vector<ptrdiff_t> label(P.rows());
+    //     rowArgmax(P, label.data());         // label[i] = argmax_j P(i, j)
+    friend void rowSum(const T& A, T* y) {
+        __lines(reduce::SUM, true, A, y, nullptr);
+    }
+
+    friend void colSum(const T& A, T* y) {
+        __lines(reduce::SUM, false, A, y, nullptr);
+    }
+
+    friend void rowMean(const T& A, T* y) {
+        __lines(reduce::MEAN, true, A, y, nullptr);
+    }
+
+    friend void colMean(const T& A, T* y) {
+        __lines(reduce::MEAN, false, A, y, nullptr);
+    }
+
+    friend void rowMax(const T& A, T* y) {
+        __lines(reduce::MAX, true, A, y, nullptr);
+    }
+
+    friend void colMax(const T& A, T* y) {
+        __lines(reduce::MAX, false, A, y, nullptr);
+    }
+
+    friend void rowMin(const T& A, T* y) {
+        __lines(reduce::MIN, true, A, y, nullptr);
+    }
+
+    friend void colMin(const T& A, T* y) {
+        __lines(reduce::MIN, false, A, y, nullptr);
+    }
+
+    friend void rowArgmax(const T& A, ptrdiff_t* index) {
+        __lines(reduce::ARGMAX, true, A, nullptr, index);
+    }
+
+    friend void colArgmax(const T& A, ptrdiff_t* index) {
+        __lines(reduce::ARGMAX, false, A, nullptr, index);
+    }
+
+    friend void rowArgmin(const T& A, ptrdiff_t* index) {
+        __lines(reduce::ARGMIN, true, A, nullptr, index);
+    }
+
+    friend void colArgmin(const T& A, ptrdiff_t* index) {
+        __lines(reduce::ARGMIN, false, A, nullptr, index);
+    }
+
+    // Hyperbolic Tangent, see VMath.h for the accuracy modes
+    friend void tanh(T* A, const vmath::Accuracy mode = vmath::HIGH) {
+        MATRIX_TRACE_SPAN("tanh", T, A->rows(), A->cols(), 0,
+                          1. * numel(*A));
+        A->__tanh(mode);
     }
 
     // Addition operator: A+=B
@@ -266,7 +613,8 @@ class OperatorSet{
         T* A = static_cast<T*>(this);
         if (this->rows() != B.rows() || this->cols() != B.cols())
             throw(1);
-        if (A->__daxpy(1.0, B, 1))
+        MATRIX_TRACE_SPAN("maxpy", T, B.rows(), B.cols(), 0, 2. * numel(B));
+        if (A->__daxpy(1.0, B, 1, B.ld()))
             throw(1);
         return *A;
     }
@@ -276,26 +624,45 @@ class OperatorSet{
         T* A = static_cast<T*>(this);
         if (this->rows() != B.rows() || this->cols() != B.cols())
             throw(1);
+        MATRIX_TRACE_SPAN("msub", T, B.rows(), B.cols(), 0, 1. * numel(B));
         if (A->__sub(B, A))
             throw(1);
         return *A;
     }
 
     // Move Operator: B = std::move(A)
+    // Copies an A that does not own its storage (e.g. B = X.row(i))
     T& operator=(T&& A) {
         T* B = static_cast<T*>(this);
-        if (this != &A) {  // Ignore A = std::move(A);
+        if (A._view) {
+            *B = T(static_cast<const T&>(A));
+        } else if (this != &A) {  // Ignore A = std::move(A);
             B->__dealloc();
             B->_data = A._data;
             B->_m = A._m;
             B->_n = A._n;
+            B->_ld = A._ld;
             A._data = nullptr;
             A._m = 0;
             A._n = 0;
+            A._ld = 0;
         }
         return *B;
     }
 
+    // Expression Assignment: C = A + B
+    // Writes in place if dimensions match, otherwise reallocates
+    template <typename E>
+    T& operator=(const MatrixExpression<E>& e) {
+        T* C = static_cast<T*>(this);
+        if (C->rows() != e.rows() || C->cols() != e.cols()) {
+            *C = T(e);
+        } else {
+            evaluate(e, _data, _ld);
+        }
+        return *C;
+    }
+
     // Deep Copy Assignment: A = B
     // Disabled to avoid accidental copy assignment
     // Use copy operator instead (e.g. A = Matrix(B))
@@ -307,48 +674,190 @@ class OperatorSet{
     }
 
     // Fill matrix with passed value
-    void fill(double value) {
-        for (int i = 0; i < numel(*this); i++) {
-            static_cast<double*>(*this)[i] = value;
-        }
+    void fill(Scalar value) {
+        Scalar* data = static_cast<Scalar*>(*this);
+        const ptrdiff_t ld = _ld;
+        parallel_rows(_m, _n, contiguous(), ThreadPool::grain(),
+            [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+                std::fill(data + i*ld + j0, data + i*ld + j1, value);
+            });
     }
 
     // Matrix Transpose (Allocates Memory)
-    friend T transpose(const T& X) {
+    friend T transpose(const T& X) requires (!FixedShape<T>) {
         T Y(X.cols(), X.rows());
-        for (ptrdiff_t i = 0; i < Y.rows(); i++) {
-            for (ptrdiff_t j = 0; j < Y.cols(); j++) {
-                Y[i][j] = X[j][i];
-            }
-        }
+        transpose(X, &Y);
         return Y;
     }
 
-    // Serialize: [m,n,data]
+    // Matrix Transpose: Y = X^T, Does Not Allocate
+    // Blocked and parallel, see Layout.h. X and Y must not overlap.
+    friend void transpose(const T& X, T* Y) requires (!FixedShape<T>) {
+        if (Y->rows() != X.cols() || Y->cols() != X.rows()) throw(1);
+        MATRIX_TRACE_SPAN("transpose", T, Y->rows(), Y->cols(), 0, 0);
+        layout::transpose(X.rows(), X.cols(), X, X.ld(), *Y, Y->ld());
+    }
+
+    // In Place Transpose: A = A^T
+    // Square matrices (and views) swap tiles across the diagonal. A
+    // rectangular A must be contiguous, its elements are permuted along
+    // cycles and it becomes (n x m).
+    friend void transpose(T* A) requires (!FixedShape<T>) {
+        MATRIX_TRACE_SPAN("transpose", T, A->cols(), A->rows(), 0, 0);
+        if (A->rows() == A->cols()) {
+            layout::transposeSquare(A->rows(), *A, A->ld());
+        } else {
+            if (!A->contiguous()) throw(1);
+            layout::transposeInPlace(A->rows(), A->cols(), *A);
+            std::swap(A->_m, A->_n);
+            A->_ld = A->_n;
+        }
+    }
+
+    // Serialize: [header, padding, data], see MatrixFile.h
+    // The header records the element type
     friend std::ostream& operator<<(std::ostream& os, OperatorSet<T>& A) {
-        os.write(reinterpret_cast<const char*>(&A.rows()), sizeof(ptrdiff_t));
-        os.write(reinterpret_cast<const char*>(&A.cols()), sizeof(ptrdiff_t));
-        os.write(reinterpret_cast<const char*>(static_cast<double*>(A)),
-                 numel(A)*sizeof(double));
+        MATRIX_TRACE_SPAN("write", T, A.rows(), A.cols(), 0, 0);
+        const ptrdiff_t runs = A.contiguous() ? 1 : A.rows();
+        const size_t len = (A.contiguous() ? numel(A) : A.cols())
+                         * sizeof(Scalar);
+        matrixfile::Checksum c;
+        for (ptrdiff_t i = 0; i < runs; i++) {
+            c.update(static_cast<Scalar*>(A) + i*A.ld(), len);
+        }
+        const matrixfile::Header h = matrixfile::Header::make(
+            A.rows(), A.cols(), c.digest(), matrixfile::dtype<Scalar>());
+        os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        const char zeros[matrixfile::ALIGN] = {};
+        for (size_t pad = h.offset - sizeof(h); pad > 0;) {
+            const size_t k = std::min<size_t>(pad, sizeof(zeros));
+            os.write(zeros, k);
+            pad -= k;
+        }
+        // One write per row of a strided view
+        for (ptrdiff_t i = 0; i < runs; i++) {
+            os.write(reinterpret_cast<const char*>(
+                         static_cast<Scalar*>(A) + i*A.ld()), len);
+        }
         return os;
     }
 
-    // Deserialize
+    // Deserialize, throw(1) on a corrupt or unsupported file. Files
+    // written before the header was introduced ([m,n,data]) still load.
+    // Data stored in the other precision is converted after the checksum
+    // is verified.
     friend std::istream& operator>>(std::istream& is, OperatorSet<T>& A) {
+        MATRIX_TRACE_SPAN("read", T, 0, 0, 0, 0);
+        matrixfile::Header h;
+        is.read(reinterpret_cast<char*>(&h), sizeof(h.magic));
         ptrdiff_t rows, cols;
-        is.read(reinterpret_cast<char*>(&rows), sizeof(ptrdiff_t));
-        is.read(reinterpret_cast<char*>(&cols), sizeof(ptrdiff_t));
+        uint32_t dtype = matrixfile::FLOAT64;
+        if (h.recognized()) {
+            is.read(reinterpret_cast<char*>(&h) + sizeof(h.magic),
+                    sizeof(h) - sizeof(h.magic));
+            if (!is || !h.valid()) throw(1);
+            is.ignore(h.offset - sizeof(h));
+            rows = h.rows;
+            cols = h.cols;
+            dtype = h.dtype;
+        } else {
+            // Legacy: the first word is the row count
+            std::memcpy(&rows, h.magic, sizeof(rows));
+            is.read(reinterpret_cast<char*>(&cols), sizeof(ptrdiff_t));
+        }
         // Allocate memory
         static_cast<T&>(A) = T(rows, cols);
-        is.read(reinterpret_cast<char*>(static_cast<double*>(A)),
-                rows*cols*sizeof(double));
+        Scalar* data = static_cast<Scalar*>(A);
+        if (dtype == matrixfile::dtype<Scalar>()) {
+            is.read(reinterpret_cast<char*>(data), rows*cols*sizeof(Scalar));
+            if (!is) throw(1);
+            if (h.recognized()
+                && matrixfile::checksum(data, h.bytes()) != h.checksum) {
+                throw(1);
+            }
+            return is;
+        }
+        // Legacy files hold doubles and have no checksum
+        std::vector<char> bytes(h.recognized() ? h.bytes()
+                                               : rows*cols*sizeof(double));
+        is.read(bytes.data(), bytes.size());
+        if (!is) throw(1);
+        if (h.recognized()
+            && matrixfile::checksum(bytes.data(), bytes.size()) != h.checksum) {
+            throw(1);
+        }
+        if (dtype == matrixfile::FLOAT64) {
+            const double* src = reinterpret_cast<const double*>(bytes.data());
+            std::copy(src, src + rows*cols, data);
+        } else {
+            const float* src = reinterpret_cast<const float*>(bytes.data());
+            std::copy(src, src + rows*cols, data);
+        }
         return is;
     }
 
  protected:
+    // C = act(alpha * op(A) * op(B) + beta * C + bias) on __mult, except
+    // when C is a single column or row: then op(B) (resp. op(A)) is a
+    // vector and the product runs on __gemv
+    static int __product(const bool transA, const bool transB,
+            const double alpha, const T& A, const T& B, const double beta,
+            T* C, const gemm::Epilogue& epilogue) {
+        [[maybe_unused]] const ptrdiff_t k = transA ? A.rows() : A.cols();
+        MATRIX_TRACE_SPAN("mprod", T, C->rows(), C->cols(), k,
+                          2. * C->rows() * C->cols() * k);
+        if (C->cols() == 1) {
+            // c = op(A) * b
+            if (A.__gemv(transA, alpha, B, transB ? 1 : B.ld(), beta, *C,
+                         C->ld())) return 1;
+        } else if (C->rows() == 1) {
+            // c^T = op(B)^T * a^T
+            if (B.__gemv(!transB, alpha, A, transA ? A.ld() : 1, beta, *C,
+                         1)) return 1;
+        } else {
+            return A.__mult(transA, transB, alpha, B, beta, C, epilogue);
+        }
+        gemm::epilogue(epilogue, C->rows(), C->cols(), *C, C->ld());
+        return 0;
+    }
+
+    // C = A op v, v spans A's rows (m x 1) or its columns (1 x n), see
+    // badd()
+    static void __broadcastOp([[maybe_unused]] const char* name,
+                              const broadcast::Op op,
+                              const T& A, const T& v, T* C) {
+        if (A.rows() != C->rows() || A.cols() != C->cols()) throw(1);
+        broadcast::Axis axis;
+        if (v.rows() == A.rows() && v.cols() == 1) {
+            axis = broadcast::ROW;
+        } else if (v.rows() == 1 && v.cols() == A.cols()) {
+            axis = broadcast::COL;
+        } else {
+            throw(1);
+        }
+        MATRIX_TRACE_SPAN(name, T, A.rows(), A.cols(), 0, 1. * numel(A));
+        if (A.__broadcast(op, axis, v._data, v.ld(), C)) throw(1);
+    }
+
+    // y = op of each row of A (rows) or each column, see rowSum(). y, if
+    // not null, must be a contiguous vector of that length.
+    static void __lines(const reduce::Op op, const bool rows, const T& A,
+                        T* y, ptrdiff_t* index) {
+        const ptrdiff_t len = rows ? A.rows() : A.cols();
+        if (y != nullptr && (numel(*y) != len || !y->contiguous())) throw(1);
+        if (index == nullptr && (op == reduce::ARGMAX || op == reduce::ARGMIN))
+            throw(1);
+        MATRIX_TRACE_SPAN(rows ? "rowReduce" : "colReduce", T, A.rows(),
+                          A.cols(), 0, 1. * numel(A));
+        if (A.__reduce(op, rows, y == nullptr ? nullptr : y->_data, index))
+            throw(1);
+    }
+
     ptrdiff_t _m = 0;
     ptrdiff_t _n = 0;
-    double* _data = nullptr;
+    ptrdiff_t _ld = 0;
+    Scalar* _data = nullptr;
+    bool _view = false;  // _data is not owned (View, Ptr), never moved
 };
 
 // Scalar Multiply
@@ -380,9 +889,12 @@ T&& operator+(const OperatorSet<T>& A, OperatorSet<T>&& B) {
     return std::move(static_cast<T&&>(B))+static_cast<const T&>(A);
 }
 
-// [DELETED] Add: A + B
+// Add: A + B (lazy, see Expression.h)
 template <typename T>
-T operator+(OperatorSet<T>& A, OperatorSet<T>& B) = delete;
+auto operator+(const OperatorSet<T>& A, const OperatorSet<T>& B) {
+    using namespace expression;  // NOLINT [build/namespaces]
+    return Binary<Node<T>, Node<T>, Add>(wrap(A), wrap(B));
+}
 
 // Subtract: std::move(A) - B
 template <typename T>
@@ -397,9 +909,16 @@ T&& operator-(OperatorSet<T>&& A, const OperatorSet<T>& B) {
 // Subtract: A - std::move(B)
 template <typename T>
 T&& operator-(const OperatorSet<T>& A, OperatorSet<T>&& B) {
-    return -1*(std::move(static_cast<T&&>(B))-static_cast<const T&>(A));
+    T&& BB = static_cast<T&&>(B);
+    const T& AA = static_cast<const T&>(A);
+    if (A.rows() != B.rows() || A.cols() != B.cols()) throw(1);
+    if (AA.__sub(BB, &BB)) throw(1);  // B = A - B, single pass
+    return std::move(BB);
 }
 
-// [DELETED] Subtract: A - B
+// Subtract: A - B (lazy, see Expression.h)
 template <typename T>
-T operator-(const OperatorSet<T>& A, const OperatorSet<T>& B) = delete;
+auto operator-(const OperatorSet<T>& A, const OperatorSet<T>& B) {
+    using namespace expression;  // NOLINT [build/namespaces]
+    return Binary<Node<T>, Node<T>, Sub>(wrap(A), wrap(B));
+}
@@ -0,0 +1,221 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Matrix.h"
+#include "MatrixFile.h"
+
+// Matrix stored in a matrix file (see MatrixFile.h) and accessed by
+// rectangular tiles through pread/pwrite, for operands larger than RAM.
+class DiskMatrix {
+ public:
+    // Open an existing file, throw(1) if it is not a valid matrix file
+    explicit DiskMatrix(const char* path);
+
+    // Create (or truncate) a zero-filled rows x cols file. Call seal()
+    // once every tile is written to record the checksum.
+    static DiskMatrix create(const char* path, ptrdiff_t rows, ptrdiff_t cols);
+
+    DiskMatrix(DiskMatrix&& D);
+    ~DiskMatrix();
+
+    DiskMatrix(const DiskMatrix&) = delete;
+    DiskMatrix& operator=(const DiskMatrix&) = delete;
+    DiskMatrix& operator=(DiskMatrix&&) = delete;
+
+    ptrdiff_t rows() const { return _header.rows; }
+    ptrdiff_t cols() const { return _header.cols; }
+
+    // dst[r*ldd + c] = file(i + r, j + c) for an (m x n) tile at (i, j)
+    void read(ptrdiff_t i, ptrdiff_t j, ptrdiff_t m, ptrdiff_t n,
+              double* dst, ptrdiff_t ldd) const;
+
+    // file(i + r, j + c) = src[r*lds + c]
+    void write(ptrdiff_t i, ptrdiff_t j, ptrdiff_t m, ptrdiff_t n,
+               const double* src, ptrdiff_t lds);
+
+    // Recompute the checksum over the data and rewrite the header
+    void seal();
+
+ private:
+    DiskMatrix() = default;
+
+    int _fd = -1;
+    matrixfile::Header _header;
+};
+
+// Background I/O thread that runs load(step, buffer) for step = 0, 1, ...
+// up to depth steps ahead of the consumer, so reads overlap compute.
+//
+// Example:
+//     Prefetcher io(steps, bufferSize, 2, load);
+//     for (ptrdiff_t s = 0; s < steps; s++) {
+//         double* tile = io.acquire(s);  // Blocks until loaded
+//         ...
+//         io.release(s);                 // Buffer may be refilled
+//     }
+class Prefetcher {
+ public:
+    using Load = std::function<void(ptrdiff_t step, double* buffer)>;
+
+    Prefetcher(ptrdiff_t steps, size_t bufferSize, int depth, Load load);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    // Buffer holding step, rethrows anything load() threw
+    double* acquire(ptrdiff_t step);
+
+    // Hand the buffer of step back to the I/O thread
+    void release(ptrdiff_t step);
+
+ private:
+    void run();
+
+    ptrdiff_t _steps;
+    size_t _bufferSize;
+    Load _load;
+    std::vector<double*> _buffers;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    ptrdiff_t _loaded = 0;
+    ptrdiff_t _released = 0;
+    bool _stop = false;
+    std::exception_ptr _error;
+    std::thread _thread;
+};
+
+namespace outofcore {
+
+// Default working set of the streamed tiles
+constexpr size_t BUDGET = size_t(1) << 28;  // 256 MiB
+
+// Square tile edge b so that two prefetched A and B tiles plus two C
+// tiles, 6*b*b doubles, fit in budget bytes
+ptrdiff_t tile(size_t budget);
+
+}  // namespace outofcore
+
+// Out-of-core Matrix Product: C = alpha * op(A) * op(B)
+//
+// A and B are streamed from disk in (b x b) tiles, with b chosen from the
+// memory budget, while a background thread prefetches the next pair of
+// tiles. Each tile of C is accumulated in core from __mult calls.
+//
+// Example:
+//     DiskMatrix X("features.bin");                  // (N x d), N huge
+//     Matrix<T> G(X.cols(), X.cols());
+//     mprod(true, false, 1.0, X, X, &G);             // Gram matrix X^T X
+template <BLAS T>
+void mprod(const bool transA, const bool transB, const double alpha,
+           const DiskMatrix& A, const DiskMatrix& B, Matrix<T>* C,
+           size_t budget = outofcore::BUDGET);
+
+// Out-of-core Matrix Product written to disk tile by tile. C comes from
+// DiskMatrix::create(path, m, n) and is sealed once complete.
+template <BLAS T>
+void mprod(const bool transA, const bool transB, const double alpha,
+           const DiskMatrix& A, const DiskMatrix& B, DiskMatrix* C,
+           size_t budget = outofcore::BUDGET);
+
+namespace outofcore {
+
+// Shared driver: sink(i, j, tile) receives each finished (mb x nb) tile
+// of C at (i, j) with leading dimension nb
+template <BLAS T, typename Sink>
+void mprod(const bool transA, const bool transB, const double alpha,
+           const DiskMatrix& A, const DiskMatrix& B,
+           const ptrdiff_t m, const ptrdiff_t n, const size_t budget,
+           Sink&& sink) {
+    const ptrdiff_t k = transA ? A.rows() : A.cols();
+    if ((transB ? B.cols() : B.rows()) != k) throw(1);
+    if ((transA ? A.cols() : A.rows()) != m) throw(1);
+    if ((transB ? B.rows() : B.cols()) != n) throw(1);
+    if (m == 0 || n == 0) return;
+
+    const ptrdiff_t b = tile(budget);
+    const ptrdiff_t mt = (m + b - 1) / b, nt = (n + b - 1) / b;
+    const ptrdiff_t kt = std::max<ptrdiff_t>(1, (k + b - 1) / b);
+
+    // Step s loads the tiles of op(A)(I, P) and op(B)(P, J)
+    auto range = [b](ptrdiff_t t, ptrdiff_t n) {
+        return std::pair<ptrdiff_t, ptrdiff_t>(t*b, std::min(b, n - t*b));
+    };
+    auto load = [&](ptrdiff_t s, double* buffer) {
+        const ptrdiff_t p = s % kt, t = s / kt;
+        auto [i, mb] = range(t / nt, m);
+        auto [j, nb] = range(t % nt, n);
+        auto [l, kb] = range(p, k);
+        if (transA) A.read(l, i, kb, mb, buffer, mb);
+        else        A.read(i, l, mb, kb, buffer, kb);
+        if (transB) B.read(j, l, nb, kb, buffer + b*b, kb);
+        else        B.read(l, j, kb, nb, buffer + b*b, nb);
+    };
+    Prefetcher io(mt * nt * kt, 2*b*b, 2, load);
+
+    Matrix<T> tiles(2, b*b);
+    double* c = tiles;
+    double* tmp = c + b*b;
+    for (ptrdiff_t t = 0, s = 0; t < mt * nt; t++) {
+        auto [i, mb] = range(t / nt, m);
+        auto [j, nb] = range(t % nt, n);
+        typename Matrix<T>::View Ct(c, mb, nb, nb), Tt(tmp, mb, nb, nb);
+        if (k == 0) Ct.fill(0);
+        for (ptrdiff_t p = 0; p < kt; p++, s++) {
+            const ptrdiff_t kb = range(p, k).second;
+            double* buffer = io.acquire(s);
+            typename Matrix<T>::View
+                At(buffer, transA ? kb : mb, transA ? mb : kb,
+                   transA ? mb : kb),
+                Bt(buffer + b*b, transB ? nb : kb, transB ? kb : nb,
+                   transB ? kb : nb);
+            // The first panel writes C, the rest accumulate into it
+            if (kb > 0) {
+                mprod(transA, transB, alpha, At, Bt, p == 0 ? &Ct : &Tt);
+            }
+            io.release(s);
+            if (p > 0) maxpy(1.0, Tt, 1, &Ct);
+        }
+        sink(i, j, Ct);
+    }
+}
+
+}  // namespace outofcore
+
+template <BLAS T>
+void mprod(const bool transA, const bool transB, const double alpha,
+           const DiskMatrix& A, const DiskMatrix& B, Matrix<T>* C,
+           size_t budget) {
+    outofcore::mprod<T>(transA, transB, alpha, A, B, C->rows(), C->cols(),
+                        budget, [C](ptrdiff_t i, ptrdiff_t j,
+                                    const Matrix<T>& tile) {
+        typename Matrix<T>::View dst = C->block(i, j, tile.rows(), tile.cols());
+        mcopy(tile, &dst);
+    });
+}
+
+template <BLAS T>
+void mprod(const bool transA, const bool transB, const double alpha,
+           const DiskMatrix& A, const DiskMatrix& B, DiskMatrix* C,
+           size_t budget) {
+    outofcore::mprod<T>(transA, transB, alpha, A, B, C->rows(), C->cols(),
+                        budget, [C](ptrdiff_t i, ptrdiff_t j,
+                                    const Matrix<T>& tile) {
+        C->write(i, j, tile.rows(), tile.cols(),
+                 static_cast<double*>(tile), tile.ld());
+    });
+    C->seal();
+}
@@ -0,0 +1,86 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Counter-based random numbers (Philox4x32-10, Salmon et al. 2011)
+//
+// Each 128-bit counter maps to four independent 32-bit words through a
+// keyed bijection, with no state carried from one draw to the next. A
+// Generator is a key (its seed) and a stream number, and hands out
+// counters from an atomic offset. A fill takes ceil(n / PER_COUNTER)
+// counters and value i comes from counter offset + i / PER_COUNTER, so
+// the result depends only on the seed, the stream and the sequence of
+// draws, not on the thread count, and blocks fill in parallel.
+//
+// Example:
+//     rng::Generator g(42);                    // Seed 42, stream 0
+//     Matrix<T> A = Matrix<T>::randn(m, n, g); // Same A on every run
+//     rng::Generator h(42, 1);                 // Independent stream
+namespace rng {
+
+// Values drawn per counter: two doubles (53-bit uniforms) or four floats
+template <typename S>
+constexpr ptrdiff_t PER_COUNTER = sizeof(S) == sizeof(float) ? 4 : 2;
+
+// Philox4x32-10 block function: out = philox_key(counter)
+void philox(const uint32_t counter[4], const uint32_t key[2],
+            uint32_t out[4]);
+
+class Generator {
+ public:
+    explicit Generator(uint64_t seed, uint64_t stream = 0)
+        : _seed(seed), _stream(stream) {}
+
+    Generator(const Generator& g)
+        : _seed(g._seed), _stream(g._stream), _offset(g.offset()) {}
+
+    Generator& operator=(const Generator& g) {
+        _seed = g._seed;
+        _stream = g._stream;
+        seek(g.offset());
+        return *this;
+    }
+
+    uint64_t seed() const { return _seed; }
+    uint64_t stream() const { return _stream; }
+
+    // Counters consumed so far, seek() to replay or skip ahead
+    uint64_t offset() const { return _offset.load(std::memory_order_relaxed); }
+    void seek(uint64_t offset) {
+        _offset.store(offset, std::memory_order_relaxed);
+    }
+
+    // Claim the next n counters, returns the first. Thread-safe.
+    uint64_t reserve(uint64_t n) {
+        return _offset.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // x[i] ~ N(0, 1), i < n, by Box-Muller
+    void normal(ptrdiff_t n, double* x);
+    void normal(ptrdiff_t n, float* x);
+
+    // x[i] ~ U[0, 1), i < n
+    void uniform(ptrdiff_t n, double* x);
+    void uniform(ptrdiff_t n, float* x);
+
+    // Single draws, each takes a counter
+    double normal();
+    double uniform();
+
+ private:
+    uint64_t _seed, _stream;
+    std::atomic<uint64_t> _offset{0};
+};
+
+// Process-wide generator behind Matrix<T>::randn(), seeded from
+// MATRIX_SEED if set, otherwise from std::random_device
+Generator& global();
+
+// Reseed the process-wide generator, stream 0 from offset 0
+void seed(uint64_t seed);
+
+}  // namespace rng
@@ -0,0 +1,52 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+
+// Serial reduction kernels over arrays of doubles or floats
+//
+// Sums run over eight independent accumulators, so that the additions
+// vectorize and pipeline without reassociating a single dependency
+// chain. Float arrays accumulate in double, like dot(). Matrix<T> splits
+// the work across the ThreadPool (see sum(), rowSum(), colMax(), ...).
+namespace reduce {
+
+// Row or column reductions. ARGMAX and ARGMIN write the position of the
+// first extreme element, and its value if y is not null.
+enum Op { SUM, MEAN, MAX, MIN, ARGMAX, ARGMIN };
+
+// sum(x[0:n])
+double sum(const ptrdiff_t n, const double* x);
+double sum(const ptrdiff_t n, const float* x);
+
+// sum(|x[0:n]|)
+double asum(const ptrdiff_t n, const double* x);
+double asum(const ptrdiff_t n, const float* x);
+
+// sum(x[0:n] .* y[0:n])
+double dot(const ptrdiff_t n, const double* x, const double* y);
+double dot(const ptrdiff_t n, const float* x, const float* y);
+
+// sum((scale * x[0:n])^2), the scaled pass of an overflow-safe norm
+double sumsq(const ptrdiff_t n, const double* x, const double scale);
+double sumsq(const ptrdiff_t n, const float* x, const double scale);
+
+// Index of the first largest |x[i]|, i < n, and that magnitude in *amax.
+// NaNs are skipped. Returns 0 with *amax = 0 if n = 0.
+ptrdiff_t iamax(const ptrdiff_t n, const double* x, double* amax);
+ptrdiff_t iamax(const ptrdiff_t n, const float* x, double* amax);
+
+// y[i] = op(a[i*lda : i*lda + n]), i < m
+void rows(const Op op, const ptrdiff_t m, const ptrdiff_t n, const double* a,
+          const ptrdiff_t lda, double* y, ptrdiff_t* index);
+void rows(const Op op, const ptrdiff_t m, const ptrdiff_t n, const float* a,
+          const ptrdiff_t lda, float* y, ptrdiff_t* index);
+
+// y[j] = op(a[j], a[lda + j], ..., a[(m-1)*lda + j]), j < n
+void cols(const Op op, const ptrdiff_t m, const ptrdiff_t n, const double* a,
+          const ptrdiff_t lda, double* y, ptrdiff_t* index);
+void cols(const Op op, const ptrdiff_t m, const ptrdiff_t n, const float* a,
+          const ptrdiff_t lda, float* y, ptrdiff_t* index);
+
+}  // namespace reduce
@@ -0,0 +1,373 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "Matrix.h"
+
+// Sparse kernels on compressed arrays (ptr, index, values) with `outer`
+// slices: the nonzeros of slice o are index[k], values[k] for k in
+// [ptr[o], ptr[o+1]). They describe the (outer x inner) matrix P with
+// P(o, index[k]) = values[k], which is A for CSR and A^T for CSC.
+namespace sparse {
+
+enum Format { CSR, CSC };
+
+// C = alpha * op(P) * B + beta * C, B has n columns and leading
+// dimension ldb. Without the transpose each row of C gathers its slice;
+// with it, slices scatter into C across column panels or per-thread
+// partial sums. Split across the ThreadPool by nonzeros.
+void mult(const bool trans, const ptrdiff_t outer, const ptrdiff_t inner,
+          const ptrdiff_t* ptr, const ptrdiff_t* index, const double* values,
+          const ptrdiff_t n, const double alpha,
+          const double* B, const ptrdiff_t ldb,
+          const double beta, double* C, const ptrdiff_t ldc);
+void mult(const bool trans, const ptrdiff_t outer, const ptrdiff_t inner,
+          const ptrdiff_t* ptr, const ptrdiff_t* index, const float* values,
+          const ptrdiff_t n, const double alpha,
+          const float* B, const ptrdiff_t ldb,
+          const double beta, float* C, const ptrdiff_t ldc);
+
+// C = alpha * B * op(P) + beta * C, B has m rows. Split by rows of B.
+void multRight(const bool trans, const ptrdiff_t outer,
+               const ptrdiff_t inner, const ptrdiff_t* ptr,
+               const ptrdiff_t* index, const double* values,
+               const ptrdiff_t m, const double alpha,
+               const double* B, const ptrdiff_t ldb,
+               const double beta, double* C, const ptrdiff_t ldc);
+void multRight(const bool trans, const ptrdiff_t outer,
+               const ptrdiff_t inner, const ptrdiff_t* ptr,
+               const ptrdiff_t* index, const float* values,
+               const ptrdiff_t m, const double alpha,
+               const float* B, const ptrdiff_t ldb,
+               const double beta, float* C, const ptrdiff_t ldc);
+
+// sum P(o, i) * B(o, i), or B(i, o) if trans, reduced in double
+double dot(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+           const ptrdiff_t* index, const double* values,
+           const double* B, const ptrdiff_t ldb);
+double dot(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+           const ptrdiff_t* index, const float* values,
+           const float* B, const ptrdiff_t ldb);
+
+// B += alpha * P, or alpha * P^T if trans
+void axpy(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+          const ptrdiff_t* index, const double* values, const double alpha,
+          double* B, const ptrdiff_t ldb);
+void axpy(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+          const ptrdiff_t* index, const float* values, const double alpha,
+          float* B, const ptrdiff_t ldb);
+
+}  // namespace sparse
+
+// Compressed sparse (m x n) matrix storing only its nonzeros, in CSR
+// (rows compressed) or CSC (columns compressed) format, see namespace
+// sparse. Products against dense Matrix<T, S> use MKL's sparse BLAS on
+// MKL and the ThreadPool kernels above on the other backends.
+//
+// Example:
+//     Sparse<T> X(N, d, rows, cols, values);  // From COO triplets
+//     mprod(false, 1.0, X, w, 0.0, &y);       // y = X * w
+//     mprod(true, 1.0, X, r, 0.0, &g);        // g = X^T * r
+//     Matrix<T> Z = H * X;                    // Dense times sparse
+template <BLAS T, Real S = double>
+class Sparse {
+ public:
+    using Scalar = S;
+    using Dense = Matrix<T, S>;
+
+    // Zero (m x n) matrix
+    Sparse(ptrdiff_t m, ptrdiff_t n, sparse::Format format = sparse::CSR)
+        : _m(m), _n(n), _format(format) {
+        if (m < 0 || n < 0) throw(1);
+        _ptr.assign(outer() + 1, 0);
+    }
+
+    // From COO triplets A(rows[k], cols[k]) = values[k], in any order.
+    // Duplicates are summed, throw(1) on an index out of range.
+    Sparse(ptrdiff_t m, ptrdiff_t n, const std::vector<ptrdiff_t>& rows,
+           const std::vector<ptrdiff_t>& cols, const std::vector<S>& values,
+           sparse::Format format = sparse::CSR)
+        : Sparse(m, n, format) {
+        if (rows.size() != cols.size() || rows.size() != values.size())
+            throw(1);
+        for (size_t k = 0; k < rows.size(); k++) {
+            if (rows[k] < 0 || rows[k] >= m) throw(1);
+            if (cols[k] < 0 || cols[k] >= n) throw(1);
+        }
+        const bool csr = format == sparse::CSR;
+        compress(csr ? rows : cols, csr ? cols : rows, values);
+    }
+
+    // Nonzeros of a dense matrix
+    explicit Sparse(const Dense& A, sparse::Format format = sparse::CSR)
+        : Sparse(A.rows(), A.cols(), format) {
+        std::vector<ptrdiff_t> rows, cols;
+        std::vector<S> values;
+        for (ptrdiff_t i = 0; i < _m; i++) {
+            for (ptrdiff_t j = 0; j < _n; j++) {
+                if (A[i][j] == 0) continue;
+                rows.push_back(i);
+                cols.push_back(j);
+                values.push_back(A[i][j]);
+            }
+        }
+        const bool csr = format == sparse::CSR;
+        compress(csr ? rows : cols, csr ? cols : rows, values);
+    }
+
+    // Deep Copy Constructor: Sparse<T> A(B);
+    explicit Sparse(const Sparse& A) = default;
+    Sparse(Sparse&& A) = default;
+
+    // Deep Copy Assignment disabled, as for Matrix<T>
+    Sparse& operator=(const Sparse& A) = delete;
+    Sparse& operator=(Sparse&& A) = default;
+
+    ptrdiff_t rows() const { return _m; }
+    ptrdiff_t cols() const { return _n; }
+    ptrdiff_t nnz() const { return _ptr.back(); }
+    sparse::Format format() const { return _format; }
+
+    // Compressed dimension, rows for CSR and columns for CSC
+    ptrdiff_t outer() const { return _format == sparse::CSR ? _m : _n; }
+    ptrdiff_t inner() const { return _format == sparse::CSR ? _n : _m; }
+
+    // Compressed arrays, see namespace sparse
+    const ptrdiff_t* ptr() const { return _ptr.data(); }
+    const ptrdiff_t* index() const { return _index.data(); }
+    const S* values() const { return _values.data(); }
+    S* values() { return _values.data(); }
+
+    // Same matrix in the given format
+    Sparse convert(sparse::Format format) const {
+        if (format == _format) return Sparse(*this);
+        // Slice indices of each nonzero become its inner indices
+        std::vector<ptrdiff_t> slice(nnz());
+        for (ptrdiff_t o = 0; o < outer(); o++)
+            std::fill(slice.begin() + _ptr[o], slice.begin() + _ptr[o + 1], o);
+        Sparse A(_m, _n, format);
+        A.compress(_index, slice, _values);
+        return A;
+    }
+
+    // Dense copy
+    Dense dense() const {
+        Dense A(_m, _n);
+        A.fill(0);
+        sparse::axpy(_format == sparse::CSC, outer(), ptr(), index(),
+                     values(), 1.0, A, A.ld());
+        return A;
+    }
+
+    // Sparse-Dense Multiply: C = alpha * op(*this) * B + beta * C
+    int __mult(const bool transA, const double alpha, const Dense& B,
+               const double beta, Dense* C) const;
+
+    // Dense-Sparse Multiply: C = alpha * A * op(*this) + beta * C
+    int __multRight(const bool transB, const double alpha, const Dense& A,
+                    const double beta, Dense* C) const;
+
+    // Dot Product with a dense matrix
+    int __dot(const Dense& B, double* d) const;
+
+    // DAXPY: B = B + alpha * (*this)
+    int __daxpy(const double alpha, Dense* B) const;
+
+ private:
+    // Fill the compressed arrays from triplets (outer[k], inner[k]),
+    // sorted by two stable counting sorts, with duplicates summed
+    void compress(const std::vector<ptrdiff_t>& outer,
+                  const std::vector<ptrdiff_t>& inner,
+                  const std::vector<S>& values) {
+        const ptrdiff_t nnz = values.size();
+        auto sort = [nnz](const std::vector<ptrdiff_t>& order,
+                          const std::vector<ptrdiff_t>& key,
+                          ptrdiff_t range, std::vector<ptrdiff_t>* start) {
+            start->assign(range + 1, 0);
+            for (ptrdiff_t k = 0; k < nnz; k++) (*start)[key[k] + 1]++;
+            for (ptrdiff_t r = 0; r < range; r++)
+                (*start)[r + 1] += (*start)[r];
+            std::vector<ptrdiff_t> next(start->begin(), start->end() - 1);
+            std::vector<ptrdiff_t> sorted(nnz);
+            for (ptrdiff_t k : order) sorted[next[key[k]]++] = k;
+            return sorted;
+        };
+        std::vector<ptrdiff_t> order(nnz), start;
+        for (ptrdiff_t k = 0; k < nnz; k++) order[k] = k;
+        order = sort(order, inner, this->inner(), &start);
+        order = sort(order, outer, this->outer(), &start);
+
+        _index.clear();
+        _values.clear();
+        _index.reserve(nnz);
+        _values.reserve(nnz);
+        for (ptrdiff_t o = 0; o < this->outer(); o++) {
+            _ptr[o] = _index.size();
+            for (ptrdiff_t s = start[o]; s < start[o + 1]; s++) {
+                const ptrdiff_t k = order[s];
+                if (ptrdiff_t(_index.size()) > _ptr[o]
+                        && _index.back() == inner[k]) {
+                    _values.back() += values[k];
+                } else {
+                    _index.push_back(inner[k]);
+                    _values.push_back(values[k]);
+                }
+            }
+        }
+        _ptr[this->outer()] = _index.size();
+    }
+
+    ptrdiff_t _m, _n;
+    sparse::Format _format;
+    std::vector<ptrdiff_t> _ptr;
+    std::vector<ptrdiff_t> _index;
+    std::vector<S> _values;
+};
+
+#if MKL_FOUND
+// Products through MKL's sparse BLAS, see MatrixMKL.cpp
+template <> int Sparse<MKL, double>::__mult(const bool, const double,
+    const Dense&, const double, Dense*) const;
+template <> int Sparse<MKL, double>::__multRight(const bool, const double,
+    const Dense&, const double, Dense*) const;
+template <> int Sparse<MKL, float>::__mult(const bool, const double,
+    const Dense&, const double, Dense*) const;
+template <> int Sparse<MKL, float>::__multRight(const bool, const double,
+    const Dense&, const double, Dense*) const;
+#endif
+
+template <BLAS T, Real S>
+int Sparse<T, S>::__mult(const bool transA,
+        const double alpha,
+        const Dense& B,
+        const double beta,
+        Dense* C) const {
+    sparse::mult(transA != (_format == sparse::CSC),  // trans
+                 outer(),                             // outer
+                 inner(),                             // inner
+                 ptr(),                               // ptr
+                 index(),                             // index
+                 values(),                            // values
+                 B.cols(),                            // n
+                 alpha,                               // alpha
+                 B,                                   // B
+                 B.ld(),                              // ldb
+                 beta,                                // beta
+                 *C,                                  // C
+                 C->ld());                            // ldc
+    return 0;  // Successful Multiply
+}
+
+template <BLAS T, Real S>
+int Sparse<T, S>::__multRight(const bool transB,
+        const double alpha,
+        const Dense& A,
+        const double beta,
+        Dense* C) const {
+    sparse::multRight(transB != (_format == sparse::CSC),  // trans
+                      outer(),                             // outer
+                      inner(),                             // inner
+                      ptr(),                               // ptr
+                      index(),                             // index
+                      values(),                            // values
+                      A.rows(),                            // m
+                      alpha,                               // alpha
+                      A,                                   // B
+                      A.ld(),                              // ldb
+                      beta,                                // beta
+                      *C,                                  // C
+                      C->ld());                            // ldc
+    return 0;  // Successful Multiply
+}
+
+template <BLAS T, Real S>
+int Sparse<T, S>::__dot(const Dense& B, double* d) const {
+    *d = sparse::dot(_format == sparse::CSC, outer(), ptr(), index(),
+                     values(), B, B.ld());
+    return 0;
+}
+
+template <BLAS T, Real S>
+int Sparse<T, S>::__daxpy(const double alpha, Dense* B) const {
+    sparse::axpy(_format == sparse::CSC, outer(), ptr(), index(), values(),
+                 alpha, *B, B->ld());
+    return 0;
+}
+
+// Sparse-Dense Product: C = alpha * op(A) * B + beta * C
+// C must not overlap B.
+template <BLAS T, Real S>
+void mprod(const bool transA, const double alpha, const Sparse<T, S>& A,
+           const Matrix<T, S>& B, const double beta, Matrix<T, S>* C) {
+    if ((transA ? A.rows() : A.cols()) != B.rows()) throw(1);
+    if ((transA ? A.cols() : A.rows()) != C->rows()) throw(1);
+    if (B.cols() != C->cols()) throw(1);
+    if (A.__mult(transA, alpha, B, beta, C)) throw(1);
+}
+
+// Dense-Sparse Product: C = alpha * A * op(B) + beta * C
+// C must not overlap A.
+template <BLAS T, Real S>
+void mprod(const bool transB, const double alpha, const Matrix<T, S>& A,
+           const Sparse<T, S>& B, const double beta, Matrix<T, S>* C) {
+    if (A.cols() != (transB ? B.cols() : B.rows())) throw(1);
+    if (A.rows() != C->rows()) throw(1);
+    if ((transB ? B.rows() : B.cols()) != C->cols()) throw(1);
+    if (B.__multRight(transB, alpha, A, beta, C)) throw(1);
+}
+
+// C = A * B
+template <BLAS T, Real S>
+void mprod(const Sparse<T, S>& A, const Matrix<T, S>& B, Matrix<T, S>* C) {
+    mprod(false, 1.0, A, B, 0.0, C);
+}
+
+template <BLAS T, Real S>
+void mprod(const Matrix<T, S>& A, const Sparse<T, S>& B, Matrix<T, S>* C) {
+    mprod(false, 1.0, A, B, 0.0, C);
+}
+
+// C = A * B, allocating C
+template <BLAS T, Real S>
+Matrix<T, S> operator*(const Sparse<T, S>& A, const Matrix<T, S>& B) {
+    Matrix<T, S> C(A.rows(), B.cols());
+    mprod(A, B, &C);
+    return C;
+}
+
+template <BLAS T, Real S>
+Matrix<T, S> operator*(const Matrix<T, S>& A, const Sparse<T, S>& B) {
+    Matrix<T, S> C(A.rows(), B.cols());
+    mprod(A, B, &C);
+    return C;
+}
+
+// MAXPY: B += alpha * A
+template <BLAS T, Real S>
+void maxpy(const double alpha, const Sparse<T, S>& A, const ptrdiff_t inca,
+           Matrix<T, S>* B) {
+    if (A.rows() != B->rows()) throw(1);
+    if (A.cols() != B->cols()) throw(1);
+    if (inca != 1) throw(1);
+    A.__daxpy(alpha, B);
+}
+
+// Dot Product
+template <BLAS T, Real S>
+double dot(const Sparse<T, S>& A, const Matrix<T, S>& B) {
+    if (A.rows() != B.rows()) throw(1);
+    if (A.cols() != B.cols()) throw(1);
+    double d;
+    A.__dot(B, &d);
+    return d;
+}
+
+template <BLAS T, Real S>
+double dot(const Matrix<T, S>& A, const Sparse<T, S>& B) {
+    return dot(B, A);
+}
@@ -0,0 +1,169 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide pool of worker threads used to split the REF kernels
+// across cores. The calling thread participates in every job, so a pool
+// of size n owns n-1 worker threads.
+//
+// The worker count defaults to the hardware concurrency and can be set
+// with the MATRIX_NUM_THREADS environment variable or setNumThreads().
+// Setting MATRIX_PIN_THREADS=1 (or calling pin(true)) binds worker i to
+// core i on platforms that support thread affinity.
+//
+// Example:
+//     parallel_for(n, ThreadPool::grain(), [&](ptrdiff_t i0, ptrdiff_t i1) {
+//         for (ptrdiff_t i = i0; i < i1; i++) y[i] += x[i];
+//     });
+class ThreadPool {
+ public:
+    // Minimum elements per chunk for element-wise kernels, below which
+    // the fork/join overhead outweighs the gain. Set at load time from
+    // the tuning cache or the L2 size, see Tuning.h.
+    static ptrdiff_t grain() { return _grain.load(std::memory_order_relaxed); }
+    static void grain(ptrdiff_t n) {
+        _grain.store(std::max<ptrdiff_t>(n, 1), std::memory_order_relaxed);
+    }
+
+    // Process-wide instance
+    static ThreadPool& instance();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads participating in a job (workers + caller)
+    int size() const { return _size; }
+
+    // Resize to n threads (n < 1 selects the hardware concurrency)
+    void resize(int n);
+
+    // Bind worker threads to cores
+    void pin(bool enable);
+    bool pinned() const { return _pin; }
+
+    // True on pool workers, where nested jobs run serially
+    static bool nested();
+
+    // Number of chunks [0, n) is split into for a given grain
+    ptrdiff_t chunks(ptrdiff_t n, ptrdiff_t grain) const {
+        if (grain < 1) grain = 1;
+        return std::max<ptrdiff_t>(1, std::min<ptrdiff_t>(_size, n / grain));
+    }
+
+    // Call fn(ctx, c) for c in [0, chunks), blocking until all return
+    void run(ptrdiff_t chunks, void (*fn)(void*, ptrdiff_t), void* ctx);
+
+ private:
+    ThreadPool();
+    ~ThreadPool();
+
+    struct Job {
+        void (*fn)(void*, ptrdiff_t);
+        void* ctx;
+        ptrdiff_t chunks;
+        std::atomic<ptrdiff_t> next;
+        std::atomic<ptrdiff_t> remaining;
+    };
+
+    void start(int n);
+    void stop();
+    void worker(int id);
+    void execute(Job* job);
+
+    static inline std::atomic<ptrdiff_t> _grain{1 << 15};
+
+    int _size = 1;
+    bool _pin = false;
+    std::vector<std::thread> _workers;
+
+    std::mutex _run;      // Serializes jobs from distinct callers
+    std::mutex _mutex;    // Guards the fields below
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    Job* _job = nullptr;
+    unsigned long long _generation = 0;  // NOLINT [runtime/int]
+    int _busy = 0;
+    bool _stop = false;
+};
+
+// Apply f(begin, end) to contiguous chunks of [0, n) across the pool.
+// Runs serially when n <= grain, on a single thread, or when nested.
+template <typename F>
+void parallel_for(const ptrdiff_t n, const ptrdiff_t grain, F&& f) {
+    if (n <= 0) return;
+    ThreadPool& pool = ThreadPool::instance();
+    const ptrdiff_t chunks = pool.chunks(n, grain);
+    if (n <= grain || chunks == 1 || ThreadPool::nested()) {
+        f(ptrdiff_t(0), n);
+        return;
+    }
+    struct Context { F* f; ptrdiff_t n, chunks; } ctx{&f, n, chunks};
+    pool.run(chunks, [](void* p, ptrdiff_t c) {
+        Context& ctx = *static_cast<Context*>(p);
+        (*ctx.f)(c * ctx.n / ctx.chunks, (c + 1) * ctx.n / ctx.chunks);
+    }, &ctx);
+}
+
+// Sum f(begin, end) over contiguous chunks of [0, n) across the pool
+template <typename F>
+double parallel_reduce(const ptrdiff_t n, const ptrdiff_t grain, F&& f) {
+    if (n <= 0) return 0;
+    ThreadPool& pool = ThreadPool::instance();
+    const ptrdiff_t chunks = ThreadPool::nested() ? 1 : pool.chunks(n, grain);
+    std::vector<double> partial(chunks);
+    parallel_for(chunks, 1, [&](ptrdiff_t c0, ptrdiff_t c1) {
+        for (ptrdiff_t c = c0; c < c1; c++) {
+            partial[c] = f(c * n / chunks, (c + 1) * n / chunks);
+        }
+    });
+    double sum = 0;
+    for (double p : partial) sum += p;
+    return sum;
+}
+
+// Element-wise traversal of an (m x n) matrix: f(i, j0, j1) is applied
+// to columns [j0, j1) of row i, and a contiguous matrix is traversed as
+// a single row of m*n elements.
+template <typename F>
+void parallel_rows(const ptrdiff_t m, const ptrdiff_t n,
+                   const bool contiguous, const ptrdiff_t grain, F&& f) {
+    if (contiguous) {
+        parallel_for(m * n, grain, [&](ptrdiff_t i0, ptrdiff_t i1) {
+            f(ptrdiff_t(0), i0, i1);
+        });
+    } else {
+        const ptrdiff_t rows = grain / std::max<ptrdiff_t>(n, 1);
+        parallel_for(m, std::max<ptrdiff_t>(1, rows),
+            [&](ptrdiff_t i0, ptrdiff_t i1) {
+                for (ptrdiff_t i = i0; i < i1; i++) f(i, ptrdiff_t(0), n);
+            });
+    }
+}
+
+// Reduction over the same traversal: the sum of f(i, j0, j1) over the
+// row segments of an (m x n) matrix
+template <typename F>
+double parallel_rows_reduce(const ptrdiff_t m, const ptrdiff_t n,
+                            const bool contiguous, const ptrdiff_t grain,
+                            F&& f) {
+    if (contiguous) {
+        return parallel_reduce(m * n, grain, [&](ptrdiff_t i0, ptrdiff_t i1) {
+            return f(ptrdiff_t(0), i0, i1);
+        });
+    }
+    return parallel_reduce(m,
+        std::max<ptrdiff_t>(1, grain / std::max<ptrdiff_t>(n, 1)),
+        [&](ptrdiff_t i0, ptrdiff_t i1) {
+            double sum = 0;
+            for (ptrdiff_t i = i0; i < i1; i++) sum += f(i, ptrdiff_t(0), n);
+            return sum;
+        });
+}
@@ -0,0 +1,97 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Per-operation tracing
+//
+// Built with MATRIX_TRACE defined (cmake -DTRACE=ON), every OperatorSet
+// entry point (mprod, mgemv, msub, hprod, maxpy, mger, mcopy, dot, norm,
+// tanh, transpose, the serializers, += and -=) records an Event: its
+// name, backend, precision, shape, FLOPs, duration and thread. Events go
+// to a buffer owned by the recording thread, appended without locks, and
+// are kept until clear(). Without MATRIX_TRACE, MATRIX_TRACE_SPAN expands
+// to nothing and the entry points carry no tracing code at all.
+//
+// Example:
+//     for (int step = 0; step < steps; step++) train(step);
+//     trace::writeSummary(std::cout);    // Time per op and backend
+//     std::ofstream os("trace.json");
+//     trace::writeChrome(os);            // Open in chrome://tracing
+namespace trace {
+
+struct Event {
+    const char* name;       // e.g. "mprod", a string literal
+    int backend;            // BLAS
+    bool single;            // float, otherwise double
+    ptrdiff_t m, n, k;      // Output (m x n), inner dimension k (or 0)
+    double flops;           // Floating point operations, 0 for data motion
+    int64_t start;          // Nanoseconds since the process started
+    int64_t duration;       // Nanoseconds
+    uint32_t thread;        // 0 for the first thread to record, 1, ...
+};
+
+// Recording, on unless MATRIX_TRACING=0 in the environment
+void enable(bool on = true);
+bool enabled();
+
+// Drop every recorded event. Events recorded concurrently may be lost.
+void clear();
+
+// Recorded events of every thread, ordered by start. A thread whose
+// buffer is reset by a concurrent clear() contributes no events.
+std::vector<Event> events();
+
+// Chrome trace event JSON ("X" events, microseconds, args holding the
+// shape and FLOPs), for chrome://tracing or https://ui.perfetto.dev
+void writeChrome(std::ostream& os);
+
+// Calls, total and mean time and GFLOP/s per op, backend and precision,
+// most total time first
+void writeSummary(std::ostream& os);
+
+// Nanoseconds since the process started, steady
+int64_t now();
+
+// Records an Event for its lifetime, if enabled() at construction
+class Span {
+ public:
+    Span(const char* name, int backend, bool single, ptrdiff_t m,
+         ptrdiff_t n, ptrdiff_t k, double flops)
+            : _event{name, backend, single, m, n, k, flops, 0, 0, 0},
+              _on(enabled()) {
+        if (_on) _event.start = now();
+    }
+
+    ~Span() {
+        if (_on) {
+            _event.duration = now() - _event.start;
+            record(&_event);
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+ private:
+    // Append to the calling thread's buffer, setting the thread id
+    static void record(Event* event);
+
+    Event _event;
+    const bool _on;
+};
+
+}  // namespace trace
+
+// Trace the enclosing scope as an operation on the matrix class T
+#if defined(MATRIX_TRACE)
+#define MATRIX_TRACE_SPAN(name, T, m, n, k, flops)                         \
+    trace::Span traceSpan(name, BackendType<T>::value,                     \
+        std::is_same_v<typename ScalarType<T>::type, float>, m, n, k, flops)
+#else
+#define MATRIX_TRACE_SPAN(name, T, m, n, k, flops)
+#endif
@@ -0,0 +1,75 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Tuned parameters of the REF kernels
+//
+// The best GEMM cache blocks, transpose tile and element-wise grain
+// depend on the host's caches. When the library is loaded it applies the
+// entry for cpuModel() in cachePath(), written by the tune tool (built
+// next to benchmark), and otherwise parameters derived from the cache
+// sizes by heuristic().
+//
+// Example:
+//     $ ./tune                       # Search on this host, save the entry
+//     tuning::current().kc           # 384
+namespace tuning {
+
+struct Params {
+    // GEMM microkernel ("avx512", "avx2" or "generic"), i.e. the register
+    // tile the inner loop is unrolled to. Empty keeps the active one.
+    std::string kernel;
+
+    // GEMM cache blocks (see gemm::Blocking), double and single precision
+    ptrdiff_t mc = 0, kc = 0, nc = 0;
+    ptrdiff_t smc = 0, skc = 0, snc = 0;
+
+    // Transpose tile edge, layout::block()
+    ptrdiff_t block = 0;
+
+    // Minimum elements per chunk of the element-wise kernels,
+    // ThreadPool::grain()
+    ptrdiff_t grain = 0;
+};
+
+// Data cache sizes in bytes, 0 where unknown. L3 is shared by all cores.
+struct Caches {
+    ptrdiff_t l1 = 0, l2 = 0, l3 = 0;
+};
+
+Caches caches();
+
+// CPU model string keying the cache, e.g. "Intel(R) Xeon(R) Gold 6248"
+std::string cpuModel();
+
+// Parameters for the active GEMM microkernel derived from caches(). Sizes
+// that are unknown keep the defaults of the kernel tables.
+//     kc    : L1 / (16 * sizeof(S)), micro-panels of A and B stream
+//             through L1 together
+//     mc    : the mc x kc block of A fills a quarter of L2
+//     nc    : the kc x nc block of B, shared by all threads, fills half
+//             of L3
+//     block : a tile and its destination fill half of L1
+//     grain : three streams of doubles fill three quarters of L2
+Params heuristic();
+
+// Parameters in effect
+Params current();
+
+// Set every nonzero parameter. Returns false, changing nothing, if the
+// kernel is not supported by the host.
+bool apply(const Params& p);
+
+// Tuning cache: MATRIX_TUNE_CACHE, else $HOME/.matrix_tune
+std::string cachePath();
+
+// Apply the entry for cpuModel(), returns false if there is none
+bool load(const std::string& path = cachePath());
+
+// Write p as the entry for cpuModel(), keeping the other CPUs' entries
+bool save(const Params& p, const std::string& path = cachePath());
+
+}  // namespace tuning
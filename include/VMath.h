@@ -0,0 +1,41 @@
+// Copyright 2023 Caleb Magruder
+
+#pragma once
+
+#include <cstddef>
+
+// Vectorized elementary functions over arrays of doubles or floats
+//
+// Each function takes an accuracy mode, after MKL VML's HA/LA/EP:
+//     HIGH : the scalar libm function (std::tanh), the reference
+//     LOW  : SIMD rational approximation, at most 4 ulp
+//     FAST : SIMD rational approximation with a single division,
+//            relative error below 1e-8, i.e. about half of the bits
+// The SIMD kernels are selected at runtime from the host's extensions.
+namespace vmath {
+
+enum Accuracy { HIGH, LOW, FAST };
+
+// y[i] = tanh(x[i]), i < n. x and y may be the same array.
+void tanh(const ptrdiff_t n, const double* x, double* y,
+          const Accuracy mode = HIGH);
+
+// Single precision, LOW and FAST widen to double through the same kernels
+void tanh(const ptrdiff_t n, const float* x, float* y,
+          const Accuracy mode = HIGH);
+
+// Box-Muller transform of uniform pairs to standard normal pairs:
+//     z0[i] = r cos(2 pi u2[i]), z1[i] = r sin(2 pi u2[i]),
+//     r = sqrt(-2 log(u1[i])),
+// for u1[i] in (0, 1] and u2[i] in [0, 1), i < n. SIMD log and sincos,
+// within a few ulp of libm.
+void boxMuller(const ptrdiff_t n, const double* u1, const double* u2,
+               double* z0, double* z1);
+
+// Name of the active SIMD kernel: "avx512", "avx2" or "generic"
+const char* kernel();
+
+// Force a SIMD kernel by name, returns false if unsupported by the host
+bool kernel(const char* name);
+
+}  // namespace vmath
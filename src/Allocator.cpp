@@ -0,0 +1,230 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Allocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+// Each PoolAllocator block starts with a 64-byte header so that the
+// payload stays 64-byte aligned and deallocate() can find its origin
+enum Kind : uint32_t { POOLED, LARGE, ARENA };
+
+struct alignas(PoolAllocator::ALIGN) Header {
+    Kind kind;
+    int sizeClass;
+};
+
+constexpr size_t HEADER = sizeof(Header);
+
+size_t round64(size_t bytes) {
+    return (bytes + 63) / 64 * 64;
+}
+
+// Four classes per power of two: 64, 80, 96, 112, 128, 160, 192, ...
+size_t classSize(int c) {
+    return size_t(4 + c % 4) << (c / 4 + 4);
+}
+
+// Smallest class holding bytes
+int sizeClass(size_t bytes) {
+    if (bytes <= 64) return 0;
+    const int e = std::bit_width(bytes - 1) - 1;  // 2^e < bytes <= 2^(e+1)
+    const size_t q = (bytes + (size_t(1) << (e - 2)) - 1) >> (e - 2);
+    return 4 * (e - 6) + static_cast<int>(q) - 4;
+}
+
+constexpr int NCLASSES = 4 * (26 - 7) + 5;  // Through MAXPOOLED
+
+// Blocks a thread keeps per class before spilling to the shared list
+size_t cacheLimit(int c) {
+    return std::clamp<size_t>((size_t(4) << 20) / classSize(c), 4, 64);
+}
+
+Header* systemAlloc(int c) {
+    void* block = std::aligned_alloc(PoolAllocator::ALIGN,
+                                     round64(HEADER + classSize(c)));
+    if (block == nullptr) return nullptr;
+    return new (block) Header{POOLED, c};
+}
+
+// Free lists shared by all threads
+struct Shared {
+    std::mutex mutex;
+    std::vector<Header*> free[NCLASSES];
+
+    Header* pop(int c) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free[c].empty()) return nullptr;
+        Header* h = free[c].back();
+        free[c].pop_back();
+        return h;
+    }
+
+    void push(Header* h) {
+        std::lock_guard<std::mutex> lock(mutex);
+        free[h->sizeClass].push_back(h);
+    }
+};
+
+// Leaked so that it outlives thread-local caches at exit
+Shared& shared() {
+    static Shared* s = new Shared;
+    return *s;
+}
+
+// Set when the calling thread's Cache is destroyed. Trivially
+// destructible, so that it is still readable while static objects (e.g.
+// a static Matrix) are destroyed after the thread-local cache.
+thread_local bool cacheDestroyed = false;
+
+// Per-thread free lists, spilled to the shared lists on thread exit
+struct Cache {
+    std::vector<Header*> free[NCLASSES];
+
+    ~Cache() {
+        cacheDestroyed = true;
+        Shared& s = shared();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (int c = 0; c < NCLASSES; c++) {
+            s.free[c].insert(s.free[c].end(), free[c].begin(), free[c].end());
+        }
+    }
+
+    Header* pop(int c) {
+        std::vector<Header*>& list = free[c];
+        if (list.empty()) {
+            // Refill half a cache's worth from the shared list
+            Shared& s = shared();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            std::vector<Header*>& from = s.free[c];
+            const size_t n = std::min(from.size(), cacheLimit(c) / 2 + 1);
+            list.insert(list.end(), from.end() - n, from.end());
+            from.resize(from.size() - n);
+        }
+        if (list.empty()) return nullptr;
+        Header* h = list.back();
+        list.pop_back();
+        return h;
+    }
+
+    void push(Header* h) {
+        std::vector<Header*>& list = free[h->sizeClass];
+        list.push_back(h);
+        if (list.size() > cacheLimit(h->sizeClass)) {
+            // Spill the older half to the shared list
+            Shared& s = shared();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            const size_t n = list.size() / 2;
+            std::vector<Header*>& to = s.free[h->sizeClass];
+            to.insert(to.end(), list.begin(), list.begin() + n);
+            list.erase(list.begin(), list.begin() + n);
+        }
+    }
+};
+
+// Calling thread's cache, nullptr once it is destroyed at exit
+Cache* cache() {
+    if (cacheDestroyed) return nullptr;
+    thread_local Cache c;
+    return &c;
+}
+
+thread_local ScopedArena* currentArena = nullptr;
+
+}  // namespace
+
+void* PoolAllocator::allocate(size_t bytes) {
+    if (ScopedArena* arena = ScopedArena::current()) {
+        return arena->allocate(bytes);
+    }
+    Header* h;
+    if (bytes > MAXPOOLED) {
+        void* block = std::aligned_alloc(ALIGN, round64(HEADER + bytes));
+        if (block == nullptr) return nullptr;
+        h = new (block) Header{LARGE, -1};
+    } else {
+        const int c = sizeClass(bytes);
+        Cache* cached = cache();
+        h = cached != nullptr ? cached->pop(c) : shared().pop(c);
+        if (h == nullptr) h = systemAlloc(c);
+        if (h == nullptr) return nullptr;
+    }
+    return h + 1;
+}
+
+void PoolAllocator::deallocate(void* ptr, size_t /*bytes*/) {
+    if (ptr == nullptr) return;
+    Header* h = static_cast<Header*>(ptr) - 1;
+    switch (h->kind) {
+        case POOLED:
+            if (Cache* cached = cache()) {
+                cached->push(h);
+            } else {
+                shared().push(h);
+            }
+            break;
+        case LARGE:
+            std::free(h);
+            break;
+        case ARENA:
+            break;  // Released with the arena
+    }
+}
+
+void PoolAllocator::trim() {
+    Shared& s = shared();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (std::vector<Header*>& list : s.free) {
+        for (Header* h : list) std::free(h);
+        list.clear();
+        list.shrink_to_fit();
+    }
+}
+
+// Arena chunk, payload follows the 64-byte chunk header
+struct alignas(PoolAllocator::ALIGN) ScopedArena::Chunk {
+    Chunk* next;
+    size_t size;
+    size_t offset;
+};
+
+ScopedArena::ScopedArena(size_t bytes)
+        : _chunkSize(round64(std::max<size_t>(bytes, 4096))),
+          _prev(currentArena) {
+    currentArena = this;
+}
+
+ScopedArena::~ScopedArena() {
+    while (_chunks != nullptr) {
+        Chunk* next = _chunks->next;
+        std::free(_chunks);
+        _chunks = next;
+    }
+    currentArena = _prev;
+}
+
+ScopedArena* ScopedArena::current() {
+    return currentArena;
+}
+
+void* ScopedArena::allocate(size_t bytes) {
+    const size_t need = round64(HEADER + bytes);
+    if (_chunks == nullptr || _chunks->offset + need > _chunks->size) {
+        const size_t size = std::max(_chunkSize, need);
+        void* block = std::aligned_alloc(PoolAllocator::ALIGN,
+                                         sizeof(Chunk) + size);
+        if (block == nullptr) return nullptr;
+        _chunks = new (block) Chunk{_chunks, size, 0};
+    }
+    char* payload = reinterpret_cast<char*>(_chunks + 1) + _chunks->offset;
+    Header* h = new (payload) Header{ARENA, -1};
+    _chunks->offset += need;
+    _used += bytes;
+    return h + 1;
+}
@@ -0,0 +1,212 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Async.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace async {
+
+// An operation and its place in the dependency graph, guarded by the
+// scheduler's mutex
+struct Event::Node {
+    std::function<void()> f;
+    std::vector<Range> reads, writes;
+    std::vector<std::shared_ptr<Node>> dependents;
+    int pending = 0;  // Incomplete operations this one waits for
+    bool done = false;
+    std::exception_ptr error;
+};
+
+namespace {
+
+typedef Event::Node Node;
+
+bool overlap(const std::vector<Range>& a, const std::vector<Range>& b) {
+    for (const Range& x : a) {
+        for (const Range& y : b) {
+            if (x.begin < y.end && y.begin < x.end) return true;
+        }
+    }
+    return false;
+}
+
+// RAW, WAR or WAW between an earlier operation and a later one
+bool hazard(const Node& earlier, const Node& later) {
+    return overlap(earlier.writes, later.reads)
+        || overlap(earlier.writes, later.writes)
+        || overlap(earlier.reads, later.writes);
+}
+
+class Scheduler {
+ public:
+    Scheduler() {
+        const char* env = std::getenv("MATRIX_ASYNC_THREADS");
+        start(env != nullptr && *env != '\0' ? std::atoi(env) : 0);
+    }
+
+    ~Scheduler() {
+        drain();
+        stop();
+    }
+
+    void submit(const std::shared_ptr<Node>& node) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const std::shared_ptr<Node>& earlier : _inflight) {
+            if (hazard(*earlier, *node)) {
+                earlier->dependents.push_back(node);
+                node->pending++;
+            }
+        }
+        _inflight.push_back(node);
+        if (node->pending == 0) {
+            _ready.push_back(node);
+            _wake.notify_one();
+        }
+    }
+
+    void wait(const Node& node) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [&] { return node.done; });
+    }
+
+    bool ready(const Node& node) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return node.done;
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [&] { return _inflight.empty(); });
+    }
+
+    int size() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _workers.size();
+    }
+
+    void resize(int n) {
+        std::lock_guard<std::mutex> resizing(_resize);
+        drain();
+        stop();
+        start(n);
+    }
+
+ private:
+    void start(int n) {
+        if (n < 1) n = std::max(1u, std::thread::hardware_concurrency());
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = false;
+        for (int i = 0; i < n; i++) _workers.emplace_back([this] { work(); });
+    }
+
+    void stop() {
+        std::vector<std::thread> workers;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+            workers.swap(_workers);
+        }
+        _wake.notify_all();
+        for (std::thread& t : workers) t.join();
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _wake.wait(lock, [&] { return _stop || !_ready.empty(); });
+            if (_ready.empty()) return;
+            std::shared_ptr<Node> node = std::move(_ready.front());
+            _ready.pop_front();
+            lock.unlock();
+            if (!node->error) {
+                try {
+                    node->f();
+                } catch (...) {
+                    node->error = std::current_exception();
+                }
+            }
+            node->f = nullptr;  // Release captures outside the lock
+            lock.lock();
+            complete(node);
+        }
+    }
+
+    // Release the dependents of a finished node, skipping those of a
+    // failed one with its error
+    void complete(const std::shared_ptr<Node>& node) {
+        node->done = true;
+        _inflight.remove(node);
+        for (const std::shared_ptr<Node>& d : node->dependents) {
+            if (node->error && !d->error) d->error = node->error;
+            if (--d->pending == 0) {
+                _ready.push_back(d);
+                _wake.notify_one();
+            }
+        }
+        node->dependents.clear();
+        _done.notify_all();
+    }
+
+    std::mutex _resize;  // Serializes resize()
+    std::mutex _mutex;   // Guards the fields below and every Node
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::list<std::shared_ptr<Node>> _inflight;  // In submission order
+    std::deque<std::shared_ptr<Node>> _ready;
+    std::vector<std::thread> _workers;
+    bool _stop = false;
+};
+
+Scheduler& scheduler() {
+    static Scheduler s;
+    return s;
+}
+
+}  // namespace
+
+void Event::wait() const {
+    if (!_node) return;
+    scheduler().wait(*_node);
+    if (_node->error) std::rethrow_exception(_node->error);
+}
+
+bool Event::ready() const {
+    return !_node || scheduler().ready(*_node);
+}
+
+Event submit(const std::vector<Range>& reads,
+             const std::vector<Range>& writes, std::function<void()> f) {
+    auto node = std::make_shared<Node>();
+    node->f = std::move(f);
+    // Empty operands cannot conflict
+    for (const Range& r : reads) {
+        if (r.begin != r.end) node->reads.push_back(r);
+    }
+    for (const Range& w : writes) {
+        if (w.begin != w.end) node->writes.push_back(w);
+    }
+    scheduler().submit(node);
+    return Event(node);
+}
+
+void wait() {
+    scheduler().drain();
+}
+
+int workers() {
+    return scheduler().size();
+}
+
+void workers(int n) {
+    scheduler().resize(n);
+}
+
+}  // namespace async
@@ -0,0 +1,68 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Broadcast.h"
+
+namespace broadcast {
+
+namespace {
+
+template <typename S>
+void vectorT(const Op op, const ptrdiff_t n, const S* a, const S* v, S* c) {
+    switch (op) {
+        case ADD:
+            for (ptrdiff_t j = 0; j < n; j++) c[j] = a[j] + v[j];
+            break;
+        case SUB:
+            for (ptrdiff_t j = 0; j < n; j++) c[j] = a[j] - v[j];
+            break;
+        case MUL:
+            for (ptrdiff_t j = 0; j < n; j++) c[j] = a[j] * v[j];
+            break;
+        case DIV:
+            for (ptrdiff_t j = 0; j < n; j++) c[j] = a[j] / v[j];
+            break;
+    }
+}
+
+template <typename S>
+void scalarT(const Op op, const ptrdiff_t n, const S* a, const S s, S* c) {
+    switch (op) {
+        case ADD:
+            for (ptrdiff_t j = 0; j < n; j++) c[j] = a[j] + s;
+            break;
+        case SUB:
+            for (ptrdiff_t j = 0; j < n; j++) c[j] = a[j] - s;
+            break;
+        case MUL:
+            for (ptrdiff_t j = 0; j < n; j++) c[j] = a[j] * s;
+            break;
+        case DIV:
+            // Divides rather than multiplying by 1 / s, to round as a / s
+            for (ptrdiff_t j = 0; j < n; j++) c[j] = a[j] / s;
+            break;
+    }
+}
+
+}  // namespace
+
+void vector(const Op op, const ptrdiff_t n, const double* a, const double* v,
+            double* c) {
+    vectorT(op, n, a, v, c);
+}
+
+void vector(const Op op, const ptrdiff_t n, const float* a, const float* v,
+            float* c) {
+    vectorT(op, n, a, v, c);
+}
+
+void scalar(const Op op, const ptrdiff_t n, const double* a, const double s,
+            double* c) {
+    scalarT(op, n, a, s, c);
+}
+
+void scalar(const Op op, const ptrdiff_t n, const float* a, const float s,
+            float* c) {
+    scalarT(op, n, a, s, c);
+}
+
+}  // namespace broadcast
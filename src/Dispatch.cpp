@@ -0,0 +1,299 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Dispatch.h"
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "Matrix.h"
+
+namespace dispatch {
+
+namespace {
+
+// Timing rounds per measurement, and the speedup a backend needs over
+// the one listed before it to be chosen (so noise does not flip ties)
+constexpr int ROUNDS = 3;
+constexpr double MARGIN = 0.95;
+
+const char* const NAMES[OPS] = {"gemm", "gemv", "ger", "dot", "axpy",
+                                "copy", "scale"};
+
+// Largest size class measured by calibrate(), by operation
+int maxClass(Op op, ptrdiff_t maxDim) {
+    switch (op) {
+        case GEMM: return sizeClass(maxDim);
+        case GEMV: case GER: return sizeClass(4 * maxDim);
+        default: return sizeClass(maxDim * maxDim);
+    }
+}
+
+// The BLAS preferred above the REF thresholds, REF if none is linked
+BLAS preferred() {
+#if MKL_FOUND
+    return MKL;
+#elif ACC_FOUND
+    return ACC;
+#elif OPB_FOUND
+    return OPB;
+#else
+    return REF;
+#endif
+}
+
+// Uncalibrated choice: BLAS for level 3 from 32 and level 2 from 64,
+// REF's threaded loops for level 1
+BLAS fallback(Op op, int c) {
+    switch (op) {
+        case GEMM: return c > sizeClass(31) ? preferred() : REF;
+        case GEMV: case GER: return c > sizeClass(63) ? preferred() : REF;
+        default: return REF;
+    }
+}
+
+struct Table {
+    std::atomic<BLAS> entry[2][OPS][CLASSES];
+
+    Table() { defaults(); }
+
+    void defaults() {
+        for (int s = 0; s < 2; s++)
+            for (int op = 0; op < OPS; op++)
+                for (int c = 0; c < CLASSES; c++)
+                    entry[s][op][c].store(fallback(Op(op), c),
+                                          std::memory_order_relaxed);
+    }
+};
+
+// The table before the cache is read
+Table& raw() {
+    static Table t;
+    return t;
+}
+
+bool read(const std::string& path);
+
+// The table, read from cachePath() on first use
+Table& table() {
+    static const bool loaded = read(cachePath());
+    (void)loaded;
+    return raw();
+}
+
+bool linked(BLAS backend) {
+    for (BLAS b : backends()) if (b == backend) return true;
+    return false;
+}
+
+bool parse(const std::string& s, BLAS* backend) {
+    for (BLAS b : {REF, ACC, OPB, MKL}) {
+        std::ostringstream os;
+        os << b;
+        if (os.str() == s) {
+            *backend = b;
+            return true;
+        }
+    }
+    return false;
+}
+
+// One line per entry: "<double|float> <op> <class> <backend>"
+bool read(const std::string& path) {
+    std::ifstream is(path);
+    if (!is) return false;
+    BLAS entry[2][OPS][CLASSES];
+    for (int s = 0; s < 2; s++)
+        for (int op = 0; op < OPS; op++)
+            for (int c = 0; c < CLASSES; c++)
+                entry[s][op][c] = fallback(Op(op), c);
+    std::string line;
+    while (std::getline(is, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ls(line);
+        std::string precision, op, backend;
+        int c = -1;
+        if (!(ls >> precision >> op >> c >> backend)) return false;
+        int o = 0;
+        while (o < OPS && op != NAMES[o]) o++;
+        BLAS b;
+        if (o == OPS || c < 0 || c >= CLASSES || !parse(backend, &b)
+            || (precision != "double" && precision != "float")) return false;
+        if (linked(b)) entry[precision == "float"][o][c] = b;
+    }
+    for (int s = 0; s < 2; s++)
+        for (int op = 0; op < OPS; op++)
+            for (int c = 0; c < CLASSES; c++)
+                raw().entry[s][op][c].store(entry[s][op][c]);
+    return true;
+}
+
+// Seconds per call of op on (size x size) operands, or size elements for
+// level 1: the best of ROUNDS averages over budget / ROUNDS seconds each,
+// after a warm-up call
+template <BLAS T, Real S>
+double time(Op op, ptrdiff_t size, double budget) {
+    const bool level1 = op != GEMM && op != GEMV && op != GER;
+    const ptrdiff_t m = size, n = level1 ? 1 : size;
+    Matrix<T, S> A = Matrix<T, S>::randn(m, n);
+    Matrix<T, S> B = Matrix<T, S>::randn(m, n);
+    Matrix<T, S> C(m, n);
+    Matrix<T, S> x = Matrix<T, S>::randn(n), y = Matrix<T, S>::randn(m);
+    double d = 0;
+    auto call = [&] {
+        switch (op) {
+            case GEMM:
+                A.__mult(false, false, 1.0, B, 0.0, &C, gemm::Epilogue());
+                break;
+            case GEMV:
+                A.__gemv(false, 1.0, x, 1, 0.0, y, 1);
+                break;
+            case GER:
+                A.__dger(1e-9, y, x);
+                break;
+            case DOT:
+                A.__dot(B, &d);
+                break;
+            case AXPY:
+                A.__daxpy(1e-9, B, 1, 1);
+                break;
+            case COPY:
+                A.__copy(B, 1, 1);
+                break;
+            default:
+                A.__mult(1.0);
+                break;
+        }
+    };
+    using clock = std::chrono::steady_clock;
+    call();
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        const auto start = clock::now();
+        std::chrono::duration<double> elapsed(0);
+        ptrdiff_t calls = 0;
+        do {
+            call();
+            calls++;
+            elapsed = clock::now() - start;
+        } while (elapsed.count() < budget / ROUNDS);
+        const double t = elapsed.count() / calls;
+        if (round == 0 || t < best) best = t;
+    }
+    return best;
+}
+
+template <Real S>
+double time(BLAS backend, Op op, ptrdiff_t size, double budget) {
+    switch (backend) {
+#if ACC_FOUND
+        case ACC: return time<ACC, S>(op, size, budget);
+#endif
+#if OPB_FOUND
+        case OPB: return time<OPB, S>(op, size, budget);
+#endif
+#if MKL_FOUND
+        case MKL: return time<MKL, S>(op, size, budget);
+#endif
+        default: return time<REF, S>(op, size, budget);
+    }
+}
+
+template <Real S>
+void calibrate(double budget, ptrdiff_t maxDim) {
+    const bool single = std::is_same_v<S, float>;
+    for (int op = 0; op < OPS; op++) {
+        const int last = maxClass(Op(op), maxDim);
+        BLAS best = REF;
+        for (int c = 1; c < CLASSES; c++) {
+            if (c <= last) {
+                // Smallest size of the class
+                const ptrdiff_t size = ptrdiff_t(1) << (c - 1);
+                double fastest = 0;
+                for (BLAS b : backends()) {
+                    const double t = time<S>(b, Op(op), size, budget);
+                    if (b == REF || t < MARGIN * fastest) {
+                        fastest = t;
+                        best = b;
+                    }
+                }
+            }
+            set(Op(op), single, c, best);
+        }
+    }
+}
+
+}  // namespace
+
+int sizeClass(ptrdiff_t size) {
+    return std::min<int>(std::bit_width(size_t(std::max<ptrdiff_t>(size, 0))),
+                         CLASSES - 1);
+}
+
+BLAS select(Op op, bool single, int sizeClass) {
+    return table().entry[single][op][sizeClass].load(
+        std::memory_order_relaxed);
+}
+
+void set(Op op, bool single, int sizeClass, BLAS backend) {
+    if (!linked(backend)) throw(1);
+    table().entry[single][op][sizeClass].store(backend);
+}
+
+const std::vector<BLAS>& backends() {
+    static const std::vector<BLAS> linked = {
+        REF,
+#if ACC_FOUND
+        ACC,
+#endif
+#if OPB_FOUND
+        OPB,
+#endif
+#if MKL_FOUND
+        MKL,
+#endif
+    };
+    return linked;
+}
+
+void reset() {
+    table().defaults();
+}
+
+void calibrate(double seconds, ptrdiff_t maxDim) {
+    calibrate<double>(seconds, maxDim);
+    calibrate<float>(seconds, maxDim);
+}
+
+std::string cachePath() {
+    const char* path = std::getenv("MATRIX_DISPATCH_CACHE");
+    if (path != nullptr && *path != '\0') return path;
+    const char* home = std::getenv("HOME");
+    return std::string(home != nullptr ? home : ".") + "/.matrix_dispatch";
+}
+
+bool save(const std::string& path) {
+    std::ofstream os(path);
+    os << "# Matrix dispatch table: precision op class backend\n";
+    for (int s = 0; s < 2; s++)
+        for (int op = 0; op < OPS; op++)
+            for (int c = 0; c < CLASSES; c++)
+                os << (s ? "float " : "double ") << NAMES[op] << " " << c
+                   << " " << select(Op(op), s, c) << "\n";
+    return bool(os);
+}
+
+bool load(const std::string& path) {
+    table();
+    return read(path);
+}
+
+const char* name(Op op) {
+    return NAMES[op];
+}
+
+}  // namespace dispatch
@@ -0,0 +1,1346 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Gemm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define GEMM_X86
+#include <immintrin.h>
+#endif
+
+#include "ThreadPool.h"
+
+namespace gemm {
+
+namespace {
+
+// Microkernel: C[0:MR, 0:NR] = alpha * a * b + beta * C
+//     a : MR x kc panel of op(A), packed column by column
+//     b : kc x NR panel of op(B), packed row by row
+// C is not read when beta == 0. S is the element type.
+template <typename S>
+using Microkernel = void (*)(const ptrdiff_t kc, const S alpha,
+                             const S* a, const S* b,
+                             const S beta, S* c, const ptrdiff_t ldc);
+
+// Arguments of dgemmInterleaved
+struct Interleaved {
+    bool transA, transB;
+    ptrdiff_t m, n, k;
+    double alpha;
+    const double* A;
+    const double* B;
+    double beta;
+    double* C;
+
+    // Operands of group q
+    const double* a(ptrdiff_t q) const { return A + q*m*k*LANES; }
+    const double* b(ptrdiff_t q) const { return B + q*k*n*LANES; }
+    double* c(ptrdiff_t q) const { return C + q*m*n*LANES; }
+
+    // Offsets of the lane vectors of op(A)(i, p), op(B)(p, j), C(i, j)
+    ptrdiff_t a(ptrdiff_t i, ptrdiff_t p) const {
+        return (transA ? p*m + i : i*k + p) * LANES;
+    }
+    ptrdiff_t b(ptrdiff_t p, ptrdiff_t j) const {
+        return (transB ? j*k + p : p*n + j) * LANES;
+    }
+    ptrdiff_t c(ptrdiff_t i, ptrdiff_t j) const {
+        return (i*n + j) * LANES;
+    }
+};
+
+// Batch kernel: the products of groups [q0, q1) of an interleaved batch
+typedef void (*BatchKernel)(const Interleaved& g, const ptrdiff_t q0,
+                            const ptrdiff_t q1);
+
+// GEMV kernels on four rows of A, with x and y contiguous
+//     Dots : r[0:4] = A[0:4, 0:n] * x
+//     Axpy : y[0:n] += A[0:4, 0:n]^T * s[0:4]
+template <typename S>
+using Dots = void (*)(const ptrdiff_t n, const S* A, const ptrdiff_t lda,
+                      const S* x, S* r);
+template <typename S>
+using Axpy = void (*)(const ptrdiff_t n, const S* A, const ptrdiff_t lda,
+                      const S* s, S* y);
+
+// Microkernel and its blocking parameters
+//     mr x nr : register tile of C
+//     mc x kc : block of op(A) kept in L2
+//     kc x nc : block of op(B) kept in L3, streamed through L1 by panel
+// Batched kernels exist in double precision only. dots and axpy are the
+// GEMV kernels of the same instruction set.
+template <typename S>
+struct Kernel {
+    const char* name;
+    ptrdiff_t mr, nr;
+    ptrdiff_t mc, kc, nc;
+    Microkernel<S> fn;
+    BatchKernel batched;
+    Dots<S> dots;
+    Axpy<S> axpy;
+};
+
+// Largest register tile across all kernels, used to size edge buffers
+constexpr ptrdiff_t MAXTILE = 8 * 32;
+
+template <typename S>
+void kernelGeneric(const ptrdiff_t kc, const S alpha,
+                   const S* a, const S* b,
+                   const S beta, S* c, const ptrdiff_t ldc) {
+    S ab[4][4] = {};
+    for (ptrdiff_t p = 0; p < kc; p++) {
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                ab[i][j] += a[i] * b[j];
+            }
+        }
+        a += 4;
+        b += 4;
+    }
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            c[i*ldc + j] = beta == 0 ? alpha * ab[i][j]
+                                     : alpha * ab[i][j] + beta * c[i*ldc + j];
+        }
+    }
+}
+
+// Vectorized across the batch: each FMA updates LANES independent products
+void batchedGeneric(const Interleaved& g, const ptrdiff_t q0,
+                    const ptrdiff_t q1) {
+    for (ptrdiff_t q = q0; q < q1; q++) {
+        const double* A = g.a(q);
+        const double* B = g.b(q);
+        double* C = g.c(q);
+        for (ptrdiff_t i = 0; i < g.m; i++) {
+            for (ptrdiff_t j = 0; j < g.n; j++) {
+                double acc[LANES] = {};
+                for (ptrdiff_t p = 0; p < g.k; p++) {
+                    const double* a = A + g.a(i, p);
+                    const double* b = B + g.b(p, j);
+                    for (ptrdiff_t v = 0; v < LANES; v++) acc[v] += a[v] * b[v];
+                }
+                double* c = C + g.c(i, j);
+                for (ptrdiff_t v = 0; v < LANES; v++) {
+                    c[v] = g.beta == 0 ? g.alpha * acc[v]
+                                       : g.alpha * acc[v] + g.beta * c[v];
+                }
+            }
+        }
+    }
+}
+
+// Four accumulators per row break the dependency chain of the sum
+template <typename S>
+void dotsGeneric(const ptrdiff_t n, const S* A, const ptrdiff_t lda,
+                 const S* x, S* r) {
+    for (ptrdiff_t i = 0; i < 4; i++) {
+        const S* a = A + i*lda;
+        S s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        ptrdiff_t j = 0;
+        for (; j + 4 <= n; j += 4) {
+            s0 += a[j] * x[j];
+            s1 += a[j + 1] * x[j + 1];
+            s2 += a[j + 2] * x[j + 2];
+            s3 += a[j + 3] * x[j + 3];
+        }
+        for (; j < n; j++) s0 += a[j] * x[j];
+        r[i] = (s0 + s1) + (s2 + s3);
+    }
+}
+
+// Four rows per pass, so y is loaded and stored once per four rows of A
+template <typename S>
+void axpyGeneric(const ptrdiff_t n, const S* A, const ptrdiff_t lda,
+                 const S* s, S* y) {
+    const S* a0 = A;
+    const S* a1 = A + lda;
+    const S* a2 = A + 2*lda;
+    const S* a3 = A + 3*lda;
+    for (ptrdiff_t j = 0; j < n; j++) {
+        y[j] += (s[0] * a0[j] + s[1] * a1[j]) + (s[2] * a2[j] + s[3] * a3[j]);
+    }
+}
+
+#ifdef GEMM_X86
+
+// c[0:4] = alpha * x + beta * c[0:4]
+__attribute__((target("avx2,fma")))
+inline void storeAVX2(double* c, const __m256d x, const __m256d alpha,
+                      const __m256d beta, const bool accumulate) {
+    __m256d y = _mm256_mul_pd(alpha, x);
+    if (accumulate) y = _mm256_fmadd_pd(beta, _mm256_loadu_pd(c), y);
+    _mm256_storeu_pd(c, y);
+}
+
+// 6 x 8 tile held in 12 ymm accumulators
+__attribute__((target("avx2,fma")))
+void kernelAVX2(const ptrdiff_t kc, const double alpha,
+                const double* a, const double* b,
+                const double beta, double* c, const ptrdiff_t ldc) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+    for (ptrdiff_t p = 0; p < kc; p++) {
+        const __m256d b0 = _mm256_loadu_pd(b);
+        const __m256d b1 = _mm256_loadu_pd(b + 4);
+        __m256d ai;
+        ai = _mm256_broadcast_sd(a);
+        c00 = _mm256_fmadd_pd(ai, b0, c00);
+        c01 = _mm256_fmadd_pd(ai, b1, c01);
+        ai = _mm256_broadcast_sd(a + 1);
+        c10 = _mm256_fmadd_pd(ai, b0, c10);
+        c11 = _mm256_fmadd_pd(ai, b1, c11);
+        ai = _mm256_broadcast_sd(a + 2);
+        c20 = _mm256_fmadd_pd(ai, b0, c20);
+        c21 = _mm256_fmadd_pd(ai, b1, c21);
+        ai = _mm256_broadcast_sd(a + 3);
+        c30 = _mm256_fmadd_pd(ai, b0, c30);
+        c31 = _mm256_fmadd_pd(ai, b1, c31);
+        ai = _mm256_broadcast_sd(a + 4);
+        c40 = _mm256_fmadd_pd(ai, b0, c40);
+        c41 = _mm256_fmadd_pd(ai, b1, c41);
+        ai = _mm256_broadcast_sd(a + 5);
+        c50 = _mm256_fmadd_pd(ai, b0, c50);
+        c51 = _mm256_fmadd_pd(ai, b1, c51);
+        a += 6;
+        b += 8;
+    }
+    const __m256d va = _mm256_set1_pd(alpha);
+    const __m256d vb = _mm256_set1_pd(beta);
+    const bool acc = beta != 0;
+    storeAVX2(c,             c00, va, vb, acc);
+    storeAVX2(c + 4,         c01, va, vb, acc);
+    storeAVX2(c + ldc,       c10, va, vb, acc);
+    storeAVX2(c + ldc + 4,   c11, va, vb, acc);
+    storeAVX2(c + 2*ldc,     c20, va, vb, acc);
+    storeAVX2(c + 2*ldc + 4, c21, va, vb, acc);
+    storeAVX2(c + 3*ldc,     c30, va, vb, acc);
+    storeAVX2(c + 3*ldc + 4, c31, va, vb, acc);
+    storeAVX2(c + 4*ldc,     c40, va, vb, acc);
+    storeAVX2(c + 4*ldc + 4, c41, va, vb, acc);
+    storeAVX2(c + 5*ldc,     c50, va, vb, acc);
+    storeAVX2(c + 5*ldc + 4, c51, va, vb, acc);
+}
+
+// c[0:8] = alpha * x + beta * c[0:8]
+__attribute__((target("avx512f")))
+inline void storeAVX512(double* c, const __m512d x, const __m512d alpha,
+                        const __m512d beta, const bool accumulate) {
+    __m512d y = _mm512_mul_pd(alpha, x);
+    if (accumulate) y = _mm512_fmadd_pd(beta, _mm512_loadu_pd(c), y);
+    _mm512_storeu_pd(c, y);
+}
+
+// 8 x 16 tile held in 16 zmm accumulators
+__attribute__((target("avx512f")))
+void kernelAVX512(const ptrdiff_t kc, const double alpha,
+                  const double* a, const double* b,
+                  const double beta, double* c, const ptrdiff_t ldc) {
+    __m512d c00 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd();
+    __m512d c10 = _mm512_setzero_pd(), c11 = _mm512_setzero_pd();
+    __m512d c20 = _mm512_setzero_pd(), c21 = _mm512_setzero_pd();
+    __m512d c30 = _mm512_setzero_pd(), c31 = _mm512_setzero_pd();
+    __m512d c40 = _mm512_setzero_pd(), c41 = _mm512_setzero_pd();
+    __m512d c50 = _mm512_setzero_pd(), c51 = _mm512_setzero_pd();
+    __m512d c60 = _mm512_setzero_pd(), c61 = _mm512_setzero_pd();
+    __m512d c70 = _mm512_setzero_pd(), c71 = _mm512_setzero_pd();
+    for (ptrdiff_t p = 0; p < kc; p++) {
+        const __m512d b0 = _mm512_loadu_pd(b);
+        const __m512d b1 = _mm512_loadu_pd(b + 8);
+        __m512d ai;
+        ai = _mm512_set1_pd(a[0]);
+        c00 = _mm512_fmadd_pd(ai, b0, c00);
+        c01 = _mm512_fmadd_pd(ai, b1, c01);
+        ai = _mm512_set1_pd(a[1]);
+        c10 = _mm512_fmadd_pd(ai, b0, c10);
+        c11 = _mm512_fmadd_pd(ai, b1, c11);
+        ai = _mm512_set1_pd(a[2]);
+        c20 = _mm512_fmadd_pd(ai, b0, c20);
+        c21 = _mm512_fmadd_pd(ai, b1, c21);
+        ai = _mm512_set1_pd(a[3]);
+        c30 = _mm512_fmadd_pd(ai, b0, c30);
+        c31 = _mm512_fmadd_pd(ai, b1, c31);
+        ai = _mm512_set1_pd(a[4]);
+        c40 = _mm512_fmadd_pd(ai, b0, c40);
+        c41 = _mm512_fmadd_pd(ai, b1, c41);
+        ai = _mm512_set1_pd(a[5]);
+        c50 = _mm512_fmadd_pd(ai, b0, c50);
+        c51 = _mm512_fmadd_pd(ai, b1, c51);
+        ai = _mm512_set1_pd(a[6]);
+        c60 = _mm512_fmadd_pd(ai, b0, c60);
+        c61 = _mm512_fmadd_pd(ai, b1, c61);
+        ai = _mm512_set1_pd(a[7]);
+        c70 = _mm512_fmadd_pd(ai, b0, c70);
+        c71 = _mm512_fmadd_pd(ai, b1, c71);
+        a += 8;
+        b += 16;
+    }
+    const __m512d va = _mm512_set1_pd(alpha);
+    const __m512d vb = _mm512_set1_pd(beta);
+    const bool acc = beta != 0;
+    storeAVX512(c,             c00, va, vb, acc);
+    storeAVX512(c + 8,         c01, va, vb, acc);
+    storeAVX512(c + ldc,       c10, va, vb, acc);
+    storeAVX512(c + ldc + 8,   c11, va, vb, acc);
+    storeAVX512(c + 2*ldc,     c20, va, vb, acc);
+    storeAVX512(c + 2*ldc + 8, c21, va, vb, acc);
+    storeAVX512(c + 3*ldc,     c30, va, vb, acc);
+    storeAVX512(c + 3*ldc + 8, c31, va, vb, acc);
+    storeAVX512(c + 4*ldc,     c40, va, vb, acc);
+    storeAVX512(c + 4*ldc + 8, c41, va, vb, acc);
+    storeAVX512(c + 5*ldc,     c50, va, vb, acc);
+    storeAVX512(c + 5*ldc + 8, c51, va, vb, acc);
+    storeAVX512(c + 6*ldc,     c60, va, vb, acc);
+    storeAVX512(c + 6*ldc + 8, c61, va, vb, acc);
+    storeAVX512(c + 7*ldc,     c70, va, vb, acc);
+    storeAVX512(c + 7*ldc + 8, c71, va, vb, acc);
+}
+
+// One group is two ymm vectors; four columns of C at a time
+__attribute__((target("avx2,fma")))
+void batchedAVX2(const Interleaved& g, const ptrdiff_t q0,
+                 const ptrdiff_t q1) {
+    const __m256d va = _mm256_set1_pd(g.alpha);
+    const __m256d vb = _mm256_set1_pd(g.beta);
+    const bool acc = g.beta != 0;
+    for (ptrdiff_t q = q0; q < q1; q++) {
+        for (ptrdiff_t h = 0; h < LANES; h += 4) {
+            const double* A = g.a(q) + h;
+            const double* B = g.b(q) + h;
+            double* C = g.c(q) + h;
+            for (ptrdiff_t i = 0; i < g.m; i++) {
+                ptrdiff_t j = 0;
+                for (; j + 4 <= g.n; j += 4) {
+                    __m256d c0 = _mm256_setzero_pd(), c1 = _mm256_setzero_pd();
+                    __m256d c2 = _mm256_setzero_pd(), c3 = _mm256_setzero_pd();
+                    for (ptrdiff_t p = 0; p < g.k; p++) {
+                        const __m256d a = _mm256_loadu_pd(A + g.a(i, p));
+                        const double* b = B + g.b(p, j);
+                        const ptrdiff_t s = g.b(p, j + 1) - g.b(p, j);
+                        c0 = _mm256_fmadd_pd(a, _mm256_loadu_pd(b), c0);
+                        c1 = _mm256_fmadd_pd(a, _mm256_loadu_pd(b + s), c1);
+                        c2 = _mm256_fmadd_pd(a, _mm256_loadu_pd(b + 2*s), c2);
+                        c3 = _mm256_fmadd_pd(a, _mm256_loadu_pd(b + 3*s), c3);
+                    }
+                    storeAVX2(C + g.c(i, j),     c0, va, vb, acc);
+                    storeAVX2(C + g.c(i, j + 1), c1, va, vb, acc);
+                    storeAVX2(C + g.c(i, j + 2), c2, va, vb, acc);
+                    storeAVX2(C + g.c(i, j + 3), c3, va, vb, acc);
+                }
+                for (; j < g.n; j++) {
+                    __m256d c0 = _mm256_setzero_pd();
+                    for (ptrdiff_t p = 0; p < g.k; p++) {
+                        c0 = _mm256_fmadd_pd(_mm256_loadu_pd(A + g.a(i, p)),
+                                             _mm256_loadu_pd(B + g.b(p, j)),
+                                             c0);
+                    }
+                    storeAVX2(C + g.c(i, j), c0, va, vb, acc);
+                }
+            }
+        }
+    }
+}
+
+// One group is one zmm vector; four columns of C at a time
+__attribute__((target("avx512f")))
+void batchedAVX512(const Interleaved& g, const ptrdiff_t q0,
+                   const ptrdiff_t q1) {
+    const __m512d va = _mm512_set1_pd(g.alpha);
+    const __m512d vb = _mm512_set1_pd(g.beta);
+    const bool acc = g.beta != 0;
+    for (ptrdiff_t q = q0; q < q1; q++) {
+        const double* A = g.a(q);
+        const double* B = g.b(q);
+        double* C = g.c(q);
+        for (ptrdiff_t i = 0; i < g.m; i++) {
+            ptrdiff_t j = 0;
+            for (; j + 4 <= g.n; j += 4) {
+                __m512d c0 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+                __m512d c2 = _mm512_setzero_pd(), c3 = _mm512_setzero_pd();
+                for (ptrdiff_t p = 0; p < g.k; p++) {
+                    const __m512d a = _mm512_loadu_pd(A + g.a(i, p));
+                    const double* b = B + g.b(p, j);
+                    const ptrdiff_t s = g.b(p, j + 1) - g.b(p, j);
+                    c0 = _mm512_fmadd_pd(a, _mm512_loadu_pd(b), c0);
+                    c1 = _mm512_fmadd_pd(a, _mm512_loadu_pd(b + s), c1);
+                    c2 = _mm512_fmadd_pd(a, _mm512_loadu_pd(b + 2*s), c2);
+                    c3 = _mm512_fmadd_pd(a, _mm512_loadu_pd(b + 3*s), c3);
+                }
+                storeAVX512(C + g.c(i, j),     c0, va, vb, acc);
+                storeAVX512(C + g.c(i, j + 1), c1, va, vb, acc);
+                storeAVX512(C + g.c(i, j + 2), c2, va, vb, acc);
+                storeAVX512(C + g.c(i, j + 3), c3, va, vb, acc);
+            }
+            for (; j < g.n; j++) {
+                __m512d c0 = _mm512_setzero_pd();
+                for (ptrdiff_t p = 0; p < g.k; p++) {
+                    c0 = _mm512_fmadd_pd(_mm512_loadu_pd(A + g.a(i, p)),
+                                         _mm512_loadu_pd(B + g.b(p, j)),
+                                         c0);
+                }
+                storeAVX512(C + g.c(i, j), c0, va, vb, acc);
+            }
+        }
+    }
+}
+
+// c[0:8] = alpha * x + beta * c[0:8], single precision
+__attribute__((target("avx2,fma")))
+inline void storeAVX2(float* c, const __m256 x, const __m256 alpha,
+                      const __m256 beta, const bool accumulate) {
+    __m256 y = _mm256_mul_ps(alpha, x);
+    if (accumulate) y = _mm256_fmadd_ps(beta, _mm256_loadu_ps(c), y);
+    _mm256_storeu_ps(c, y);
+}
+
+// 6 x 16 single precision tile held in 12 ymm accumulators
+__attribute__((target("avx2,fma")))
+void kernelAVX2(const ptrdiff_t kc, const float alpha,
+                const float* a, const float* b,
+                const float beta, float* c, const ptrdiff_t ldc) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for (ptrdiff_t p = 0; p < kc; p++) {
+        const __m256 b0 = _mm256_loadu_ps(b);
+        const __m256 b1 = _mm256_loadu_ps(b + 8);
+        __m256 ai;
+        ai = _mm256_broadcast_ss(a);
+        c00 = _mm256_fmadd_ps(ai, b0, c00);
+        c01 = _mm256_fmadd_ps(ai, b1, c01);
+        ai = _mm256_broadcast_ss(a + 1);
+        c10 = _mm256_fmadd_ps(ai, b0, c10);
+        c11 = _mm256_fmadd_ps(ai, b1, c11);
+        ai = _mm256_broadcast_ss(a + 2);
+        c20 = _mm256_fmadd_ps(ai, b0, c20);
+        c21 = _mm256_fmadd_ps(ai, b1, c21);
+        ai = _mm256_broadcast_ss(a + 3);
+        c30 = _mm256_fmadd_ps(ai, b0, c30);
+        c31 = _mm256_fmadd_ps(ai, b1, c31);
+        ai = _mm256_broadcast_ss(a + 4);
+        c40 = _mm256_fmadd_ps(ai, b0, c40);
+        c41 = _mm256_fmadd_ps(ai, b1, c41);
+        ai = _mm256_broadcast_ss(a + 5);
+        c50 = _mm256_fmadd_ps(ai, b0, c50);
+        c51 = _mm256_fmadd_ps(ai, b1, c51);
+        a += 6;
+        b += 16;
+    }
+    const __m256 va = _mm256_set1_ps(alpha);
+    const __m256 vb = _mm256_set1_ps(beta);
+    const bool acc = beta != 0;
+    storeAVX2(c,             c00, va, vb, acc);
+    storeAVX2(c + 8,         c01, va, vb, acc);
+    storeAVX2(c + ldc,       c10, va, vb, acc);
+    storeAVX2(c + ldc + 8,   c11, va, vb, acc);
+    storeAVX2(c + 2*ldc,     c20, va, vb, acc);
+    storeAVX2(c + 2*ldc + 8, c21, va, vb, acc);
+    storeAVX2(c + 3*ldc,     c30, va, vb, acc);
+    storeAVX2(c + 3*ldc + 8, c31, va, vb, acc);
+    storeAVX2(c + 4*ldc,     c40, va, vb, acc);
+    storeAVX2(c + 4*ldc + 8, c41, va, vb, acc);
+    storeAVX2(c + 5*ldc,     c50, va, vb, acc);
+    storeAVX2(c + 5*ldc + 8, c51, va, vb, acc);
+}
+
+// c[0:16] = alpha * x + beta * c[0:16], single precision
+__attribute__((target("avx512f")))
+inline void storeAVX512(float* c, const __m512 x, const __m512 alpha,
+                        const __m512 beta, const bool accumulate) {
+    __m512 y = _mm512_mul_ps(alpha, x);
+    if (accumulate) y = _mm512_fmadd_ps(beta, _mm512_loadu_ps(c), y);
+    _mm512_storeu_ps(c, y);
+}
+
+// 8 x 32 single precision tile held in 16 zmm accumulators
+__attribute__((target("avx512f")))
+void kernelAVX512(const ptrdiff_t kc, const float alpha,
+                  const float* a, const float* b,
+                  const float beta, float* c, const ptrdiff_t ldc) {
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+    __m512 c60 = _mm512_setzero_ps(), c61 = _mm512_setzero_ps();
+    __m512 c70 = _mm512_setzero_ps(), c71 = _mm512_setzero_ps();
+    for (ptrdiff_t p = 0; p < kc; p++) {
+        const __m512 b0 = _mm512_loadu_ps(b);
+        const __m512 b1 = _mm512_loadu_ps(b + 16);
+        __m512 ai;
+        ai = _mm512_set1_ps(a[0]);
+        c00 = _mm512_fmadd_ps(ai, b0, c00);
+        c01 = _mm512_fmadd_ps(ai, b1, c01);
+        ai = _mm512_set1_ps(a[1]);
+        c10 = _mm512_fmadd_ps(ai, b0, c10);
+        c11 = _mm512_fmadd_ps(ai, b1, c11);
+        ai = _mm512_set1_ps(a[2]);
+        c20 = _mm512_fmadd_ps(ai, b0, c20);
+        c21 = _mm512_fmadd_ps(ai, b1, c21);
+        ai = _mm512_set1_ps(a[3]);
+        c30 = _mm512_fmadd_ps(ai, b0, c30);
+        c31 = _mm512_fmadd_ps(ai, b1, c31);
+        ai = _mm512_set1_ps(a[4]);
+        c40 = _mm512_fmadd_ps(ai, b0, c40);
+        c41 = _mm512_fmadd_ps(ai, b1, c41);
+        ai = _mm512_set1_ps(a[5]);
+        c50 = _mm512_fmadd_ps(ai, b0, c50);
+        c51 = _mm512_fmadd_ps(ai, b1, c51);
+        ai = _mm512_set1_ps(a[6]);
+        c60 = _mm512_fmadd_ps(ai, b0, c60);
+        c61 = _mm512_fmadd_ps(ai, b1, c61);
+        ai = _mm512_set1_ps(a[7]);
+        c70 = _mm512_fmadd_ps(ai, b0, c70);
+        c71 = _mm512_fmadd_ps(ai, b1, c71);
+        a += 8;
+        b += 32;
+    }
+    const __m512 va = _mm512_set1_ps(alpha);
+    const __m512 vb = _mm512_set1_ps(beta);
+    const bool acc = beta != 0;
+    storeAVX512(c,              c00, va, vb, acc);
+    storeAVX512(c + 16,         c01, va, vb, acc);
+    storeAVX512(c + ldc,        c10, va, vb, acc);
+    storeAVX512(c + ldc + 16,   c11, va, vb, acc);
+    storeAVX512(c + 2*ldc,      c20, va, vb, acc);
+    storeAVX512(c + 2*ldc + 16, c21, va, vb, acc);
+    storeAVX512(c + 3*ldc,      c30, va, vb, acc);
+    storeAVX512(c + 3*ldc + 16, c31, va, vb, acc);
+    storeAVX512(c + 4*ldc,      c40, va, vb, acc);
+    storeAVX512(c + 4*ldc + 16, c41, va, vb, acc);
+    storeAVX512(c + 5*ldc,      c50, va, vb, acc);
+    storeAVX512(c + 5*ldc + 16, c51, va, vb, acc);
+    storeAVX512(c + 6*ldc,      c60, va, vb, acc);
+    storeAVX512(c + 6*ldc + 16, c61, va, vb, acc);
+    storeAVX512(c + 7*ldc,      c70, va, vb, acc);
+    storeAVX512(c + 7*ldc + 16, c71, va, vb, acc);
+}
+
+// Horizontal sums of a ymm register
+__attribute__((target("avx2,fma")))
+inline double hsumAVX2(const __m256d v) {
+    const __m128d x = _mm_add_pd(_mm256_castpd256_pd128(v),
+                                 _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(x, _mm_unpackhi_pd(x, x)));
+}
+
+__attribute__((target("avx2,fma")))
+inline float hsumAVX2(const __m256 v) {
+    __m128 x = _mm_add_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    return _mm_cvtss_f32(_mm_add_ss(x, _mm_movehdup_ps(x)));
+}
+
+// Four rows of A against x, two ymm accumulators per row
+__attribute__((target("avx2,fma")))
+void dotsAVX2(const ptrdiff_t n, const double* A, const ptrdiff_t lda,
+              const double* x, double* r) {
+    const double* a0 = A;
+    const double* a1 = A + lda;
+    const double* a2 = A + 2*lda;
+    const double* a3 = A + 3*lda;
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    ptrdiff_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        const __m256d x0 = _mm256_loadu_pd(x + j);
+        const __m256d x1 = _mm256_loadu_pd(x + j + 4);
+        c00 = _mm256_fmadd_pd(_mm256_loadu_pd(a0 + j), x0, c00);
+        c01 = _mm256_fmadd_pd(_mm256_loadu_pd(a0 + j + 4), x1, c01);
+        c10 = _mm256_fmadd_pd(_mm256_loadu_pd(a1 + j), x0, c10);
+        c11 = _mm256_fmadd_pd(_mm256_loadu_pd(a1 + j + 4), x1, c11);
+        c20 = _mm256_fmadd_pd(_mm256_loadu_pd(a2 + j), x0, c20);
+        c21 = _mm256_fmadd_pd(_mm256_loadu_pd(a2 + j + 4), x1, c21);
+        c30 = _mm256_fmadd_pd(_mm256_loadu_pd(a3 + j), x0, c30);
+        c31 = _mm256_fmadd_pd(_mm256_loadu_pd(a3 + j + 4), x1, c31);
+    }
+    double r0 = hsumAVX2(_mm256_add_pd(c00, c01));
+    double r1 = hsumAVX2(_mm256_add_pd(c10, c11));
+    double r2 = hsumAVX2(_mm256_add_pd(c20, c21));
+    double r3 = hsumAVX2(_mm256_add_pd(c30, c31));
+    for (; j < n; j++) {
+        r0 += a0[j] * x[j];
+        r1 += a1[j] * x[j];
+        r2 += a2[j] * x[j];
+        r3 += a3[j] * x[j];
+    }
+    r[0] = r0; r[1] = r1; r[2] = r2; r[3] = r3;
+}
+
+// y += A[0:4, :]^T * s, as two independent pairs of rows
+__attribute__((target("avx2,fma")))
+void axpyAVX2(const ptrdiff_t n, const double* A, const ptrdiff_t lda,
+              const double* s, double* y) {
+    const double* a0 = A;
+    const double* a1 = A + lda;
+    const double* a2 = A + 2*lda;
+    const double* a3 = A + 3*lda;
+    const __m256d s0 = _mm256_set1_pd(s[0]), s1 = _mm256_set1_pd(s[1]);
+    const __m256d s2 = _mm256_set1_pd(s[2]), s3 = _mm256_set1_pd(s[3]);
+    ptrdiff_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m256d t0 = _mm256_mul_pd(s0, _mm256_loadu_pd(a0 + j));
+        __m256d t1 = _mm256_mul_pd(s2, _mm256_loadu_pd(a2 + j));
+        t0 = _mm256_fmadd_pd(s1, _mm256_loadu_pd(a1 + j), t0);
+        t1 = _mm256_fmadd_pd(s3, _mm256_loadu_pd(a3 + j), t1);
+        _mm256_storeu_pd(y + j, _mm256_add_pd(_mm256_loadu_pd(y + j),
+                                              _mm256_add_pd(t0, t1)));
+    }
+    for (; j < n; j++) {
+        y[j] += (s[0] * a0[j] + s[1] * a1[j]) + (s[2] * a2[j] + s[3] * a3[j]);
+    }
+}
+
+// Four rows of A against x, two zmm accumulators per row, masked tail
+__attribute__((target("avx512f")))
+void dotsAVX512(const ptrdiff_t n, const double* A, const ptrdiff_t lda,
+                const double* x, double* r) {
+    const double* a0 = A;
+    const double* a1 = A + lda;
+    const double* a2 = A + 2*lda;
+    const double* a3 = A + 3*lda;
+    __m512d c00 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd();
+    __m512d c10 = _mm512_setzero_pd(), c11 = _mm512_setzero_pd();
+    __m512d c20 = _mm512_setzero_pd(), c21 = _mm512_setzero_pd();
+    __m512d c30 = _mm512_setzero_pd(), c31 = _mm512_setzero_pd();
+    ptrdiff_t j = 0;
+    for (; j + 16 <= n; j += 16) {
+        const __m512d x0 = _mm512_loadu_pd(x + j);
+        const __m512d x1 = _mm512_loadu_pd(x + j + 8);
+        c00 = _mm512_fmadd_pd(_mm512_loadu_pd(a0 + j), x0, c00);
+        c01 = _mm512_fmadd_pd(_mm512_loadu_pd(a0 + j + 8), x1, c01);
+        c10 = _mm512_fmadd_pd(_mm512_loadu_pd(a1 + j), x0, c10);
+        c11 = _mm512_fmadd_pd(_mm512_loadu_pd(a1 + j + 8), x1, c11);
+        c20 = _mm512_fmadd_pd(_mm512_loadu_pd(a2 + j), x0, c20);
+        c21 = _mm512_fmadd_pd(_mm512_loadu_pd(a2 + j + 8), x1, c21);
+        c30 = _mm512_fmadd_pd(_mm512_loadu_pd(a3 + j), x0, c30);
+        c31 = _mm512_fmadd_pd(_mm512_loadu_pd(a3 + j + 8), x1, c31);
+    }
+    for (; j < n; j += 8) {
+        const __mmask8 k = n - j >= 8 ? 0xFF : (1u << (n - j)) - 1;
+        const __m512d x0 = _mm512_maskz_loadu_pd(k, x + j);
+        c00 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, a0 + j), x0, c00);
+        c10 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, a1 + j), x0, c10);
+        c20 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, a2 + j), x0, c20);
+        c30 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(k, a3 + j), x0, c30);
+    }
+    r[0] = _mm512_reduce_add_pd(_mm512_add_pd(c00, c01));
+    r[1] = _mm512_reduce_add_pd(_mm512_add_pd(c10, c11));
+    r[2] = _mm512_reduce_add_pd(_mm512_add_pd(c20, c21));
+    r[3] = _mm512_reduce_add_pd(_mm512_add_pd(c30, c31));
+}
+
+// y += A[0:4, :]^T * s, masked tail
+__attribute__((target("avx512f")))
+void axpyAVX512(const ptrdiff_t n, const double* A, const ptrdiff_t lda,
+                const double* s, double* y) {
+    const double* a0 = A;
+    const double* a1 = A + lda;
+    const double* a2 = A + 2*lda;
+    const double* a3 = A + 3*lda;
+    const __m512d s0 = _mm512_set1_pd(s[0]), s1 = _mm512_set1_pd(s[1]);
+    const __m512d s2 = _mm512_set1_pd(s[2]), s3 = _mm512_set1_pd(s[3]);
+    for (ptrdiff_t j = 0; j < n; j += 8) {
+        const __mmask8 k = n - j >= 8 ? 0xFF : (1u << (n - j)) - 1;
+        __m512d t0 = _mm512_mul_pd(s0, _mm512_maskz_loadu_pd(k, a0 + j));
+        __m512d t1 = _mm512_mul_pd(s2, _mm512_maskz_loadu_pd(k, a2 + j));
+        t0 = _mm512_fmadd_pd(s1, _mm512_maskz_loadu_pd(k, a1 + j), t0);
+        t1 = _mm512_fmadd_pd(s3, _mm512_maskz_loadu_pd(k, a3 + j), t1);
+        _mm512_mask_storeu_pd(y + j, k,
+            _mm512_add_pd(_mm512_maskz_loadu_pd(k, y + j),
+                          _mm512_add_pd(t0, t1)));
+    }
+}
+
+// Single precision: four rows of A against x, two ymm accumulators per row
+__attribute__((target("avx2,fma")))
+void dotsAVX2(const ptrdiff_t n, const float* A, const ptrdiff_t lda,
+              const float* x, float* r) {
+    const float* a0 = A;
+    const float* a1 = A + lda;
+    const float* a2 = A + 2*lda;
+    const float* a3 = A + 3*lda;
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    ptrdiff_t j = 0;
+    for (; j + 16 <= n; j += 16) {
+        const __m256 x0 = _mm256_loadu_ps(x + j);
+        const __m256 x1 = _mm256_loadu_ps(x + j + 8);
+        c00 = _mm256_fmadd_ps(_mm256_loadu_ps(a0 + j), x0, c00);
+        c01 = _mm256_fmadd_ps(_mm256_loadu_ps(a0 + j + 8), x1, c01);
+        c10 = _mm256_fmadd_ps(_mm256_loadu_ps(a1 + j), x0, c10);
+        c11 = _mm256_fmadd_ps(_mm256_loadu_ps(a1 + j + 8), x1, c11);
+        c20 = _mm256_fmadd_ps(_mm256_loadu_ps(a2 + j), x0, c20);
+        c21 = _mm256_fmadd_ps(_mm256_loadu_ps(a2 + j + 8), x1, c21);
+        c30 = _mm256_fmadd_ps(_mm256_loadu_ps(a3 + j), x0, c30);
+        c31 = _mm256_fmadd_ps(_mm256_loadu_ps(a3 + j + 8), x1, c31);
+    }
+    float r0 = hsumAVX2(_mm256_add_ps(c00, c01));
+    float r1 = hsumAVX2(_mm256_add_ps(c10, c11));
+    float r2 = hsumAVX2(_mm256_add_ps(c20, c21));
+    float r3 = hsumAVX2(_mm256_add_ps(c30, c31));
+    for (; j < n; j++) {
+        r0 += a0[j] * x[j];
+        r1 += a1[j] * x[j];
+        r2 += a2[j] * x[j];
+        r3 += a3[j] * x[j];
+    }
+    r[0] = r0; r[1] = r1; r[2] = r2; r[3] = r3;
+}
+
+// Single precision: y += A[0:4, :]^T * s
+__attribute__((target("avx2,fma")))
+void axpyAVX2(const ptrdiff_t n, const float* A, const ptrdiff_t lda,
+              const float* s, float* y) {
+    const float* a0 = A;
+    const float* a1 = A + lda;
+    const float* a2 = A + 2*lda;
+    const float* a3 = A + 3*lda;
+    const __m256 s0 = _mm256_set1_ps(s[0]), s1 = _mm256_set1_ps(s[1]);
+    const __m256 s2 = _mm256_set1_ps(s[2]), s3 = _mm256_set1_ps(s[3]);
+    ptrdiff_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256 t0 = _mm256_mul_ps(s0, _mm256_loadu_ps(a0 + j));
+        __m256 t1 = _mm256_mul_ps(s2, _mm256_loadu_ps(a2 + j));
+        t0 = _mm256_fmadd_ps(s1, _mm256_loadu_ps(a1 + j), t0);
+        t1 = _mm256_fmadd_ps(s3, _mm256_loadu_ps(a3 + j), t1);
+        _mm256_storeu_ps(y + j, _mm256_add_ps(_mm256_loadu_ps(y + j),
+                                              _mm256_add_ps(t0, t1)));
+    }
+    for (; j < n; j++) {
+        y[j] += (s[0] * a0[j] + s[1] * a1[j]) + (s[2] * a2[j] + s[3] * a3[j]);
+    }
+}
+
+// Single precision: four rows of A against x, two zmm accumulators per row
+__attribute__((target("avx512f")))
+void dotsAVX512(const ptrdiff_t n, const float* A, const ptrdiff_t lda,
+                const float* x, float* r) {
+    const float* a0 = A;
+    const float* a1 = A + lda;
+    const float* a2 = A + 2*lda;
+    const float* a3 = A + 3*lda;
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    ptrdiff_t j = 0;
+    for (; j + 32 <= n; j += 32) {
+        const __m512 x0 = _mm512_loadu_ps(x + j);
+        const __m512 x1 = _mm512_loadu_ps(x + j + 16);
+        c00 = _mm512_fmadd_ps(_mm512_loadu_ps(a0 + j), x0, c00);
+        c01 = _mm512_fmadd_ps(_mm512_loadu_ps(a0 + j + 16), x1, c01);
+        c10 = _mm512_fmadd_ps(_mm512_loadu_ps(a1 + j), x0, c10);
+        c11 = _mm512_fmadd_ps(_mm512_loadu_ps(a1 + j + 16), x1, c11);
+        c20 = _mm512_fmadd_ps(_mm512_loadu_ps(a2 + j), x0, c20);
+        c21 = _mm512_fmadd_ps(_mm512_loadu_ps(a2 + j + 16), x1, c21);
+        c30 = _mm512_fmadd_ps(_mm512_loadu_ps(a3 + j), x0, c30);
+        c31 = _mm512_fmadd_ps(_mm512_loadu_ps(a3 + j + 16), x1, c31);
+    }
+    for (; j < n; j += 16) {
+        const __mmask16 k = n - j >= 16 ? 0xFFFF : (1u << (n - j)) - 1;
+        const __m512 x0 = _mm512_maskz_loadu_ps(k, x + j);
+        c00 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(k, a0 + j), x0, c00);
+        c10 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(k, a1 + j), x0, c10);
+        c20 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(k, a2 + j), x0, c20);
+        c30 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(k, a3 + j), x0, c30);
+    }
+    r[0] = _mm512_reduce_add_ps(_mm512_add_ps(c00, c01));
+    r[1] = _mm512_reduce_add_ps(_mm512_add_ps(c10, c11));
+    r[2] = _mm512_reduce_add_ps(_mm512_add_ps(c20, c21));
+    r[3] = _mm512_reduce_add_ps(_mm512_add_ps(c30, c31));
+}
+
+// Single precision: y += A[0:4, :]^T * s, masked tail
+__attribute__((target("avx512f")))
+void axpyAVX512(const ptrdiff_t n, const float* A, const ptrdiff_t lda,
+                const float* s, float* y) {
+    const float* a0 = A;
+    const float* a1 = A + lda;
+    const float* a2 = A + 2*lda;
+    const float* a3 = A + 3*lda;
+    const __m512 s0 = _mm512_set1_ps(s[0]), s1 = _mm512_set1_ps(s[1]);
+    const __m512 s2 = _mm512_set1_ps(s[2]), s3 = _mm512_set1_ps(s[3]);
+    for (ptrdiff_t j = 0; j < n; j += 16) {
+        const __mmask16 k = n - j >= 16 ? 0xFFFF : (1u << (n - j)) - 1;
+        __m512 t0 = _mm512_mul_ps(s0, _mm512_maskz_loadu_ps(k, a0 + j));
+        __m512 t1 = _mm512_mul_ps(s2, _mm512_maskz_loadu_ps(k, a2 + j));
+        t0 = _mm512_fmadd_ps(s1, _mm512_maskz_loadu_ps(k, a1 + j), t0);
+        t1 = _mm512_fmadd_ps(s3, _mm512_maskz_loadu_ps(k, a3 + j), t1);
+        _mm512_mask_storeu_ps(y + j, k,
+            _mm512_add_ps(_mm512_maskz_loadu_ps(k, y + j),
+                          _mm512_add_ps(t0, t1)));
+    }
+}
+
+#endif  // GEMM_X86
+
+// Ordered by preference, the first supported kernel is selected. Single
+// precision kernels use the same names and are selected together.
+const Kernel<double> kernels[] = {
+#ifdef GEMM_X86
+    {"avx512", 8, 16, 128, 256, 4096, kernelAVX512, batchedAVX512,
+     dotsAVX512, axpyAVX512},
+    {"avx2",   6,  8,  72, 256, 4080, kernelAVX2,   batchedAVX2,
+     dotsAVX2, axpyAVX2},
+#endif
+    {"generic", 4, 4,  64, 256, 4096, kernelGeneric<double>, batchedGeneric,
+     dotsGeneric<double>, axpyGeneric<double>},
+};
+
+const Kernel<float> skernels[] = {
+#ifdef GEMM_X86
+    {"avx512", 8, 32, 128, 512, 4096, kernelAVX512, nullptr,
+     dotsAVX512, axpyAVX512},
+    {"avx2",   6, 16,  72, 512, 4080, kernelAVX2,   nullptr,
+     dotsAVX2, axpyAVX2},
+#endif
+    {"generic", 4, 4,  64, 512, 4096, kernelGeneric<float>, nullptr,
+     dotsGeneric<float>, axpyGeneric<float>},
+};
+
+template <typename S>
+const auto& table() {
+    if constexpr (std::is_same_v<S, float>) return skernels;
+    else
+        return kernels;
+}
+
+template <typename S>
+bool supported(const Kernel<S>& K) {
+#ifdef GEMM_X86
+    if (std::strcmp(K.name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512f");
+    if (std::strcmp(K.name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    return std::strcmp(K.name, "generic") == 0;
+}
+
+template <typename S>
+const Kernel<S>* detect() {
+    for (const Kernel<S>& K : table<S>()) {
+        if (supported(K)) return &K;
+    }
+    return nullptr;  // Unreachable, generic is always supported
+}
+
+template <typename S = double>
+std::atomic<const Kernel<S>*>& active() {
+    static std::atomic<const Kernel<S>*> K{detect<S>()};
+    return K;
+}
+
+ptrdiff_t roundUp(ptrdiff_t n, ptrdiff_t r) {
+    return (n + r - 1) / r * r;
+}
+
+// Overrides of a kernel's mc, kc and nc, zero keeps the table's value
+struct Overrides {
+    std::atomic<ptrdiff_t> mc{0}, kc{0}, nc{0};
+};
+
+Overrides doverrides[std::size(kernels)], soverrides[std::size(skernels)];
+
+template <typename S>
+Overrides& overrides(const Kernel<S>& K) {
+    if constexpr (std::is_same_v<S, float>) return soverrides[&K - skernels];
+    else
+        return doverrides[&K - kernels];
+}
+
+template <typename S>
+Blocking blocking(const Kernel<S>& K) {
+    const Overrides& o = overrides(K);
+    auto value = [](const std::atomic<ptrdiff_t>& v, ptrdiff_t fallback) {
+        const ptrdiff_t x = v.load(std::memory_order_relaxed);
+        return x > 0 ? x : fallback;
+    };
+    return {K.mr, K.nr, value(o.mc, K.mc), value(o.kc, K.kc),
+            value(o.nc, K.nc)};
+}
+
+template <typename S>
+void blocking(const Kernel<S>& K, const Blocking& b) {
+    Overrides& o = overrides(K);
+    o.mc.store(b.mc > 0 ? roundUp(b.mc, K.mr) : 0);
+    o.kc.store(std::max<ptrdiff_t>(b.kc, 0));
+    o.nc.store(b.nc > 0 ? roundUp(b.nc, K.nr) : 0);
+}
+
+// Thread-local, 64-byte aligned scratch space for packed panels
+class Buffer {
+ public:
+    ~Buffer() { std::free(_data); }
+
+    // Room for n elements of type S
+    template <typename S>
+    S* get(ptrdiff_t n) {
+        if (n * static_cast<ptrdiff_t>(sizeof(S)) > _size) {
+            std::free(_data);
+            // aligned_alloc requires a multiple of the alignment
+            _size = (n * sizeof(S) + 63) / 64 * 64;
+            _data = std::aligned_alloc(64, _size);
+        }
+        return static_cast<S*>(_data);
+    }
+
+ private:
+    void* _data = nullptr;
+    ptrdiff_t _size = 0;
+};
+
+thread_local Buffer bufA, bufB;
+
+// Products with fewer multiply-adds than this run on the calling thread
+constexpr double PARALLEL_FLOPS = 64. * 64. * 64.;
+
+// Minimum slice of y per thread in y = A^T * x
+constexpr ptrdiff_t GEMV_PANEL = 256;
+
+// Pack op(A)[0:mc, 0:kc] into panels of mr rows, zero-padding the last
+//     A points to op(A)[0][0]; op(A)[i][p] = trans ? A[p*lda+i] : A[i*lda+p]
+template <typename S>
+void packA(const bool trans, const ptrdiff_t mc, const ptrdiff_t kc,
+           const S* A, const ptrdiff_t lda,
+           const ptrdiff_t mr, S* Ap) {
+    for (ptrdiff_t ir = 0; ir < mc; ir += mr) {
+        const ptrdiff_t rows = std::min(mr, mc - ir);
+        if (!trans) {
+            // Row-major rows of A become columns of the panel
+            for (ptrdiff_t r = 0; r < rows; r++) {
+                const S* src = A + (ir + r) * lda;
+                for (ptrdiff_t p = 0; p < kc; p++) {
+                    Ap[p*mr + r] = src[p];
+                }
+            }
+        } else {
+            // Rows of A^T are contiguous, copy mr at a time
+            for (ptrdiff_t p = 0; p < kc; p++) {
+                std::memcpy(Ap + p*mr, A + p*lda + ir, rows*sizeof(S));
+            }
+        }
+        for (ptrdiff_t r = rows; r < mr; r++) {
+            for (ptrdiff_t p = 0; p < kc; p++) {
+                Ap[p*mr + r] = 0;
+            }
+        }
+        Ap += mr * kc;
+    }
+}
+
+// Pack op(B)[0:kc, 0:nc] into panels of nr columns, zero-padding the last
+//     B points to op(B)[0][0]; op(B)[p][j] = trans ? B[j*ldb+p] : B[p*ldb+j]
+template <typename S>
+void packB(const bool trans, const ptrdiff_t kc, const ptrdiff_t nc,
+           const S* B, const ptrdiff_t ldb,
+           const ptrdiff_t nr, S* Bp) {
+    for (ptrdiff_t jr = 0; jr < nc; jr += nr) {
+        const ptrdiff_t cols = std::min(nr, nc - jr);
+        if (!trans) {
+            // Rows of B are contiguous, copy nr at a time
+            for (ptrdiff_t p = 0; p < kc; p++) {
+                std::memcpy(Bp + p*nr, B + p*ldb + jr, cols*sizeof(S));
+            }
+        } else {
+            // Row-major rows of B become columns of the panel
+            for (ptrdiff_t c = 0; c < cols; c++) {
+                const S* src = B + (jr + c) * ldb;
+                for (ptrdiff_t p = 0; p < kc; p++) {
+                    Bp[p*nr + c] = src[p];
+                }
+            }
+        }
+        for (ptrdiff_t c = cols; c < nr; c++) {
+            for (ptrdiff_t p = 0; p < kc; p++) {
+                Bp[p*nr + c] = 0;
+            }
+        }
+        Bp += nr * kc;
+    }
+}
+
+// C = act(C + bias) on the (m x n) block of C at (i0, j0)
+template <typename S>
+void apply(const Epilogue& e, const ptrdiff_t i0, const ptrdiff_t j0,
+           const ptrdiff_t m, const ptrdiff_t n,
+           S* C, const ptrdiff_t ldc) {
+    const S* bias = static_cast<const S*>(e.b);
+    for (ptrdiff_t i = 0; i < m; i++) {
+        S* c = C + i*ldc;
+        if (e.bias == Epilogue::ROW) {
+            const S bi = bias[(i0 + i) * e.incb];
+            for (ptrdiff_t j = 0; j < n; j++) c[j] += bi;
+        } else if (e.bias == Epilogue::COL) {
+            const S* b = bias + j0 * e.incb;
+            for (ptrdiff_t j = 0; j < n; j++) c[j] += b[j * e.incb];
+        }
+        switch (e.activation) {
+            case Epilogue::IDENTITY:
+                break;
+            case Epilogue::RELU:
+                for (ptrdiff_t j = 0; j < n; j++) c[j] = std::max(c[j], S(0));
+                break;
+            case Epilogue::TANH:
+                vmath::tanh(n, c, c, e.accuracy);
+                break;
+            case Epilogue::CUSTOM:
+                if constexpr (std::is_same_v<S, float>) e.fnf(c, n, e.context);
+                else
+                    e.fn(c, n, e.context);
+                break;
+        }
+    }
+}
+
+// C[0:mc, 0:nc] = alpha * Ap * Bp + beta * C, one register tile at a time.
+// With an epilogue, each mc x nr strip of C is finished as soon as its
+// tiles are, (i0, j0) being the position of C in the full product.
+template <typename S>
+void macroKernel(const Kernel<S>& K,
+                 const ptrdiff_t mc, const ptrdiff_t nc, const ptrdiff_t kc,
+                 const S alpha, const S* Ap, const S* Bp,
+                 const S beta, S* C, const ptrdiff_t ldc,
+                 const Epilogue* e, const ptrdiff_t i0, const ptrdiff_t j0) {
+    alignas(64) S tile[MAXTILE];
+    for (ptrdiff_t jr = 0; jr < nc; jr += K.nr) {
+        const ptrdiff_t cols = std::min(K.nr, nc - jr);
+        for (ptrdiff_t ir = 0; ir < mc; ir += K.mr) {
+            const ptrdiff_t rows = std::min(K.mr, mc - ir);
+            const S* a = Ap + ir * kc;
+            const S* b = Bp + jr * kc;
+            S* c = C + ir * ldc + jr;
+            if (rows == K.mr && cols == K.nr) {
+                K.fn(kc, alpha, a, b, beta, c, ldc);
+                continue;
+            }
+            // Edge tile: compute into scratch, then merge the valid part
+            K.fn(kc, alpha, a, b, S(0), tile, K.nr);
+            for (ptrdiff_t i = 0; i < rows; i++) {
+                for (ptrdiff_t j = 0; j < cols; j++) {
+                    c[i*ldc + j] = beta == 0
+                        ? tile[i*K.nr + j]
+                        : tile[i*K.nr + j] + beta * c[i*ldc + j];
+                }
+            }
+        }
+        if (e) apply(*e, i0, j0 + jr, mc, cols, C + jr, ldc);
+    }
+}
+
+// C = beta * C
+template <typename S>
+void scale(const ptrdiff_t m, const ptrdiff_t n, const S beta,
+           S* C, const ptrdiff_t ldc) {
+    for (ptrdiff_t i = 0; i < m; i++) {
+        for (ptrdiff_t j = 0; j < n; j++) {
+            C[i*ldc + j] = beta == 0 ? 0 : beta * C[i*ldc + j];
+        }
+    }
+}
+
+// Blocked driver shared by dgemm and sgemm
+template <typename S>
+void driver(const bool transA, const bool transB,
+            const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+            const S alpha,
+            const S* A, const ptrdiff_t lda,
+            const S* B, const ptrdiff_t ldb,
+            const S beta,
+            S* C, const ptrdiff_t ldc,
+            const Epilogue& epilogue) {
+    if (m <= 0 || n <= 0) return;
+    if (k <= 0 || alpha == 0) {
+        scale(m, n, beta, C, ldc);
+        gemm::epilogue(epilogue, m, n, C, ldc);
+        return;
+    }
+
+    const Kernel<S>& K = *active<S>().load();
+    const Blocking P = blocking(K);
+
+    // Split the rows of C over the pool, shrinking the A block so every
+    // thread has one when m is small. Tiny products stay serial.
+    const bool parallel = !ThreadPool::nested()
+                       && ThreadPool::instance().size() > 1
+                       && static_cast<double>(m) * n * k >= PARALLEL_FLOPS;
+    const ptrdiff_t threads = parallel ? ThreadPool::instance().size() : 1;
+    const ptrdiff_t MC = std::min(P.mc, roundUp((m + threads - 1) / threads,
+                                                K.mr));
+    const ptrdiff_t blocks = (m + MC - 1) / MC;
+    const ptrdiff_t grain = parallel ? 1 : blocks;
+
+    S* Bp = bufB.get<S>(roundUp(std::min(n, P.nc), K.nr) * P.kc);
+
+    for (ptrdiff_t jc = 0; jc < n; jc += P.nc) {
+        const ptrdiff_t nc = std::min(P.nc, n - jc);
+        const ptrdiff_t panels = (nc + K.nr - 1) / K.nr;
+        for (ptrdiff_t pc = 0; pc < k; pc += P.kc) {
+            const ptrdiff_t kc = std::min(P.kc, k - pc);
+            parallel_for(panels, parallel ? 1 : panels,
+                [&](ptrdiff_t q0, ptrdiff_t q1) {
+                    const ptrdiff_t j0 = jc + q0 * K.nr;
+                    const ptrdiff_t j1 = std::min(jc + q1 * K.nr, jc + nc);
+                    packB(transB, kc, j1 - j0,
+                          transB ? B + j0*ldb + pc : B + pc*ldb + j0, ldb,
+                          K.nr, Bp + q0 * K.nr * kc);
+                });
+            // Only the first pass over k applies the caller's beta, and
+            // only the last one the epilogue
+            const S b = pc == 0 ? beta : S(1);
+            const Epilogue* e = pc + kc >= k && !epilogue.empty()
+                              ? &epilogue : nullptr;
+            parallel_for(blocks, grain, [&](ptrdiff_t b0, ptrdiff_t b1) {
+                S* Ap = bufA.get<S>(roundUp(MC, K.mr) * P.kc);
+                for (ptrdiff_t blk = b0; blk < b1; blk++) {
+                    const ptrdiff_t ic = blk * MC;
+                    const ptrdiff_t mc = std::min(MC, m - ic);
+                    packA(transA, mc, kc,
+                          transA ? A + pc*lda + ic : A + ic*lda + pc, lda,
+                          K.mr, Ap);
+                    macroKernel(K, mc, nc, kc, alpha, Ap, Bp, b,
+                                C + ic*ldc + jc, ldc, e, ic, jc);
+                }
+            });
+        }
+    }
+}
+
+// Matrix-vector driver shared by dgemv and sgemv
+template <typename S>
+void gemvDriver(const bool trans, const ptrdiff_t m, const ptrdiff_t n,
+                const S alpha, const S* A, const ptrdiff_t lda,
+                const S* x, const ptrdiff_t incx,
+                const S beta, S* y, const ptrdiff_t incy) {
+    const ptrdiff_t lenx = trans ? m : n, leny = trans ? n : m;
+    if (leny <= 0) return;
+    if (lenx <= 0 || alpha == 0) {
+        scale(leny, 1, beta, y, std::abs(incy));
+        return;
+    }
+    const Kernel<S>& K = *active<S>().load();
+
+    // Strided vectors (BLAS convention for negative increments) are
+    // copied to contiguous scratch, the kernels run on unit strides
+    const S* xs = x;
+    if (incx != 1) {
+        S* xc = bufB.get<S>(lenx);
+        const S* x0 = incx < 0 ? x + (1 - lenx)*incx : x;
+        for (ptrdiff_t i = 0; i < lenx; i++) xc[i] = x0[i*incx];
+        xs = xc;
+    }
+    S* ys = y;
+    S* y0 = incy < 0 ? y + (1 - leny)*incy : y;
+    if (incy != 1) {
+        ys = bufA.get<S>(leny);
+        if (beta != 0) {
+            for (ptrdiff_t i = 0; i < leny; i++) ys[i] = y0[i*incy];
+        }
+    }
+
+    // A is read once: split by rows of A (y = A * x) or by columns of A,
+    // i.e. disjoint slices of y (y = A^T * x)
+    const ptrdiff_t grain = std::max<ptrdiff_t>(1, ThreadPool::grain() / lenx);
+    if (!trans) {
+        parallel_for((m + 3) / 4, std::max<ptrdiff_t>(1, grain / 4),
+            [&](ptrdiff_t b0, ptrdiff_t b1) {
+                for (ptrdiff_t i = 4*b0; i < std::min(4*b1, m); i += 4) {
+                    S r[4] = {};
+                    if (i + 4 <= m) {
+                        K.dots(n, A + i*lda, lda, xs, r);
+                    } else {
+                        for (ptrdiff_t t = 0; i + t < m; t++)
+                            for (ptrdiff_t j = 0; j < n; j++)
+                                r[t] += A[(i + t)*lda + j] * xs[j];
+                    }
+                    for (ptrdiff_t t = 0; t < 4 && i + t < m; t++) {
+                        ys[i + t] = beta == 0 ? alpha * r[t]
+                                              : alpha * r[t] + beta * ys[i + t];
+                    }
+                }
+            });
+    } else {
+        parallel_for(n, std::max<ptrdiff_t>(GEMV_PANEL, grain),
+            [&](ptrdiff_t j0, ptrdiff_t j1) {
+                S* yj = ys + j0;
+                const ptrdiff_t w = j1 - j0;
+                scale(1, w, beta, yj, w);
+                ptrdiff_t i = 0;
+                for (; i + 4 <= m; i += 4) {
+                    const S s[4] = {alpha * xs[i], alpha * xs[i + 1],
+                                    alpha * xs[i + 2], alpha * xs[i + 3]};
+                    K.axpy(w, A + i*lda + j0, lda, s, yj);
+                }
+                for (; i < m; i++) {
+                    const S s = alpha * xs[i];
+                    const S* a = A + i*lda + j0;
+                    for (ptrdiff_t j = 0; j < w; j++) yj[j] += s * a[j];
+                }
+            });
+    }
+    if (incy != 1) {
+        for (ptrdiff_t i = 0; i < leny; i++) y0[i*incy] = ys[i];
+    }
+}
+
+}  // namespace
+
+void dgemm(const bool transA, const bool transB,
+           const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+           const double alpha,
+           const double* A, const ptrdiff_t lda,
+           const double* B, const ptrdiff_t ldb,
+           const double beta,
+           double* C, const ptrdiff_t ldc) {
+    dgemm(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc,
+          Epilogue());
+}
+
+void dgemm(const bool transA, const bool transB,
+           const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+           const double alpha,
+           const double* A, const ptrdiff_t lda,
+           const double* B, const ptrdiff_t ldb,
+           const double beta,
+           double* C, const ptrdiff_t ldc,
+           const Epilogue& epilogue) {
+    driver(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc,
+           epilogue);
+}
+
+void sgemm(const bool transA, const bool transB,
+           const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+           const float alpha,
+           const float* A, const ptrdiff_t lda,
+           const float* B, const ptrdiff_t ldb,
+           const float beta,
+           float* C, const ptrdiff_t ldc,
+           const Epilogue& epilogue) {
+    driver(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc,
+           epilogue);
+}
+
+void dgemv(const bool trans, const ptrdiff_t m, const ptrdiff_t n,
+           const double alpha, const double* A, const ptrdiff_t lda,
+           const double* x, const ptrdiff_t incx,
+           const double beta, double* y, const ptrdiff_t incy) {
+    gemvDriver(trans, m, n, alpha, A, lda, x, incx, beta, y, incy);
+}
+
+void sgemv(const bool trans, const ptrdiff_t m, const ptrdiff_t n,
+           const float alpha, const float* A, const ptrdiff_t lda,
+           const float* x, const ptrdiff_t incx,
+           const float beta, float* y, const ptrdiff_t incy) {
+    gemvDriver(trans, m, n, alpha, A, lda, x, incx, beta, y, incy);
+}
+
+void epilogue(const Epilogue& e, const ptrdiff_t m, const ptrdiff_t n,
+              double* C, const ptrdiff_t ldc) {
+    if (m <= 0 || n <= 0 || e.empty()) return;
+    parallel_rows(m, n, false, ThreadPool::grain(),
+        [&](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            apply(e, i, j0, 1, j1 - j0, C + i*ldc + j0, ldc);
+        });
+}
+
+void epilogue(const Epilogue& e, const ptrdiff_t m, const ptrdiff_t n,
+              float* C, const ptrdiff_t ldc) {
+    if (m <= 0 || n <= 0 || e.empty()) return;
+    parallel_rows(m, n, false, ThreadPool::grain(),
+        [&](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            apply(e, i, j0, 1, j1 - j0, C + i*ldc + j0, ldc);
+        });
+}
+
+void dgemmInterleaved(const bool transA, const bool transB,
+                      const ptrdiff_t m, const ptrdiff_t n, const ptrdiff_t k,
+                      const double alpha, const double* A, const double* B,
+                      const double beta, double* C, const ptrdiff_t count) {
+    if (m <= 0 || n <= 0 || count <= 0) return;
+    const Interleaved g{transA, transB, m, n, k, alpha, A, B, beta, C};
+    const BatchKernel kernel = active().load()->batched;
+    // Split the groups over the pool
+    const double flops = static_cast<double>(LANES) * m * n
+                       * std::max<ptrdiff_t>(k, 1);
+    const ptrdiff_t grain = std::max<ptrdiff_t>(1, PARALLEL_FLOPS / flops);
+    parallel_for(groups(count), grain, [&](ptrdiff_t q0, ptrdiff_t q1) {
+        kernel(g, q0, q1);
+    });
+}
+
+void interleave(const ptrdiff_t count, const ptrdiff_t m, const ptrdiff_t n,
+                const double* const* X, const ptrdiff_t ldx, double* Y) {
+    for (ptrdiff_t q = 0; q < groups(count); q++) {
+        const ptrdiff_t lanes = std::min(LANES, count - q*LANES);
+        const double* const* x = X + q*LANES;
+        double* y = Y + q*m*n*LANES;
+        for (ptrdiff_t i = 0; i < m; i++) {
+            for (ptrdiff_t j = 0; j < n; j++, y += LANES) {
+                for (ptrdiff_t v = 0; v < lanes; v++) y[v] = x[v][i*ldx + j];
+                std::fill(y + lanes, y + LANES, 0.0);
+            }
+        }
+    }
+}
+
+void deinterleave(const ptrdiff_t count, const ptrdiff_t m, const ptrdiff_t n,
+                  const double* Y, double* const* X, const ptrdiff_t ldx) {
+    for (ptrdiff_t q = 0; q < groups(count); q++) {
+        const ptrdiff_t lanes = std::min(LANES, count - q*LANES);
+        double* const* x = X + q*LANES;
+        const double* y = Y + q*m*n*LANES;
+        for (ptrdiff_t i = 0; i < m; i++) {
+            for (ptrdiff_t j = 0; j < n; j++, y += LANES) {
+                for (ptrdiff_t v = 0; v < lanes; v++) x[v][i*ldx + j] = y[v];
+            }
+        }
+    }
+}
+
+Blocking blocking(const bool single) {
+    return single ? blocking(*active<float>().load())
+                  : blocking(*active<double>().load());
+}
+
+void blocking(const Blocking& b, const bool single) {
+    if (single) blocking(*active<float>().load(), b);
+    else
+        blocking(*active<double>().load(), b);
+}
+
+const char* kernel() {
+    return active().load()->name;
+}
+
+bool kernel(const char* name) {
+    for (size_t i = 0; i < std::size(kernels); i++) {
+        if (std::strcmp(kernels[i].name, name) == 0 && supported(kernels[i])) {
+            active<double>().store(&kernels[i]);
+            active<float>().store(&skernels[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace gemm
@@ -0,0 +1,55 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Graph.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace graph {
+
+ptrdiff_t pack(const std::vector<Interval>& buffers,
+               std::vector<ptrdiff_t>* offsets) {
+    const ptrdiff_t ALIGN = 64;
+    const size_t n = buffers.size();
+    offsets->assign(n, 0);
+
+    // Largest first, then earliest, so placement is deterministic
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+        if (buffers[i].bytes != buffers[j].bytes)
+            return buffers[i].bytes > buffers[j].bytes;
+        return buffers[i].first < buffers[j].first;
+    });
+
+    // Lowest aligned offset clear of every placed buffer live at the
+    // same time, trying the start and the end of each such buffer
+    ptrdiff_t size = 0;
+    std::vector<size_t> placed;
+    for (size_t i : order) {
+        const Interval& b = buffers[i];
+        const ptrdiff_t bytes = (b.bytes + ALIGN - 1) / ALIGN * ALIGN;
+        std::vector<size_t> live;
+        for (size_t j : placed) {
+            if (buffers[j].first <= b.last && b.first <= buffers[j].last)
+                live.push_back(j);
+        }
+        std::sort(live.begin(), live.end(), [&](size_t x, size_t y) {
+            return (*offsets)[x] < (*offsets)[y];
+        });
+        ptrdiff_t offset = 0;
+        for (size_t j : live) {
+            const ptrdiff_t begin = (*offsets)[j];
+            const ptrdiff_t end = begin + (buffers[j].bytes + ALIGN - 1)
+                                        / ALIGN * ALIGN;
+            if (offset + bytes <= begin) break;
+            offset = std::max(offset, end);
+        }
+        (*offsets)[i] = offset;
+        placed.push_back(i);
+        size = std::max(size, offset + bytes);
+    }
+    return size;
+}
+
+}  // namespace graph
@@ -0,0 +1,237 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Instrument.h"
+
+#include <atomic>
+#include <cstdlib>
+
+#include "Matrix.h"
+
+namespace instrument {
+
+namespace {
+
+// Process-wide events of one backend
+struct Events {
+    std::atomic<int64_t> allocations{0}, deallocations{0}, bytes{0},
+                         freedBytes{0}, copies{0}, copiedBytes{0};
+};
+
+struct Gauge {
+    std::atomic<int64_t> live{0}, peak{0};
+
+    void add(int64_t bytes) {
+        const int64_t now = live.fetch_add(bytes, std::memory_order_relaxed)
+                          + bytes;
+        int64_t top = peak.load(std::memory_order_relaxed);
+        while (now > top && !peak.compare_exchange_weak(top, now,
+                   std::memory_order_relaxed)) {}
+    }
+};
+
+// Function-local so that hooks called during static initialization of
+// other translation units find them constructed
+struct State {
+    std::atomic<bool> enabled{false};
+    Events events[BACKENDS];
+    Gauge gauges[BACKENDS];
+    Gauge total;
+
+    State() {
+        const char* env = std::getenv("MATRIX_INSTRUMENT");
+        enabled = env != nullptr && std::atoi(env) != 0;
+    }
+};
+
+State& state() {
+    static State* s = new State;  // Leaked, outlives matrices at exit
+    return *s;
+}
+
+// Live Scopes on the calling thread
+thread_local int scopes = 0;
+
+// True if events on the calling thread are counted
+bool counting(const State& s) {
+    return scopes > 0 || s.enabled.load(std::memory_order_relaxed);
+}
+
+Counters (&thread())[BACKENDS] {
+    thread_local Counters c[BACKENDS];
+    return c;
+}
+
+bool valid(int backend) {
+    return backend >= 0 && backend < BACKENDS;
+}
+
+Counters load(const Events& e) {
+    Counters c;
+    c.allocations = e.allocations.load(std::memory_order_relaxed);
+    c.deallocations = e.deallocations.load(std::memory_order_relaxed);
+    c.bytes = e.bytes.load(std::memory_order_relaxed);
+    c.freedBytes = e.freedBytes.load(std::memory_order_relaxed);
+    c.copies = e.copies.load(std::memory_order_relaxed);
+    c.copiedBytes = e.copiedBytes.load(std::memory_order_relaxed);
+    return c;
+}
+
+}  // namespace
+
+Counters& Counters::operator+=(const Counters& c) {
+    allocations += c.allocations;
+    deallocations += c.deallocations;
+    bytes += c.bytes;
+    freedBytes += c.freedBytes;
+    copies += c.copies;
+    copiedBytes += c.copiedBytes;
+    return *this;
+}
+
+Counters Counters::operator-(const Counters& c) const {
+    Counters d = *this;
+    d.allocations -= c.allocations;
+    d.deallocations -= c.deallocations;
+    d.bytes -= c.bytes;
+    d.freedBytes -= c.freedBytes;
+    d.copies -= c.copies;
+    d.copiedBytes -= c.copiedBytes;
+    return d;
+}
+
+void enable(bool on) {
+    state().enabled.store(on, std::memory_order_relaxed);
+}
+
+bool enabled() {
+    return counting(state());
+}
+
+Counters counters() {
+    Counters c;
+    for (const Events& e : state().events) c += load(e);
+    return c;
+}
+
+Counters counters(BLAS backend) {
+    return valid(backend) ? load(state().events[backend]) : Counters();
+}
+
+Counters threadCounters() {
+    Counters c;
+    for (const Counters& t : thread()) c += t;
+    return c;
+}
+
+Counters threadCounters(BLAS backend) {
+    return valid(backend) ? thread()[backend] : Counters();
+}
+
+void reset() {
+    State& s = state();
+    for (Events& e : s.events) {
+        e.allocations = 0;
+        e.deallocations = 0;
+        e.bytes = 0;
+        e.freedBytes = 0;
+        e.copies = 0;
+        e.copiedBytes = 0;
+    }
+    for (Gauge& g : s.gauges) g.peak = g.live.load();
+    s.total.peak = s.total.live.load();
+    for (Counters& t : thread()) t = Counters();
+}
+
+int64_t liveBytes() {
+    return state().total.live.load(std::memory_order_relaxed);
+}
+
+int64_t liveBytes(BLAS backend) {
+    if (!valid(backend)) return 0;
+    return state().gauges[backend].live.load(std::memory_order_relaxed);
+}
+
+int64_t peakBytes() {
+    return state().total.peak.load(std::memory_order_relaxed);
+}
+
+int64_t peakBytes(BLAS backend) {
+    if (!valid(backend)) return 0;
+    return state().gauges[backend].peak.load(std::memory_order_relaxed);
+}
+
+void write(std::ostream& os) {
+    auto line = [&](const char* name, int backend, int64_t value) {
+        os << "matrix_" << name << "{backend=\"" << BLAS(backend) << "\"} "
+           << value << "\n";
+    };
+    for (int b = 0; b < BACKENDS; b++) {
+        line("live_bytes", b, liveBytes(BLAS(b)));
+        line("peak_bytes", b, peakBytes(BLAS(b)));
+    }
+    for (int b = 0; b < BACKENDS; b++) {
+        const Counters c = counters(BLAS(b));
+        line("allocations_total", b, c.allocations);
+        line("deallocations_total", b, c.deallocations);
+        line("allocated_bytes_total", b, c.bytes);
+        line("freed_bytes_total", b, c.freedBytes);
+        line("copies_total", b, c.copies);
+        line("copied_bytes_total", b, c.copiedBytes);
+    }
+}
+
+Scope::Scope() {
+    for (int b = 0; b < BACKENDS; b++) _start[b] = thread()[b];
+    scopes++;
+}
+
+Scope::~Scope() {
+    scopes--;
+}
+
+Counters Scope::delta() const {
+    Counters c;
+    for (int b = 0; b < BACKENDS; b++) c += thread()[b] - _start[b];
+    return c;
+}
+
+Counters Scope::delta(BLAS backend) const {
+    if (!valid(backend)) return Counters();
+    return thread()[backend] - _start[backend];
+}
+
+void allocated(int backend, size_t bytes) {
+    State& s = state();
+    s.gauges[backend].add(bytes);
+    s.total.add(bytes);
+    if (!counting(s)) return;
+    s.events[backend].allocations.fetch_add(1, std::memory_order_relaxed);
+    s.events[backend].bytes.fetch_add(bytes, std::memory_order_relaxed);
+    Counters& t = thread()[backend];
+    t.allocations++;
+    t.bytes += bytes;
+}
+
+void deallocated(int backend, size_t bytes) {
+    State& s = state();
+    s.gauges[backend].live.fetch_sub(bytes, std::memory_order_relaxed);
+    s.total.live.fetch_sub(bytes, std::memory_order_relaxed);
+    if (!counting(s)) return;
+    s.events[backend].deallocations.fetch_add(1, std::memory_order_relaxed);
+    s.events[backend].freedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    Counters& t = thread()[backend];
+    t.deallocations++;
+    t.freedBytes += bytes;
+}
+
+void copied(int backend, size_t bytes) {
+    State& s = state();
+    if (!counting(s)) return;
+    s.events[backend].copies.fetch_add(1, std::memory_order_relaxed);
+    s.events[backend].copiedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    Counters& t = thread()[backend];
+    t.copies++;
+    t.copiedBytes += bytes;
+}
+
+}  // namespace instrument
@@ -0,0 +1,441 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Layout.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LAYOUT_X86
+#include <immintrin.h>
+#endif
+
+#include "ThreadPool.h"
+
+namespace layout {
+
+namespace {
+
+// Register block: b[0:W, 0:W] = a[0:W, 0:W]^T
+template <typename S>
+using Block = void (*)(const S* a, const ptrdiff_t lda,
+                       S* b, const ptrdiff_t ldb);
+
+// Register block swap across the diagonal: with X = a[0:W, 0:W] and
+// Y = b[0:W, 0:W], a = Y^T and b = X^T. a == b transposes in place.
+template <typename S>
+using Swap = void (*)(S* a, S* b, const ptrdiff_t ld);
+
+template <typename S>
+struct Kernel {
+    const char* name;
+    ptrdiff_t w;
+    Block<S> block;
+    Swap<S> swap;
+};
+
+template <typename S>
+void blockGeneric(const S* a, const ptrdiff_t lda,
+                  S* b, const ptrdiff_t ldb) {
+    for (ptrdiff_t i = 0; i < 4; i++) {
+        for (ptrdiff_t j = 0; j < 4; j++) b[j*ldb + i] = a[i*lda + j];
+    }
+}
+
+template <typename S>
+void swapGeneric(S* a, S* b, const ptrdiff_t ld) {
+    S x[16], y[16];
+    for (ptrdiff_t i = 0; i < 4; i++) {
+        for (ptrdiff_t j = 0; j < 4; j++) {
+            x[i*4 + j] = a[i*ld + j];
+            y[i*4 + j] = b[i*ld + j];
+        }
+    }
+    for (ptrdiff_t i = 0; i < 4; i++) {
+        for (ptrdiff_t j = 0; j < 4; j++) {
+            a[j*ld + i] = y[i*4 + j];
+            b[j*ld + i] = x[i*4 + j];
+        }
+    }
+}
+
+#ifdef LAYOUT_X86
+
+// r[0:4] = rows of a 4 x 4 block, transposed in registers
+__attribute__((target("avx2"), always_inline))
+inline void transpose4(__m256d r[4]) {
+    const __m256d t0 = _mm256_unpacklo_pd(r[0], r[1]);
+    const __m256d t1 = _mm256_unpackhi_pd(r[0], r[1]);
+    const __m256d t2 = _mm256_unpacklo_pd(r[2], r[3]);
+    const __m256d t3 = _mm256_unpackhi_pd(r[2], r[3]);
+    r[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+    r[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+    r[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+    r[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+__attribute__((target("avx2")))
+void blockAVX2(const double* a, const ptrdiff_t lda,
+               double* b, const ptrdiff_t ldb) {
+    __m256d r[4];
+    for (int i = 0; i < 4; i++) r[i] = _mm256_loadu_pd(a + i*lda);
+    transpose4(r);
+    for (int i = 0; i < 4; i++) _mm256_storeu_pd(b + i*ldb, r[i]);
+}
+
+__attribute__((target("avx2")))
+void swapAVX2(double* a, double* b, const ptrdiff_t ld) {
+    __m256d x[4], y[4];
+    for (int i = 0; i < 4; i++) {
+        x[i] = _mm256_loadu_pd(a + i*ld);
+        y[i] = _mm256_loadu_pd(b + i*ld);
+    }
+    transpose4(x);
+    transpose4(y);
+    for (int i = 0; i < 4; i++) {
+        _mm256_storeu_pd(a + i*ld, y[i]);
+        _mm256_storeu_pd(b + i*ld, x[i]);
+    }
+}
+
+// r[0:8] = rows of an 8 x 8 block, transposed in registers: pairs of rows
+// interleave, then 128-bit lanes gather in two rounds. The zero-masking
+// forms under a full mask are the same instructions; the plain ones pass
+// GCC an uninitialized _mm512_undefined_pd() (-Wmaybe-uninitialized).
+__attribute__((target("avx512f"), always_inline))
+inline void transpose8(__m512d r[8]) {
+    const __mmask8 ALL = 0xFF;
+    __m512d t[8], u[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i] = _mm512_maskz_unpacklo_pd(ALL, r[i], r[i + 1]);
+        t[i + 1] = _mm512_maskz_unpackhi_pd(ALL, r[i], r[i + 1]);
+    }
+    // u[0]: columns 0, 4 of rows 0-3, u[1]: columns 2, 6, u[2]: 1, 5,
+    // u[3]: 3, 7, u[4:8] likewise for rows 4-7
+    for (int h = 0; h < 8; h += 4) {
+        u[h] = _mm512_maskz_shuffle_f64x2(ALL, t[h], t[h + 2], 0x88);
+        u[h + 1] = _mm512_maskz_shuffle_f64x2(ALL, t[h], t[h + 2], 0xDD);
+        u[h + 2] = _mm512_maskz_shuffle_f64x2(ALL, t[h + 1], t[h + 3], 0x88);
+        u[h + 3] = _mm512_maskz_shuffle_f64x2(ALL, t[h + 1], t[h + 3], 0xDD);
+    }
+    r[0] = _mm512_maskz_shuffle_f64x2(ALL, u[0], u[4], 0x88);
+    r[4] = _mm512_maskz_shuffle_f64x2(ALL, u[0], u[4], 0xDD);
+    r[2] = _mm512_maskz_shuffle_f64x2(ALL, u[1], u[5], 0x88);
+    r[6] = _mm512_maskz_shuffle_f64x2(ALL, u[1], u[5], 0xDD);
+    r[1] = _mm512_maskz_shuffle_f64x2(ALL, u[2], u[6], 0x88);
+    r[5] = _mm512_maskz_shuffle_f64x2(ALL, u[2], u[6], 0xDD);
+    r[3] = _mm512_maskz_shuffle_f64x2(ALL, u[3], u[7], 0x88);
+    r[7] = _mm512_maskz_shuffle_f64x2(ALL, u[3], u[7], 0xDD);
+}
+
+__attribute__((target("avx512f")))
+void blockAVX512(const double* a, const ptrdiff_t lda,
+                 double* b, const ptrdiff_t ldb) {
+    __m512d r[8];
+    for (int i = 0; i < 8; i++) r[i] = _mm512_loadu_pd(a + i*lda);
+    transpose8(r);
+    for (int i = 0; i < 8; i++) _mm512_storeu_pd(b + i*ldb, r[i]);
+}
+
+__attribute__((target("avx512f")))
+void swapAVX512(double* a, double* b, const ptrdiff_t ld) {
+    __m512d x[8], y[8];
+    for (int i = 0; i < 8; i++) {
+        x[i] = _mm512_loadu_pd(a + i*ld);
+        y[i] = _mm512_loadu_pd(b + i*ld);
+    }
+    transpose8(x);
+    transpose8(y);
+    for (int i = 0; i < 8; i++) {
+        _mm512_storeu_pd(a + i*ld, y[i]);
+        _mm512_storeu_pd(b + i*ld, x[i]);
+    }
+}
+
+// r[0:8] = rows of an 8 x 8 single precision block, transposed in
+// registers: pairs of rows interleave, pairs of pairs shuffle, then the
+// 128-bit halves gather
+__attribute__((target("avx2"), always_inline))
+inline void transpose8(__m256 r[8]) {
+    __m256 t[8], u[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+    }
+    for (int h = 0; h < 8; h += 4) {
+        u[h] = _mm256_shuffle_ps(t[h], t[h + 2], 0x44);
+        u[h + 1] = _mm256_shuffle_ps(t[h], t[h + 2], 0xEE);
+        u[h + 2] = _mm256_shuffle_ps(t[h + 1], t[h + 3], 0x44);
+        u[h + 3] = _mm256_shuffle_ps(t[h + 1], t[h + 3], 0xEE);
+    }
+    for (int i = 0; i < 4; i++) {
+        r[i] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x20);
+        r[i + 4] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x31);
+    }
+}
+
+__attribute__((target("avx2")))
+void blockAVX2(const float* a, const ptrdiff_t lda,
+               float* b, const ptrdiff_t ldb) {
+    __m256 r[8];
+    for (int i = 0; i < 8; i++) r[i] = _mm256_loadu_ps(a + i*lda);
+    transpose8(r);
+    for (int i = 0; i < 8; i++) _mm256_storeu_ps(b + i*ldb, r[i]);
+}
+
+__attribute__((target("avx2")))
+void swapAVX2(float* a, float* b, const ptrdiff_t ld) {
+    __m256 x[8], y[8];
+    for (int i = 0; i < 8; i++) {
+        x[i] = _mm256_loadu_ps(a + i*ld);
+        y[i] = _mm256_loadu_ps(b + i*ld);
+    }
+    transpose8(x);
+    transpose8(y);
+    for (int i = 0; i < 8; i++) {
+        _mm256_storeu_ps(a + i*ld, y[i]);
+        _mm256_storeu_ps(b + i*ld, x[i]);
+    }
+}
+
+#endif  // LAYOUT_X86
+
+// Ordered by preference, the first supported kernel is selected. Single
+// precision uses the same names; its 8 x 8 ymm block serves avx512 too.
+const Kernel<double> kernels[] = {
+#ifdef LAYOUT_X86
+    {"avx512", 8, blockAVX512, swapAVX512},
+    {"avx2", 4, blockAVX2, swapAVX2},
+#endif
+    {"generic", 4, blockGeneric<double>, swapGeneric<double>},
+};
+
+const Kernel<float> skernels[] = {
+#ifdef LAYOUT_X86
+    {"avx512", 8, blockAVX2, swapAVX2},
+    {"avx2", 8, blockAVX2, swapAVX2},
+#endif
+    {"generic", 4, blockGeneric<float>, swapGeneric<float>},
+};
+
+template <typename S>
+const auto& table() {
+    if constexpr (std::is_same_v<S, float>) return skernels;
+    else
+        return kernels;
+}
+
+template <typename S>
+bool supported(const Kernel<S>& K) {
+#ifdef LAYOUT_X86
+    if (std::strcmp(K.name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512f");
+    if (std::strcmp(K.name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+#endif
+    return std::strcmp(K.name, "generic") == 0;
+}
+
+template <typename S>
+const Kernel<S>* detect() {
+    for (const Kernel<S>& K : table<S>()) {
+        if (supported(K)) return &K;
+    }
+    return nullptr;  // Unreachable, generic is always supported
+}
+
+template <typename S = double>
+std::atomic<const Kernel<S>*>& active() {
+    static std::atomic<const Kernel<S>*> K{detect<S>()};
+    return K;
+}
+
+std::atomic<ptrdiff_t> tileEdge{32};
+
+// Split point of a dimension larger than b, a multiple of b
+ptrdiff_t half(const ptrdiff_t m, const ptrdiff_t b) {
+    return (m + 2*b - 1) / (2*b) * b;
+}
+
+// B = A^T for an (m x n) tile, m, n <= block()
+template <typename S>
+void tile(const Kernel<S>& K, const ptrdiff_t m, const ptrdiff_t n,
+          const S* A, const ptrdiff_t lda,
+          S* B, const ptrdiff_t ldb) {
+    const ptrdiff_t W = K.w, mw = m - m % W, nw = n - n % W;
+    for (ptrdiff_t i = 0; i < mw; i += W) {
+        for (ptrdiff_t j = 0; j < nw; j += W) {
+            K.block(A + i*lda + j, lda, B + j*ldb + i, ldb);
+        }
+    }
+    // Edges
+    for (ptrdiff_t i = 0; i < m; i++) {
+        for (ptrdiff_t j = i < mw ? nw : 0; j < n; j++) {
+            B[j*ldb + i] = A[i*lda + j];
+        }
+    }
+}
+
+// B = A^T, halving the larger dimension down to (b x b) tiles
+template <typename S>
+void recurse(const Kernel<S>& K, const ptrdiff_t b,
+             const ptrdiff_t m, const ptrdiff_t n,
+             const S* A, const ptrdiff_t lda,
+             S* B, const ptrdiff_t ldb) {
+    if (m <= b && n <= b) {
+        tile(K, m, n, A, lda, B, ldb);
+    } else if (m >= n) {
+        const ptrdiff_t h = half(m, b);
+        recurse(K, b, h, n, A, lda, B, ldb);
+        recurse(K, b, m - h, n, A + h*lda, lda, B + h, ldb);
+    } else {
+        const ptrdiff_t h = half(n, b);
+        recurse(K, b, m, h, A, lda, B, ldb);
+        recurse(K, b, m, n - h, A + h, lda, B + h*ldb, ldb);
+    }
+}
+
+// Swap the (m x n) tile X at a with the (n x m) tile Y at b across the
+// diagonal: a = Y^T, b = X^T. a == b (m == n) transposes a diagonal tile.
+template <typename S>
+void swapTiles(const Kernel<S>& K, const ptrdiff_t m, const ptrdiff_t n,
+               S* a, S* b, const ptrdiff_t ld) {
+    const ptrdiff_t W = K.w, mw = m - m % W, nw = n - n % W;
+    const bool diagonal = a == b;
+    for (ptrdiff_t i = 0; i < mw; i += W) {
+        for (ptrdiff_t j = diagonal ? i : 0; j < nw; j += W) {
+            K.swap(a + i*ld + j, b + j*ld + i, ld);
+        }
+    }
+    // Edges
+    for (ptrdiff_t i = 0; i < m; i++) {
+        for (ptrdiff_t j = i < mw ? nw : 0; j < n; j++) {
+            if (!diagonal || j > i) std::swap(a[i*ld + j], b[j*ld + i]);
+        }
+    }
+}
+
+template <typename S>
+void transposeT(const ptrdiff_t m, const ptrdiff_t n,
+                const S* A, const ptrdiff_t lda,
+                S* B, const ptrdiff_t ldb) {
+    const Kernel<S>& K = *active<S>().load();
+    const ptrdiff_t b = block();
+    // Row panels of the longer side across the pool
+    const ptrdiff_t panels = (std::max(m, n) + b - 1) / b;
+    const ptrdiff_t grain = std::max<ptrdiff_t>(
+        1, ThreadPool::grain() / (b * std::max<ptrdiff_t>(1, std::min(m, n))));
+    parallel_for(panels, grain, [&](ptrdiff_t p0, ptrdiff_t p1) {
+        if (m >= n) {
+            const ptrdiff_t i0 = p0 * b, i1 = std::min(m, p1 * b);
+            recurse(K, b, i1 - i0, n, A + i0*lda, lda, B + i0, ldb);
+        } else {
+            const ptrdiff_t j0 = p0 * b, j1 = std::min(n, p1 * b);
+            recurse(K, b, m, j1 - j0, A + j0, lda, B + j0*ldb, ldb);
+        }
+    });
+}
+
+template <typename S>
+void transposeSquareT(const ptrdiff_t n, S* A, const ptrdiff_t lda) {
+    const Kernel<S>& K = *active<S>().load();
+    const ptrdiff_t b = block();
+    // Block row I swaps tiles (I, J) and (J, I) for J >= I, so block rows
+    // touch disjoint tiles and run in parallel
+    const ptrdiff_t blocks = (n + b - 1) / b;
+    const ptrdiff_t grain = std::max<ptrdiff_t>(
+        1, ThreadPool::grain() / (b * std::max<ptrdiff_t>(1, n)));
+    parallel_for(blocks, grain, [&](ptrdiff_t I0, ptrdiff_t I1) {
+        for (ptrdiff_t I = I0; I < I1; I++) {
+            const ptrdiff_t i = I * b, m = std::min(b, n - i);
+            for (ptrdiff_t j = i; j < n; j += b) {
+                swapTiles(K, m, std::min(b, n - j),
+                          A + i*lda + j, A + j*lda + i, lda);
+            }
+        }
+    });
+}
+
+template <typename S>
+void transposeInPlaceT(const ptrdiff_t m, const ptrdiff_t n, S* A) {
+    if (m <= 1 || n <= 1) return;  // Same layout
+    if (m == n) {
+        transposeSquareT(n, A, n);
+        return;
+    }
+    // Element k = i*n + j moves to j*m + i = k*m mod (m*n - 1), the first
+    // and last elements stay
+    const ptrdiff_t size = m*n - 1;
+    std::vector<bool> moved(size);
+    for (ptrdiff_t s = 1; s < size; s++) {
+        if (moved[s]) continue;
+        S carry = A[s];
+        ptrdiff_t k = s;
+        do {
+            k = k * m % size;
+            std::swap(carry, A[k]);
+            moved[k] = true;
+        } while (k != s);
+    }
+}
+
+}  // namespace
+
+void transpose(const ptrdiff_t m, const ptrdiff_t n,
+               const double* A, const ptrdiff_t lda,
+               double* B, const ptrdiff_t ldb) {
+    transposeT(m, n, A, lda, B, ldb);
+}
+
+void transpose(const ptrdiff_t m, const ptrdiff_t n,
+               const float* A, const ptrdiff_t lda,
+               float* B, const ptrdiff_t ldb) {
+    transposeT(m, n, A, lda, B, ldb);
+}
+
+void transposeSquare(const ptrdiff_t n, double* A, const ptrdiff_t lda) {
+    transposeSquareT(n, A, lda);
+}
+
+void transposeSquare(const ptrdiff_t n, float* A, const ptrdiff_t lda) {
+    transposeSquareT(n, A, lda);
+}
+
+void transposeInPlace(const ptrdiff_t m, const ptrdiff_t n, double* A) {
+    transposeInPlaceT(m, n, A);
+}
+
+void transposeInPlace(const ptrdiff_t m, const ptrdiff_t n, float* A) {
+    transposeInPlaceT(m, n, A);
+}
+
+ptrdiff_t block() {
+    return tileEdge.load(std::memory_order_relaxed);
+}
+
+void block(ptrdiff_t n) {
+    tileEdge.store(std::max<ptrdiff_t>(n / 8 * 8, 8),
+                   std::memory_order_relaxed);
+}
+
+const char* kernel() {
+    return active().load()->name;
+}
+
+bool kernel(const char* name) {
+    for (size_t i = 0; i < std::size(kernels); i++) {
+        if (std::strcmp(kernels[i].name, name) == 0 && supported(kernels[i])) {
+            active<double>().store(&kernels[i]);
+            active<float>().store(&skernels[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace layout
@@ -1,5 +1,7 @@
 // Copyright 2023 Caleb Magruder
 
+#include <cstdlib>
+
 #include "Matrix.h"
 
 std::ostream& operator<<(std::ostream& os, BLAS type) {
@@ -16,6 +18,36 @@ std::ostream& operator<<(std::ostream& os, BLAS type) {
         case MKL:
             os << "MKL";
             break;
+        case AUTO:
+            os << "AUTO";
+            break;
     }
     return os;
 }
+
+void setNumThreads(int n) {
+    ThreadPool::instance().resize(n);
+    n = ThreadPool::instance().size();
+#if OPB_FOUND
+    Matrix<OPB>::__threads(n);
+#endif
+#if MKL_FOUND
+    Matrix<MKL>::__threads(n);
+#endif
+}
+
+int getNumThreads() {
+    return ThreadPool::instance().size();
+}
+
+namespace {
+
+// Apply MATRIX_NUM_THREADS to the BLAS backends at load time, the REF
+// pool reads it itself on first use
+const int threadsFromEnv = [] {
+    const char* n = std::getenv("MATRIX_NUM_THREADS");
+    if (n != nullptr && *n != '\0') setNumThreads(std::atoi(n));
+    return 0;
+}();
+
+}  // namespace
@@ -3,35 +3,68 @@
 #include <Accelerate/Accelerate.h>
 
 #include <cassert>
+#include <cmath>
 
 #include "Matrix.h"
 
-template<> int Matrix<ACC>::__alloc() {
-    if (_m*_n > 0) {
-        _data = new double[_m*_n];
+template<> int Matrix<ACC>::__broadcast(const broadcast::Op op,
+        const broadcast::Axis axis,
+        const double* v,
+        const ptrdiff_t incv,
+        Matrix<ACC>* C) const {
+    // vDSP's vsub and vdiv take the subtrahend and divisor first
+    for (ptrdiff_t i = 0; i < _m; i++) {
+        const double* a = _data + i*_ld;
+        double* c = C->_data + i*C->_ld;
+        if (axis == broadcast::ROW) {
+            const double s = op == broadcast::SUB ? -v[i*incv] : v[i*incv];
+            switch (op) {
+                case broadcast::ADD:
+                case broadcast::SUB: vDSP_vsaddD(a, 1, &s, c, 1, _n); break;
+                case broadcast::MUL: vDSP_vsmulD(a, 1, &s, c, 1, _n); break;
+                case broadcast::DIV: vDSP_vsdivD(a, 1, &s, c, 1, _n); break;
+            }
+        } else {
+            switch (op) {
+                case broadcast::ADD: vDSP_vaddD(a, 1, v, 1, c, 1, _n); break;
+                case broadcast::SUB: vDSP_vsubD(v, 1, a, 1, c, 1, _n); break;
+                case broadcast::MUL: vDSP_vmulD(a, 1, v, 1, c, 1, _n); break;
+                case broadcast::DIV: vDSP_vdivD(v, 1, a, 1, c, 1, _n); break;
+            }
+        }
     }
-    return 0;  // Successful Allocation
+    return 0;
 }
 
-template<> int Matrix<ACC>::__copy(double* A, const ptrdiff_t inca) {
-    // _data = copy(A._data)
-    cblas_dcopy(_m * _n,  // n
-                A,        // x
-                inca,     // incx
-                _data,    // y
-                1);    // incy
+template<> int Matrix<ACC>::__copy(const double* A,
+                                   const ptrdiff_t inca,
+                                   const ptrdiff_t lda) {
+    instrument::copied(ACC, _m * _n * sizeof(double));
+    // _data = copy(A._data), one call per row if either is strided
+    const Runs r(_m, _n, contiguous() && lda == _n * inca);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_dcopy(r.len,           // n
+                    A + i*lda,       // x
+                    inca,            // incx
+                    _data + i*_ld,   // y
+                    1);              // incy
+    }
     return 0;  // Successful Copy
 }
 
 template<> int Matrix<ACC>::__daxpy(const double alpha,
                                     const double* B,
-                                    const ptrdiff_t incb) {
-    cblas_daxpy(_m * _n,  // N
-                alpha,    // alpha
-                B,        // X
-                incb,     // incX
-                _data,    // Y);
-                1);       // incY
+                                    const ptrdiff_t incb,
+                                    const ptrdiff_t ldb) {
+    const Runs r(_m, _n, contiguous() && ldb == _n * incb);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_daxpy(r.len,           // N
+                    alpha,           // alpha
+                    B + i*ldb,       // X
+                    incb,            // incX
+                    _data + i*_ld,   // Y
+                    1);              // incY
+    }
     return 0;
 }
 
@@ -43,33 +76,32 @@ template<> int Matrix<ACC>::__dger(const double alpha,
                this->_n,       // n
                alpha,          // alpha
                x._data,        // x
-               1,              // incx
+               x.inc(),        // incx
                y._data,        // y
-               1,              // incy
+               y.inc(),        // incy
                _data,          // a
-               this->_n);       // lda
+               this->_ld);     // lda
     return 0;
 }
 
-template<> int Matrix<ACC>::__dealloc() {
-    if (_data != nullptr) {
-        // mkl_free(_data);
-        delete _data;
-    }
-    return 0;  // Successful Deallocation
-}
-
 template<> int Matrix<ACC>::__dot(const Matrix<ACC>& B, double* d) const {
-    *d = cblas_ddot(this->rows() * this->cols(), this->_data, 1, B._data, 1);
+    const Runs r(_m, _n, contiguous() && B.contiguous());
+    *d = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *d += cblas_ddot(r.len, _data + i*_ld, 1, B._data + i*B._ld, 1);
+    }
     return 0;
 }
 
 template<> int Matrix<ACC>::__hprod(const Matrix<ACC>& B,
                                     Matrix<ACC>* C) const {
-    vDSP_vmulD(*this, 1,
-               B, 1,
-               *C, 1,
-               this->rows() * this->cols());
+    const Runs r(_m, _n, contiguous() && B.contiguous() && C->contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vDSP_vmulD(_data + i*_ld, 1,
+                   B._data + i*B._ld, 1,
+                   C->_data + i*C->_ld, 1,
+                   r.len);
+    }
     return 0;
 }
 
@@ -77,7 +109,9 @@ template<> int Matrix<ACC>::__mult(const bool transA,
         const bool transB,
         const double alpha,
         const Matrix<ACC>& B,
-        Matrix<ACC>* C) const {
+        const double beta,
+        Matrix<ACC>* C,
+        const gemm::Epilogue& epilogue) const {
     cblas_dgemm(CblasRowMajor,                   // Layout
             transA ? CblasTrans : CblasNoTrans,  // transa
             transB ? CblasTrans : CblasNoTrans,  // transb
@@ -86,43 +120,253 @@ template<> int Matrix<ACC>::__mult(const bool transA,
             transB ? B._n : B._m,                // k
             alpha,                               // alpha
             _data,                               // a
-            _n,                                  // lda
+            _ld,                                 // lda
             B._data,                             // b
-            B._n,                                // ldb
-            0,                                   // beta
+            B._ld,                               // ldb
+            beta,                                // beta
             C->_data,                            // c
-            C->_n);                              // ldc
+            C->_ld);                             // ldc
+    // Bias and activation as one pass over C
+    gemm::epilogue(epilogue, C->_m, C->_n, C->_data, C->_ld);
+    return 0;
+}
+
+template<> int Matrix<ACC>::__gemv(const bool trans,
+        const double alpha,
+        const double* x,
+        const ptrdiff_t incx,
+        const double beta,
+        double* y,
+        const ptrdiff_t incy) const {
+    cblas_dgemv(CblasRowMajor,                      // Layout
+                trans ? CblasTrans : CblasNoTrans,  // trans
+                _m,                                 // m
+                _n,                                 // n
+                alpha,                              // alpha
+                _data,                              // a
+                _ld,                                // lda
+                x,                                  // x
+                incx,                               // incx
+                beta,                               // beta
+                y,                                  // y
+                incy);                              // incy
     return 0;
 }
 
 template<> int Matrix<ACC>::__mult(const double alpha) {
-    const int n(_m*_n), incx(1);
-    cblas_dscal(n,      // n
-                alpha,  // alpha
-                _data,  // data
-                incx);  // incx
+    const Runs r(_m, _n, contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_dscal(r.len,          // n
+                    alpha,          // alpha
+                    _data + i*_ld,  // data
+                    1);             // incx
+    }
     return 0;  // Successful Multiply
 }
 
 template<> int Matrix<ACC>::__norm(double* n) const {
-    *n = cblas_dnrm2(this->rows() * this->cols(), this->_data, 1);
+    const Runs r(_m, _n, contiguous());
+    if (r.count == 1) {
+        *n = cblas_dnrm2(r.len, _data, 1);
+        return 0;
+    }
+    // Combine per-row norms of a strided view, without squaring them
+    *n = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *n = std::hypot(*n, cblas_dnrm2(r.len, _data + i*_ld, 1));
+    }
     return 0;
 }
 
 template<> int Matrix<ACC>::__sub(const Matrix<ACC>& B, Matrix<ACC>* C) const {
     // C = A - B
-    vDSP_vsubD(B._data,     // __B
-               1,           // __IB
-               _data,       // __A
-               1,           // __IA
-               C->_data,    // __C
-               1,           // __IC
-               numel(*C));  // __N
+    const Runs r(_m, _n, contiguous() && B.contiguous() && C->contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vDSP_vsubD(B._data + i*B._ld,     // __B
+                   1,                     // __IB
+                   _data + i*_ld,         // __A
+                   1,                     // __IA
+                   C->_data + i*C->_ld,   // __C
+                   1,                     // __IC
+                   r.len);                // __N
+    }
+    return 0;  // Successful Subtraction
+}
+
+template<> int Matrix<ACC>::__tanh(const vmath::Accuracy mode) {
+    const Runs r(_m, _n, contiguous());
+    const int n = r.len;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        // vvtanh has a single accuracy, within HIGH and LOW's bounds
+        if (mode == vmath::FAST) {
+            vmath::tanh(n, _data + i*_ld, _data + i*_ld, mode);
+        } else {
+            vvtanh(_data + i*_ld, _data + i*_ld, &n);
+        }
+    }
+    return 0;
+}
+
+// Single precision: the s-prefixed routines, with results reduced in double
+
+template<> int Matrix<ACC, float>::__broadcast(const broadcast::Op op,
+        const broadcast::Axis axis,
+        const float* v,
+        const ptrdiff_t incv,
+        Matrix<ACC, float>* C) const {
+    // vDSP's vsub and vdiv take the subtrahend and divisor first
+    for (ptrdiff_t i = 0; i < _m; i++) {
+        const float* a = _data + i*_ld;
+        float* c = C->_data + i*C->_ld;
+        if (axis == broadcast::ROW) {
+            const float s = op == broadcast::SUB ? -v[i*incv] : v[i*incv];
+            switch (op) {
+                case broadcast::ADD:
+                case broadcast::SUB: vDSP_vsadd(a, 1, &s, c, 1, _n); break;
+                case broadcast::MUL: vDSP_vsmul(a, 1, &s, c, 1, _n); break;
+                case broadcast::DIV: vDSP_vsdiv(a, 1, &s, c, 1, _n); break;
+            }
+        } else {
+            switch (op) {
+                case broadcast::ADD: vDSP_vadd(a, 1, v, 1, c, 1, _n); break;
+                case broadcast::SUB: vDSP_vsub(v, 1, a, 1, c, 1, _n); break;
+                case broadcast::MUL: vDSP_vmul(a, 1, v, 1, c, 1, _n); break;
+                case broadcast::DIV: vDSP_vdiv(v, 1, a, 1, c, 1, _n); break;
+            }
+        }
+    }
+    return 0;
+}
+
+template<> int Matrix<ACC, float>::__copy(const float* A,
+                                          const ptrdiff_t inca,
+                                          const ptrdiff_t lda) {
+    instrument::copied(ACC, _m * _n * sizeof(float));
+    const Runs r(_m, _n, contiguous() && lda == _n * inca);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_scopy(r.len, A + i*lda, inca, _data + i*_ld, 1);
+    }
+    return 0;  // Successful Copy
+}
+
+template<> int Matrix<ACC, float>::__daxpy(const double alpha,
+                                           const float* B,
+                                           const ptrdiff_t incb,
+                                           const ptrdiff_t ldb) {
+    const Runs r(_m, _n, contiguous() && ldb == _n * incb);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_saxpy(r.len, alpha, B + i*ldb, incb, _data + i*_ld, 1);
+    }
+    return 0;
+}
+
+template<> int Matrix<ACC, float>::__dger(const double alpha,
+                                          const Matrix<ACC, float>& x,
+                                          const Matrix<ACC, float>& y) {
+    cblas_sger(CblasRowMajor, _m, _n, alpha, x._data, x.inc(),
+               y._data, y.inc(), _data, _ld);
+    return 0;
+}
+
+template<> int Matrix<ACC, float>::__dot(const Matrix<ACC, float>& B,
+                                         double* d) const {
+    const Runs r(_m, _n, contiguous() && B.contiguous());
+    *d = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *d += cblas_dsdot(r.len, _data + i*_ld, 1, B._data + i*B._ld, 1);
+    }
+    return 0;
+}
+
+template<> int Matrix<ACC, float>::__hprod(const Matrix<ACC, float>& B,
+                                           Matrix<ACC, float>* C) const {
+    const Runs r(_m, _n, contiguous() && B.contiguous() && C->contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vDSP_vmul(_data + i*_ld, 1,
+                  B._data + i*B._ld, 1,
+                  C->_data + i*C->_ld, 1,
+                  r.len);
+    }
+    return 0;
+}
+
+template<> int Matrix<ACC, float>::__mult(const bool transA,
+        const bool transB,
+        const double alpha,
+        const Matrix<ACC, float>& B,
+        const double beta,
+        Matrix<ACC, float>* C,
+        const gemm::Epilogue& epilogue) const {
+    cblas_sgemm(CblasRowMajor,
+            transA ? CblasTrans : CblasNoTrans,
+            transB ? CblasTrans : CblasNoTrans,
+            C->_m,
+            transB ? B._m : B._n,
+            transB ? B._n : B._m,
+            alpha,
+            _data,
+            _ld,
+            B._data,
+            B._ld,
+            beta,
+            C->_data,
+            C->_ld);
+    gemm::epilogue(epilogue, C->_m, C->_n, C->_data, C->_ld);
+    return 0;
+}
+
+template<> int Matrix<ACC, float>::__gemv(const bool trans,
+        const double alpha,
+        const float* x,
+        const ptrdiff_t incx,
+        const double beta,
+        float* y,
+        const ptrdiff_t incy) const {
+    cblas_sgemv(CblasRowMajor, trans ? CblasTrans : CblasNoTrans, _m, _n,
+                alpha, _data, _ld, x, incx, beta, y, incy);
+    return 0;
+}
+
+template<> int Matrix<ACC, float>::__mult(const double alpha) {
+    const Runs r(_m, _n, contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_sscal(r.len, alpha, _data + i*_ld, 1);
+    }
+    return 0;  // Successful Multiply
+}
+
+template<> int Matrix<ACC, float>::__norm(double* n) const {
+    const Runs r(_m, _n, contiguous());
+    double sum = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        const double ni = cblas_snrm2(r.len, _data + i*_ld, 1);
+        sum += ni * ni;
+    }
+    *n = std::sqrt(sum);
+    return 0;
+}
+
+template<> int Matrix<ACC, float>::__sub(const Matrix<ACC, float>& B,
+                                         Matrix<ACC, float>* C) const {
+    const Runs r(_m, _n, contiguous() && B.contiguous() && C->contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vDSP_vsub(B._data + i*B._ld, 1,
+                  _data + i*_ld, 1,
+                  C->_data + i*C->_ld, 1,
+                  r.len);
+    }
     return 0;  // Successful Subtraction
 }
 
-template<> int Matrix<ACC>::__tanh() {
-    const int n = this->rows() * this->cols();
-    vvtanh(*this, *this, &n);
+template<> int Matrix<ACC, float>::__tanh(const vmath::Accuracy mode) {
+    const Runs r(_m, _n, contiguous());
+    const int n = r.len;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        if (mode == vmath::FAST) {
+            vmath::tanh(n, _data + i*_ld, _data + i*_ld, mode);
+        } else {
+            vvtanhf(_data + i*_ld, _data + i*_ld, &n);
+        }
+    }
     return 0;
 }
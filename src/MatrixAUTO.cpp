@@ -0,0 +1,268 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cmath>
+#include <type_traits>
+
+#include "Matrix.h"
+
+namespace {
+
+// Matrix<T, S> over the storage of A, without copying
+template <BLAS T, Real S>
+typename Matrix<T, S>::View as(const Matrix<AUTO, S>& A) {
+    return typename Matrix<T, S>::View(static_cast<S*>(A), A.rows(),
+                                       A.cols(), A.ld());
+}
+
+template <BLAS T>
+using Backend = std::integral_constant<BLAS, T>;
+
+// f(Backend<T>()) for the backend T selected for op at the given size
+template <Real S, typename F>
+int forward(dispatch::Op op, double size, F&& f) {
+    const int c = dispatch::sizeClass(std::llround(size));
+    switch (dispatch::select(op, std::is_same_v<S, float>, c)) {
+#if ACC_FOUND
+        case ACC: return f(Backend<ACC>());
+#endif
+#if OPB_FOUND
+        case OPB: return f(Backend<OPB>());
+#endif
+#if MKL_FOUND
+        case MKL: return f(Backend<MKL>());
+#endif
+        default: return f(Backend<REF>());
+    }
+}
+
+// Level-1 reductions follow the routing of dot
+template <Real S>
+int asum(const Matrix<AUTO, S>& A, double* s) {
+    return forward<S>(dispatch::DOT, numel(A), [&]<BLAS T>(Backend<T>) {
+        return as<T, S>(A).__asum(s);
+    });
+}
+
+// Element-wise broadcasts follow the routing of axpy
+template <Real S>
+int broadcastOp(const Matrix<AUTO, S>& A, const broadcast::Op op,
+                const broadcast::Axis axis, const S* v, const ptrdiff_t incv,
+                Matrix<AUTO, S>* C) {
+    return forward<S>(dispatch::AXPY, numel(A), [&]<BLAS T>(Backend<T>) {
+        auto c = as<T, S>(*C);
+        return as<T, S>(A).__broadcast(op, axis, v, incv, &c);
+    });
+}
+
+template <Real S>
+int copy(Matrix<AUTO, S>* A, const S* B, const ptrdiff_t incb,
+         const ptrdiff_t ldb) {
+    return forward<S>(dispatch::COPY, numel(*A), [&]<BLAS T>(Backend<T>) {
+        return as<T, S>(*A).__copy(B, incb, ldb);
+    });
+}
+
+template <Real S>
+int daxpy(Matrix<AUTO, S>* A, const double alpha, const S* B,
+          const ptrdiff_t incb, const ptrdiff_t ldb) {
+    return forward<S>(dispatch::AXPY, numel(*A), [&]<BLAS T>(Backend<T>) {
+        return as<T, S>(*A).__daxpy(alpha, B, incb, ldb);
+    });
+}
+
+template <Real S>
+int dger(Matrix<AUTO, S>* A, const double alpha, const Matrix<AUTO, S>& x,
+         const Matrix<AUTO, S>& y) {
+    const double size = std::sqrt(double(numel(*A)));
+    return forward<S>(dispatch::GER, size, [&]<BLAS T>(Backend<T>) {
+        return as<T, S>(*A).__dger(alpha, as<T, S>(x), as<T, S>(y));
+    });
+}
+
+template <Real S>
+int dot(const Matrix<AUTO, S>& A, const Matrix<AUTO, S>& B, double* d) {
+    return forward<S>(dispatch::DOT, numel(A), [&]<BLAS T>(Backend<T>) {
+        return as<T, S>(A).__dot(as<T, S>(B), d);
+    });
+}
+
+template <Real S>
+int iamax(const Matrix<AUTO, S>& A, ptrdiff_t* i) {
+    return forward<S>(dispatch::DOT, numel(A), [&]<BLAS T>(Backend<T>) {
+        return as<T, S>(A).__iamax(i);
+    });
+}
+
+template <Real S>
+int mult(const Matrix<AUTO, S>& A, const bool transA, const bool transB,
+         const double alpha, const Matrix<AUTO, S>& B, const double beta,
+         Matrix<AUTO, S>* C, const gemm::Epilogue& epilogue) {
+    const double k = transA ? A.rows() : A.cols();
+    const double size = std::cbrt(k * C->rows() * C->cols());
+    return forward<S>(dispatch::GEMM, size, [&]<BLAS T>(Backend<T>) {
+        auto c = as<T, S>(*C);
+        return as<T, S>(A).__mult(transA, transB, alpha, as<T, S>(B),
+                                  beta, &c, epilogue);
+    });
+}
+
+template <Real S>
+int scale(Matrix<AUTO, S>* A, const double alpha) {
+    return forward<S>(dispatch::SCALE, numel(*A), [&]<BLAS T>(Backend<T>) {
+        return as<T, S>(*A).__mult(alpha);
+    });
+}
+
+template <Real S>
+int gemv(const Matrix<AUTO, S>& A, const bool trans, const double alpha,
+         const S* x, const ptrdiff_t incx, const double beta, S* y,
+         const ptrdiff_t incy) {
+    const double size = std::sqrt(double(numel(A)));
+    return forward<S>(dispatch::GEMV, size, [&]<BLAS T>(Backend<T>) {
+        return as<T, S>(A).__gemv(trans, alpha, x, incx, beta, y, incy);
+    });
+}
+
+template <Real S>
+int norm(const Matrix<AUTO, S>& A, double* n) {
+    return forward<S>(dispatch::DOT, numel(A), [&]<BLAS T>(Backend<T>) {
+        return as<T, S>(A).__norm(n);
+    });
+}
+
+}  // namespace
+
+template<> int Matrix<AUTO>::__asum(double* s) const {
+    return asum(*this, s);
+}
+
+template<> int Matrix<AUTO>::__broadcast(const broadcast::Op op,
+        const broadcast::Axis axis,
+        const double* v,
+        const ptrdiff_t incv,
+        Matrix<AUTO>* C) const {
+    return broadcastOp(*this, op, axis, v, incv, C);
+}
+
+template<> int Matrix<AUTO>::__copy(const double* A,
+                                    const ptrdiff_t inca,
+                                    const ptrdiff_t lda) {
+    return copy(this, A, inca, lda);
+}
+
+template<> int Matrix<AUTO>::__daxpy(const double alpha,
+                                     const double* B,
+                                     const ptrdiff_t incb,
+                                     const ptrdiff_t ldb) {
+    return daxpy(this, alpha, B, incb, ldb);
+}
+
+template<> int Matrix<AUTO>::__dger(const double alpha,
+                                    const Matrix<AUTO>& x,
+                                    const Matrix<AUTO>& y) {
+    return dger(this, alpha, x, y);
+}
+
+template<> int Matrix<AUTO>::__dot(const Matrix<AUTO>& B, double* d) const {
+    return dot(*this, B, d);
+}
+
+template<> int Matrix<AUTO>::__iamax(ptrdiff_t* i) const {
+    return iamax(*this, i);
+}
+
+template<> int Matrix<AUTO>::__mult(const bool transA,
+                                    const bool transB,
+                                    const double alpha,
+                                    const Matrix<AUTO>& B,
+                                    const double beta,
+                                    Matrix<AUTO>* C,
+                                    const gemm::Epilogue& epilogue) const {
+    return mult(*this, transA, transB, alpha, B, beta, C, epilogue);
+}
+
+template<> int Matrix<AUTO>::__gemv(const bool trans,
+                                    const double alpha,
+                                    const double* x,
+                                    const ptrdiff_t incx,
+                                    const double beta,
+                                    double* y,
+                                    const ptrdiff_t incy) const {
+    return gemv(*this, trans, alpha, x, incx, beta, y, incy);
+}
+
+template<> int Matrix<AUTO>::__mult(const double alpha) {
+    return scale(this, alpha);
+}
+
+template<> int Matrix<AUTO>::__norm(double* n) const {
+    return norm(*this, n);
+}
+
+template<> int Matrix<AUTO, float>::__asum(double* s) const {
+    return asum(*this, s);
+}
+
+template<> int Matrix<AUTO, float>::__broadcast(const broadcast::Op op,
+        const broadcast::Axis axis,
+        const float* v,
+        const ptrdiff_t incv,
+        Matrix<AUTO, float>* C) const {
+    return broadcastOp(*this, op, axis, v, incv, C);
+}
+
+template<> int Matrix<AUTO, float>::__copy(const float* A,
+                                           const ptrdiff_t inca,
+                                           const ptrdiff_t lda) {
+    return copy(this, A, inca, lda);
+}
+
+template<> int Matrix<AUTO, float>::__daxpy(const double alpha,
+                                            const float* B,
+                                            const ptrdiff_t incb,
+                                            const ptrdiff_t ldb) {
+    return daxpy(this, alpha, B, incb, ldb);
+}
+
+template<> int Matrix<AUTO, float>::__dger(const double alpha,
+                                           const Matrix<AUTO, float>& x,
+                                           const Matrix<AUTO, float>& y) {
+    return dger(this, alpha, x, y);
+}
+
+template<> int Matrix<AUTO, float>::__dot(const Matrix<AUTO, float>& B,
+                                          double* d) const {
+    return dot(*this, B, d);
+}
+
+template<> int Matrix<AUTO, float>::__iamax(ptrdiff_t* i) const {
+    return iamax(*this, i);
+}
+
+template<> int Matrix<AUTO, float>::__mult(const bool transA,
+        const bool transB,
+        const double alpha,
+        const Matrix<AUTO, float>& B,
+        const double beta,
+        Matrix<AUTO, float>* C,
+        const gemm::Epilogue& epilogue) const {
+    return mult(*this, transA, transB, alpha, B, beta, C, epilogue);
+}
+
+template<> int Matrix<AUTO, float>::__gemv(const bool trans,
+                                           const double alpha,
+                                           const float* x,
+                                           const ptrdiff_t incx,
+                                           const double beta,
+                                           float* y,
+                                           const ptrdiff_t incy) const {
+    return gemv(*this, trans, alpha, x, incx, beta, y, incy);
+}
+
+template<> int Matrix<AUTO, float>::__mult(const double alpha) {
+    return scale(this, alpha);
+}
+
+template<> int Matrix<AUTO, float>::__norm(double* n) const {
+    return norm(*this, n);
+}
@@ -0,0 +1,191 @@
+// Copyright 2023 Caleb Magruder
+
+#include "MatrixFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace matrixfile {
+
+namespace {
+
+constexpr char MAGIC[8] = {'\x89', 'M', 'A', 'T', 'R', 'I', 'X', '\n'};
+constexpr uint64_t PRIME = 0x9E3779B185EBCA87ull;
+
+uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+}  // namespace
+
+Header Header::make(int64_t rows, int64_t cols, uint64_t checksum,
+                    DType dtype, uint32_t alignment) {
+    if (alignment < ALIGN || (alignment & (alignment - 1))) throw(1);
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.dtype = dtype;
+    h.layout = ROW_MAJOR;
+    h.alignment = alignment;
+    h.rows = rows;
+    h.cols = cols;
+    h.offset = (sizeof(Header) + alignment - 1) / alignment * alignment;
+    h.checksum = checksum;
+    return h;
+}
+
+bool Header::recognized() const {
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool Header::valid() const {
+    uint64_t bytes;  // Rejects shapes whose size overflows
+    return recognized() && version == VERSION && itemsize(dtype) != 0
+        && layout == ROW_MAJOR && alignment >= ALIGN
+        && (alignment & (alignment - 1)) == 0 && offset >= sizeof(Header)
+        && offset % alignment == 0 && rows >= 0 && cols >= 0
+        && !__builtin_mul_overflow(uint64_t(rows), uint64_t(cols), &bytes)
+        && !__builtin_mul_overflow(bytes, uint64_t(itemsize(dtype)), &bytes);
+}
+
+uint64_t Header::bytes() const {
+    return uint64_t(rows) * uint64_t(cols) * itemsize(dtype);
+}
+
+void Checksum::word(uint64_t w) {
+    uint64_t& lane = _lanes[_words++ & 3];
+    lane = rotl(lane + w * PRIME, 31) * PRIME;
+}
+
+void Checksum::update(const void* data, size_t bytes) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    _bytes += bytes;
+    // Complete a word left over from the previous call
+    if (_pending) {
+        const size_t n = std::min(sizeof(_tail) - _pending, bytes);
+        std::memcpy(_tail + _pending, p, n);
+        _pending += n;
+        p += n;
+        bytes -= n;
+        if (_pending < sizeof(_tail)) return;
+        uint64_t w;
+        std::memcpy(&w, _tail, 8);
+        word(w);
+        _pending = 0;
+    }
+    // Whole words, four at a time so the lanes run independently
+    while (bytes >= 32 && (_words & 3) == 0) {
+        uint64_t w[4];
+        std::memcpy(w, p, 32);
+        for (int l = 0; l < 4; l++) {
+            _lanes[l] = rotl(_lanes[l] + w[l] * PRIME, 31) * PRIME;
+        }
+        _words += 4;
+        p += 32;
+        bytes -= 32;
+    }
+    while (bytes >= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        word(w);
+        p += 8;
+        bytes -= 8;
+    }
+    std::memcpy(_tail, p, bytes);
+    _pending = bytes;
+}
+
+uint64_t Checksum::digest() const {
+    uint64_t lanes[4] = {_lanes[0], _lanes[1], _lanes[2], _lanes[3]};
+    if (_pending) {
+        // Zero-padded trailing word
+        uint64_t w = 0;
+        std::memcpy(&w, _tail, _pending);
+        uint64_t& lane = lanes[_words & 3];
+        lane = rotl(lane + w * PRIME, 31) * PRIME;
+    }
+    uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7)
+               + rotl(lanes[2], 12) + rotl(lanes[3], 18) + _bytes;
+    h ^= h >> 33;
+    h *= PRIME;
+    h ^= h >> 29;
+    return h;
+}
+
+uint64_t checksum(const void* data, size_t bytes) {
+    Checksum c;
+    c.update(data, bytes);
+    return c.digest();
+}
+
+}  // namespace matrixfile
+
+MappedFile::MappedFile(const char* path, Mode mode, Advice advice,
+                       bool verify) : _mode(mode) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) throw(1);
+    struct stat st;
+    if (fstat(fd, &st) != 0
+        || size_t(st.st_size) < sizeof(matrixfile::Header)) {
+        ::close(fd);
+        throw(1);
+    }
+    _size = st.st_size;
+    // Private read/write pages are copied on first write
+    _base = mmap(nullptr, _size,
+                 mode == READ_ONLY ? PROT_READ : PROT_READ | PROT_WRITE,
+                 mode == READ_ONLY ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping keeps the file open
+    if (_base == MAP_FAILED) {
+        _base = nullptr;
+        throw(1);
+    }
+    const matrixfile::Header& h = header();
+    // Compared without overflow on a hostile offset or shape
+    if (!h.valid() || h.offset > _size || h.bytes() > _size - h.offset
+        || (verify && matrixfile::checksum(raw(), h.bytes()) != h.checksum)) {
+        munmap(_base, _size);
+        _base = nullptr;
+        throw(1);
+    }
+    advise(advice);
+}
+
+MappedFile::MappedFile(MappedFile&& F)
+    : _base(F._base), _size(F._size), _mode(F._mode) {
+    F._base = nullptr;
+    F._size = 0;
+}
+
+MappedFile::~MappedFile() {
+    if (_base) munmap(_base, _size);
+}
+
+void MappedFile::advise(Advice advice) {
+    int flag;
+    switch (advice) {
+        case SEQUENTIAL: flag = MADV_SEQUENTIAL; break;
+        case RANDOM:     flag = MADV_RANDOM;     break;
+        case WILLNEED:   flag = MADV_WILLNEED;   break;
+#ifdef MADV_HUGEPAGE
+        case HUGEPAGE:   flag = MADV_HUGEPAGE;   break;
+#endif
+        default:         flag = MADV_NORMAL;     break;
+    }
+    // Hints are best effort, failures are ignored
+    madvise(_base, _size, flag);
+}
+
+const matrixfile::Header& MappedFile::header() const {
+    return *static_cast<const matrixfile::Header*>(_base);
+}
+
+void* MappedFile::raw() const {
+    return static_cast<char*>(_base) + header().offset;
+}
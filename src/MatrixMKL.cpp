@@ -2,38 +2,82 @@
 
 #include <mkl.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
 
 #include "Matrix.h"
+#include "Sparse.h"
 
-template<> int Matrix<MKL>::__alloc() {
-    if (_m*_n > 0) {
-        void* ptr = mkl_malloc( _m*_n*sizeof( double ), 64);
-        _data = reinterpret_cast<double *>(ptr);
+template<> int Matrix<MKL>::__asum(double* s) const {
+    const Runs r(_m, _n, contiguous());
+    *s = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *s += cblas_dasum(r.len, _data + i*_ld, 1);
     }
-    return 0;  // Successful Allocation
+    return 0;
 }
 
-template<> int Matrix<MKL>::__copy(double* A, const ptrdiff_t inca) {
-    // _data = copy(B._data)
-    const MKL_INT incx(inca), incy(1);
-    cblas_dcopy(_m * _n,  // n
-                A,        // x
-                incx,     // incx
-                _data,    // y
-                incy);    // incy
+template<> int Matrix<MKL>::__broadcast(const broadcast::Op op,
+        const broadcast::Axis axis,
+        const double* v,
+        const ptrdiff_t incv,
+        Matrix<MKL>* C) const {
+    const double* a = _data;
+    double* c = C->_data;
+    const ptrdiff_t n = _n, lda = _ld, ldc = C->_ld;
+    if (axis == broadcast::ROW) {
+        // VML has no vector-scalar forms, v[i] runs on the REF kernel
+        parallel_rows(_m, _n, false, ThreadPool::grain(),
+            [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+                broadcast::scalar(op, j1 - j0, a + i*lda + j0, v[i*incv],
+                                  c + i*ldc + j0);
+            });
+        return 0;
+    }
+    for (ptrdiff_t i = 0; i < _m; i++) {
+        switch (op) {
+            case broadcast::ADD: vdAdd(n, a + i*lda, v, c + i*ldc); break;
+            case broadcast::SUB: vdSub(n, a + i*lda, v, c + i*ldc); break;
+            case broadcast::MUL: vdMul(n, a + i*lda, v, c + i*ldc); break;
+            case broadcast::DIV: vdDiv(n, a + i*lda, v, c + i*ldc); break;
+        }
+    }
+    return 0;
+}
+
+template<> int Matrix<MKL>::__copy(const double* A,
+                                   const ptrdiff_t inca,
+                                   const ptrdiff_t lda) {
+    instrument::copied(MKL, _m * _n * sizeof(double));
+    // _data = copy(A._data), one call per row if either is strided
+    const Runs r(_m, _n, contiguous() && lda == _n * inca);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_dcopy(r.len,           // n
+                    A + i*lda,       // x
+                    inca,            // incx
+                    _data + i*_ld,   // y
+                    1);              // incy
+    }
     return 0;  // Successful Copy
 }
 
 template<> int Matrix<MKL>::__daxpy(const double alpha,
                                     const double* B,
-                                    const ptrdiff_t incb) {
-    cblas_daxpy(_m * _n,  // N
-                alpha,    // alpha
-                B,  // X
-                incb,     // incX
-                _data,    // Y);
-                1);       // incY
+                                    const ptrdiff_t incb,
+                                    const ptrdiff_t ldb) {
+    const Runs r(_m, _n, contiguous() && ldb == _n * incb);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_daxpy(r.len,           // N
+                    alpha,           // alpha
+                    B + i*ldb,       // X
+                    incb,            // incX
+                    _data + i*_ld,   // Y
+                    1);              // incY
+    }
     return 0;
 }
 
@@ -45,29 +89,44 @@ template<> int Matrix<MKL>::__dger(const double alpha,
                this->_n,       // n
                alpha,          // alpha
                x._data,        // x
-               1,              // incx
+               x.inc(),        // incx
                y._data,        // y
-               1,              // incy
+               y.inc(),        // incy
                _data,          // a
-               this->_n);      // lda
+               this->_ld);     // lda
     return 0;
 }
 
-template<> int Matrix<MKL>::__dealloc() {
-    if (_data != nullptr) {
-        mkl_free(_data);
+template<> int Matrix<MKL>::__dot(const Matrix<MKL>& B, double* d) const {
+    const Runs r(_m, _n, contiguous() && B.contiguous());
+    *d = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *d += cblas_ddot(r.len, _data + i*_ld, 1, B._data + i*B._ld, 1);
     }
-    return 0;  // Successful Deallocation
+    return 0;
 }
 
-template<> int Matrix<MKL>::__dot(const Matrix<MKL>& B, double* d) const {
-    *d = cblas_ddot(this->rows() * this->cols(), this->_data, 1, B._data, 1);
+template<> int Matrix<MKL>::__iamax(ptrdiff_t* index) const {
+    // The first largest of the per-row maxima of a strided view
+    const Runs r(_m, _n, contiguous());
+    double amax = -1;
+    *index = 0;
+    for (ptrdiff_t i = 0; i < r.count && r.len > 0; i++) {
+        const ptrdiff_t j = cblas_idamax(r.len, _data + i*_ld, 1);
+        if (std::fabs(_data[i*_ld + j]) > amax) {
+            amax = std::fabs(_data[i*_ld + j]);
+            *index = i*_n + j;
+        }
+    }
     return 0;
 }
 
 template<> int Matrix<MKL>::__hprod(const Matrix<MKL>& B,
                                     Matrix<MKL>* C) const {
-    vdMul(this->rows() * this->cols(), *this, B, *C);
+    const Runs r(_m, _n, contiguous() && B.contiguous() && C->contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vdMul(r.len, _data + i*_ld, B._data + i*B._ld, C->_data + i*C->_ld);
+    }
     return 0;
 }
 
@@ -75,48 +134,554 @@ template<> int Matrix<MKL>::__mult(const bool transA,
         const bool transB,
         const double alpha,
         const Matrix<MKL>& B,
-        Matrix<MKL>* C) const {
-    cblas_dgemm(CblasRowMajor,                       // Layout
-                transA ? CblasTrans : CblasNoTrans,  // transa
-                transB ? CblasTrans : CblasNoTrans,  // transb
-                _m,                                  // m
-                B._n,                                // n
-                _n,                                  // k
-                alpha,                               // alpha
-                _data,                               // a
-                _n,                                  // lda
-                B._data,                             // b
-                B._n,                                // ldb
-                0,                                   // beta
-                C->_data,                            // c
-                C->_n);                              // ldc
+        const double beta,
+        Matrix<MKL>* C,
+        const gemm::Epilogue& epilogue) const {
+    cblas_dgemm(CblasRowMajor,                   // Layout
+            transA ? CblasTrans : CblasNoTrans,  // transa
+            transB ? CblasTrans : CblasNoTrans,  // transb
+            C->_m,                               // m
+            transB ? B._m : B._n,                // n
+            transB ? B._n : B._m,                // k
+            alpha,                               // alpha
+            _data,                               // a
+            _ld,                                 // lda
+            B._data,                             // b
+            B._ld,                               // ldb
+            beta,                                // beta
+            C->_data,                            // c
+            C->_ld);                             // ldc
+    // Bias and activation as one pass over C
+    gemm::epilogue(epilogue, C->_m, C->_n, C->_data, C->_ld);
+    return 0;
+}
+
+template<> int Matrix<MKL>::__multBatched(const bool transA,
+        const bool transB,
+        const double alpha,
+        const Matrix<MKL>* A,
+        const Matrix<MKL>* B,
+        Matrix<MKL>* C,
+        const ptrdiff_t count) {
+    // One group of equally-shaped products, so every matrix of an operand
+    // must share its leading dimension
+    for (ptrdiff_t b = 1; b < count; b++) {
+        if (A[b]._ld != A->_ld || B[b]._ld != B->_ld || C[b]._ld != C->_ld) {
+            for (ptrdiff_t c = 0; c < count; c++) {
+                A[c].__mult(transA, transB, alpha, B[c], 0, &C[c],
+                            gemm::Epilogue());
+            }
+            return 0;
+        }
+    }
+    std::vector<const double*> a(count), b(count);
+    std::vector<double*> c(count);
+    for (ptrdiff_t i = 0; i < count; i++) {
+        a[i] = A[i]._data;
+        b[i] = B[i]._data;
+        c[i] = C[i]._data;
+    }
+    const CBLAS_TRANSPOSE ta = transA ? CblasTrans : CblasNoTrans;
+    const CBLAS_TRANSPOSE tb = transB ? CblasTrans : CblasNoTrans;
+    const MKL_INT m(C->_m);
+    const MKL_INT n(transB ? B->_m : B->_n), k(transB ? B->_n : B->_m);
+    const MKL_INT lda(A->_ld), ldb(B->_ld), ldc(C->_ld), size(count);
+    const double beta = 0;
+    cblas_dgemm_batch(CblasRowMajor,  // Layout
+                      &ta,            // transa_array
+                      &tb,            // transb_array
+                      &m,             // m_array
+                      &n,             // n_array
+                      &k,             // k_array
+                      &alpha,         // alpha_array
+                      a.data(),       // a_array
+                      &lda,           // lda_array
+                      b.data(),       // b_array
+                      &ldb,           // ldb_array
+                      &beta,          // beta_array
+                      c.data(),       // c_array
+                      &ldc,           // ldc_array
+                      1,              // group_count
+                      &size);         // group_size
+    return 0;
+}
+
+template<> int Matrix<MKL>::__gemv(const bool trans,
+        const double alpha,
+        const double* x,
+        const ptrdiff_t incx,
+        const double beta,
+        double* y,
+        const ptrdiff_t incy) const {
+    cblas_dgemv(CblasRowMajor,                      // Layout
+                trans ? CblasTrans : CblasNoTrans,  // trans
+                _m,                                 // m
+                _n,                                 // n
+                alpha,                              // alpha
+                _data,                              // a
+                _ld,                                // lda
+                x,                                  // x
+                incx,                               // incx
+                beta,                               // beta
+                y,                                  // y
+                incy);                              // incy
     return 0;
 }
 
 template<> int Matrix<MKL>::__mult(const double alpha) {
-    const MKL_INT n(_m*_n), incx(1);
-    cblas_dscal(n,      // n
-                alpha,  // alpha
-                _data,  // data
-                incx);  // incx
+    const Runs r(_m, _n, contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_dscal(r.len,          // n
+                    alpha,          // alpha
+                    _data + i*_ld,  // data
+                    1);             // incx
+    }
     return 0;  // Successful Multiply
 }
 
 template<> int Matrix<MKL>::__norm(double* n) const {
-    *n = cblas_dnrm2(this->rows() * this->cols(), this->_data, 1);
+    const Runs r(_m, _n, contiguous());
+    if (r.count == 1) {
+        *n = cblas_dnrm2(r.len, _data, 1);
+        return 0;
+    }
+    // Combine per-row norms of a strided view, without squaring them
+    *n = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *n = std::hypot(*n, cblas_dnrm2(r.len, _data + i*_ld, 1));
+    }
     return 0;
 }
 
 template<> int Matrix<MKL>::__sub(const Matrix<MKL>& B, Matrix<MKL>* C) const {
-    // A -= B
-    vdSub(_m*_n,      // n
-          _data,      // a
-          B._data,    // b
-          C->_data);  // y
+    // C = A - B
+    const Runs r(_m, _n, contiguous() && B.contiguous() && C->contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vdSub(r.len,                 // n
+              _data + i*_ld,         // a
+              B._data + i*B._ld,     // b
+              C->_data + i*C->_ld);  // y
+    }
+    return 0;  // Successful Subtraction
+}
+
+template<> int Matrix<MKL>::__tanh(const vmath::Accuracy mode) {
+    const MKL_INT64 vml = mode == vmath::HIGH ? VML_HA
+                        : mode == vmath::LOW ? VML_LA : VML_EP;
+    const Runs r(_m, _n, contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vmdTanh(r.len, _data + i*_ld, _data + i*_ld, vml);
+    }
+    return 0;
+}
+
+template<> int Matrix<MKL>::__threads(const int n) {
+    mkl_set_num_threads(n);
+    return 0;
+}
+
+// Single precision: the s-prefixed routines, with results reduced in double
+
+template<> int Matrix<MKL, float>::__asum(double* s) const {
+    const Runs r(_m, _n, contiguous());
+    *s = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *s += cblas_sasum(r.len, _data + i*_ld, 1);
+    }
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__broadcast(const broadcast::Op op,
+        const broadcast::Axis axis,
+        const float* v,
+        const ptrdiff_t incv,
+        Matrix<MKL, float>* C) const {
+    const float* a = _data;
+    float* c = C->_data;
+    const ptrdiff_t n = _n, lda = _ld, ldc = C->_ld;
+    if (axis == broadcast::ROW) {
+        // VML has no vector-scalar forms, v[i] runs on the REF kernel
+        parallel_rows(_m, _n, false, ThreadPool::grain(),
+            [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+                broadcast::scalar(op, j1 - j0, a + i*lda + j0, v[i*incv],
+                                  c + i*ldc + j0);
+            });
+        return 0;
+    }
+    for (ptrdiff_t i = 0; i < _m; i++) {
+        switch (op) {
+            case broadcast::ADD: vsAdd(n, a + i*lda, v, c + i*ldc); break;
+            case broadcast::SUB: vsSub(n, a + i*lda, v, c + i*ldc); break;
+            case broadcast::MUL: vsMul(n, a + i*lda, v, c + i*ldc); break;
+            case broadcast::DIV: vsDiv(n, a + i*lda, v, c + i*ldc); break;
+        }
+    }
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__copy(const float* A,
+                                          const ptrdiff_t inca,
+                                          const ptrdiff_t lda) {
+    instrument::copied(MKL, _m * _n * sizeof(float));
+    const Runs r(_m, _n, contiguous() && lda == _n * inca);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_scopy(r.len, A + i*lda, inca, _data + i*_ld, 1);
+    }
+    return 0;  // Successful Copy
+}
+
+template<> int Matrix<MKL, float>::__daxpy(const double alpha,
+                                           const float* B,
+                                           const ptrdiff_t incb,
+                                           const ptrdiff_t ldb) {
+    const Runs r(_m, _n, contiguous() && ldb == _n * incb);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_saxpy(r.len, alpha, B + i*ldb, incb, _data + i*_ld, 1);
+    }
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__dger(const double alpha,
+                                          const Matrix<MKL, float>& x,
+                                          const Matrix<MKL, float>& y) {
+    cblas_sger(CblasRowMajor, _m, _n, alpha, x._data, x.inc(),
+               y._data, y.inc(), _data, _ld);
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__dot(const Matrix<MKL, float>& B,
+                                         double* d) const {
+    const Runs r(_m, _n, contiguous() && B.contiguous());
+    *d = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *d += cblas_dsdot(r.len, _data + i*_ld, 1, B._data + i*B._ld, 1);
+    }
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__hprod(const Matrix<MKL, float>& B,
+                                           Matrix<MKL, float>* C) const {
+    const Runs r(_m, _n, contiguous() && B.contiguous() && C->contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vsMul(r.len, _data + i*_ld, B._data + i*B._ld, C->_data + i*C->_ld);
+    }
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__iamax(ptrdiff_t* index) const {
+    const Runs r(_m, _n, contiguous());
+    double amax = -1;
+    *index = 0;
+    for (ptrdiff_t i = 0; i < r.count && r.len > 0; i++) {
+        const ptrdiff_t j = cblas_isamax(r.len, _data + i*_ld, 1);
+        if (std::fabs(_data[i*_ld + j]) > amax) {
+            amax = std::fabs(_data[i*_ld + j]);
+            *index = i*_n + j;
+        }
+    }
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__mult(const bool transA,
+        const bool transB,
+        const double alpha,
+        const Matrix<MKL, float>& B,
+        const double beta,
+        Matrix<MKL, float>* C,
+        const gemm::Epilogue& epilogue) const {
+    cblas_sgemm(CblasRowMajor,
+            transA ? CblasTrans : CblasNoTrans,
+            transB ? CblasTrans : CblasNoTrans,
+            C->_m,
+            transB ? B._m : B._n,
+            transB ? B._n : B._m,
+            alpha,
+            _data,
+            _ld,
+            B._data,
+            B._ld,
+            beta,
+            C->_data,
+            C->_ld);
+    gemm::epilogue(epilogue, C->_m, C->_n, C->_data, C->_ld);
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__multBatched(const bool transA,
+        const bool transB,
+        const double alpha,
+        const Matrix<MKL, float>* A,
+        const Matrix<MKL, float>* B,
+        Matrix<MKL, float>* C,
+        const ptrdiff_t count) {
+    for (ptrdiff_t b = 1; b < count; b++) {
+        if (A[b]._ld != A->_ld || B[b]._ld != B->_ld || C[b]._ld != C->_ld) {
+            for (ptrdiff_t c = 0; c < count; c++) {
+                A[c].__mult(transA, transB, alpha, B[c], 0, &C[c],
+                            gemm::Epilogue());
+            }
+            return 0;
+        }
+    }
+    std::vector<const float*> a(count), b(count);
+    std::vector<float*> c(count);
+    for (ptrdiff_t i = 0; i < count; i++) {
+        a[i] = A[i]._data;
+        b[i] = B[i]._data;
+        c[i] = C[i]._data;
+    }
+    const CBLAS_TRANSPOSE ta = transA ? CblasTrans : CblasNoTrans;
+    const CBLAS_TRANSPOSE tb = transB ? CblasTrans : CblasNoTrans;
+    const MKL_INT m(C->_m);
+    const MKL_INT n(transB ? B->_m : B->_n), k(transB ? B->_n : B->_m);
+    const MKL_INT lda(A->_ld), ldb(B->_ld), ldc(C->_ld), size(count);
+    const float salpha = alpha, beta = 0;
+    cblas_sgemm_batch(CblasRowMajor, &ta, &tb, &m, &n, &k, &salpha,
+                      a.data(), &lda, b.data(), &ldb, &beta, c.data(), &ldc,
+                      1, &size);
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__gemv(const bool trans,
+        const double alpha,
+        const float* x,
+        const ptrdiff_t incx,
+        const double beta,
+        float* y,
+        const ptrdiff_t incy) const {
+    cblas_sgemv(CblasRowMajor, trans ? CblasTrans : CblasNoTrans, _m, _n,
+                alpha, _data, _ld, x, incx, beta, y, incy);
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__mult(const double alpha) {
+    const Runs r(_m, _n, contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_sscal(r.len, alpha, _data + i*_ld, 1);
+    }
+    return 0;  // Successful Multiply
+}
+
+template<> int Matrix<MKL, float>::__norm(double* n) const {
+    const Runs r(_m, _n, contiguous());
+    double sum = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        const double ni = cblas_snrm2(r.len, _data + i*_ld, 1);
+        sum += ni * ni;
+    }
+    *n = std::sqrt(sum);
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__sub(const Matrix<MKL, float>& B,
+                                         Matrix<MKL, float>* C) const {
+    const Runs r(_m, _n, contiguous() && B.contiguous() && C->contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vsSub(r.len, _data + i*_ld, B._data + i*B._ld, C->_data + i*C->_ld);
+    }
     return 0;  // Successful Subtraction
 }
 
-template<> int Matrix<MKL>::__tanh() {
-    vmdTanh(this->rows() * this->cols(), *this, *this, VML_HA);
+template<> int Matrix<MKL, float>::__tanh(const vmath::Accuracy mode) {
+    const MKL_INT64 vml = mode == vmath::HIGH ? VML_HA
+                        : mode == vmath::LOW ? VML_LA : VML_EP;
+    const Runs r(_m, _n, contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        vmsTanh(r.len, _data + i*_ld, _data + i*_ld, vml);
+    }
+    return 0;
+}
+
+template<> int Matrix<MKL, float>::__threads(const int n) {
+    mkl_set_num_threads(n);
+    return 0;
+}
+
+// Random: normal fills through VSL's Philox4x32-10, keyed and counted
+// like rng::Generator so that seeds, streams and offsets carry over. The
+// Gaussian transform is VSL's, so values differ from the REF fill.
+
+namespace {
+
+// Elements per VSL stream. Each chunk starts at its own counter, so the
+// values do not depend on the thread count.
+constexpr ptrdiff_t RNG_CHUNK = ptrdiff_t(1) << 14;
+
+template <Real S>
+int vslNormal(rng::Generator* g, const ptrdiff_t n, S* x) {
+    constexpr ptrdiff_t K = rng::PER_COUNTER<S>;
+    const uint64_t c0 = g->reserve((n + K - 1) / K);
+    const uint64_t seed = g->seed(), id = g->stream();
+    const ptrdiff_t chunks = (n + RNG_CHUNK - 1) / RNG_CHUNK;
+    parallel_for(chunks, 1, [&](ptrdiff_t b0, ptrdiff_t b1) {
+        for (ptrdiff_t b = b0; b < b1; b++) {
+            const uint64_t c = c0 + b * (RNG_CHUNK / K);
+            // Key, then the 128-bit counter from its low word up
+            const unsigned int params[6] = {
+                static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+                static_cast<uint32_t>(c), static_cast<uint32_t>(c >> 32),
+                static_cast<uint32_t>(id), static_cast<uint32_t>(id >> 32)};
+            VSLStreamStatePtr stream;
+            vslNewStreamEx(&stream, VSL_BRNG_PHILOX4X32X10, 6, params);
+            const MKL_INT len = std::min(RNG_CHUNK, n - b * RNG_CHUNK);
+            if constexpr (std::is_same_v<S, double>) {
+                vdRngGaussian(VSL_RNG_METHOD_GAUSSIAN_BOXMULLER2, stream, len,
+                              x + b * RNG_CHUNK, 0.0, 1.0);
+            } else {
+                vsRngGaussian(VSL_RNG_METHOD_GAUSSIAN_BOXMULLER2, stream, len,
+                              x + b * RNG_CHUNK, 0.0f, 1.0f);
+            }
+            vslDeleteStream(&stream);
+        }
+    });
     return 0;
 }
+
+}  // namespace
+
+template<> int Matrix<MKL, double>::__randn(rng::Generator* g) {
+    return vslNormal(g, numel(*this), _data);
+}
+
+template<> int Matrix<MKL, float>::__randn(rng::Generator* g) {
+    return vslNormal(g, numel(*this), _data);
+}
+
+// Sparse: products through MKL's inspector-executor sparse BLAS
+
+namespace {
+
+// MKL handle over the compressed arrays of A, which must outlive it. The
+// indices are narrowed to MKL_INT unless ptrdiff_t already matches it.
+template <Real S>
+class SparseHandle {
+ public:
+    explicit SparseHandle(const Sparse<MKL, S>& A) {
+        const MKL_INT* ptr;
+        const MKL_INT* index;
+        if constexpr (sizeof(MKL_INT) == sizeof(ptrdiff_t)) {
+            ptr = reinterpret_cast<const MKL_INT*>(A.ptr());
+            index = reinterpret_cast<const MKL_INT*>(A.index());
+        } else {
+            _ptr.assign(A.ptr(), A.ptr() + A.outer() + 1);
+            _index.assign(A.index(), A.index() + A.nnz());
+            ptr = _ptr.data();
+            index = _index.data();
+        }
+        MKL_INT* p = const_cast<MKL_INT*>(ptr);
+        MKL_INT* i = const_cast<MKL_INT*>(index);
+        S* v = const_cast<S*>(A.values());
+        const bool csr = A.format() == sparse::CSR;
+        sparse_status_t status;
+        if constexpr (std::is_same_v<S, double>) {
+            status = csr
+                ? mkl_sparse_d_create_csr(&_handle, SPARSE_INDEX_BASE_ZERO,
+                      A.rows(), A.cols(), p, p + 1, i, v)
+                : mkl_sparse_d_create_csc(&_handle, SPARSE_INDEX_BASE_ZERO,
+                      A.rows(), A.cols(), p, p + 1, i, v);
+        } else {
+            status = csr
+                ? mkl_sparse_s_create_csr(&_handle, SPARSE_INDEX_BASE_ZERO,
+                      A.rows(), A.cols(), p, p + 1, i, v)
+                : mkl_sparse_s_create_csc(&_handle, SPARSE_INDEX_BASE_ZERO,
+                      A.rows(), A.cols(), p, p + 1, i, v);
+        }
+        if (status != SPARSE_STATUS_SUCCESS) throw(1);
+    }
+
+    ~SparseHandle() { mkl_sparse_destroy(_handle); }
+
+    SparseHandle(const SparseHandle&) = delete;
+    SparseHandle& operator=(const SparseHandle&) = delete;
+
+    // y = alpha * op(A) * x + beta * y
+    int mv(const bool trans, const S alpha, const S* x,
+           const S beta, S* y) const {
+        const sparse_operation_t op = trans ? SPARSE_OPERATION_TRANSPOSE
+                                            : SPARSE_OPERATION_NON_TRANSPOSE;
+        sparse_status_t status;
+        if constexpr (std::is_same_v<S, double>) {
+            status = mkl_sparse_d_mv(op, alpha, _handle, descr(), x, beta, y);
+        } else {
+            status = mkl_sparse_s_mv(op, alpha, _handle, descr(), x, beta, y);
+        }
+        return status != SPARSE_STATUS_SUCCESS;
+    }
+
+    // C = alpha * op(A) * B + beta * C, B has n columns in the layout
+    int mm(const bool trans, const sparse_layout_t layout, const S alpha,
+           const S* B, const ptrdiff_t n, const ptrdiff_t ldb,
+           const S beta, S* C, const ptrdiff_t ldc) const {
+        const sparse_operation_t op = trans ? SPARSE_OPERATION_TRANSPOSE
+                                            : SPARSE_OPERATION_NON_TRANSPOSE;
+        sparse_status_t status;
+        if constexpr (std::is_same_v<S, double>) {
+            status = mkl_sparse_d_mm(op, alpha, _handle, descr(), layout,
+                                     B, n, ldb, beta, C, ldc);
+        } else {
+            status = mkl_sparse_s_mm(op, alpha, _handle, descr(), layout,
+                                     B, n, ldb, beta, C, ldc);
+        }
+        return status != SPARSE_STATUS_SUCCESS;
+    }
+
+ private:
+    static matrix_descr descr() {
+        matrix_descr d;
+        d.type = SPARSE_MATRIX_TYPE_GENERAL;
+        return d;
+    }
+
+    std::vector<MKL_INT> _ptr, _index;
+    sparse_matrix_t _handle = nullptr;
+};
+
+// C = alpha * op(A) * B + beta * C, SpMV for contiguous vectors
+template <Real S>
+int sparseMult(const Sparse<MKL, S>& A, const bool transA, const double alpha,
+               const Matrix<MKL, S>& B, const double beta,
+               Matrix<MKL, S>* C) {
+    const SparseHandle<S> h(A);
+    if (B.cols() == 1 && B.ld() == 1 && C->ld() == 1) {
+        return h.mv(transA, alpha, B, beta, *C);
+    }
+    return h.mm(transA, SPARSE_LAYOUT_ROW_MAJOR, alpha, B, B.cols(), B.ld(),
+                beta, *C, C->ld());
+}
+
+// C = alpha * B * op(A) + beta * C as C^T = alpha * op(A)^T * B^T +
+// beta * C^T, where the row-major B and C are column-major B^T and C^T
+template <Real S>
+int sparseMultRight(const Sparse<MKL, S>& A, const bool transA,
+                    const double alpha, const Matrix<MKL, S>& B,
+                    const double beta, Matrix<MKL, S>* C) {
+    const SparseHandle<S> h(A);
+    return h.mm(!transA, SPARSE_LAYOUT_COLUMN_MAJOR, alpha, B, B.rows(),
+                B.ld(), beta, *C, C->ld());
+}
+
+}  // namespace
+
+template<> int Sparse<MKL, double>::__mult(const bool transA,
+        const double alpha, const Dense& B, const double beta,
+        Dense* C) const {
+    return sparseMult(*this, transA, alpha, B, beta, C);
+}
+
+template<> int Sparse<MKL, double>::__multRight(const bool transB,
+        const double alpha, const Dense& A, const double beta,
+        Dense* C) const {
+    return sparseMultRight(*this, transB, alpha, A, beta, C);
+}
+
+template<> int Sparse<MKL, float>::__mult(const bool transA,
+        const double alpha, const Dense& B, const double beta,
+        Dense* C) const {
+    return sparseMult(*this, transA, alpha, B, beta, C);
+}
+
+template<> int Sparse<MKL, float>::__multRight(const bool transB,
+        const double alpha, const Dense& A, const double beta,
+        Dense* C) const {
+    return sparseMultRight(*this, transB, alpha, A, beta, C);
+}
@@ -2,34 +2,48 @@
 
 #include <cblas.h>
 
+#include <cmath>
+
 #include "Matrix.h"
 
-template<> int Matrix<OPB>::__alloc() {
-    if (_m*_n > 0) {
-        _data = new double[_m*_n];
+template<> int Matrix<OPB>::__asum(double* s) const {
+    const Runs r(_m, _n, contiguous());
+    *s = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *s += cblas_dasum(r.len, _data + i*_ld, 1);
     }
-    return 0;  // Successful Allocation
+    return 0;
 }
 
-template<> int Matrix<OPB>::__copy(double* A, const ptrdiff_t inca) {
-    // _data = copy(A._data)
-    cblas_dcopy(_m * _n,  // n
-                A,        // x
-                inca,     // incx
-                _data,    // y
-                1);    // incy
+template<> int Matrix<OPB>::__copy(const double* A,
+                                   const ptrdiff_t inca,
+                                   const ptrdiff_t lda) {
+    instrument::copied(OPB, _m * _n * sizeof(double));
+    // _data = copy(A._data), one call per row if either is strided
+    const Runs r(_m, _n, contiguous() && lda == _n * inca);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_dcopy(r.len,           // n
+                    A + i*lda,       // x
+                    inca,            // incx
+                    _data + i*_ld,   // y
+                    1);              // incy
+    }
     return 0;  // Successful Copy
 }
 
 template<> int Matrix<OPB>::__daxpy(const double alpha,
                                     const double* B,
-                                    const ptrdiff_t incb) {
-    cblas_daxpy(_m * _n,  // N
-                alpha,    // alpha
-                B,  // X
-                incb,     // incX
-                _data,    // Y);
-                1);       // incY
+                                    const ptrdiff_t incb,
+                                    const ptrdiff_t ldb) {
+    const Runs r(_m, _n, contiguous() && ldb == _n * incb);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_daxpy(r.len,           // N
+                    alpha,           // alpha
+                    B + i*ldb,       // X
+                    incb,            // incX
+                    _data + i*_ld,   // Y
+                    1);              // incY
+    }
     return 0;
 }
 
@@ -41,24 +55,35 @@ template<> int Matrix<OPB>::__dger(const double alpha,
                this->_n,       // n
                alpha,          // alpha
                x._data,        // x
-               1,              // incx
+               x.inc(),        // incx
                y._data,        // y
-               1,              // incy
+               y.inc(),        // incy
                _data,          // a
-               this->_n);       // lda
+               this->_ld);     // lda
     return 0;
 }
 
-template<> int Matrix<OPB>::__dealloc() {
-    if (_data != nullptr) {
-        // mkl_free(_data);
-        delete _data;
+template<> int Matrix<OPB>::__dot(const Matrix<OPB>& B, double* d) const {
+    const Runs r(_m, _n, contiguous() && B.contiguous());
+    *d = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *d += cblas_ddot(r.len, _data + i*_ld, 1, B._data + i*B._ld, 1);
     }
-    return 0;  // Successful Deallocation
+    return 0;
 }
 
-template<> int Matrix<OPB>::__dot(const Matrix<OPB>& B, double* d) const {
-    *d = cblas_ddot(this->rows() * this->cols(), this->_data, 1, B._data, 1);
+template<> int Matrix<OPB>::__iamax(ptrdiff_t* index) const {
+    // The first largest of the per-row maxima of a strided view
+    const Runs r(_m, _n, contiguous());
+    double amax = -1;
+    *index = 0;
+    for (ptrdiff_t i = 0; i < r.count && r.len > 0; i++) {
+        const ptrdiff_t j = cblas_idamax(r.len, _data + i*_ld, 1);
+        if (std::fabs(_data[i*_ld + j]) > amax) {
+            amax = std::fabs(_data[i*_ld + j]);
+            *index = i*_n + j;
+        }
+    }
     return 0;
 }
 
@@ -71,7 +96,9 @@ template<> int Matrix<OPB>::__mult(const bool transA,
         const bool transB,
         const double alpha,
         const Matrix<OPB>& B,
-        Matrix<OPB>* C) const {
+        const double beta,
+        Matrix<OPB>* C,
+        const gemm::Epilogue& epilogue) const {
     cblas_dgemm(CblasRowMajor,                   // Layout
             transA ? CblasTrans : CblasNoTrans,  // transa
             transB ? CblasTrans : CblasNoTrans,  // transb
@@ -80,26 +107,61 @@ template<> int Matrix<OPB>::__mult(const bool transA,
             transB ? B._n : B._m,                // k
             alpha,                               // alpha
             _data,                               // a
-            _n,                                  // lda
+            _ld,                                 // lda
             B._data,                             // b
-            B._n,                                // ldb
-            0,                                   // beta
+            B._ld,                               // ldb
+            beta,                                // beta
             C->_data,                            // c
-            C->_n);                              // ldc
+            C->_ld);                             // ldc
+    // Bias and activation as one pass over C
+    gemm::epilogue(epilogue, C->_m, C->_n, C->_data, C->_ld);
+    return 0;
+}
+
+template<> int Matrix<OPB>::__gemv(const bool trans,
+        const double alpha,
+        const double* x,
+        const ptrdiff_t incx,
+        const double beta,
+        double* y,
+        const ptrdiff_t incy) const {
+    cblas_dgemv(CblasRowMajor,                      // Layout
+                trans ? CblasTrans : CblasNoTrans,  // trans
+                _m,                                 // m
+                _n,                                 // n
+                alpha,                              // alpha
+                _data,                              // a
+                _ld,                                // lda
+                x,                                  // x
+                incx,                               // incx
+                beta,                               // beta
+                y,                                  // y
+                incy);                              // incy
     return 0;
 }
 
 template<> int Matrix<OPB>::__mult(const double alpha) {
-    const int n(_m*_n), incx(1);
-    cblas_dscal(n,      // n
-                alpha,  // alpha
-                _data,  // data
-                incx);  // incx
+    const Runs r(_m, _n, contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_dscal(r.len,          // n
+                    alpha,          // alpha
+                    _data + i*_ld,  // data
+                    1);             // incx
+    }
     return 0;  // Successful Multiply
 }
 
 template<> int Matrix<OPB>::__norm(double* n) const {
-    *n = cblas_dnrm2(this->rows() * this->cols(), this->_data, 1);
+    const Runs r(_m, _n, contiguous());
+    if (r.count == 1) {
+        *n = cblas_dnrm2(r.len, _data, 1);
+        return 0;
+    }
+    // Combine per-row norms of a strided view, without squaring them
+    *n = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *n = std::hypot(*n, cblas_dnrm2(r.len, _data + i*_ld, 1));
+    }
     return 0;
 }
 
@@ -109,7 +171,139 @@ template<> int Matrix<OPB>::__norm(double* n) const {
     // return 0;  // Successful Subtraction
 // }
 
-// template<> int Matrix<OPB>::__tanh() {
+// template<> int Matrix<OPB>::__tanh(const vmath::Accuracy mode) {
     // Hyperbolic Tangent: *this = tanh(*this)
     // return 0;
 // }
+
+template<> int Matrix<OPB>::__threads(const int n) {
+    openblas_set_num_threads(n);
+    return 0;
+}
+
+// Single precision: the s-prefixed routines, with results reduced in double
+
+template<> int Matrix<OPB, float>::__asum(double* s) const {
+    const Runs r(_m, _n, contiguous());
+    *s = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *s += cblas_sasum(r.len, _data + i*_ld, 1);
+    }
+    return 0;
+}
+
+template<> int Matrix<OPB, float>::__copy(const float* A,
+                                          const ptrdiff_t inca,
+                                          const ptrdiff_t lda) {
+    instrument::copied(OPB, _m * _n * sizeof(float));
+    const Runs r(_m, _n, contiguous() && lda == _n * inca);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_scopy(r.len, A + i*lda, inca, _data + i*_ld, 1);
+    }
+    return 0;  // Successful Copy
+}
+
+template<> int Matrix<OPB, float>::__daxpy(const double alpha,
+                                           const float* B,
+                                           const ptrdiff_t incb,
+                                           const ptrdiff_t ldb) {
+    const Runs r(_m, _n, contiguous() && ldb == _n * incb);
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_saxpy(r.len, alpha, B + i*ldb, incb, _data + i*_ld, 1);
+    }
+    return 0;
+}
+
+template<> int Matrix<OPB, float>::__dger(const double alpha,
+                                          const Matrix<OPB, float>& x,
+                                          const Matrix<OPB, float>& y) {
+    cblas_sger(CblasRowMajor, _m, _n, alpha, x._data, x.inc(),
+               y._data, y.inc(), _data, _ld);
+    return 0;
+}
+
+template<> int Matrix<OPB, float>::__dot(const Matrix<OPB, float>& B,
+                                         double* d) const {
+    // Double accumulation across rows, as the double dot product
+    const Runs r(_m, _n, contiguous() && B.contiguous());
+    *d = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        *d += cblas_dsdot(r.len, _data + i*_ld, 1, B._data + i*B._ld, 1);
+    }
+    return 0;
+}
+
+template<> int Matrix<OPB, float>::__iamax(ptrdiff_t* index) const {
+    const Runs r(_m, _n, contiguous());
+    double amax = -1;
+    *index = 0;
+    for (ptrdiff_t i = 0; i < r.count && r.len > 0; i++) {
+        const ptrdiff_t j = cblas_isamax(r.len, _data + i*_ld, 1);
+        if (std::fabs(_data[i*_ld + j]) > amax) {
+            amax = std::fabs(_data[i*_ld + j]);
+            *index = i*_n + j;
+        }
+    }
+    return 0;
+}
+
+template<> int Matrix<OPB, float>::__mult(const bool transA,
+        const bool transB,
+        const double alpha,
+        const Matrix<OPB, float>& B,
+        const double beta,
+        Matrix<OPB, float>* C,
+        const gemm::Epilogue& epilogue) const {
+    cblas_sgemm(CblasRowMajor,
+            transA ? CblasTrans : CblasNoTrans,
+            transB ? CblasTrans : CblasNoTrans,
+            C->_m,
+            transB ? B._m : B._n,
+            transB ? B._n : B._m,
+            alpha,
+            _data,
+            _ld,
+            B._data,
+            B._ld,
+            beta,
+            C->_data,
+            C->_ld);
+    gemm::epilogue(epilogue, C->_m, C->_n, C->_data, C->_ld);
+    return 0;
+}
+
+template<> int Matrix<OPB, float>::__gemv(const bool trans,
+        const double alpha,
+        const float* x,
+        const ptrdiff_t incx,
+        const double beta,
+        float* y,
+        const ptrdiff_t incy) const {
+    cblas_sgemv(CblasRowMajor, trans ? CblasTrans : CblasNoTrans, _m, _n,
+                alpha, _data, _ld, x, incx, beta, y, incy);
+    return 0;
+}
+
+template<> int Matrix<OPB, float>::__mult(const double alpha) {
+    const Runs r(_m, _n, contiguous());
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        cblas_sscal(r.len, alpha, _data + i*_ld, 1);
+    }
+    return 0;  // Successful Multiply
+}
+
+template<> int Matrix<OPB, float>::__norm(double* n) const {
+    const Runs r(_m, _n, contiguous());
+    double sum = 0;
+    for (ptrdiff_t i = 0; i < r.count; i++) {
+        const double ni = cblas_snrm2(r.len, _data + i*_ld, 1);
+        sum += ni * ni;
+    }
+    *n = std::sqrt(sum);
+    return 0;
+}
+
+template<> int Matrix<OPB, float>::__threads(const int n) {
+    openblas_set_num_threads(n);
+    return 0;
+}
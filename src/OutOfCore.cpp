@@ -0,0 +1,190 @@
+// Copyright 2023 Caleb Magruder
+
+#include "OutOfCore.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// pread/pwrite until done, throw(1) on error or end of file
+void preadAll(int fd, void* dst, size_t bytes, off_t offset) {
+    char* p = static_cast<char*>(dst);
+    while (bytes > 0) {
+        const ssize_t r = pread(fd, p, bytes, offset);
+        if (r <= 0) throw(1);
+        p += r;
+        bytes -= r;
+        offset += r;
+    }
+}
+
+void pwriteAll(int fd, const void* src, size_t bytes, off_t offset) {
+    const char* p = static_cast<const char*>(src);
+    while (bytes > 0) {
+        const ssize_t r = pwrite(fd, p, bytes, offset);
+        if (r <= 0) throw(1);
+        p += r;
+        bytes -= r;
+        offset += r;
+    }
+}
+
+}  // namespace
+
+DiskMatrix::DiskMatrix(const char* path) {
+    _fd = ::open(path, O_RDONLY);
+    if (_fd < 0) throw(1);
+    try {
+        preadAll(_fd, &_header, sizeof(_header), 0);
+    } catch (...) {
+        ::close(_fd);
+        throw;
+    }
+    // Tiles are streamed as doubles
+    if (!_header.valid() || _header.dtype != matrixfile::FLOAT64) {
+        ::close(_fd);
+        throw(1);
+    }
+}
+
+DiskMatrix DiskMatrix::create(const char* path, ptrdiff_t rows,
+                              ptrdiff_t cols) {
+    if (rows < 0 || cols < 0) throw(1);
+    DiskMatrix D;
+    D._fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (D._fd < 0) throw(1);
+    D._header = matrixfile::Header::make(rows, cols, 0);
+    // Sparse, zero-filled data
+    if (ftruncate(D._fd, D._header.offset + D._header.bytes()) != 0) throw(1);
+    pwriteAll(D._fd, &D._header, sizeof(D._header), 0);
+    return D;
+}
+
+DiskMatrix::DiskMatrix(DiskMatrix&& D) : _fd(D._fd), _header(D._header) {
+    D._fd = -1;
+}
+
+DiskMatrix::~DiskMatrix() {
+    if (_fd >= 0) ::close(_fd);
+}
+
+void DiskMatrix::read(ptrdiff_t i, ptrdiff_t j, ptrdiff_t m, ptrdiff_t n,
+                      double* dst, ptrdiff_t ldd) const {
+    if (i < 0 || j < 0 || i + m > rows() || j + n > cols()) throw(1);
+    const off_t base = _header.offset + (i*cols() + j)*sizeof(double);
+    // Whole rows into a compact tile are a single read
+    if (n == cols() && ldd == n) {
+        preadAll(_fd, dst, m*n*sizeof(double), base);
+        return;
+    }
+    for (ptrdiff_t r = 0; r < m; r++) {
+        preadAll(_fd, dst + r*ldd, n*sizeof(double),
+                 base + r*cols()*sizeof(double));
+    }
+}
+
+void DiskMatrix::write(ptrdiff_t i, ptrdiff_t j, ptrdiff_t m, ptrdiff_t n,
+                       const double* src, ptrdiff_t lds) {
+    if (i < 0 || j < 0 || i + m > rows() || j + n > cols()) throw(1);
+    const off_t base = _header.offset + (i*cols() + j)*sizeof(double);
+    if (n == cols() && lds == n) {
+        pwriteAll(_fd, src, m*n*sizeof(double), base);
+        return;
+    }
+    for (ptrdiff_t r = 0; r < m; r++) {
+        pwriteAll(_fd, src + r*lds, n*sizeof(double),
+                  base + r*cols()*sizeof(double));
+    }
+}
+
+void DiskMatrix::seal() {
+    // One pass over the data in 1 MiB reads
+    std::vector<char> buffer(size_t(1) << 20);
+    matrixfile::Checksum c;
+    for (uint64_t done = 0; done < _header.bytes();) {
+        const size_t len = std::min<uint64_t>(buffer.size(),
+                                              _header.bytes() - done);
+        preadAll(_fd, buffer.data(), len, _header.offset + done);
+        c.update(buffer.data(), len);
+        done += len;
+    }
+    _header.checksum = c.digest();
+    pwriteAll(_fd, &_header, sizeof(_header), 0);
+}
+
+Prefetcher::Prefetcher(ptrdiff_t steps, size_t bufferSize, int depth,
+                       Load load)
+    : _steps(steps), _bufferSize(bufferSize), _load(std::move(load)),
+      _buffers(std::max(depth, 1)) {
+    for (double*& buffer : _buffers) {
+        buffer = static_cast<double*>(
+            AlignedAllocator<>::allocate(bufferSize * sizeof(double)));
+        if (buffer == nullptr) throw(1);
+    }
+    _thread = std::thread(&Prefetcher::run, this);
+}
+
+Prefetcher::~Prefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+    for (double* buffer : _buffers) {
+        AlignedAllocator<>::deallocate(buffer, _bufferSize * sizeof(double));
+    }
+}
+
+void Prefetcher::run() {
+    const ptrdiff_t depth = _buffers.size();
+    for (ptrdiff_t s = 0; s < _steps; s++) {
+        {
+            // Wait for the buffer of step s - depth to be released
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [&] { return _stop || s - _released < depth; });
+            if (_stop) return;
+        }
+        try {
+            _load(s, _buffers[s % depth]);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _error = std::current_exception();
+            _cv.notify_all();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _loaded = s + 1;
+        }
+        _cv.notify_all();
+    }
+}
+
+double* Prefetcher::acquire(ptrdiff_t step) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [&] { return _error || _loaded > step; });
+    if (_loaded <= step) std::rethrow_exception(_error);
+    return _buffers[step % _buffers.size()];
+}
+
+void Prefetcher::release(ptrdiff_t step) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _released = step + 1;
+    }
+    _cv.notify_all();
+}
+
+namespace outofcore {
+
+ptrdiff_t tile(size_t budget) {
+    const double b = std::sqrt(double(budget) / (6 * sizeof(double)));
+    return std::max<ptrdiff_t>(1, ptrdiff_t(b));
+}
+
+}  // namespace outofcore
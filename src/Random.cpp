@@ -0,0 +1,246 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "ThreadPool.h"
+#include "VMath.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RNG_X86
+#endif
+
+namespace rng {
+
+namespace {
+
+// Philox4x32 multipliers and Weyl key increments
+constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+constexpr uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+// Counters per batch. The rounds run lane-wise over a batch so that the
+// 32 x 32 -> 64-bit products vectorize.
+constexpr ptrdiff_t BATCH = 64;
+
+// w[j][i] = word j of philox(counter c0 + i on stream), i < BATCH. The
+// lanes are independent so the loop over them vectorizes.
+[[gnu::always_inline]] inline void rounds(uint64_t seed, uint64_t stream,
+                                          uint64_t c0, uint32_t w[4][BATCH]) {
+    for (ptrdiff_t i = 0; i < BATCH; i++) {
+        uint32_t x0 = static_cast<uint32_t>(c0 + i);
+        uint32_t x1 = static_cast<uint32_t>((c0 + i) >> 32);
+        uint32_t x2 = static_cast<uint32_t>(stream);
+        uint32_t x3 = static_cast<uint32_t>(stream >> 32);
+        uint32_t k0 = static_cast<uint32_t>(seed);
+        uint32_t k1 = static_cast<uint32_t>(seed >> 32);
+        for (int round = 0; round < 10; round++) {
+            const uint64_t p0 = uint64_t(M0) * x0, p1 = uint64_t(M1) * x2;
+            x0 = static_cast<uint32_t>(p1 >> 32) ^ x1 ^ k0;
+            x1 = static_cast<uint32_t>(p1);
+            x2 = static_cast<uint32_t>(p0 >> 32) ^ x3 ^ k1;
+            x3 = static_cast<uint32_t>(p0);
+            k0 += W0;
+            k1 += W1;
+        }
+        w[0][i] = x0;
+        w[1][i] = x1;
+        w[2][i] = x2;
+        w[3][i] = x3;
+    }
+}
+
+void philoxGeneric(uint64_t seed, uint64_t stream, uint64_t c0,
+                   uint32_t w[4][BATCH]) {
+    rounds(seed, stream, c0, w);
+}
+
+#ifdef RNG_X86
+
+__attribute__((target("avx2")))
+void philoxAVX2(uint64_t seed, uint64_t stream, uint64_t c0,
+                uint32_t w[4][BATCH]) {
+    rounds(seed, stream, c0, w);
+}
+
+__attribute__((target("avx512f")))
+void philoxAVX512(uint64_t seed, uint64_t stream, uint64_t c0,
+                  uint32_t w[4][BATCH]) {
+    rounds(seed, stream, c0, w);
+}
+
+#endif  // RNG_X86
+
+// Widest supported variant, all give the same words
+void philox(uint64_t seed, uint64_t stream, uint64_t c0,
+            uint32_t w[4][BATCH]) {
+    typedef void (*Fn)(uint64_t, uint64_t, uint64_t, uint32_t[4][BATCH]);
+    static const Fn fn = [] {
+#ifdef RNG_X86
+        if (__builtin_cpu_supports("avx512f")) return philoxAVX512;
+        if (__builtin_cpu_supports("avx2")) return philoxAVX2;
+#endif
+        return philoxGeneric;
+    }();
+    fn(seed, stream, c0, w);
+}
+
+// Uniforms from random words: 53 bits in [0, 1), or (0, 1] for log
+inline double unit(uint32_t lo, uint32_t hi) {
+    return ((uint64_t(hi) << 32 | lo) >> 11) * 0x1p-53;
+}
+inline double positive(uint32_t lo, uint32_t hi) {
+    return (((uint64_t(hi) << 32 | lo) >> 11) + 1) * 0x1p-53;
+}
+
+// Values of BATCH counters from c0 on, PER_COUNTER<S> each
+void normals(const Generator& g, uint64_t c0, double* x) {
+    alignas(64) uint32_t w[4][BATCH];
+    alignas(64) double u1[BATCH], u2[BATCH], z0[BATCH], z1[BATCH];
+    philox(g.seed(), g.stream(), c0, w);
+    for (ptrdiff_t i = 0; i < BATCH; i++) {
+        u1[i] = positive(w[0][i], w[1][i]);
+        u2[i] = unit(w[2][i], w[3][i]);
+    }
+    vmath::boxMuller(BATCH, u1, u2, z0, z1);
+    for (ptrdiff_t i = 0; i < BATCH; i++) {
+        x[2*i] = z0[i];
+        x[2*i + 1] = z1[i];
+    }
+}
+
+void normals(const Generator& g, uint64_t c0, float* x) {
+    alignas(64) uint32_t w[4][BATCH];
+    alignas(64) double u1[2*BATCH], u2[2*BATCH], z0[2*BATCH], z1[2*BATCH];
+    philox(g.seed(), g.stream(), c0, w);
+    // Words (0, 1) and (2, 3) each give a pair, from 32-bit uniforms
+    for (ptrdiff_t i = 0; i < BATCH; i++) {
+        u1[2*i] = (w[0][i] + 1.0) * 0x1p-32;
+        u2[2*i] = w[1][i] * 0x1p-32;
+        u1[2*i + 1] = (w[2][i] + 1.0) * 0x1p-32;
+        u2[2*i + 1] = w[3][i] * 0x1p-32;
+    }
+    vmath::boxMuller(2*BATCH, u1, u2, z0, z1);
+    for (ptrdiff_t i = 0; i < 2*BATCH; i++) {
+        x[2*i] = static_cast<float>(z0[i]);
+        x[2*i + 1] = static_cast<float>(z1[i]);
+    }
+}
+
+void uniforms(const Generator& g, uint64_t c0, double* x) {
+    alignas(64) uint32_t w[4][BATCH];
+    philox(g.seed(), g.stream(), c0, w);
+    for (ptrdiff_t i = 0; i < BATCH; i++) {
+        x[2*i] = unit(w[0][i], w[1][i]);
+        x[2*i + 1] = unit(w[2][i], w[3][i]);
+    }
+}
+
+void uniforms(const Generator& g, uint64_t c0, float* x) {
+    alignas(64) uint32_t w[4][BATCH];
+    philox(g.seed(), g.stream(), c0, w);
+    for (ptrdiff_t i = 0; i < BATCH; i++) {
+        for (int j = 0; j < 4; j++) x[4*i + j] = (w[j][i] >> 8) * 0x1p-24f;
+    }
+}
+
+// x[0:n] from the next ceil(n / PER_COUNTER) counters of g, a batch of
+// counters per task so the split does not change the values
+template <typename S, typename Kernel>
+void fill(Generator* g, const ptrdiff_t n, S* x, Kernel kernel) {
+    constexpr ptrdiff_t K = PER_COUNTER<S>;
+    const ptrdiff_t counters = (n + K - 1) / K;
+    const uint64_t c0 = g->reserve(counters);
+    const ptrdiff_t batches = (counters + BATCH - 1) / BATCH;
+    const ptrdiff_t grain = std::max<ptrdiff_t>(1,
+        ThreadPool::grain() / (BATCH * K));
+    parallel_for(batches, grain, [&](ptrdiff_t b0, ptrdiff_t b1) {
+        alignas(64) S buf[BATCH * K];
+        for (ptrdiff_t b = b0; b < b1; b++) {
+            const ptrdiff_t i0 = b * BATCH * K;
+            kernel(*g, c0 + b * BATCH, buf);
+            std::memcpy(x + i0, buf,
+                        std::min(BATCH * K, n - i0) * sizeof(S));
+        }
+    });
+}
+
+// MATRIX_SEED, otherwise 64 bits from the random device
+uint64_t initialSeed() {
+    const char* env = std::getenv("MATRIX_SEED");
+    if (env != nullptr && *env != '\0') return std::strtoull(env, nullptr, 0);
+    std::random_device rd;
+    return uint64_t(rd()) << 32 | rd();
+}
+
+}  // namespace
+
+void philox(const uint32_t counter[4], const uint32_t key[2],
+            uint32_t out[4]) {
+    uint32_t x0 = counter[0], x1 = counter[1], x2 = counter[2];
+    uint32_t x3 = counter[3], k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        const uint64_t p0 = uint64_t(M0) * x0, p1 = uint64_t(M1) * x2;
+        x0 = static_cast<uint32_t>(p1 >> 32) ^ x1 ^ k0;
+        x1 = static_cast<uint32_t>(p1);
+        x2 = static_cast<uint32_t>(p0 >> 32) ^ x3 ^ k1;
+        x3 = static_cast<uint32_t>(p0);
+        k0 += W0;
+        k1 += W1;
+    }
+    out[0] = x0;
+    out[1] = x1;
+    out[2] = x2;
+    out[3] = x3;
+}
+
+void Generator::normal(ptrdiff_t n, double* x) {
+    fill(this, n, x, [](const Generator& g, uint64_t c0, double* buf) {
+        normals(g, c0, buf);
+    });
+}
+
+void Generator::normal(ptrdiff_t n, float* x) {
+    fill(this, n, x, [](const Generator& g, uint64_t c0, float* buf) {
+        normals(g, c0, buf);
+    });
+}
+
+void Generator::uniform(ptrdiff_t n, double* x) {
+    fill(this, n, x, [](const Generator& g, uint64_t c0, double* buf) {
+        uniforms(g, c0, buf);
+    });
+}
+
+void Generator::uniform(ptrdiff_t n, float* x) {
+    fill(this, n, x, [](const Generator& g, uint64_t c0, float* buf) {
+        uniforms(g, c0, buf);
+    });
+}
+
+double Generator::normal() {
+    double x;
+    normal(1, &x);
+    return x;
+}
+
+double Generator::uniform() {
+    double x;
+    uniform(1, &x);
+    return x;
+}
+
+Generator& global() {
+    static Generator g(initialSeed());
+    return g;
+}
+
+void seed(uint64_t seed) {
+    global() = Generator(seed);
+}
+
+}  // namespace rng
@@ -0,0 +1,240 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Reduce.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace reduce {
+
+namespace {
+
+// Independent accumulators per reduction
+constexpr int LANES = 8;
+
+// Columns reduced together by cols(), their accumulators stay in L1
+constexpr ptrdiff_t BLOCK = 256;
+
+// sum(f(i)), i < n, over LANES interleaved partial sums added in a fixed
+// order
+template <typename F>
+[[gnu::always_inline]] inline double accumulate(const ptrdiff_t n, F f) {
+    double acc[LANES] = {};
+    ptrdiff_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < LANES; k++) acc[k] += f(i + k);
+    }
+    double tail = 0;
+    for (; i < n; i++) tail += f(i);
+    for (int k = 1; k < LANES; k++) acc[0] += acc[k];
+    return acc[0] + tail;
+}
+
+// First x[i] with the greatest (MAX) or least value, i < n, and its
+// index in *at. NaNs are skipped; an empty or all-NaN x gives -inf
+// (+inf) at 0.
+template <bool MAX, typename S>
+S extreme(const ptrdiff_t n, const S* x, ptrdiff_t* at) {
+    constexpr S none = MAX ? -std::numeric_limits<S>::infinity()
+                           : std::numeric_limits<S>::infinity();
+    S best[LANES];
+    ptrdiff_t index[LANES];
+    std::fill(best, best + LANES, none);
+    std::fill(index, index + LANES, 0);
+    ptrdiff_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < LANES; k++) {
+            const S v = x[i + k];
+            const bool better = MAX ? v > best[k] : v < best[k];
+            best[k] = better ? v : best[k];
+            index[k] = better ? i + k : index[k];
+        }
+    }
+    // The tail comes after every lane's elements, lane 0 keeps order
+    for (; i < n; i++) {
+        if (MAX ? x[i] > best[0] : x[i] < best[0]) {
+            best[0] = x[i];
+            index[0] = i;
+        }
+    }
+    int r = 0;
+    for (int k = 1; k < LANES; k++) {
+        const bool better = MAX ? best[k] > best[r] : best[k] < best[r];
+        if (better || (best[k] == best[r] && index[k] < index[r])) r = k;
+    }
+    *at = index[r];
+    return best[r];
+}
+
+template <typename S>
+ptrdiff_t iamaxT(const ptrdiff_t n, const S* x, double* amax) {
+    double best[LANES];
+    ptrdiff_t index[LANES];
+    std::fill(best, best + LANES, -1.0);
+    std::fill(index, index + LANES, 0);
+    ptrdiff_t i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < LANES; k++) {
+            const double v = std::fabs(static_cast<double>(x[i + k]));
+            const bool better = v > best[k];
+            best[k] = better ? v : best[k];
+            index[k] = better ? i + k : index[k];
+        }
+    }
+    for (; i < n; i++) {
+        const double v = std::fabs(static_cast<double>(x[i]));
+        if (v > best[0]) {
+            best[0] = v;
+            index[0] = i;
+        }
+    }
+    int r = 0;
+    for (int k = 1; k < LANES; k++) {
+        if (best[k] > best[r] || (best[k] == best[r] && index[k] < index[r]))
+            r = k;
+    }
+    *amax = std::max(best[r], 0.0);
+    return index[r];
+}
+
+template <typename S>
+void rowsT(const Op op, const ptrdiff_t m, const ptrdiff_t n, const S* a,
+           const ptrdiff_t lda, S* y, ptrdiff_t* index) {
+    for (ptrdiff_t i = 0; i < m; i++) {
+        const S* row = a + i*lda;
+        ptrdiff_t at = 0;
+        S v;
+        switch (op) {
+            case SUM:
+            case MEAN: {
+                const double s = sum(n, row);
+                v = static_cast<S>(op == MEAN ? s / n : s);
+                break;
+            }
+            case MAX:
+            case ARGMAX:
+                v = extreme<true>(n, row, &at);
+                break;
+            default:
+                v = extreme<false>(n, row, &at);
+                break;
+        }
+        if (y != nullptr) y[i] = v;
+        if (op == ARGMAX || op == ARGMIN) index[i] = at;
+    }
+}
+
+template <typename S>
+void colsT(const Op op, const ptrdiff_t m, const ptrdiff_t n, const S* a,
+           const ptrdiff_t lda, S* y, ptrdiff_t* index) {
+    for (ptrdiff_t j0 = 0; j0 < n; j0 += BLOCK) {
+        const ptrdiff_t w = std::min(BLOCK, n - j0);
+        if (op == SUM || op == MEAN) {
+            double acc[BLOCK] = {};
+            for (ptrdiff_t i = 0; i < m; i++) {
+                const S* row = a + i*lda + j0;
+                for (ptrdiff_t j = 0; j < w; j++) acc[j] += row[j];
+            }
+            const double scale = op == MEAN ? 1.0 / m : 1.0;
+            for (ptrdiff_t j = 0; j < w; j++)
+                y[j0 + j] = static_cast<S>(acc[j] * scale);
+            continue;
+        }
+        const bool max = op == MAX || op == ARGMAX;
+        S best[BLOCK];
+        ptrdiff_t at[BLOCK] = {};
+        std::fill(best, best + w, max ? -std::numeric_limits<S>::infinity()
+                                      : std::numeric_limits<S>::infinity());
+        for (ptrdiff_t i = 0; i < m; i++) {
+            const S* row = a + i*lda + j0;
+            if (max) {
+                for (ptrdiff_t j = 0; j < w; j++) {
+                    const bool better = row[j] > best[j];
+                    best[j] = better ? row[j] : best[j];
+                    at[j] = better ? i : at[j];
+                }
+            } else {
+                for (ptrdiff_t j = 0; j < w; j++) {
+                    const bool better = row[j] < best[j];
+                    best[j] = better ? row[j] : best[j];
+                    at[j] = better ? i : at[j];
+                }
+            }
+        }
+        if (y != nullptr) std::copy(best, best + w, y + j0);
+        if (op == ARGMAX || op == ARGMIN) std::copy(at, at + w, index + j0);
+    }
+}
+
+}  // namespace
+
+double sum(const ptrdiff_t n, const double* x) {
+    return accumulate(n, [=](ptrdiff_t i) { return x[i]; });
+}
+
+double sum(const ptrdiff_t n, const float* x) {
+    return accumulate(n, [=](ptrdiff_t i) { return double(x[i]); });
+}
+
+double asum(const ptrdiff_t n, const double* x) {
+    return accumulate(n, [=](ptrdiff_t i) { return std::fabs(x[i]); });
+}
+
+double asum(const ptrdiff_t n, const float* x) {
+    return accumulate(n, [=](ptrdiff_t i) { return std::fabs(double(x[i])); });
+}
+
+double dot(const ptrdiff_t n, const double* x, const double* y) {
+    return accumulate(n, [=](ptrdiff_t i) { return x[i] * y[i]; });
+}
+
+double dot(const ptrdiff_t n, const float* x, const float* y) {
+    return accumulate(n, [=](ptrdiff_t i) {
+        return double(x[i]) * double(y[i]);
+    });
+}
+
+double sumsq(const ptrdiff_t n, const double* x, const double scale) {
+    return accumulate(n, [=](ptrdiff_t i) {
+        const double v = scale * x[i];
+        return v * v;
+    });
+}
+
+double sumsq(const ptrdiff_t n, const float* x, const double scale) {
+    return accumulate(n, [=](ptrdiff_t i) {
+        const double v = scale * x[i];
+        return v * v;
+    });
+}
+
+ptrdiff_t iamax(const ptrdiff_t n, const double* x, double* amax) {
+    return iamaxT(n, x, amax);
+}
+
+ptrdiff_t iamax(const ptrdiff_t n, const float* x, double* amax) {
+    return iamaxT(n, x, amax);
+}
+
+void rows(const Op op, const ptrdiff_t m, const ptrdiff_t n, const double* a,
+          const ptrdiff_t lda, double* y, ptrdiff_t* index) {
+    rowsT(op, m, n, a, lda, y, index);
+}
+
+void rows(const Op op, const ptrdiff_t m, const ptrdiff_t n, const float* a,
+          const ptrdiff_t lda, float* y, ptrdiff_t* index) {
+    rowsT(op, m, n, a, lda, y, index);
+}
+
+void cols(const Op op, const ptrdiff_t m, const ptrdiff_t n, const double* a,
+          const ptrdiff_t lda, double* y, ptrdiff_t* index) {
+    colsT(op, m, n, a, lda, y, index);
+}
+
+void cols(const Op op, const ptrdiff_t m, const ptrdiff_t n, const float* a,
+          const ptrdiff_t lda, float* y, ptrdiff_t* index) {
+    colsT(op, m, n, a, lda, y, index);
+}
+
+}  // namespace reduce
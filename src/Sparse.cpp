@@ -0,0 +1,285 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Sparse.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace sparse {
+
+namespace {
+
+// Minimum column panel per thread when scattering across columns of C
+constexpr ptrdiff_t PANEL = 16;
+
+// C = beta * C, beta = 0 overwrites so that NaNs in C do not propagate
+template <typename S>
+void scale(const ptrdiff_t m, const ptrdiff_t n, const double beta,
+           S* C, const ptrdiff_t ldc) {
+    if (beta == 1) return;
+    const S b = beta;
+    parallel_rows(m, n, ldc == n, ThreadPool::grain(),
+        [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+            for (ptrdiff_t j = j0; j < j1; j++)
+                C[i*ldc + j] = b == 0 ? 0 : b * C[i*ldc + j];
+        });
+}
+
+// Number of chunks for a kernel touching n elements per nonzero and slice
+ptrdiff_t chunks(const ptrdiff_t outer, const ptrdiff_t* ptr,
+                 const ptrdiff_t n) {
+    if (ThreadPool::nested()) return 1;
+    return ThreadPool::instance().chunks((ptr[outer] + outer) * n,
+                                         ThreadPool::grain());
+}
+
+// Apply f(c, o0, o1) to chunks of slices holding about equal numbers of
+// nonzeros (plus one per slice, so empty slices are not free)
+template <typename F>
+void balanced(const ptrdiff_t outer, const ptrdiff_t* ptr,
+              const ptrdiff_t chunks, F&& f) {
+    const ptrdiff_t work = ptr[outer] + outer;
+    auto bound = [=](ptrdiff_t c) {
+        // First slice o with ptr[o] + o >= c * work / chunks
+        const ptrdiff_t target = c * work / chunks;
+        ptrdiff_t lo = 0, hi = outer;
+        while (lo < hi) {
+            const ptrdiff_t mid = (lo + hi) / 2;
+            if (ptr[mid] + mid < target) lo = mid + 1;
+            else                         hi = mid;
+        }
+        return lo;
+    };
+    parallel_for(chunks, 1, [&](ptrdiff_t c0, ptrdiff_t c1) {
+        for (ptrdiff_t c = c0; c < c1; c++) f(c, bound(c), bound(c + 1));
+    });
+}
+
+// Rows o0..o1 of C = alpha * P * B + beta * C
+template <typename S>
+void gather(const ptrdiff_t o0, const ptrdiff_t o1, const ptrdiff_t* ptr,
+            const ptrdiff_t* index, const S* values, const ptrdiff_t n,
+            const S alpha, const S* B, const ptrdiff_t ldb,
+            const S beta, S* C, const ptrdiff_t ldc) {
+    for (ptrdiff_t o = o0; o < o1; o++) {
+        S* c = C + o*ldc;
+        // SpMV: one dot product per row
+        if (n == 1) {
+            S s = 0;
+            for (ptrdiff_t k = ptr[o]; k < ptr[o + 1]; k++)
+                s += values[k] * B[index[k]*ldb];
+            c[0] = beta == 0 ? alpha * s : alpha * s + beta * c[0];
+            continue;
+        }
+        for (ptrdiff_t j = 0; j < n; j++)
+            c[j] = beta == 0 ? 0 : beta * c[j];
+        for (ptrdiff_t k = ptr[o]; k < ptr[o + 1]; k++) {
+            const S a = alpha * values[k];
+            const S* b = B + index[k]*ldb;
+            for (ptrdiff_t j = 0; j < n; j++) c[j] += a * b[j];
+        }
+    }
+}
+
+// C[:, j0:j1] += alpha * P[o0:o1, :]^T * B[o0:o1, j0:j1]
+template <typename S>
+void scatter(const ptrdiff_t o0, const ptrdiff_t o1, const ptrdiff_t* ptr,
+             const ptrdiff_t* index, const S* values,
+             const ptrdiff_t j0, const ptrdiff_t j1,
+             const S alpha, const S* B, const ptrdiff_t ldb,
+             S* C, const ptrdiff_t ldc) {
+    for (ptrdiff_t o = o0; o < o1; o++) {
+        const S* b = B + o*ldb;
+        for (ptrdiff_t k = ptr[o]; k < ptr[o + 1]; k++) {
+            const S a = alpha * values[k];
+            S* c = C + index[k]*ldc;
+            for (ptrdiff_t j = j0; j < j1; j++) c[j] += a * b[j];
+        }
+    }
+}
+
+template <typename S>
+void multT(const bool trans, const ptrdiff_t outer, const ptrdiff_t inner,
+           const ptrdiff_t* ptr, const ptrdiff_t* index, const S* values,
+           const ptrdiff_t n, const double alpha,
+           const S* B, const ptrdiff_t ldb,
+           const double beta, S* C, const ptrdiff_t ldc) {
+    if (n == 0) return;
+    const ptrdiff_t p = chunks(outer, ptr, n);
+    if (!trans) {
+        balanced(outer, ptr, p, [&](ptrdiff_t, ptrdiff_t o0, ptrdiff_t o1) {
+            gather<S>(o0, o1, ptr, index, values, n, alpha, B, ldb, beta,
+                      C, ldc);
+        });
+        return;
+    }
+    scale(inner, n, beta, C, ldc);
+    if (p == 1) {
+        scatter<S>(0, outer, ptr, index, values, 0, n, alpha, B, ldb, C, ldc);
+    } else if (n >= p * PANEL) {
+        // Wide B: each thread owns a panel of columns of C
+        parallel_for(n, PANEL, [&](ptrdiff_t j0, ptrdiff_t j1) {
+            scatter<S>(0, outer, ptr, index, values, j0, j1, alpha, B, ldb,
+                       C, ldc);
+        });
+    } else {
+        // Narrow B (e.g. SpMV): chunk c > 0 scatters into its own partial
+        // (inner x n) sum, added to C once every chunk is done
+        std::vector<S> partial((p - 1) * inner * n, 0);
+        balanced(outer, ptr, p, [&](ptrdiff_t c, ptrdiff_t o0, ptrdiff_t o1) {
+            if (c == 0) {
+                scatter<S>(o0, o1, ptr, index, values, 0, n, alpha, B, ldb,
+                           C, ldc);
+            } else {
+                scatter<S>(o0, o1, ptr, index, values, 0, n, alpha, B, ldb,
+                           partial.data() + (c - 1)*inner*n, n);
+            }
+        });
+        const S* q = partial.data();
+        parallel_rows(inner, n, false, ThreadPool::grain() / p,
+            [=](ptrdiff_t i, ptrdiff_t j0, ptrdiff_t j1) {
+                for (ptrdiff_t c = 0; c < p - 1; c++)
+                    for (ptrdiff_t j = j0; j < j1; j++)
+                        C[i*ldc + j] += q[(c*inner + i)*n + j];
+            });
+    }
+}
+
+template <typename S>
+void multRightT(const bool trans, const ptrdiff_t outer,
+                const ptrdiff_t inner, const ptrdiff_t* ptr,
+                const ptrdiff_t* index, const S* values,
+                const ptrdiff_t m, const double alpha,
+                const S* B, const ptrdiff_t ldb,
+                const double beta, S* C, const ptrdiff_t ldc) {
+    const S a = alpha, b = beta;
+    const ptrdiff_t work = ptr[outer] + outer;
+    parallel_for(m, std::max<ptrdiff_t>(1, ThreadPool::grain() / work),
+        [&](ptrdiff_t i0, ptrdiff_t i1) {
+            for (ptrdiff_t i = i0; i < i1; i++) {
+                const S* x = B + i*ldb;
+                S* y = C + i*ldc;
+                if (trans) {
+                    // y = a * P * x + b * y, one slice per element of y
+                    for (ptrdiff_t o = 0; o < outer; o++) {
+                        S s = 0;
+                        for (ptrdiff_t k = ptr[o]; k < ptr[o + 1]; k++)
+                            s += values[k] * x[index[k]];
+                        y[o] = b == 0 ? a * s : a * s + b * y[o];
+                    }
+                } else {
+                    // y = a * P^T * x + b * y, slice o scaled by x[o]
+                    for (ptrdiff_t j = 0; j < inner; j++)
+                        y[j] = b == 0 ? 0 : b * y[j];
+                    for (ptrdiff_t o = 0; o < outer; o++) {
+                        const S s = a * x[o];
+                        if (s == 0) continue;
+                        for (ptrdiff_t k = ptr[o]; k < ptr[o + 1]; k++)
+                            y[index[k]] += s * values[k];
+                    }
+                }
+            }
+        });
+}
+
+template <typename S>
+double dotT(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+            const ptrdiff_t* index, const S* values,
+            const S* B, const ptrdiff_t ldb) {
+    const ptrdiff_t is = trans ? ldb : 1, os = trans ? 1 : ldb;
+    const ptrdiff_t p = chunks(outer, ptr, 1);
+    std::vector<double> partial(p);
+    balanced(outer, ptr, p, [&](ptrdiff_t c, ptrdiff_t o0, ptrdiff_t o1) {
+        double s = 0;
+        for (ptrdiff_t o = o0; o < o1; o++)
+            for (ptrdiff_t k = ptr[o]; k < ptr[o + 1]; k++)
+                s += double(values[k]) * B[o*os + index[k]*is];
+        partial[c] = s;
+    });
+    double sum = 0;
+    for (double s : partial) sum += s;
+    return sum;
+}
+
+template <typename S>
+void axpyT(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+           const ptrdiff_t* index, const S* values, const double alpha,
+           S* B, const ptrdiff_t ldb) {
+    // Slices write disjoint rows (or columns) of B
+    const ptrdiff_t is = trans ? ldb : 1, os = trans ? 1 : ldb;
+    const S a = alpha;
+    balanced(outer, ptr, chunks(outer, ptr, 1),
+        [&](ptrdiff_t, ptrdiff_t o0, ptrdiff_t o1) {
+            for (ptrdiff_t o = o0; o < o1; o++)
+                for (ptrdiff_t k = ptr[o]; k < ptr[o + 1]; k++)
+                    B[o*os + index[k]*is] += a * values[k];
+        });
+}
+
+}  // namespace
+
+void mult(const bool trans, const ptrdiff_t outer, const ptrdiff_t inner,
+          const ptrdiff_t* ptr, const ptrdiff_t* index, const double* values,
+          const ptrdiff_t n, const double alpha,
+          const double* B, const ptrdiff_t ldb,
+          const double beta, double* C, const ptrdiff_t ldc) {
+    multT(trans, outer, inner, ptr, index, values, n, alpha, B, ldb, beta,
+          C, ldc);
+}
+
+void mult(const bool trans, const ptrdiff_t outer, const ptrdiff_t inner,
+          const ptrdiff_t* ptr, const ptrdiff_t* index, const float* values,
+          const ptrdiff_t n, const double alpha,
+          const float* B, const ptrdiff_t ldb,
+          const double beta, float* C, const ptrdiff_t ldc) {
+    multT(trans, outer, inner, ptr, index, values, n, alpha, B, ldb, beta,
+          C, ldc);
+}
+
+void multRight(const bool trans, const ptrdiff_t outer,
+               const ptrdiff_t inner, const ptrdiff_t* ptr,
+               const ptrdiff_t* index, const double* values,
+               const ptrdiff_t m, const double alpha,
+               const double* B, const ptrdiff_t ldb,
+               const double beta, double* C, const ptrdiff_t ldc) {
+    multRightT(trans, outer, inner, ptr, index, values, m, alpha, B, ldb,
+               beta, C, ldc);
+}
+
+void multRight(const bool trans, const ptrdiff_t outer,
+               const ptrdiff_t inner, const ptrdiff_t* ptr,
+               const ptrdiff_t* index, const float* values,
+               const ptrdiff_t m, const double alpha,
+               const float* B, const ptrdiff_t ldb,
+               const double beta, float* C, const ptrdiff_t ldc) {
+    multRightT(trans, outer, inner, ptr, index, values, m, alpha, B, ldb,
+               beta, C, ldc);
+}
+
+double dot(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+           const ptrdiff_t* index, const double* values,
+           const double* B, const ptrdiff_t ldb) {
+    return dotT(trans, outer, ptr, index, values, B, ldb);
+}
+
+double dot(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+           const ptrdiff_t* index, const float* values,
+           const float* B, const ptrdiff_t ldb) {
+    return dotT(trans, outer, ptr, index, values, B, ldb);
+}
+
+void axpy(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+          const ptrdiff_t* index, const double* values, const double alpha,
+          double* B, const ptrdiff_t ldb) {
+    axpyT(trans, outer, ptr, index, values, alpha, B, ldb);
+}
+
+void axpy(const bool trans, const ptrdiff_t outer, const ptrdiff_t* ptr,
+          const ptrdiff_t* index, const float* values, const double alpha,
+          float* B, const ptrdiff_t ldb) {
+    axpyT(trans, outer, ptr, index, values, alpha, B, ldb);
+}
+
+}  // namespace sparse
@@ -0,0 +1,153 @@
+// Copyright 2023 Caleb Magruder
+
+#include "ThreadPool.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <cstdlib>
+
+namespace {
+
+thread_local bool inWorker = false;
+
+int envInt(const char* name, int fallback) {
+    const char* value = std::getenv(name);
+    return value != nullptr && *value != '\0' ? std::atoi(value) : fallback;
+}
+
+int hardwareThreads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Bind the calling thread to a single core, ignored where unsupported
+void setAffinity(int core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % hardwareThreads(), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+#else
+    (void)core;
+#endif
+}
+
+}  // namespace
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool() {
+    _pin = envInt("MATRIX_PIN_THREADS", 0) != 0;
+    start(envInt("MATRIX_NUM_THREADS", 0));
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+void ThreadPool::resize(int n) {
+    std::lock_guard<std::mutex> lock(_run);
+    stop();
+    start(n);
+}
+
+void ThreadPool::pin(bool enable) {
+    if (enable == _pin) return;
+    std::lock_guard<std::mutex> lock(_run);
+    const int n = _size;
+    stop();
+    _pin = enable;
+    start(n);
+}
+
+bool ThreadPool::nested() {
+    return inWorker;
+}
+
+void ThreadPool::start(int n) {
+    _size = n < 1 ? hardwareThreads() : n;
+    _stop = false;
+    for (int id = 1; id < _size; id++) {
+        _workers.emplace_back(&ThreadPool::worker, this, id);
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (std::thread& t : _workers) t.join();
+    _workers.clear();
+    _size = 1;
+}
+
+void ThreadPool::run(ptrdiff_t chunks, void (*fn)(void*, ptrdiff_t),
+                     void* ctx) {
+    // Another thread owns the pool, run inline rather than queue
+    std::unique_lock<std::mutex> owner(_run, std::try_to_lock);
+    if (!owner.owns_lock() || _size == 1) {
+        for (ptrdiff_t c = 0; c < chunks; c++) fn(ctx, c);
+        return;
+    }
+
+    Job job;
+    job.fn = fn;
+    job.ctx = ctx;
+    job.chunks = chunks;
+    job.next = 0;
+    job.remaining = chunks;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _job = &job;
+        _generation++;
+    }
+    _wake.notify_all();
+
+    // The caller works too, and runs nested jobs serially meanwhile
+    inWorker = true;
+    execute(&job);
+    inWorker = false;
+
+    // Retire the job once no worker can still touch it
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [&] { return job.remaining == 0 && _busy == 0; });
+    _job = nullptr;
+}
+
+void ThreadPool::worker(int id) {
+    inWorker = true;
+    if (_pin) setAffinity(id);
+    unsigned long long seen = 0;  // NOLINT [runtime/int]
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _wake.wait(lock, [&] { return _stop || _generation != seen; });
+        if (_stop) return;
+        seen = _generation;
+        Job* job = _job;
+        if (job == nullptr) continue;  // Finished before this worker woke
+        _busy++;
+        lock.unlock();
+        execute(job);
+        lock.lock();
+        _busy--;
+        if (_busy == 0) _done.notify_all();
+    }
+}
+
+void ThreadPool::execute(Job* job) {
+    ptrdiff_t c;
+    while ((c = job->next.fetch_add(1)) < job->chunks) {
+        job->fn(job->ctx, c);
+        if (job->remaining.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done.notify_all();
+        }
+    }
+}
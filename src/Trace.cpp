@@ -0,0 +1,221 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+#include "Matrix.h"
+
+namespace trace {
+
+namespace {
+
+const std::chrono::steady_clock::time_point origin =
+    std::chrono::steady_clock::now();
+
+constexpr size_t CHUNK = 1024;
+
+// Fixed-size block of events, chunks are never moved so readers can walk
+// them while the owner appends
+struct Chunk {
+    Event events[CHUNK];
+    std::atomic<Chunk*> next{nullptr};
+
+    ~Chunk() { delete next.load(); }
+};
+
+// Events of one thread. Only the owner writes; size is published with
+// release so readers see complete events. clear() bumps the global
+// generation and the owner restarts its buffer on its next record.
+struct Buffer {
+    Chunk head;
+    Chunk* tail = &head;
+    std::atomic<size_t> size{0};
+    std::atomic<uint64_t> generation{0};
+    uint32_t thread = 0;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    std::atomic<uint64_t> generation{0};
+    std::atomic<bool> enabled{true};
+
+    Registry() {
+        const char* env = std::getenv("MATRIX_TRACING");
+        if (env != nullptr && *env != '\0') enabled = std::atoi(env) != 0;
+    }
+};
+
+// Leaked, so buffers of exited threads and static destructors are safe
+Registry& registry() {
+    static Registry* r = new Registry;
+    return *r;
+}
+
+// The calling thread's buffer, registered on first use and kept by the
+// registry after the thread exits
+Buffer& buffer() {
+    thread_local std::shared_ptr<Buffer> b = [] {
+        Registry& r = registry();
+        auto buffer = std::make_shared<Buffer>();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        buffer->thread = r.buffers.size();
+        buffer->generation = r.generation.load();
+        r.buffers.push_back(buffer);
+        return buffer;
+    }();
+    return *b;
+}
+
+std::string backendName(const Event& e) {
+    std::ostringstream os;
+    os << BLAS(e.backend);
+    return os.str();
+}
+
+}  // namespace
+
+int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - origin).count();
+}
+
+void enable(bool on) {
+    registry().enabled.store(on, std::memory_order_relaxed);
+}
+
+bool enabled() {
+    return registry().enabled.load(std::memory_order_relaxed);
+}
+
+void Span::record(Event* event) {
+    Buffer& b = buffer();
+    const uint64_t generation =
+        registry().generation.load(std::memory_order_relaxed);
+    size_t i = b.size.load(std::memory_order_relaxed);
+    if (b.generation.load(std::memory_order_relaxed) != generation) {
+        b.size.store(0, std::memory_order_relaxed);
+        b.generation.store(generation, std::memory_order_relaxed);
+        // Orders the reset before the events overwritten below, see events()
+        std::atomic_thread_fence(std::memory_order_release);
+        b.tail = &b.head;
+        i = 0;
+    }
+    if (i > 0 && i % CHUNK == 0) {
+        Chunk* next = b.tail->next.load(std::memory_order_relaxed);
+        if (next == nullptr) {
+            next = new Chunk;
+            b.tail->next.store(next, std::memory_order_release);
+        }
+        b.tail = next;
+    }
+    event->thread = b.thread;
+    b.tail->events[i % CHUNK] = *event;
+    b.size.store(i + 1, std::memory_order_release);
+}
+
+void clear() {
+    registry().generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<Event> events() {
+    Registry& r = registry();
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        buffers = r.buffers;
+    }
+    const uint64_t generation = r.generation.load(std::memory_order_relaxed);
+    std::vector<Event> all;
+    for (const auto& b : buffers) {
+        if (b->generation.load(std::memory_order_relaxed) != generation)
+            continue;
+        const size_t n = b->size.load(std::memory_order_acquire);
+        const size_t first = all.size();
+        const Chunk* c = &b->head;
+        for (size_t i = 0; i < n; i++) {
+            if (i > 0 && i % CHUNK == 0)
+                c = c->next.load(std::memory_order_acquire);
+            all.push_back(c->events[i % CHUNK]);
+        }
+        // A clear() picked up by the owner while copying may have
+        // overwritten the copied events, drop them
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (b->generation.load(std::memory_order_relaxed) != generation)
+            all.resize(first);
+    }
+    std::sort(all.begin(), all.end(), [](const Event& a, const Event& b) {
+        return a.start < b.start;
+    });
+    return all;
+}
+
+void writeChrome(std::ostream& os) {
+    const std::vector<Event> all = events();
+    const auto flags = os.flags();
+    os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    for (size_t i = 0; i < all.size(); i++) {
+        const Event& e = all[i];
+        os << (i ? ",\n" : "\n")
+           << "{\"name\":\"" << e.name << "\",\"cat\":\"" << backendName(e)
+           << "\",\"ph\":\"X\",\"ts\":" << e.start * 1e-3
+           << ",\"dur\":" << e.duration * 1e-3
+           << ",\"pid\":1,\"tid\":" << e.thread
+           << ",\"args\":{\"dtype\":\"" << (e.single ? "float" : "double")
+           << "\",\"m\":" << e.m << ",\"n\":" << e.n << ",\"k\":" << e.k
+           << ",\"flops\":" << std::setprecision(0) << e.flops
+           << std::setprecision(3) << "}}";
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    os.flags(flags);
+}
+
+void writeSummary(std::ostream& os) {
+    struct Total {
+        int64_t calls = 0, nanoseconds = 0;
+        double flops = 0;
+    };
+    std::map<std::tuple<std::string, std::string, bool>, Total> totals;
+    for (const Event& e : events()) {
+        Total& t = totals[{e.name, backendName(e), e.single}];
+        t.calls++;
+        t.nanoseconds += e.duration;
+        t.flops += e.flops;
+    }
+    std::vector<std::pair<decltype(totals)::key_type, Total>> rows(
+        totals.begin(), totals.end());
+    std::stable_sort(rows.begin(), rows.end(), [](const auto& a,
+                                                  const auto& b) {
+        return a.second.nanoseconds > b.second.nanoseconds;
+    });
+    const auto flags = os.flags();
+    os << std::left << std::setw(16) << "op" << std::setw(8) << "backend"
+       << std::setw(8) << "dtype" << std::right << std::setw(10) << "calls"
+       << std::setw(14) << "total ms" << std::setw(12) << "mean us"
+       << std::setw(10) << "GFLOP/s" << "\n";
+    os << std::fixed;
+    for (const auto& [key, t] : rows) {
+        const auto& [name, backend, single] = key;
+        os << std::left << std::setw(16) << name << std::setw(8) << backend
+           << std::setw(8) << (single ? "float" : "double") << std::right
+           << std::setw(10) << t.calls << std::setprecision(3)
+           << std::setw(14) << t.nanoseconds * 1e-6 << std::setw(12)
+           << t.nanoseconds * 1e-3 / t.calls << std::setprecision(2)
+           << std::setw(10)
+           << (t.nanoseconds > 0 ? t.flops / t.nanoseconds : 0) << "\n";
+    }
+    os.flags(flags);
+}
+
+}  // namespace trace
@@ -0,0 +1,229 @@
+// Copyright 2023 Caleb Magruder
+
+#include "Tuning.h"
+
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "Gemm.h"
+#include "Layout.h"
+#include "ThreadPool.h"
+
+namespace tuning {
+
+namespace {
+
+#if defined(__APPLE__)
+ptrdiff_t sysctlSize(const char* name) {
+    int64_t value = 0;
+    size_t size = sizeof(value);
+    return sysctlbyname(name, &value, &size, nullptr, 0) == 0 ? value : 0;
+}
+#endif
+
+std::string trim(const std::string& s) {
+    const size_t b = s.find_first_not_of(" \t");
+    const size_t e = s.find_last_not_of(" \t\r");
+    return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+}
+
+ptrdiff_t roundDown(ptrdiff_t n, ptrdiff_t r) {
+    return std::max(n / r * r, r);
+}
+
+// Sections of a cache file: the CPU model and its lines
+typedef std::vector<std::pair<std::string, std::vector<std::string>>>
+    Sections;
+
+Sections read(const std::string& path) {
+    Sections sections;
+    std::ifstream is(path);
+    std::string line;
+    while (std::getline(is, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
+        if (line.front() == '[' && line.back() == ']') {
+            sections.push_back({line.substr(1, line.size() - 2), {}});
+        } else if (!sections.empty()) {
+            sections.back().second.push_back(line);
+        }
+    }
+    return sections;
+}
+
+}  // namespace
+
+Caches caches() {
+    Caches c;
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+    c.l1 = std::max<long>(sysconf(_SC_LEVEL1_DCACHE_SIZE), 0);  // NOLINT
+    c.l2 = std::max<long>(sysconf(_SC_LEVEL2_CACHE_SIZE), 0);   // NOLINT
+    c.l3 = std::max<long>(sysconf(_SC_LEVEL3_CACHE_SIZE), 0);   // NOLINT
+#elif defined(__APPLE__)
+    c.l1 = sysctlSize("hw.l1dcachesize");
+    c.l2 = sysctlSize("hw.l2cachesize");
+    c.l3 = sysctlSize("hw.l3cachesize");
+#endif
+    return c;
+}
+
+std::string cpuModel() {
+#if defined(__APPLE__)
+    char name[256] = {};
+    size_t size = sizeof(name) - 1;
+    if (sysctlbyname("machdep.cpu.brand_string", name, &size, nullptr, 0)
+        == 0) return name;
+#endif
+    std::ifstream is("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(is, line)) {
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        const std::string key = trim(line.substr(0, colon));
+        if (key == "model name" || key == "Model" || key == "cpu model")
+            return trim(line.substr(colon + 1));
+    }
+    return "unknown";
+}
+
+Params heuristic() {
+    const Caches c = caches();
+    Params p;
+    const gemm::Blocking d = gemm::blocking(false);
+    const gemm::Blocking s = gemm::blocking(true);
+    if (c.l1 > 0) {
+        p.kc = std::max<ptrdiff_t>(c.l1 / (16 * sizeof(double)), 64);
+        p.skc = std::max<ptrdiff_t>(c.l1 / (16 * sizeof(float)), 64);
+        p.block = roundDown(std::sqrt(c.l1 / (4. * sizeof(double))), 8);
+    }
+    if (c.l2 > 0) {
+        const ptrdiff_t kc = p.kc ? p.kc : d.kc, skc = p.skc ? p.skc : s.kc;
+        p.mc = roundDown(c.l2 / (4 * kc * sizeof(double)), d.mr);
+        p.smc = roundDown(c.l2 / (4 * skc * sizeof(float)), s.mr);
+        p.grain = std::clamp<ptrdiff_t>(c.l2 / 32, 1 << 12, 1 << 20);
+    }
+    if (c.l3 > 0) {
+        const ptrdiff_t kc = p.kc ? p.kc : d.kc, skc = p.skc ? p.skc : s.kc;
+        p.nc = roundDown(std::min<ptrdiff_t>(
+            c.l3 / (2 * kc * sizeof(double)), 8192), d.nr);
+        p.snc = roundDown(std::min<ptrdiff_t>(
+            c.l3 / (2 * skc * sizeof(float)), 8192), s.nr);
+    }
+    return p;
+}
+
+Params current() {
+    Params p;
+    const gemm::Blocking d = gemm::blocking(false);
+    const gemm::Blocking s = gemm::blocking(true);
+    p.kernel = gemm::kernel();
+    p.mc = d.mc;
+    p.kc = d.kc;
+    p.nc = d.nc;
+    p.smc = s.mc;
+    p.skc = s.kc;
+    p.snc = s.nc;
+    p.block = layout::block();
+    p.grain = ThreadPool::grain();
+    return p;
+}
+
+bool apply(const Params& p) {
+    if (!p.kernel.empty() && !gemm::kernel(p.kernel.c_str())) return false;
+    const gemm::Blocking d = gemm::blocking(false);
+    const gemm::Blocking s = gemm::blocking(true);
+    gemm::blocking({d.mr, d.nr, p.mc ? p.mc : d.mc, p.kc ? p.kc : d.kc,
+                    p.nc ? p.nc : d.nc}, false);
+    gemm::blocking({s.mr, s.nr, p.smc ? p.smc : s.mc, p.skc ? p.skc : s.kc,
+                    p.snc ? p.snc : s.nc}, true);
+    if (p.block) layout::block(p.block);
+    if (p.grain) ThreadPool::grain(p.grain);
+    return true;
+}
+
+std::string cachePath() {
+    const char* path = std::getenv("MATRIX_TUNE_CACHE");
+    if (path != nullptr && *path != '\0') return path;
+    const char* home = std::getenv("HOME");
+    return std::string(home != nullptr ? home : ".") + "/.matrix_tune";
+}
+
+// Section for cpuModel():
+//     kernel <name>
+//     gemm <mc> <kc> <nc>
+//     sgemm <mc> <kc> <nc>
+//     block <edge>
+//     grain <elements>
+bool load(const std::string& path) {
+    const std::string model = cpuModel();
+    for (const auto& [name, lines] : read(path)) {
+        if (name != model) continue;
+        Params p;
+        for (const std::string& line : lines) {
+            std::istringstream ls(line);
+            std::string key;
+            ls >> key;
+            if (key == "kernel") ls >> p.kernel;
+            else if (key == "gemm") ls >> p.mc >> p.kc >> p.nc;
+            else if (key == "sgemm") ls >> p.smc >> p.skc >> p.snc;
+            else if (key == "block") ls >> p.block;
+            else if (key == "grain") ls >> p.grain;
+            if (ls.fail()) return false;
+        }
+        return apply(p);
+    }
+    return false;
+}
+
+bool save(const Params& p, const std::string& path) {
+    const std::string model = cpuModel();
+    Sections sections = read(path);
+    std::vector<std::string> lines;
+    if (!p.kernel.empty()) lines.push_back("kernel " + p.kernel);
+    auto blocks = [](const char* key, ptrdiff_t mc, ptrdiff_t kc,
+                     ptrdiff_t nc) {
+        std::ostringstream os;
+        os << key << " " << mc << " " << kc << " " << nc;
+        return os.str();
+    };
+    lines.push_back(blocks("gemm", p.mc, p.kc, p.nc));
+    lines.push_back(blocks("sgemm", p.smc, p.skc, p.snc));
+    lines.push_back("block " + std::to_string(p.block));
+    lines.push_back("grain " + std::to_string(p.grain));
+    auto it = std::find_if(sections.begin(), sections.end(),
+                           [&](const auto& s) { return s.first == model; });
+    if (it != sections.end()) it->second = lines;
+    else
+        sections.push_back({model, lines});
+
+    std::ofstream os(path);
+    os << "# Matrix tuning cache, one [CPU model] section per host\n";
+    for (const auto& [name, body] : sections) {
+        os << "[" << name << "]\n";
+        for (const std::string& line : body) os << line << "\n";
+    }
+    return bool(os);
+}
+
+namespace {
+
+// Apply the cached entry for this host, or the heuristics, at load time
+const bool tuned = [] {
+    if (!load()) apply(heuristic());
+    return true;
+}();
+
+}  // namespace
+
+}  // namespace tuning
@@ -0,0 +1,370 @@
+// Copyright 2023 Caleb Magruder
+
+#include "VMath.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VMATH_X86
+#endif
+
+// The vector helpers below are always inlined into their target, so the
+// ABI of passing AVX vectors by value never applies
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace vmath {
+
+namespace {
+
+// GCC vector extensions: one source per function, compiled at the width
+// of each target below. Comparisons yield all-ones/zero integer lanes.
+typedef double d2 __attribute__((vector_size(16)));
+typedef int64_t i2 __attribute__((vector_size(16)));
+typedef double d4 __attribute__((vector_size(32)));
+typedef int64_t i4 __attribute__((vector_size(32)));
+typedef double d8 __attribute__((vector_size(64)));
+typedef int64_t i8 __attribute__((vector_size(64)));
+
+constexpr int64_t SIGN = INT64_MIN;
+
+// 2^n for the integer n held in the low bits of t = y + SHIFTER
+constexpr double SHIFTER = 0x1.8p52;
+
+template <typename V, typename I>
+[[gnu::always_inline]] inline V pow2(V t) {
+    return (V)(((I)t + 1023) << 52);
+}
+
+// exp(y) for 0 <= y <= 44, Cephes' Pade form on |r| <= ln(2)/2
+template <typename V, typename I>
+[[gnu::always_inline]] inline V expPade(V y) {
+    const V t = y * 1.4426950408889634073599 + SHIFTER;
+    const V n = t - SHIFTER;
+    V r = y - n * 6.93145751953125E-1;
+    r = r - n * 1.42860682030941723212E-6;
+    const V rr = r * r;
+    const V p = r * ((1.26177193074810590878E-4 * rr
+                      + 3.02994407707441961300E-2) * rr
+                     + 9.99999999999999999910E-1);
+    const V q = ((3.00198505138664455042E-6 * rr
+                  + 2.52448340349684104192E-3) * rr
+                 + 2.27265548208155028766E-1) * rr
+                + 2.00000000000000000009E0;
+    return (1.0 + 2.0 * p / (q - p)) * pow2<V, I>(t);
+}
+
+// exp(y) for 0 <= y <= 40, degree 7 Taylor polynomial on |r| <= ln(2)/2,
+// relative error below 5e-9
+template <typename V, typename I>
+[[gnu::always_inline]] inline V expTaylor(V y) {
+    const V t = y * 1.4426950408889634073599 + SHIFTER;
+    const V r = y - (t - SHIFTER) * 0.6931471805599453094172;
+    V p = 1.0 / 5040 * r + 1.0 / 720;
+    p = p * r + 1.0 / 120;
+    p = p * r + 1.0 / 24;
+    p = p * r + 1.0 / 6;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+    return p * pow2<V, I>(t);
+}
+
+// tanh, at most 4 ulp. Cephes' rational form below 0.625,
+// 1 - 2 / (exp(2|x|) + 1) above, both computed for every lane.
+template <typename V, typename I>
+[[gnu::always_inline]] inline V tanhLow(V x) {
+    const V a = (V)((I)x & ~SIGN);
+    const V z = a * a;
+    const V p = (-9.64399179425052238628E-1 * z
+                 - 9.92877231001918586564E1) * z
+                - 1.61468768441708447952E3;
+    const V q = ((z + 1.12811678491632931402E2) * z
+                 + 2.23548839060100448583E3) * z
+                + 4.84406305325125486048E3;
+    const V small = a + a * z * (p / q);
+    // tanh(22) rounds to 1, clamp so exp cannot overflow (NaN passes)
+    const V e = expPade<V, I>(2.0 * (a > 22.0 ? 22.0 : a));
+    const V large = 1.0 - 2.0 / (e + 1.0);
+    const V r = a < 0.625 ? small : large;
+    return (V)((I)r | ((I)x & SIGN));
+}
+
+// tanh, relative error below 1e-8 with a single division: Pade (5, 4)
+// below 0.625, (e - 1) / (e + 1) with e = exp(2|x|) above
+template <typename V, typename I>
+[[gnu::always_inline]] inline V tanhFast(V x) {
+    const V a = (V)((I)x & ~SIGN);
+    const V z = a * a;
+    // Above 20, e +- 1 rounds to e and the quotient is exactly 1
+    const V e = expTaylor<V, I>(2.0 * (a > 20.0 ? 20.0 : a));
+    const I lt = a < 0.625;
+    const V num = lt ? a * ((z + 105.0) * z + 945.0) : e - 1.0;
+    const V den = lt ? (15.0 * z + 420.0) * z + 945.0 : e + 1.0;
+    return (V)((I)(num / den) | ((I)x & SIGN));
+}
+
+// log(x) for normal x > 0, Cephes' rational form on [sqrt(1/2), sqrt(2))
+template <typename V, typename I>
+[[gnu::always_inline]] inline V log(V x) {
+    const I bits = (I)x;
+    // Exponent as a double through the shifter (the sign bit is clear),
+    // mantissa in [0.5, 1)
+    V e = (V)((bits >> 52) | (I)(V{} + SHIFTER)) - (SHIFTER + 1022.0);
+    V m = (V)((bits & 0x000fffffffffffff) | 0x3fe0000000000000);
+    const I small = m < 0.70710678118654752440;
+    e = small ? e - 1.0 : e;
+    m = small ? m + m - 1.0 : m - 1.0;
+    const V z = m * m;
+    const V p = ((((1.01875663804580931796E-4 * m
+                    + 4.97494994976747001425E-1) * m
+                   + 4.70579119878881725854E0) * m
+                  + 1.44989225341610930846E1) * m
+                 + 1.79368678507819816313E1) * m
+                + 7.70838733755885391666E0;
+    const V q = ((((m + 1.12873587189167450590E1) * m
+                   + 4.52279145837532221105E1) * m
+                  + 8.29875266912776603211E1) * m
+                 + 7.11544750618563894466E1) * m
+                + 2.31251620126765340583E1;
+    const V y = m * (z * p / q) - e * 2.121944400546905827679E-4 - 0.5 * z;
+    return m + y + e * 0.693359375;
+}
+
+// sin(2 pi u) and cos(2 pi u) for 0 <= u <= 1. The quadrant comes off u
+// exactly, Cephes' polynomials cover the remainder in [-pi/4, pi/4].
+template <typename V, typename I>
+[[gnu::always_inline]] inline void sincos2pi(V u, V* s, V* c) {
+    const V t = 4.0 * u + SHIFTER;
+    const I quadrant = (I)t;
+    const V x = (u - 0.25 * (t - SHIFTER)) * 6.28318530717958647693;
+    const V z = x * x;
+    const V sp = ((((1.58962301576546568060E-10 * z
+                     - 2.50507477628578072866E-8) * z
+                    + 2.75573136213857245213E-6) * z
+                   - 1.98412698295895385996E-4) * z
+                  + 8.33333333332211858878E-3) * z
+                 - 1.66666666666666307295E-1;
+    const V cp = ((((-1.13585365213876817300E-11 * z
+                     + 2.08757008419747316778E-9) * z
+                    - 2.75573141792967388112E-7) * z
+                   + 2.48015872888517045348E-5) * z
+                  - 1.38888888888730564116E-3) * z
+                 + 4.16666666666665929218E-2;
+    const I sx = (I)(x + x * z * sp);
+    const I cx = (I)(1.0 - 0.5 * z + z * z * cp);
+    // Rotate by quadrant * pi / 2: odd quadrants swap sin and cos, sin is
+    // negative in quadrants 2 and 3, cos in 1 and 2
+    const I swap = -(quadrant & 1);
+    const I sign = quadrant << 62;
+    *s = (V)(((sx & ~swap) | (cx & swap)) ^ (sign & SIGN));
+    *c = (V)(((cx & ~swap) | (sx & swap)) ^ ((sign ^ (quadrant << 63)) & SIGN));
+}
+
+// Box-Muller on a vector of uniform pairs
+template <typename V, typename I>
+[[gnu::always_inline]] inline void boxMuller(V u1, V u2, V* z0, V* z1) {
+    const V l = -2.0 * log<V, I>(u1);
+    V r;
+    for (size_t j = 0; j < sizeof(V) / sizeof(double); j++)
+        r[j] = std::sqrt(l[j]);
+    V s, c;
+    sincos2pi<V, I>(u2, &s, &c);
+    *z0 = r * c;
+    *z1 = r * s;
+}
+
+// y[0:n] = F(x[0:n]), a vector at a time, the tail through a padded vector
+template <typename V, V (*F)(V)>
+[[gnu::always_inline]] inline void apply(const ptrdiff_t n, const double* x,
+                                         double* y) {
+    constexpr ptrdiff_t W = sizeof(V) / sizeof(double);
+    ptrdiff_t i = 0;
+    for (; i + W <= n; i += W) {
+        V v;
+        std::memcpy(&v, x + i, sizeof(V));
+        v = F(v);
+        std::memcpy(y + i, &v, sizeof(V));
+    }
+    if (i < n) {
+        V v = {};
+        std::memcpy(&v, x + i, (n - i) * sizeof(double));
+        v = F(v);
+        std::memcpy(y + i, &v, (n - i) * sizeof(double));
+    }
+}
+
+// boxMuller(n, u1, u2, z0, z1), a vector at a time
+template <typename V, typename I>
+[[gnu::always_inline]] inline void gaussian(const ptrdiff_t n,
+                                            const double* u1,
+                                            const double* u2, double* z0,
+                                            double* z1) {
+    constexpr ptrdiff_t W = sizeof(V) / sizeof(double);
+    ptrdiff_t i = 0;
+    for (; i + W <= n; i += W) {
+        V a, b, x, y;
+        std::memcpy(&a, u1 + i, sizeof(V));
+        std::memcpy(&b, u2 + i, sizeof(V));
+        boxMuller<V, I>(a, b, &x, &y);
+        std::memcpy(z0 + i, &x, sizeof(V));
+        std::memcpy(z1 + i, &y, sizeof(V));
+    }
+    if (i < n) {
+        V a = V{} + 1.0, b = {}, x, y;
+        std::memcpy(&a, u1 + i, (n - i) * sizeof(double));
+        std::memcpy(&b, u2 + i, (n - i) * sizeof(double));
+        boxMuller<V, I>(a, b, &x, &y);
+        std::memcpy(z0 + i, &x, (n - i) * sizeof(double));
+        std::memcpy(z1 + i, &y, (n - i) * sizeof(double));
+    }
+}
+
+typedef void (*Fn)(const ptrdiff_t n, const double* x, double* y);
+typedef void (*Fn2)(const ptrdiff_t n, const double* u1, const double* u2,
+                    double* z0, double* z1);
+
+void tanhLowGeneric(const ptrdiff_t n, const double* x, double* y) {
+    apply<d2, tanhLow<d2, i2>>(n, x, y);
+}
+
+void tanhFastGeneric(const ptrdiff_t n, const double* x, double* y) {
+    apply<d2, tanhFast<d2, i2>>(n, x, y);
+}
+
+void boxMullerGeneric(const ptrdiff_t n, const double* u1, const double* u2,
+                      double* z0, double* z1) {
+    gaussian<d2, i2>(n, u1, u2, z0, z1);
+}
+
+#ifdef VMATH_X86
+
+__attribute__((target("avx2,fma")))
+void tanhLowAVX2(const ptrdiff_t n, const double* x, double* y) {
+    apply<d4, tanhLow<d4, i4>>(n, x, y);
+}
+
+__attribute__((target("avx2,fma")))
+void tanhFastAVX2(const ptrdiff_t n, const double* x, double* y) {
+    apply<d4, tanhFast<d4, i4>>(n, x, y);
+}
+
+__attribute__((target("avx2,fma")))
+void boxMullerAVX2(const ptrdiff_t n, const double* u1, const double* u2,
+                   double* z0, double* z1) {
+    gaussian<d4, i4>(n, u1, u2, z0, z1);
+}
+
+__attribute__((target("avx512f")))
+void tanhLowAVX512(const ptrdiff_t n, const double* x, double* y) {
+    apply<d8, tanhLow<d8, i8>>(n, x, y);
+}
+
+__attribute__((target("avx512f")))
+void tanhFastAVX512(const ptrdiff_t n, const double* x, double* y) {
+    apply<d8, tanhFast<d8, i8>>(n, x, y);
+}
+
+__attribute__((target("avx512f")))
+void boxMullerAVX512(const ptrdiff_t n, const double* u1, const double* u2,
+                     double* z0, double* z1) {
+    gaussian<d8, i8>(n, u1, u2, z0, z1);
+}
+
+#endif  // VMATH_X86
+
+// SIMD kernels per accuracy mode
+struct Kernel {
+    const char* name;
+    Fn tanhLow, tanhFast;
+    Fn2 boxMuller;
+};
+
+// Ordered by preference, the first supported kernel is selected
+const Kernel kernels[] = {
+#ifdef VMATH_X86
+    {"avx512", tanhLowAVX512, tanhFastAVX512, boxMullerAVX512},
+    {"avx2", tanhLowAVX2, tanhFastAVX2, boxMullerAVX2},
+#endif
+    {"generic", tanhLowGeneric, tanhFastGeneric, boxMullerGeneric},
+};
+
+bool supported(const Kernel& K) {
+#ifdef VMATH_X86
+    if (std::strcmp(K.name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512f");
+    if (std::strcmp(K.name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    return std::strcmp(K.name, "generic") == 0;
+}
+
+const Kernel* detect() {
+    for (const Kernel& K : kernels) {
+        if (supported(K)) return &K;
+    }
+    return nullptr;  // Unreachable, generic is always supported
+}
+
+std::atomic<const Kernel*>& active() {
+    static std::atomic<const Kernel*> K{detect()};
+    return K;
+}
+
+}  // namespace
+
+void tanh(const ptrdiff_t n, const double* x, double* y,
+          const Accuracy mode) {
+    switch (mode) {
+        case HIGH:
+            for (ptrdiff_t i = 0; i < n; i++) y[i] = std::tanh(x[i]);
+            break;
+        case LOW:
+            active().load()->tanhLow(n, x, y);
+            break;
+        case FAST:
+            active().load()->tanhFast(n, x, y);
+            break;
+    }
+}
+
+void tanh(const ptrdiff_t n, const float* x, float* y,
+          const Accuracy mode) {
+    if (mode == HIGH) {
+        for (ptrdiff_t i = 0; i < n; i++) y[i] = std::tanh(x[i]);
+        return;
+    }
+    // Widen a chunk at a time through the double kernels, whose error is
+    // far below a float ulp
+    constexpr ptrdiff_t CHUNK = 512;
+    double buf[CHUNK];
+    for (ptrdiff_t i0 = 0; i0 < n; i0 += CHUNK) {
+        const ptrdiff_t len = n - i0 < CHUNK ? n - i0 : CHUNK;
+        for (ptrdiff_t i = 0; i < len; i++) buf[i] = x[i0 + i];
+        tanh(len, buf, buf, mode);
+        for (ptrdiff_t i = 0; i < len; i++) y[i0 + i] = buf[i];
+    }
+}
+
+void boxMuller(const ptrdiff_t n, const double* u1, const double* u2,
+               double* z0, double* z1) {
+    active().load()->boxMuller(n, u1, u2, z0, z1);
+}
+
+const char* kernel() {
+    return active().load()->name;
+}
+
+bool kernel(const char* name) {
+    for (const Kernel& K : kernels) {
+        if (std::strcmp(K.name, name) == 0 && supported(K)) {
+            active().store(&K);
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace vmath
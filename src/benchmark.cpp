@@ -2,36 +2,590 @@
 
 /*
 Benchmark Matrix Multiply
+
+Per-operation benchmarks (op/<name><T, S>/N) report FLOP/s and B/s
+counters for (N x N) operands allocated outside the timed loop, and the
+threads/... variants repeat them at 1, 2, 4, ... threads.
 */
 
+#include <algorithm>
 #include <iostream>
+#include <random>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "Batch.h"
+#include "FixedMatrix.h"
 #include "Matrix.h"
+#include "Sparse.h"
 
 #include "benchmark/benchmark.h"
 
-template <BLAS T>
+template <BLAS T, typename S = double>
 void matrixSquared(benchmark::State& state) {  // NOLINT
     const int N = state.range(0);
-    Matrix<T> A(N, N);
+    Matrix<T, S> A(N, N);
+    for (auto _ : state) {
+        Matrix<T, S> B = A * A;
+    }
+}
+
+template <BLAS T>
+void matrixAllocate(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    for (auto _ : state) {
+        Matrix<T> A(N, N);
+        benchmark::DoNotOptimize(static_cast<double*>(A));
+    }
+}
+
+// Batches of BATCH independent (N x N) products
+constexpr int BATCH = 1024;
+
+template <BLAS T>
+std::vector<Matrix<T>> batch(const int N) {
+    std::vector<Matrix<T>> A;
+    for (int b = 0; b < BATCH; b++) A.push_back(Matrix<T>::randn(N, N));
+    return A;
+}
+
+// One mprod per product
+template <BLAS T>
+void matrixBatchLoop(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    std::vector<Matrix<T>> A = batch<T>(N), C = batch<T>(N);
     for (auto _ : state) {
-        Matrix<T> B = A * A;
+        for (int b = 0; b < BATCH; b++) mprod(A[b], A[b], &C[b]);
     }
+    state.SetItemsProcessed(state.iterations() * BATCH);
 }
 
+// mprod_batched over arrays of matrices
+template <BLAS T>
+void matrixBatched(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    std::vector<Matrix<T>> A = batch<T>(N), C = batch<T>(N);
+    for (auto _ : state) {
+        mprod_batched(A.data(), A.data(), C.data(), BATCH);
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+// mprod_batched over an interleaved Batch<T>
+template <BLAS T>
+void matrixBatchedInterleaved(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Batch<T> A(BATCH, N, N), C(BATCH, N, N);
+    for (int b = 0; b < BATCH; b++) A.set(b, Matrix<T>::randn(N, N));
+    for (auto _ : state) {
+        mprod_batched(A, A, &C);
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+// Y = X^T, (N x N)
+template <BLAS T>
+void matrixTranspose(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Matrix<T> X(N, N), Y(N, N);
+    for (auto _ : state) {
+        transpose(X, &Y);
+    }
+    state.SetBytesProcessed(state.iterations() * 2 * sizeof(double) * N * N);
+}
+
+// X = X^T in place, (N x N) or (N x N/2)
+template <BLAS T>
+void matrixTransposeInPlace(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0), n = state.range(1) ? N / 2 : N;
+    Matrix<T> X(N, n);
+    for (auto _ : state) {
+        transpose(&X);
+    }
+    state.SetBytesProcessed(state.iterations() * 2 * sizeof(double) * N * n);
+}
+
+// tanh(&A, mode) over N elements, one row
+template <BLAS T, vmath::Accuracy mode>
+void matrixTanh(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Matrix<T> A = Matrix<T>::randn(1, N);
+    for (auto _ : state) {
+        tanh(&A, mode);
+        benchmark::DoNotOptimize(static_cast<double*>(A));
+    }
+    state.SetItemsProcessed(state.iterations() * N);
+}
+
+// Dense layer Y = tanh(W * X + b), W is (N x N) and X holds 256 columns
+// Unfused: product, bias (mger with a ones row) and tanh as three passes
+template <BLAS T, bool fused>
+void denseLayer(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0), batch = 256;
+    Matrix<T> W = Matrix<T>::randn(N, N), X = Matrix<T>::randn(N, batch);
+    Matrix<T> b = Matrix<T>::randn(N, 1), ones(batch, 1), Y(N, batch);
+    ones.fill(1);
+    for (auto _ : state) {
+        if (fused) {
+            mprod(false, false, 1.0, W, X, 0.0, &Y, b, gemm::Epilogue::tanh());
+        } else {
+            mprod(W, X, &Y);
+            mger(1.0, b, ones, &Y);
+            tanh(&Y);
+        }
+        benchmark::DoNotOptimize(static_cast<double*>(Y));
+    }
+    state.SetItemsProcessed(state.iterations() * 2 * N * N * batch);
+}
+
+// y = A * x for an (N x N) matrix with 1% nonzeros, sparse or dense
+template <BLAS T, bool sparse>
+void sparseMatVec(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    std::mt19937 gen(N);
+    std::uniform_int_distribution<ptrdiff_t> u(0, N - 1);
+    std::vector<ptrdiff_t> rows(N * N / 100), cols(rows.size());
+    for (size_t k = 0; k < rows.size(); k++) {
+        rows[k] = u(gen);
+        cols[k] = u(gen);
+    }
+    Sparse<T> A(N, N, rows, cols, std::vector<double>(rows.size(), 1.0));
+    Matrix<T> D = A.dense(), x = Matrix<T>::randn(N), y(N);
+    for (auto _ : state) {
+        if (sparse) mprod(A, x, &y);
+        else        mprod(D, x, &y);
+        benchmark::DoNotOptimize(static_cast<double*>(y));
+    }
+    state.SetItemsProcessed(state.iterations() * 2 * A.nnz());
+}
+
+// (N x N) product with compile-time dimensions and inline storage
+template <ptrdiff_t N>
+void fixedSquared(benchmark::State& state) {  // NOLINT
+    FixedMatrix<N, N> A = FixedMatrix<N, N>::identity();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(A);
+        FixedMatrix<N, N> B = A * A;
+        benchmark::DoNotOptimize(B);
+    }
+}
+
+/////////////////////////////////////////
+// Per-operation suite
+/////////////////////////////////////////
+
+// FLOP/s and B/s from the floating point operations and bytes moved by
+// one iteration
+void rates(benchmark::State& state, double flops, double bytes) {  // NOLINT
+    using benchmark::Counter;
+    if (flops > 0) {
+        state.counters["FLOP/s"] = Counter(flops,
+            Counter::kIsIterationInvariantRate, Counter::OneK::kIs1000);
+    }
+    state.counters["B/s"] = Counter(bytes,
+        Counter::kIsIterationInvariantRate, Counter::OneK::kIs1000);
+}
+
+// Runs at the thread count in range(1), if nonzero, restoring it after
+class Threads {
+ public:
+    explicit Threads(const benchmark::State& state)
+            : _threads(getNumThreads()) {
+        if (state.range(1) > 0) setNumThreads(state.range(1));
+    }
+    ~Threads() { setNumThreads(_threads); }
+
+ private:
+    const int _threads;
+};
+
+// C = op(A) * op(B)
+template <BLAS T, typename S, bool transA, bool transB>
+void opMprod(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), B = Matrix<T, S>::randn(N, N);
+    Matrix<T, S> C(N, N);
+    for (auto _ : state) {
+        mprod(transA, transB, 1.0, A, B, 0.0, &C);
+        benchmark::DoNotOptimize(static_cast<S*>(C));
+    }
+    rates(state, 2. * N * N * N, 3. * N * N * sizeof(S));
+}
+
+// y = A * x
+template <BLAS T, typename S>
+void opMgemv(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), x = Matrix<T, S>::randn(N);
+    Matrix<T, S> y(N);
+    for (auto _ : state) {
+        mprod(A, x, &y);
+        benchmark::DoNotOptimize(static_cast<S*>(y));
+    }
+    rates(state, 2. * N * N, (N + 2.) * N * sizeof(S));
+}
+
+// B += alpha * A
+template <BLAS T, typename S>
+void opMaxpy(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), B = Matrix<T, S>::randn(N, N);
+    for (auto _ : state) {
+        maxpy(1e-9, A, 1, &B);
+        benchmark::DoNotOptimize(static_cast<S*>(B));
+    }
+    rates(state, 2. * N * N, 3. * N * N * sizeof(S));
+}
+
+// A += alpha * x * y^T
+template <BLAS T, typename S>
+void opMger(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N);
+    Matrix<T, S> x = Matrix<T, S>::randn(N), y = Matrix<T, S>::randn(N);
+    for (auto _ : state) {
+        mger(1e-9, x, y, &A);
+        benchmark::DoNotOptimize(static_cast<S*>(A));
+    }
+    rates(state, 2. * N * N, 2. * N * N * sizeof(S));
+}
+
+// C = A .* B
+template <BLAS T, typename S>
+void opHprod(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), B = Matrix<T, S>::randn(N, N);
+    Matrix<T, S> C(N, N);
+    for (auto _ : state) {
+        hprod(A, B, &C);
+        benchmark::DoNotOptimize(static_cast<S*>(C));
+    }
+    rates(state, 1. * N * N, 3. * N * N * sizeof(S));
+}
+
+// C = A - B
+template <BLAS T, typename S>
+void opMsub(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), B = Matrix<T, S>::randn(N, N);
+    Matrix<T, S> C(N, N);
+    for (auto _ : state) {
+        msub(A, B, &C);
+        benchmark::DoNotOptimize(static_cast<S*>(C));
+    }
+    rates(state, 1. * N * N, 3. * N * N * sizeof(S));
+}
+
+// dot(A, B)
+template <BLAS T, typename S>
+void opDot(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), B = Matrix<T, S>::randn(N, N);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(dot(A, B));
+    }
+    rates(state, 2. * N * N, 2. * N * N * sizeof(S));
+}
+
+// norm(A)
+template <BLAS T, typename S>
+void opNorm(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(norm(A));
+    }
+    rates(state, 2. * N * N, 1. * N * N * sizeof(S));
+}
+
+// sum(A)
+template <BLAS T, typename S>
+void opSum(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sum(A));
+    }
+    rates(state, 1. * N * N, 1. * N * N * sizeof(S));
+}
+
+// rowSum(A, &y) (rows) or colSum(A, &y)
+template <BLAS T, typename S, bool ROWS>
+void opLineSum(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), y(N, 1);
+    for (auto _ : state) {
+        if (ROWS) {
+            rowSum(A, &y);
+        } else {
+            colSum(A, &y);
+        }
+        benchmark::ClobberMemory();
+    }
+    rates(state, 1. * N * N, 1. * N * N * sizeof(S));
+}
+
+// rowArgmax(A, index)
+template <BLAS T, typename S>
+void opRowArgmax(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N);
+    std::vector<ptrdiff_t> index(N);
+    for (auto _ : state) {
+        rowArgmax(A, index.data());
+        benchmark::ClobberMemory();
+    }
+    rates(state, 1. * N * N, 1. * N * N * sizeof(S));
+}
+
+// badd(&A, b), b a (1 x n) row added to every row
+template <BLAS T, typename S>
+void opBadd(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), b = Matrix<T, S>::randn(1, N);
+    for (auto _ : state) {
+        badd(&A, b);
+        benchmark::ClobberMemory();
+    }
+    rates(state, 1. * N * N, 2. * N * N * sizeof(S));
+}
+
+// tanh(&A), in place; FLOP/s counts one per element
+template <BLAS T, typename S>
+void opTanh(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N);
+    for (auto _ : state) {
+        tanh(&A);
+        benchmark::DoNotOptimize(static_cast<S*>(A));
+    }
+    rates(state, 1. * N * N, 2. * N * N * sizeof(S));
+}
+
+// Y = X^T
+template <BLAS T, typename S>
+void opTranspose(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> X = Matrix<T, S>::randn(N, N), Y(N, N);
+    for (auto _ : state) {
+        transpose(X, &Y);
+        benchmark::DoNotOptimize(static_cast<S*>(Y));
+    }
+    rates(state, 0, 2. * N * N * sizeof(S));
+}
+
+// B = A
+template <BLAS T, typename S>
+void opMcopy(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), B(N, N);
+    for (auto _ : state) {
+        mcopy(A, &B);
+        benchmark::DoNotOptimize(static_cast<S*>(B));
+    }
+    rates(state, 0, 2. * N * N * sizeof(S));
+}
+
+// A = randn(N, N), allocation included (served by the pool after the
+// first iteration)
+template <BLAS T, typename S>
+void opRandn(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Threads threads(state);
+    for (auto _ : state) {
+        Matrix<T, S> A = Matrix<T, S>::randn(N, N);
+        benchmark::DoNotOptimize(static_cast<S*>(A));
+    }
+    rates(state, 0, 1. * N * N * sizeof(S));
+}
+
+// os << A, then is >> B, through memory
+template <BLAS T, typename S>
+void opSerialize(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    Matrix<T, S> A = Matrix<T, S>::randn(N, N), B(N, N);
+    std::stringstream ss;
+    for (auto _ : state) {
+        ss.seekp(0);
+        ss.seekg(0);
+        ss << A;
+        ss >> B;
+        benchmark::DoNotOptimize(static_cast<S*>(B));
+    }
+    rates(state, 0, 2. * N * N * sizeof(S));
+}
+
+// Matrix<T, S> A(N, N) alone
+template <BLAS T, typename S>
+void opAlloc(benchmark::State& state) {  // NOLINT
+    const int N = state.range(0);
+    for (auto _ : state) {
+        Matrix<T, S> A(N, N);
+        benchmark::DoNotOptimize(static_cast<S*>(A));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Powers of two up to the hardware concurrency
+std::vector<int64_t> threadCounts() {
+    std::vector<int64_t> counts;
+    const int64_t hw = std::max(1u, std::thread::hardware_concurrency());
+    for (int64_t t = 1; t < hw; t *= 2) counts.push_back(t);
+    counts.push_back(hw);
+    return counts;
+}
+
+// The suite for one backend and precision. Level 3 sweeps N to 1024,
+// level 1 and 2 to 4096 (past the last level cache), and thread scaling
+// runs at the largest size.
+template <BLAS T, typename S>
+void registerSuite() {
+    std::ostringstream os;
+    os << "<" << T << (std::is_same_v<S, float> ? ", float>" : ">");
+    const std::string type = os.str();
+    // Thread count 0 keeps the current one, see Threads
+    auto add = [&](const char* name, void (*fn)(benchmark::State&),
+                   int64_t lo, int64_t hi) {
+        benchmark::RegisterBenchmark(("op/" + (name + type)).c_str(), fn)
+            ->ArgsProduct({benchmark::CreateRange(lo, hi, 4), {0}});
+    };
+    auto scale = [&](const char* name, void (*fn)(benchmark::State&),
+                     int64_t n) {
+        benchmark::RegisterBenchmark(("threads/" + (name + type)).c_str(), fn)
+            ->ArgsProduct({{n}, threadCounts()})->UseRealTime();
+    };
+    add("mprodNN", opMprod<T, S, false, false>, 16, 1024);
+    add("mprodTN", opMprod<T, S, true, false>, 16, 1024);
+    add("mprodNT", opMprod<T, S, false, true>, 16, 1024);
+    add("mprodTT", opMprod<T, S, true, true>, 16, 1024);
+    add("mgemv", opMgemv<T, S>, 16, 4096);
+    add("maxpy", opMaxpy<T, S>, 16, 4096);
+    add("mger", opMger<T, S>, 16, 4096);
+    add("hprod", opHprod<T, S>, 16, 4096);
+    add("msub", opMsub<T, S>, 16, 4096);
+    add("dot", opDot<T, S>, 16, 4096);
+    add("norm", opNorm<T, S>, 16, 4096);
+    add("sum", opSum<T, S>, 16, 4096);
+    add("rowSum", opLineSum<T, S, true>, 16, 4096);
+    add("colSum", opLineSum<T, S, false>, 16, 4096);
+    add("rowArgmax", opRowArgmax<T, S>, 16, 4096);
+    add("badd", opBadd<T, S>, 16, 4096);
+    add("tanh", opTanh<T, S>, 16, 4096);
+    add("transpose", opTranspose<T, S>, 16, 4096);
+    add("mcopy", opMcopy<T, S>, 16, 4096);
+    add("randn", opRandn<T, S>, 16, 4096);
+    add("serialize", opSerialize<T, S>, 16, 4096);
+    add("alloc", opAlloc<T, S>, 16, 4096);
+    scale("mprodNN", opMprod<T, S, false, false>, 1024);
+    scale("mgemv", opMgemv<T, S>, 4096);
+    scale("maxpy", opMaxpy<T, S>, 4096);
+    scale("tanh", opTanh<T, S>, 4096);
+    scale("transpose", opTranspose<T, S>, 4096);
+}
+
+// Registered before BENCHMARK_MAIN parses the filter
+const bool suite = [] {
+    registerSuite<REF, double>();
+    registerSuite<REF, float>();
+    registerSuite<AUTO, double>();
+    registerSuite<AUTO, float>();
+#if ACC_FOUND
+    registerSuite<ACC, double>();
+    registerSuite<ACC, float>();
+#endif
+#if OPB_FOUND
+    registerSuite<OPB, double>();
+    registerSuite<OPB, float>();
+#endif
+#if MKL_FOUND
+    registerSuite<MKL, double>();
+    registerSuite<MKL, float>();
+#endif
+    return true;
+}();
+
 BENCHMARK_TEMPLATE(matrixSquared, REF)->Range(4, 256);
+BENCHMARK_TEMPLATE(matrixSquared, REF, float)->Range(4, 256);
+BENCHMARK_TEMPLATE(fixedSquared, 4);
+BENCHMARK_TEMPLATE(fixedSquared, 8);
+BENCHMARK_TEMPLATE(matrixBatchLoop, REF)->RangeMultiplier(2)->Range(4, 16);
+BENCHMARK_TEMPLATE(matrixBatched, REF)->RangeMultiplier(2)->Range(4, 16);
+BENCHMARK_TEMPLATE(matrixBatchedInterleaved, REF)
+    ->RangeMultiplier(2)->Range(4, 16);
+BENCHMARK_TEMPLATE(matrixAllocate, REF)->Range(4, 1024);
+BENCHMARK_TEMPLATE(matrixTranspose, REF)->Range(64, 4096);
+BENCHMARK_TEMPLATE(matrixTransposeInPlace, REF)
+    ->ArgsProduct({benchmark::CreateRange(64, 4096, 8), {0, 1}});
+BENCHMARK_TEMPLATE(matrixTanh, REF, vmath::HIGH)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(matrixTanh, REF, vmath::LOW)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(matrixTanh, REF, vmath::FAST)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(denseLayer, REF, false)->Range(16, 512);
+BENCHMARK_TEMPLATE(denseLayer, REF, true)->Range(16, 512);
+BENCHMARK_TEMPLATE(sparseMatVec, REF, false)->Range(256, 4096);
+BENCHMARK_TEMPLATE(sparseMatVec, REF, true)->Range(256, 4096);
+
+// Dispatch table from dispatch::cachePath(), or the defaults
+BENCHMARK_TEMPLATE(matrixSquared, AUTO)->Range(4, 256);
+BENCHMARK_TEMPLATE(matrixSquared, AUTO, float)->Range(4, 256);
+BENCHMARK_TEMPLATE(denseLayer, AUTO, false)->Range(16, 512);
 
 #if ACC_FOUND
 BENCHMARK_TEMPLATE(matrixSquared, ACC)->Range(4, 256);
+BENCHMARK_TEMPLATE(matrixSquared, ACC, float)->Range(4, 256);
+BENCHMARK_TEMPLATE(matrixBatchLoop, ACC)->RangeMultiplier(2)->Range(4, 16);
+BENCHMARK_TEMPLATE(matrixBatched, ACC)->RangeMultiplier(2)->Range(4, 16);
+BENCHMARK_TEMPLATE(matrixTanh, ACC, vmath::HIGH)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(matrixTanh, ACC, vmath::LOW)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(matrixTanh, ACC, vmath::FAST)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(denseLayer, ACC, false)->Range(16, 512);
+BENCHMARK_TEMPLATE(denseLayer, ACC, true)->Range(16, 512);
+BENCHMARK_TEMPLATE(sparseMatVec, ACC, false)->Range(256, 4096);
+BENCHMARK_TEMPLATE(sparseMatVec, ACC, true)->Range(256, 4096);
 #endif
 
 #if OPB_FOUND
 BENCHMARK_TEMPLATE(matrixSquared, OPB)->Range(4, 256);
+BENCHMARK_TEMPLATE(matrixSquared, OPB, float)->Range(4, 256);
+BENCHMARK_TEMPLATE(matrixBatchLoop, OPB)->RangeMultiplier(2)->Range(4, 16);
+BENCHMARK_TEMPLATE(matrixBatched, OPB)->RangeMultiplier(2)->Range(4, 16);
+BENCHMARK_TEMPLATE(matrixTanh, OPB, vmath::HIGH)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(matrixTanh, OPB, vmath::LOW)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(matrixTanh, OPB, vmath::FAST)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(denseLayer, OPB, false)->Range(16, 512);
+BENCHMARK_TEMPLATE(denseLayer, OPB, true)->Range(16, 512);
+BENCHMARK_TEMPLATE(sparseMatVec, OPB, false)->Range(256, 4096);
+BENCHMARK_TEMPLATE(sparseMatVec, OPB, true)->Range(256, 4096);
 #endif
 
 #if MKL_FOUND
 BENCHMARK_TEMPLATE(matrixSquared, MKL)->Range(4, 256);
+BENCHMARK_TEMPLATE(matrixSquared, MKL, float)->Range(4, 256);
+BENCHMARK_TEMPLATE(matrixBatchLoop, MKL)->RangeMultiplier(2)->Range(4, 16);
+BENCHMARK_TEMPLATE(matrixBatched, MKL)->RangeMultiplier(2)->Range(4, 16);
+BENCHMARK_TEMPLATE(matrixTanh, MKL, vmath::HIGH)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(matrixTanh, MKL, vmath::LOW)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(matrixTanh, MKL, vmath::FAST)->Range(1024, 1 << 16);
+BENCHMARK_TEMPLATE(denseLayer, MKL, false)->Range(16, 512);
+BENCHMARK_TEMPLATE(denseLayer, MKL, true)->Range(16, 512);
+BENCHMARK_TEMPLATE(sparseMatVec, MKL, false)->Range(256, 4096);
+BENCHMARK_TEMPLATE(sparseMatVec, MKL, true)->Range(256, 4096);
 #endif
 
 BENCHMARK_MAIN();
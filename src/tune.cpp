@@ -0,0 +1,193 @@
+// Copyright 2023 Caleb Magruder
+
+/*
+Autotune the REF kernels on this host
+
+Searches the GEMM microkernel and cache blocks, the transpose tile and
+the element-wise grain, starting from tuning::heuristic(), and saves the
+best as this CPU model's entry in the tuning cache.
+
+Usage: tune [--size N] [--seconds S] [--cache PATH] [--dry-run]
+    --size N     GEMM and transpose dimension (default 1024)
+    --seconds S  Time per measurement (default 0.2)
+    --cache PATH Tuning cache (default tuning::cachePath())
+    --dry-run    Print the result without saving it
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Layout.h"
+#include "Matrix.h"
+#include "Tuning.h"
+
+namespace {
+
+ptrdiff_t size = 1024;
+double seconds = 0.2;
+
+// Best of three rounds of seconds / 3, in seconds per call
+double time(const std::function<void()>& f) {
+    using clock = std::chrono::steady_clock;
+    f();
+    double best = 0;
+    for (int round = 0; round < 3; round++) {
+        const auto start = clock::now();
+        std::chrono::duration<double> elapsed(0);
+        ptrdiff_t calls = 0;
+        do {
+            f();
+            calls++;
+            elapsed = clock::now() - start;
+        } while (elapsed.count() < seconds / 3);
+        const double t = elapsed.count() / calls;
+        if (round == 0 || t < best) best = t;
+    }
+    return best;
+}
+
+// The candidate of the lowest cost(), keeping value on ties within 2%
+ptrdiff_t search(const char* name, ptrdiff_t value,
+                 const std::vector<ptrdiff_t>& candidates,
+                 const std::function<double(ptrdiff_t)>& cost) {
+    double best = cost(value);
+    for (ptrdiff_t c : candidates) {
+        if (c == value) continue;
+        const double t = cost(c);
+        if (t < 0.98 * best) {
+            best = t;
+            value = c;
+        }
+    }
+    std::cout << "  " << name << " = " << value << std::endl;
+    return value;
+}
+
+// Seconds per (size x size) GEMM in precision S with the given blocks
+template <typename S>
+double gemmTime(ptrdiff_t mc, ptrdiff_t kc, ptrdiff_t nc) {
+    const bool single = std::is_same_v<S, float>;
+    const gemm::Blocking b = gemm::blocking(single);
+    gemm::blocking({b.mr, b.nr, mc, kc, nc}, single);
+    Matrix<REF, S> A = Matrix<REF, S>::randn(size, size);
+    Matrix<REF, S> B = Matrix<REF, S>::randn(size, size);
+    Matrix<REF, S> C(size, size);
+    return time([&] { mprod(A, B, &C); });
+}
+
+// Coordinate search of kc, then mc, then nc
+template <typename S>
+void tuneGemm(ptrdiff_t* mc, ptrdiff_t* kc, ptrdiff_t* nc) {
+    const gemm::Blocking b = gemm::blocking(std::is_same_v<S, float>);
+    std::vector<ptrdiff_t> kcs, mcs, ncs;
+    for (ptrdiff_t k : {64, 96, 128, 192, 256, 384, 512, 768, 1024})
+        kcs.push_back(k * sizeof(double) / sizeof(S));
+    *kc = search("kc", *kc, kcs, [&](ptrdiff_t k) {
+        return gemmTime<S>(*mc, k, *nc);
+    });
+    for (ptrdiff_t m = 4 * b.mr; m <= 128 * b.mr; m += m / 2)
+        mcs.push_back(m / b.mr * b.mr);
+    *mc = search("mc", *mc, mcs, [&](ptrdiff_t m) {
+        return gemmTime<S>(m, *kc, *nc);
+    });
+    for (ptrdiff_t n = 512; n <= 8192; n *= 2) ncs.push_back(n / b.nr * b.nr);
+    *nc = search("nc", *nc, ncs, [&](ptrdiff_t n) {
+        return gemmTime<S>(*mc, *kc, n);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string cache = tuning::cachePath();
+    bool dryRun = false;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--size") && i + 1 < argc) {
+            size = std::atol(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--cache") && i + 1 < argc) {
+            cache = argv[++i];
+        } else if (!std::strcmp(argv[i], "--dry-run")) {
+            dryRun = true;
+        } else {
+            std::cerr << "Usage: tune [--size N] [--seconds S] "
+                         "[--cache PATH] [--dry-run]" << std::endl;
+            return 1;
+        }
+    }
+    const tuning::Caches c = tuning::caches();
+    std::cout << tuning::cpuModel() << ": L1 " << c.l1 << ", L2 " << c.l2
+              << ", L3 " << c.l3 << ", " << getNumThreads() << " threads"
+              << std::endl;
+
+    // Microkernel (register tile) at the heuristic blocking of each
+    tuning::Params best;
+    double fastest = 0;
+    for (const char* name : {"avx512", "avx2", "generic"}) {
+        if (!gemm::kernel(name)) continue;
+        tuning::apply(tuning::heuristic());
+        const gemm::Blocking b = gemm::blocking();
+        const double t = gemmTime<double>(b.mc, b.kc, b.nc);
+        std::cout << "kernel " << name << ": "
+                  << 2e-9 * size * size * size / t << " GFLOP/s" << std::endl;
+        if (best.kernel.empty() || t < fastest) {
+            fastest = t;
+            best = tuning::current();
+        }
+    }
+    tuning::apply(best);
+
+    std::cout << "dgemm (" << best.kernel << ")" << std::endl;
+    tuneGemm<double>(&best.mc, &best.kc, &best.nc);
+    std::cout << "sgemm (" << best.kernel << ")" << std::endl;
+    tuneGemm<float>(&best.smc, &best.skc, &best.snc);
+
+    std::cout << "transpose" << std::endl;
+    {
+        Matrix<REF> A = Matrix<REF>::randn(size, size), B(size, size);
+        const std::vector<ptrdiff_t> blocks = {8, 16, 24, 32, 48, 64, 96, 128};
+        best.block = search("block", best.block, blocks, [&](ptrdiff_t b) {
+            layout::block(b);
+            return time([&] {
+                layout::transpose(size, size, A, size, B, size);
+            });
+        });
+        layout::block(best.block);
+    }
+
+    // The grain only matters with more than one thread: sizes around it
+    // are split or kept serial
+    std::cout << "element-wise" << std::endl;
+    if (getNumThreads() > 1) {
+        std::vector<ptrdiff_t> grains;
+        for (ptrdiff_t g = 1 << 12; g <= 1 << 20; g *= 2) grains.push_back(g);
+        best.grain = search("grain", best.grain, grains, [&](ptrdiff_t g) {
+            ThreadPool::grain(g);
+            double total = 0;
+            for (ptrdiff_t n = 1 << 12; n <= 1 << 21; n *= 4) {
+                Matrix<REF> x = Matrix<REF>::randn(n);
+                Matrix<REF> y = Matrix<REF>::randn(n);
+                total += time([&] { maxpy(1e-9, x, 1, &y); }) / n;
+            }
+            return total;
+        });
+    } else {
+        std::cout << "  grain = " << best.grain << " (single thread)"
+                  << std::endl;
+    }
+    tuning::apply(best);
+
+    if (dryRun) return 0;
+    if (!tuning::save(best, cache)) {
+        std::cerr << "Cannot write " << cache << std::endl;
+        return 1;
+    }
+    std::cout << "Saved to " << cache << std::endl;
+    return 0;
+}
@@ -1,17 +1,35 @@
 // Copyright 2023 Caleb Magruder
 
+#include <limits>
+#include <type_traits>
 #include <utility>  // std::move
 
 #pragma once
 
 namespace Semantics {
 
+// Tolerance of a few roundings in the element type of T
+template <typename T>
+double eps() {
+    return 16 * std::numeric_limits<typename T::Scalar>::epsilon();
+}
+
+// a == b in double precision, within eps<T>() * scale in single
+template <typename T>
+void expectEqual(double a, double b, double scale = 1) {
+    if constexpr (std::is_same_v<typename T::Scalar, float>) {
+        EXPECT_NEAR(a, b, eps<T>() * scale);
+    } else {
+        EXPECT_DOUBLE_EQ(a, b);
+    }
+}
+
 template <typename T>
 void empty(const T& e) {
     T A(e);
     EXPECT_EQ(A.rows(), 0);
     EXPECT_EQ(A.cols(), 0);
-    EXPECT_EQ(static_cast<double*>(A), nullptr);
+    EXPECT_EQ(static_cast<typename T::Scalar*>(A), nullptr);
 }
 
 template <typename T>
@@ -36,7 +54,7 @@ void copy(const T& b) {  // NOLINT [build/include_what_you_use]
     EXPECT_EQ(a, b);
 
     // Copy instance has distinct memory
-    static_cast<double*>(a)[0]++;
+    static_cast<typename S::Scalar*>(a)[0]++;
     EXPECT_FALSE(a == b);
 }
 
@@ -49,7 +67,7 @@ void equality(const T& b) {
     EXPECT_FALSE(a != b);
 
     // Compare unequal instances
-    static_cast<double*>(a)[0]++;
+    static_cast<typename S::Scalar*>(a)[0]++;
     EXPECT_FALSE(a == b);
     EXPECT_TRUE(a != b);
 
@@ -61,6 +79,7 @@ void equality(const T& b) {
 
 template <typename T>
 void scalarMultiply(const T& a) {
+    using S = typename T::Scalar;
     double alpha = 3.14;
 
     T x(a), y(a);
@@ -69,8 +88,8 @@ void scalarMultiply(const T& a) {
     alpha * x;
     const ptrdiff_t n = numel(a);
     for (ptrdiff_t i = 0; i < n; i++)  // NOLINT
-        EXPECT_EQ(alpha*static_cast<double*>(a)[i],
-                  static_cast<double*>(x)[i]);
+        EXPECT_EQ(static_cast<S>(alpha)*static_cast<S*>(a)[i],
+                  static_cast<S*>(x)[i]);
 
     // Move
     T z = alpha * y;
@@ -92,7 +111,7 @@ void additionEquals(const T& a) {
     EXPECT_EQ(x, y);
 
     // Verify distinct allocation
-    static_cast<double*>(x)[0]++;
+    static_cast<typename T::Scalar*>(x)[0]++;
     EXPECT_NE(x, y);
     EXPECT_THROW(y+=EMPTY, int);  // Wrong dims
 
@@ -110,7 +129,7 @@ void maxpy(const T& a) {
     T c(a.rows(), a.cols()), d(a.rows(), a.cols());
     c.fill(0);
     d.fill(1);
-    double two(2.0);
+    typename T::Scalar two(2.0);
     maxpy(0.5, &two, 0, &c);
 }
 
@@ -134,7 +153,7 @@ void mcopy(const T& a) {
     mcopy(a, &b);
     EXPECT_EQ(a, b);
 
-    double pi(3.14);
+    typename T::Scalar pi(3.14);
     T c(a.rows(), a.cols());
     T d(a.rows(), a.cols());
     c.fill(0);
@@ -162,7 +181,7 @@ void subtractionEquals(const T& a) {
     EXPECT_EQ(x, zeros);
 
     // Verify distinct allocation
-    static_cast<double*>(x)[0]++;
+    static_cast<typename T::Scalar*>(x)[0]++;
     EXPECT_NE(x, y);
     EXPECT_THROW(y -= EMPTY, int);  // Wrong dims
 
@@ -260,6 +279,50 @@ void subtraction(const T& a) {
     EXPECT_THROW(std::move(z)-x, int);  // Wrong dims
 }
 
+template <typename T>
+void expression(const T& a) {
+    T x(a), y(a);
+    2*y;  // Write-in-place
+
+    // Lazy add/subtract leave operands untouched
+    T z = x + y;
+    EXPECT_EQ(x, a);
+    EXPECT_EQ(z, 3*T(a));
+    z = y - x;
+    EXPECT_EQ(z, a);
+
+    // Assignment with matching dimensions writes in place
+    auto* ptr = static_cast<typename T::Scalar*>(z);
+    z = x + y - x;
+    EXPECT_EQ(static_cast<typename T::Scalar*>(z), ptr);
+    EXPECT_EQ(z, y);
+
+    // Fused chains evaluate element-wise
+    T w = 0.5 * hprod(x, y) + tanh(x - y);
+    for (ptrdiff_t i = 0; i < numel(a); i++) {
+        const double xi = static_cast<typename T::Scalar*>(x)[i];
+        const double yi = static_cast<typename T::Scalar*>(y)[i];
+        expectEqual<T>(static_cast<typename T::Scalar*>(w)[i],
+                       0.5 * xi * yi + std::tanh(xi - yi));
+    }
+
+    // lazy(A) is not scaled in place
+    z = 2.0 * lazy(x) + x;
+    EXPECT_EQ(x, a);
+    EXPECT_EQ(z, 3*T(a));
+
+    // Reallocates on shape mismatch
+    z = T(numel(a), 1);
+    z = x + y;
+    EXPECT_EQ(z.rows(), a.rows());
+    EXPECT_EQ(z.cols(), a.cols());
+
+    // Wrong dims
+    T v(numel(a), 1);
+    EXPECT_THROW(T(x + v), int);
+    EXPECT_THROW(T(hprod(x + y, v)), int);
+}
+
 template <typename S, typename T = S>
 void multiplication(const S& a, const T& b, const T& c) {
     T d = a*b;
@@ -303,8 +366,8 @@ void hadamardMultiplication(const T& a, const T&b, const T& c) {
     T d(a);
     hprod(d, b, &d);
     for (ptrdiff_t i = 0; i < numel(b); i++)
-        EXPECT_EQ(static_cast<double*>(d)[i],
-                  static_cast<double*>(c)[i]);
+        EXPECT_EQ(static_cast<typename T::Scalar*>(d)[i],
+                  static_cast<typename T::Scalar*>(c)[i]);
 }
 
 template <typename T>
@@ -313,8 +376,120 @@ void fill() {
     double alpha = 3.14;
     x.fill(alpha);
     for (ptrdiff_t i = 0; i < x._m*x._n; i++) {
-        EXPECT_EQ(static_cast<double*>(x)[i], alpha);
+        EXPECT_EQ(static_cast<typename T::Scalar*>(x)[i],
+                  static_cast<typename T::Scalar>(alpha));
     }
 }
 
+template <typename T>
+void view() {
+    ptrdiff_t m = 6, n = 5;
+    T X(m, n);
+    for (ptrdiff_t i = 0; i < m*n; i++)
+        static_cast<typename T::Scalar*>(X)[i] = i;
+
+    // Block reads through to X
+    auto B = X.block(1, 2, 3, 2);
+    EXPECT_EQ(B.rows(), 3);
+    EXPECT_EQ(B.cols(), 2);
+    EXPECT_EQ(B.ld(), n);
+    EXPECT_FALSE(B.contiguous());
+    for (ptrdiff_t i = 0; i < 3; i++)
+        for (ptrdiff_t j = 0; j < 2; j++)
+            EXPECT_EQ(B[i][j], X[i + 1][j + 2]);
+
+    // Deep copy of a view is compact
+    T C(B);
+    EXPECT_TRUE(C.contiguous());
+    EXPECT_EQ(C, B);
+
+    // So is a matrix built from a temporary view, which owns its storage
+    {
+        T G(X.rowBlock(1, 2));
+        EXPECT_EQ(G.rows(), 2);
+        EXPECT_NE(&G[0][0], &X[1][0]);
+        G.fill(0);
+    }
+    EXPECT_EQ(X[1][2], 7);
+
+    // Assigned, or moved through an rvalue operator, it is copied too
+    {
+        T G(EMPTY), H(2, 2);
+        G = X.row(4);
+        EXPECT_EQ(G.cols(), n);
+        EXPECT_NE(&G[0][0], &X[4][0]);
+        H = X.block(0, 0, 2, 2);
+        EXPECT_NE(&H[0][0], &X[0][0]);
+        T K = 1.0 * X.row(5);
+        EXPECT_NE(&K[0][0], &X[5][0]);
+        T L(std::move(X.row(5)));
+        EXPECT_NE(&L[0][0], &X[5][0]);
+        G.fill(0);
+        H.fill(0);
+        K.fill(0);
+        L.fill(0);
+    }
+    EXPECT_EQ(X[4][0], 20);
+    EXPECT_EQ(X[0][1], 1);
+    EXPECT_EQ(X[5][0], 25);
+
+    // Row, column and row block
+    auto r = X.row(2);
+    auto c = X.col(3);
+    EXPECT_EQ(r.inc(), 1);
+    EXPECT_EQ(c.inc(), n);
+    EXPECT_TRUE(X.rowBlock(2, 3).contiguous());
+    EXPECT_EQ(dot(r, r), dot(T(r), T(r)));
+    EXPECT_EQ(dot(c, c), dot(T(c), T(c)));
+    expectEqual<T>(norm(B), norm(C), norm(C));
+
+    // Writes through to X
+    T D(X);
+    maxpy(2.0, C, 1, &B);
+    for (ptrdiff_t i = 0; i < 3; i++)
+        for (ptrdiff_t j = 0; j < 2; j++)
+            EXPECT_EQ(X[i + 1][j + 2], 3 * D[i + 1][j + 2]);
+    B.fill(0);
+    EXPECT_EQ(X[1][2], 0);
+    EXPECT_EQ(X[1][4], D[1][4]);
+    B = C + C;
+    EXPECT_EQ(X[3][3], 2 * D[3][3]);
+
+    // A view cannot reallocate, other shapes throw and leave it intact
+    T F(2, 2);
+    F.fill(1);
+    EXPECT_THROW(B = F + F, int);
+    EXPECT_EQ(B.rows(), 3);
+    EXPECT_EQ(B.ld(), n);
+    EXPECT_EQ(&B[0][0], &X[1][2]);
+    EXPECT_EQ(X[3][3], 2 * D[3][3]);
+
+    // Out of bounds
+    EXPECT_ANY_THROW(X.block(4, 0, 3, 1));
+    EXPECT_ANY_THROW(X.col(n));
+
+    // Multiply into a column block: Y[:, 1:3] = X[:, 0:3] * W
+    T W(3, 2), Y(m, 4);
+    for (ptrdiff_t i = 0; i < 6; i++)
+        static_cast<typename T::Scalar*>(W)[i] = i - 2;
+    Y.fill(-1);
+    auto y = Y.colBlock(1, 2);
+    mprod(X.colBlock(0, 3), W, &y);
+    T Z = T(X.colBlock(0, 3)) * W;
+    for (ptrdiff_t i = 0; i < m; i++) {
+        EXPECT_EQ(Y[i][0], -1);
+        EXPECT_EQ(Y[i][1], Z[i][0]);
+        EXPECT_EQ(Y[i][2], Z[i][1]);
+        EXPECT_EQ(Y[i][3], -1);
+    }
+
+    // Element-wise kernels on strided operands
+    T E(3, 2);
+    hprod(B, C, &E);
+    EXPECT_EQ(E[2][1], B[2][1] * C[2][1]);
+    tanh(&B);
+    expectEqual<T>(X[2][3], std::tanh(2 * C[1][1]));
+    EXPECT_EQ(X[2][1], D[2][1]);
+}
+
 }  // namespace Semantics
@@ -0,0 +1,132 @@
+// Copyright 2023 Caleb Magruder
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Allocator.h"
+#include "Matrix.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tAllocator Fixture
+/////////////////////////////////////////
+class tAllocator : public TestWithLogging {};
+
+bool aligned(const void* ptr, size_t alignment = 64) {
+    return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+/////////////////////////////////////////
+// PoolAllocator::allocate(bytes)
+/////////////////////////////////////////
+TEST_F(tAllocator, PoolAligned) {
+    for (size_t bytes : {1, 8, 63, 64, 65, 1000, 4096, 1 << 20}) {
+        void* ptr = PoolAllocator::allocate(bytes);
+        ASSERT_NE(ptr, nullptr);
+        EXPECT_TRUE(aligned(ptr)) << bytes;
+        std::memset(ptr, 0xff, bytes);
+        PoolAllocator::deallocate(ptr, bytes);
+    }
+}
+
+/////////////////////////////////////////
+// Freed blocks are reused by the same size class
+/////////////////////////////////////////
+TEST_F(tAllocator, PoolReuse) {
+    void* a = PoolAllocator::allocate(8 * 100 * 100);
+    PoolAllocator::deallocate(a, 8 * 100 * 100);
+    void* b = PoolAllocator::allocate(8 * 100 * 100 - 16);  // Same class
+    EXPECT_EQ(a, b);
+    PoolAllocator::deallocate(b, 8 * 100 * 100 - 16);
+}
+
+/////////////////////////////////////////
+// Requests above MAXPOOLED bypass the pool
+/////////////////////////////////////////
+TEST_F(tAllocator, PoolLarge) {
+    const size_t bytes = PoolAllocator::MAXPOOLED + 1;
+    void* ptr = PoolAllocator::allocate(bytes);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_TRUE(aligned(ptr));
+    PoolAllocator::deallocate(ptr, bytes);
+}
+
+/////////////////////////////////////////
+// Blocks freed on another thread
+/////////////////////////////////////////
+TEST_F(tAllocator, PoolCrossThread) {
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 1000; i++) ptrs.push_back(PoolAllocator::allocate(512));
+    std::thread t([&] {
+        for (void* ptr : ptrs) PoolAllocator::deallocate(ptr, 512);
+    });
+    t.join();
+    // Spilled to the shared list on thread exit, then reused here
+    void* ptr = PoolAllocator::allocate(512);
+    EXPECT_NE(std::find(ptrs.begin(), ptrs.end(), ptr), ptrs.end());
+    PoolAllocator::deallocate(ptr, 512);
+    PoolAllocator::trim();
+}
+
+/////////////////////////////////////////
+// Blocks freed after the thread's cache is destroyed at exit
+/////////////////////////////////////////
+TEST_F(tAllocator, PoolAfterTeardown) {
+    // Destroyed after the cache, constructed before it
+    struct Late {
+        void* ptr = nullptr;
+        ~Late() {
+            PoolAllocator::deallocate(ptr, 512);
+            void* again = PoolAllocator::allocate(512);
+            PoolAllocator::deallocate(again, 512);
+        }
+    };
+    std::thread t([] {
+        thread_local Late late;
+        late.ptr = PoolAllocator::allocate(512);
+        PoolAllocator::deallocate(PoolAllocator::allocate(512), 512);
+    });
+    t.join();
+    PoolAllocator::trim();
+}
+
+/////////////////////////////////////////
+// ScopedArena arena; Matrix<T> A(m, n);
+/////////////////////////////////////////
+TEST_F(tAllocator, ScopedArena) {
+    EXPECT_EQ(ScopedArena::current(), nullptr);
+    {
+        ScopedArena outer(4096);
+        EXPECT_EQ(ScopedArena::current(), &outer);
+        {
+            ScopedArena inner;
+            EXPECT_EQ(ScopedArena::current(), &inner);
+            Matrix<REF> A(10, 10);
+            EXPECT_TRUE(aligned(static_cast<double*>(A)));
+            EXPECT_EQ(inner.used(), 10 * 10 * sizeof(double));
+        }
+        EXPECT_EQ(ScopedArena::current(), &outer);
+        // Grows past the initial chunk
+        Matrix<REF> B(100, 100), C(100, 100);
+        B.fill(1);
+        C.fill(2);
+        B += C;
+        EXPECT_EQ(B[99][99], 3);
+        EXPECT_EQ(outer.used(), 2 * 100 * 100 * sizeof(double));
+    }
+    EXPECT_EQ(ScopedArena::current(), nullptr);
+}
+
+/////////////////////////////////////////
+// AlignedAllocator<ALIGN>
+/////////////////////////////////////////
+TEST_F(tAllocator, Aligned) {
+    void* ptr = AlignedAllocator<4096>::allocate(100);
+    EXPECT_TRUE(aligned(ptr, 4096));
+    AlignedAllocator<4096>::deallocate(ptr, 100);
+}
@@ -0,0 +1,157 @@
+// Copyright 2023 Caleb Magruder
+
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Async.h"
+#include "Matrix.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tAsync Fixture
+/////////////////////////////////////////
+class tAsync : public TestWithLogging {
+ protected:
+    void SetUp() override { async::workers(4); }
+    void TearDown() override { async::wait(); }
+
+    static void sleep(int ms) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+};
+
+/////////////////////////////////////////
+// *_async match their synchronous results
+/////////////////////////////////////////
+TEST_F(tAsync, Operations) {
+    EXPECT_EQ(async::workers(), 4);
+    Matrix<REF> A = Matrix<REF>::randn(20, 30), B = Matrix<REF>::randn(30, 10);
+    Matrix<REF> x = Matrix<REF>::randn(20), y = Matrix<REF>::randn(10);
+
+    // Reference, synchronously
+    Matrix<REF> C = A * B, D(C);
+    tanh(&D);
+    mger(0.5, x, y, &D);
+    Matrix<REF> E(20, 10);
+    hprod(C, D, &E);
+    maxpy(2.0, C, 1, &E);
+    const double n = norm(E);
+
+    // Chained through RAW hazards
+    Matrix<REF> c(20, 10), d(20, 10), e(20, 10), f(20, 10);
+    double dn = 0, dd = 0;
+    mprod_async(A, B, &c);
+    mcopy_async(c, &d);
+    tanh_async(&d);
+    mger_async(0.5, x, y, &d);
+    hprod_async(c, d, &e);
+    maxpy_async(2.0, c, &e);
+    msub_async(e, e, &f);
+    norm_async(e, &dn);
+    async::Event last = dot_async(f, f, &dd);
+    last.wait();
+    EXPECT_TRUE(last.ready());
+    EXPECT_NEAR(dn, n, 1e-12);
+    EXPECT_EQ(dd, 0);
+
+    Matrix<REF> g(10, 20);
+    mprod_async(true, true, 1.0, B, A, 0.0, &g).wait();
+    for (ptrdiff_t i = 0; i < 20; i++)
+        for (ptrdiff_t j = 0; j < 10; j++)
+            ASSERT_NEAR(g[j][i], C[i][j], 1e-12);
+}
+
+/////////////////////////////////////////
+// Temporary views may be destroyed before the operation runs
+/////////////////////////////////////////
+TEST_F(tAsync, TemporaryViews) {
+    Matrix<REF> A = Matrix<REF>::randn(64, 48), x = Matrix<REF>::randn(48);
+    Matrix<REF> Y(64, 1), B(A);
+    {
+        auto y0 = Y.rowBlock(0, 32), y1 = Y.rowBlock(32, 32);
+        mprod_async(A.rowBlock(0, 32), x, &y0);
+        mprod_async(A.rowBlock(32, 32), x, &y1);
+        auto b = B.colBlock(8, 16);
+        tanh_async(&b);
+    }
+    async::wait();
+    Matrix<REF> Z = A * x;
+    for (ptrdiff_t i = 0; i < 64; i++) {
+        EXPECT_NEAR(Y[i][0], Z[i][0], 1e-12);
+        EXPECT_EQ(B[i][7], A[i][7]);
+        EXPECT_NEAR(B[i][8], std::tanh(A[i][8]), 1e-12);
+    }
+}
+
+/////////////////////////////////////////
+// RAW, WAR and WAW on the same buffer are serialized
+/////////////////////////////////////////
+TEST_F(tAsync, Hazards) {
+    Matrix<REF> X(4, 4), Y(4, 4);
+    X.fill(1);
+    const async::Range x = async::range(X), y = async::range(Y);
+
+    // WAR: the slow reader still sees 1
+    async::submit({x}, {y}, [&] { sleep(50); mcopy(X, &Y); });
+    async::submit({}, {x}, [&] { X.fill(2); });
+    // RAW: sees 2
+    double sum = 0;
+    async::submit({x}, {async::range(&sum)}, [&] { sum = dot(X, X); });
+    // WAW: the later write wins
+    async::submit({}, {x}, [&] { sleep(20); X.fill(3); });
+    async::submit({}, {x}, [&] { X.fill(4); });
+    async::wait();
+    EXPECT_EQ(Y[3][3], 1);
+    EXPECT_EQ(sum, 64);
+    EXPECT_EQ(X[0][0], 4);
+
+    // Disjoint row blocks of one matrix do not conflict
+    auto top = X.rowBlock(0, 2), bottom = X.rowBlock(2, 2);
+    EXPECT_LE(async::range(top).end, async::range(bottom).begin);
+}
+
+/////////////////////////////////////////
+// Independent operations run concurrently
+/////////////////////////////////////////
+TEST_F(tAsync, Concurrent) {
+    Matrix<REF> A(8, 8), B(8, 8);
+    std::atomic<int> arrived{0};
+    // Each completes only once both have started
+    auto meet = [&] {
+        arrived++;
+        for (int i = 0; i < 2000 && arrived < 2; i++) sleep(1);
+        if (arrived < 2) throw(1);
+    };
+    async::Event a = async::submit({}, {async::range(A)}, meet);
+    async::Event b = async::submit({}, {async::range(B)}, meet);
+    EXPECT_NO_THROW(a.wait());
+    EXPECT_NO_THROW(b.wait());
+}
+
+/////////////////////////////////////////
+// Errors reach wait(), dependents are skipped
+/////////////////////////////////////////
+TEST_F(tAsync, Errors) {
+    Matrix<REF> A(3, 4), B(3, 4), C(3, 3), D(3, 3);
+    C.fill(1);
+    async::Event bad = mprod_async(A, B, &C);
+    async::Event after = mcopy_async(C, &D);
+    bool ran = false;
+    async::submit({async::range(D)}, {}, [&] { ran = true; });
+    EXPECT_THROW(bad.wait(), int);
+    EXPECT_THROW(after.wait(), int);
+    async::wait();
+    EXPECT_FALSE(ran);
+    EXPECT_NO_THROW(async::Event().wait());
+
+    // Resizing waits for outstanding operations
+    async::submit({}, {async::range(D)}, [&] { sleep(20); D.fill(5); });
+    async::workers(1);
+    EXPECT_EQ(D[2][2], 5);
+    EXPECT_EQ(async::workers(), 1);
+}
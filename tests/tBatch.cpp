@@ -0,0 +1,131 @@
+// Copyright 2023 Caleb Magruder
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Batch.h"
+#include "Matrix.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tBatch Fixture
+/////////////////////////////////////////
+template <typename T>
+class tBatch : public TestWithLogging {};
+
+    using MyTypes = ::testing::Types
+            < Matrix<REF>
+        #if ACC_FOUND
+                , Matrix<ACC>
+        #endif
+        #if OPB_FOUND
+                , Matrix<OPB>
+        #endif
+        #if MKL_FOUND
+                , Matrix<MKL>
+        #endif
+            >;
+
+TYPED_TEST_SUITE(tBatch, MyTypes);
+
+template <typename T>
+std::vector<T> randn(ptrdiff_t count, ptrdiff_t m, ptrdiff_t n) {
+    std::vector<T> X;
+    for (ptrdiff_t b = 0; b < count; b++) X.push_back(T::randn(m, n));
+    return X;
+}
+
+template <typename T>
+void expectNear(const T& A, const T& B) {
+    ASSERT_EQ(A.rows(), B.rows());
+    ASSERT_EQ(A.cols(), B.cols());
+    for (ptrdiff_t i = 0; i < A.rows(); i++)
+        for (ptrdiff_t j = 0; j < A.cols(); j++)
+            EXPECT_NEAR(A[i][j], B[i][j], 1e-12);
+}
+
+// C[b] = alpha * op(A[b]) * op(B[b]) against one mprod per product
+template <typename T>
+void batched(bool transA, bool transB, ptrdiff_t count,
+             ptrdiff_t m, ptrdiff_t n, ptrdiff_t k) {
+    std::vector<T> A = randn<T>(count, transA ? k : m, transA ? m : k);
+    std::vector<T> B = randn<T>(count, transB ? n : k, transB ? k : n);
+    std::vector<T> C = randn<T>(count, m, n);
+    mprod_batched(transA, transB, 0.5, A.data(), B.data(), C.data(), count);
+    for (ptrdiff_t b = 0; b < count; b++) {
+        T D(m, n);
+        mprod(transA, transB, 0.5, A[b], B[b], &D);
+        expectNear(C[b], D);
+    }
+}
+
+/////////////////////////////////////////
+// mprod_batched(A, B, C, count), interleaved
+/////////////////////////////////////////
+TYPED_TEST(tBatch, Small) {
+    for (bool transA : {false, true})
+        for (bool transB : {false, true})
+            batched<TypeParam>(transA, transB, 37, 4, 3, 5);
+    batched<TypeParam>(false, false, 1, 1, 1, 1);
+    batched<TypeParam>(false, false, 100, 8, 8, 8);
+}
+
+/////////////////////////////////////////
+// mprod_batched(A, B, C, count), one product at a time
+/////////////////////////////////////////
+TYPED_TEST(tBatch, Large) {
+    batched<TypeParam>(false, false, 3, 17, 20, 9);
+    batched<TypeParam>(true, true, 3, 20, 17, 9);
+}
+
+/////////////////////////////////////////
+// Mismatched shapes throw
+/////////////////////////////////////////
+TYPED_TEST(tBatch, Dimensions) {
+    std::vector<TypeParam> A = randn<TypeParam>(2, 3, 4);
+    std::vector<TypeParam> B = randn<TypeParam>(2, 4, 2);
+    std::vector<TypeParam> C = randn<TypeParam>(2, 3, 2);
+    EXPECT_NO_THROW(mprod_batched(A.data(), B.data(), C.data(), 2));
+    EXPECT_ANY_THROW(mprod_batched(A.data(), A.data(), C.data(), 2));
+    B[1] = TypeParam(5, 2);
+    EXPECT_ANY_THROW(mprod_batched(A.data(), B.data(), C.data(), 2));
+}
+
+/////////////////////////////////////////
+// Batch<T> set/get and mprod_batched(A, B, &C) for every microkernel
+/////////////////////////////////////////
+TEST(tBatchInterleaved, Kernels) {
+    const ptrdiff_t count = 21, m = 5, n = 6, k = 3;
+    std::vector<Matrix<REF>> A = randn<Matrix<REF>>(count, m, k);
+    std::vector<Matrix<REF>> B = randn<Matrix<REF>>(count, k, n);
+    Batch<REF> a(count, m, k), b(count, k, n), c(count, m, n);
+    for (ptrdiff_t i = 0; i < count; i++) {
+        a.set(i, A[i]);
+        b.set(i, B[i]);
+    }
+    EXPECT_EQ(a(3, 2, 1), A[3][2][1]);
+
+    const char* active = gemm::kernel();
+    for (const char* name : {"avx512", "avx2", "generic"}) {
+        if (!gemm::kernel(name)) continue;
+        mprod_batched(a, b, &c);
+        Matrix<REF> C(m, n);
+        for (ptrdiff_t i = 0; i < count; i++) {
+            c.get(i, &C);
+            expectNear(C, Matrix<REF>(A[i] * B[i]));
+        }
+        // Transposed operands
+        Batch<REF> bt(count, n, k);
+        for (ptrdiff_t i = 0; i < count; i++) bt.set(i, transpose(B[i]));
+        mprod_batched(false, true, 2.0, a, bt, &c);
+        for (ptrdiff_t i = 0; i < count; i++) {
+            c.get(i, &C);
+            expectNear(C, Matrix<REF>(2.0 * (A[i] * B[i])));
+        }
+    }
+    gemm::kernel(active);
+
+    Batch<REF> d(count, n, n);
+    EXPECT_ANY_THROW(mprod_batched(a, b, &d));
+}
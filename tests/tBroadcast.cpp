@@ -0,0 +1,151 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+#include "Matrix.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tBroadcast Fixture
+/////////////////////////////////////////
+template <typename T>
+class tBroadcast : public TestWithLogging {
+ protected:
+    using S = typename T::Scalar;
+
+    // a op b, as the kernels round it
+    static S apply(broadcast::Op op, S a, S b) {
+        switch (op) {
+            case broadcast::ADD: return a + b;
+            case broadcast::SUB: return a - b;
+            case broadcast::MUL: return a * b;
+            default: return a / b;
+        }
+    }
+
+    // C = A op v through the friend for op, out of place or in place
+    static void run(broadcast::Op op, const T& A, const T& v, T* C) {
+        switch (op) {
+            case broadcast::ADD: badd(A, v, C); break;
+            case broadcast::SUB: bsub(A, v, C); break;
+            case broadcast::MUL: bmul(A, v, C); break;
+            default: bdiv(A, v, C); break;
+        }
+    }
+    static void run(broadcast::Op op, T* A, const T& v) {
+        switch (op) {
+            case broadcast::ADD: badd(A, v); break;
+            case broadcast::SUB: bsub(A, v); break;
+            case broadcast::MUL: bmul(A, v); break;
+            default: bdiv(A, v); break;
+        }
+    }
+
+    // C(i, j) == A0(i, j) op v(i or j), exactly
+    static void check(broadcast::Op op, const T& A0, const T& v,
+                      const T& C) {
+        const bool row = v.cols() == 1 && v.rows() == A0.rows();
+        for (ptrdiff_t i = 0; i < C.rows(); i++) {
+            for (ptrdiff_t j = 0; j < C.cols(); j++) {
+                const S b = row ? v[i][0] : v[0][j];
+                ASSERT_EQ(C[i][j], apply(op, A0[i][j], b))
+                    << "op " << op << " at " << i << ", " << j;
+            }
+        }
+    }
+};
+
+    using MyTypes = ::testing::Types
+            < Matrix<REF>
+            , Matrix<REF, float>
+            , Matrix<AUTO>
+            , Matrix<AUTO, float>
+        #if ACC_FOUND
+                , Matrix<ACC>
+                , Matrix<ACC, float>
+        #endif
+        #if OPB_FOUND
+                , Matrix<OPB>
+                , Matrix<OPB, float>
+        #endif
+        #if MKL_FOUND
+                , Matrix<MKL>
+                , Matrix<MKL, float>
+        #endif
+            >;
+
+TYPED_TEST_SUITE(tBroadcast, MyTypes);
+
+constexpr broadcast::Op OPS[] = {broadcast::ADD, broadcast::SUB,
+                                 broadcast::MUL, broadcast::DIV};
+
+/////////////////////////////////////////
+// Column (m x 1) and row (1 x n) vectors, into a separate output
+/////////////////////////////////////////
+TYPED_TEST(tBroadcast, OutOfPlace) {
+    using T = TypeParam;
+    const ptrdiff_t m = 67, n = 131;
+    T A = T::randn(m, n), col = T::randn(m, 1), row = T::randn(1, n);
+    T C(m, n);
+    for (broadcast::Op op : OPS) {
+        this->run(op, A, col, &C);
+        this->check(op, A, col, C);
+        this->run(op, A, row, &C);
+        this->check(op, A, row, C);
+    }
+}
+
+/////////////////////////////////////////
+// In place over strided views, with a column of another matrix as v
+/////////////////////////////////////////
+TYPED_TEST(tBroadcast, InPlaceViews) {
+    using T = TypeParam;
+    const ptrdiff_t m = 40, n = 50;
+    T X = T::randn(m + 3, n + 5), W = T::randn(m, 4), R = T::randn(2, n);
+    auto col = W.col(2);
+    auto row = R.row(1);
+    for (broadcast::Op op : OPS) {
+        auto A = X.block(1, 2, m, n);
+        T A0(A);
+        this->run(op, &A, col);
+        this->check(op, A0, col, A);
+        T A1(A);
+        this->run(op, &A, row);
+        this->check(op, A1, row, A);
+    }
+}
+
+/////////////////////////////////////////
+// Row and column results do not depend on the thread count
+/////////////////////////////////////////
+TYPED_TEST(tBroadcast, Threads) {
+    using T = TypeParam;
+    const int threads = getNumThreads();
+    T A = T::randn(300, 400), v = T::randn(1, 400), w = T::randn(300, 1);
+    T C1(300, 400), C4(300, 400);
+    setNumThreads(1);
+    bdiv(A, v, &C1);
+    bmul(&C1, w);
+    setNumThreads(4);
+    bdiv(A, v, &C4);
+    bmul(&C4, w);
+    setNumThreads(threads);
+    EXPECT_EQ(C1, C4);
+}
+
+/////////////////////////////////////////
+// v must match A's rows (m x 1) or columns (1 x n), C A's shape
+/////////////////////////////////////////
+TYPED_TEST(tBroadcast, Shapes) {
+    using T = TypeParam;
+    T A = T::randn(4, 6), C(4, 6), D(6, 4);
+    T a(6, 1), b(1, 4), c(4, 2);
+    EXPECT_ANY_THROW(badd(A, a, &C));
+    EXPECT_ANY_THROW(bsub(A, b, &C));
+    EXPECT_ANY_THROW(bmul(&A, c));
+    T v = T::randn(4, 1);
+    EXPECT_ANY_THROW(bdiv(A, v, &D));
+    EXPECT_NO_THROW(bdiv(A, v, &C));
+}
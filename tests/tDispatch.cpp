@@ -0,0 +1,113 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "Dispatch.h"
+#include "Matrix.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tDispatch Fixture
+/////////////////////////////////////////
+class tDispatch : public TestWithLogging {
+ protected:
+    void SetUp() override { dispatch::reset(); }
+    void TearDown() override {
+        dispatch::reset();
+        std::remove(path.c_str());
+    }
+
+    // Every entry of op, both precisions
+    static void setAll(dispatch::Op op, BLAS backend) {
+        for (bool single : {false, true})
+            for (int c = 0; c < dispatch::CLASSES; c++)
+                dispatch::set(op, single, c, backend);
+    }
+
+    const std::string path = "tDispatch.cache";
+};
+
+/////////////////////////////////////////
+// dispatch::sizeClass(size), select(op, single, class)
+/////////////////////////////////////////
+TEST_F(tDispatch, Table) {
+    EXPECT_EQ(dispatch::sizeClass(0), 0);
+    EXPECT_EQ(dispatch::sizeClass(1), 1);
+    EXPECT_EQ(dispatch::sizeClass(4), 3);
+    EXPECT_EQ(dispatch::sizeClass(7), 3);
+    EXPECT_EQ(dispatch::sizeClass(256), 9);
+    EXPECT_EQ(dispatch::sizeClass(ptrdiff_t(1) << 50), dispatch::CLASSES - 1);
+
+    // REF below the BLAS thresholds, level 1 stays on REF
+    EXPECT_EQ(dispatch::select(dispatch::GEMM, false, 3), REF);
+    EXPECT_EQ(dispatch::select(dispatch::DOT, true, 20), REF);
+    EXPECT_EQ(dispatch::select(dispatch::GEMM, false, 9) == REF,
+              dispatch::backends().size() == 1);
+
+    dispatch::set(dispatch::GEMV, true, 5, dispatch::backends().back());
+    EXPECT_EQ(dispatch::select(dispatch::GEMV, true, 5),
+              dispatch::backends().back());
+    EXPECT_EQ(dispatch::select(dispatch::GEMV, false, 5), REF);
+    EXPECT_THROW(dispatch::set(dispatch::GEMM, false, 1, AUTO), int);
+}
+
+/////////////////////////////////////////
+// Matrix<AUTO> matches REF on every linked backend
+/////////////////////////////////////////
+TEST_F(tDispatch, Backends) {
+    Matrix<REF> A = Matrix<REF>::randn(37, 19), B = Matrix<REF>::randn(19, 5);
+    Matrix<REF> C = A * B;
+    Matrix<AUTO> a(37, 19), b(19, 5);
+    mcopy(Matrix<AUTO>::Ptr(A, 37, 19), &a);
+    mcopy(Matrix<AUTO>::Ptr(B, 19, 5), &b);
+    for (BLAS backend : dispatch::backends()) {
+        for (int op = 0; op < dispatch::OPS; op++)
+            setAll(dispatch::Op(op), backend);
+        Matrix<AUTO> c = a * b;
+        for (ptrdiff_t i = 0; i < 37; i++)
+            for (ptrdiff_t j = 0; j < 5; j++)
+                ASSERT_NEAR(c[i][j], C[i][j], 1e-12) << backend;
+        Matrix<AUTO> x = b.colBlock(1, 1), y = a * x;
+        for (ptrdiff_t i = 0; i < 37; i++)
+            ASSERT_NEAR(y[i][0], C[i][1], 1e-12) << backend;
+        EXPECT_NEAR(norm(a), norm(A), 1e-12) << backend;
+    }
+}
+
+/////////////////////////////////////////
+// dispatch::save(path), load(path), calibrate()
+/////////////////////////////////////////
+TEST_F(tDispatch, Cache) {
+    const BLAS last = dispatch::backends().back();
+    setAll(dispatch::AXPY, last);
+    ASSERT_TRUE(dispatch::save(path));
+    dispatch::reset();
+    EXPECT_EQ(dispatch::select(dispatch::AXPY, false, 4), REF);
+    ASSERT_TRUE(dispatch::load(path));
+    EXPECT_EQ(dispatch::select(dispatch::AXPY, false, 4), last);
+    EXPECT_EQ(dispatch::select(dispatch::AXPY, true, 30), last);
+
+    // Missing and malformed files leave the table alone
+    EXPECT_FALSE(dispatch::load("tDispatch.missing"));
+    std::ofstream(path) << "double gemm x REF\n";
+    EXPECT_FALSE(dispatch::load(path));
+    EXPECT_EQ(dispatch::select(dispatch::AXPY, false, 4), last);
+
+    // Calibrated entries are linked backends, classes above the largest
+    // measured keep its winner
+    dispatch::calibrate(1e-4, 8);
+    for (int op = 0; op < dispatch::OPS; op++) {
+        for (bool single : {false, true}) {
+            const BLAS top = dispatch::select(dispatch::Op(op), single, 30);
+            EXPECT_EQ(dispatch::select(dispatch::Op(op), single, 31), top);
+        }
+    }
+    EXPECT_EQ(dispatch::select(dispatch::GEMM, false, 20),
+              dispatch::select(dispatch::GEMM, false, dispatch::sizeClass(8)));
+    ASSERT_TRUE(dispatch::save(path));
+    ASSERT_TRUE(dispatch::load(path));
+}
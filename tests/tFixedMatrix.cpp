@@ -0,0 +1,163 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cmath>
+#include <sstream>
+#include <type_traits>
+
+#include "gtest/gtest.h"
+
+#include "FixedMatrix.h"
+#include "Matrix.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tFixedMatrix Fixture
+/////////////////////////////////////////
+class tFixedMatrix : public TestWithLogging {};
+
+// Random FixedMatrix and its Matrix<REF> copy
+template <ptrdiff_t M, ptrdiff_t N>
+FixedMatrix<M, N> randn(Matrix<REF>* R) {
+    *R = Matrix<REF>::randn(M, N);
+    FixedMatrix<M, N> A;
+    for (ptrdiff_t i = 0; i < M; i++)
+        for (ptrdiff_t j = 0; j < N; j++)
+            A(i, j) = (*R)[i][j];
+    return A;
+}
+
+template <ptrdiff_t M, ptrdiff_t N>
+void expectNear(const FixedMatrix<M, N>& A, const Matrix<REF>& R) {
+    ASSERT_EQ(R.rows(), M);
+    ASSERT_EQ(R.cols(), N);
+    for (ptrdiff_t i = 0; i < M; i++)
+        for (ptrdiff_t j = 0; j < N; j++)
+            EXPECT_NEAR(A(i, j), R[i][j], 1e-12);
+}
+
+// Shape-changing operations only exist for matching dimensions
+template <typename A, typename B>
+concept Multipliable = requires(const A& a, const B& b) { a * b; };
+
+template <typename A, typename B, typename C>
+concept Mprod = requires(const A& a, const B& b, C* c) { mprod(a, b, c); };
+
+/////////////////////////////////////////
+// Inline storage, constant dimensions
+/////////////////////////////////////////
+TEST_F(tFixedMatrix, Storage) {
+    static_assert(FixedMatrix<3, 4>::rows() == 3);
+    static_assert(FixedMatrix<3, 4>::cols() == 4);
+    static_assert(sizeof(FixedMatrix<4, 4>) ==
+                  sizeof(OperatorSet<FixedMatrix<4, 4>>) + 16*sizeof(double));
+
+    FixedMatrix<2, 3> A;
+    EXPECT_EQ(norm(A), 0.0);
+    A = FixedMatrix<2, 3>{1, 2, 3,
+                          4, 5, 6};
+    EXPECT_EQ(A[1][2], 6.0);
+    EXPECT_EQ(A(0, 1), 2.0);
+    EXPECT_EQ(static_cast<double*>(A), &A(0, 0));
+    EXPECT_ANY_THROW((FixedMatrix<2, 2>{1, 2, 3}));
+
+    // Copies and moves keep their own storage
+    FixedMatrix<2, 3> B(A), C(std::move(A));
+    EXPECT_EQ(B, C);
+    EXPECT_NE(static_cast<double*>(B), static_cast<double*>(C));
+    B[0][0] = 7.0;
+    EXPECT_NE(B, C);
+    C = B;
+    EXPECT_EQ(B, C);
+
+    FixedVector<3> x;
+    x[1] = 2.0;
+    EXPECT_EQ(x(1, 0), 2.0);
+}
+
+/////////////////////////////////////////
+// A * B, mprod and transpose against Matrix<REF>
+/////////////////////////////////////////
+TEST_F(tFixedMatrix, Product) {
+    Matrix<REF> a(EMPTY), b(EMPTY), s(EMPTY);
+    FixedMatrix<3, 4> A = randn<3, 4>(&a);
+    FixedMatrix<4, 2> B = randn<4, 2>(&b);
+    FixedMatrix<3, 3> S = randn<3, 3>(&s);
+
+    FixedMatrix<3, 2> C = A * B;
+    expectNear(C, Matrix<REF>(a * b));
+
+    // In place: S = S * S
+    mprod(S, S, &S);
+    expectNear(S, Matrix<REF>(s * s));
+
+    expectNear(transpose(A), transpose(a));
+    expectNear(FixedMatrix<3, 3>::identity() * A, a);
+
+    FixedMatrix<3, 4> G;
+    FixedVector<3> x = A * FixedVector<4>{};
+    mger(2.0, FixedVector<3>{1, 2, 3}, FixedVector<4>{1, 0, 0, 1}, &G);
+    EXPECT_EQ(G(2, 3), 6.0);
+    EXPECT_EQ(G(2, 1), 0.0);
+    EXPECT_EQ(norm(x), 0.0);
+
+    static_assert(Multipliable<FixedMatrix<3, 4>, FixedMatrix<4, 2>>);
+    static_assert(!Multipliable<FixedMatrix<3, 4>, FixedMatrix<3, 4>>);
+    static_assert(Mprod<FixedMatrix<3, 4>, FixedMatrix<4, 2>,
+                        FixedMatrix<3, 2>>);
+    static_assert(!Mprod<FixedMatrix<3, 4>, FixedMatrix<4, 2>,
+                         FixedMatrix<2, 3>>);
+    static_assert(!Mprod<FixedMatrix<2, 2>, FixedMatrix<2, 2>,
+                         FixedMatrix<2, 3>>);
+}
+
+/////////////////////////////////////////
+// Element-wise operations and OperatorSet friends
+/////////////////////////////////////////
+TEST_F(tFixedMatrix, ElementWise) {
+    Matrix<REF> a(EMPTY), b(EMPTY);
+    FixedMatrix<4, 4> A = randn<4, 4>(&a);
+    FixedMatrix<4, 4> B = randn<4, 4>(&b);
+
+    expectNear(A + B, Matrix<REF>(a + b));
+    expectNear(A - B, Matrix<REF>(a - b));
+    expectNear(2.0 * A, Matrix<REF>(2.0 * Matrix<REF>(a)));
+    EXPECT_NEAR(dot(A, B), dot(a, b), 1e-12);
+    EXPECT_NEAR(norm(A), norm(a), 1e-12);
+
+    // Operands are left untouched
+    expectNear(A, a);
+
+    // Lazy expressions evaluate into inline storage
+    FixedMatrix<4, 4> H = hprod(A, B) - lazy(A);
+    Matrix<REF> h(4, 4);
+    hprod(a, b, &h);
+    expectNear(H, Matrix<REF>(h - a));
+
+    FixedMatrix<4, 4> C(A);
+    C += B;
+    C -= A;
+    expectNear(C, b);
+    maxpy(-1.0, B, 1, &C);
+    EXPECT_NEAR(norm(C), 0.0, 1e-12);
+
+    tanh(&A);
+    tanh(&a);
+    expectNear(A, a);
+}
+
+/////////////////////////////////////////
+// Serialization through the shared OperatorSet operators
+/////////////////////////////////////////
+TEST_F(tFixedMatrix, Serialize) {
+    Matrix<REF> a(EMPTY);
+    FixedMatrix<2, 5> A = randn<2, 5>(&a), B;
+    std::stringstream ss;
+    ss << A;
+    ss >> B;
+    EXPECT_EQ(A, B);
+
+    std::stringstream wrong;
+    wrong << a;
+    FixedMatrix<5, 2> C;
+    EXPECT_ANY_THROW(wrong >> C);
+}
@@ -0,0 +1,288 @@
+// Copyright 2023 Caleb Magruder
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Gemm.h"
+#include "TestWithLogging.h"
+#include "ThreadPool.h"
+
+/////////////////////////////////////////
+// Helper Functions
+/////////////////////////////////////////
+std::vector<double> random(ptrdiff_t n) {
+    static std::mt19937 gen {0};
+    std::uniform_real_distribution<> d(-1, 1);
+    std::vector<double> x(n);
+    for (double& xi : x) xi = d(gen);
+    return x;
+}
+
+// Triple-loop reference: C = alpha * op(A) * op(B) + beta * C
+void naive(bool transA, bool transB, ptrdiff_t m, ptrdiff_t n, ptrdiff_t k,
+           double alpha, const double* A, ptrdiff_t lda,
+           const double* B, ptrdiff_t ldb,
+           double beta, double* C, ptrdiff_t ldc) {
+    for (ptrdiff_t i = 0; i < m; i++) {
+        for (ptrdiff_t j = 0; j < n; j++) {
+            double c = 0;
+            for (ptrdiff_t p = 0; p < k; p++) {
+                c += (transA ? A[p*lda + i] : A[i*lda + p])
+                   * (transB ? B[j*ldb + p] : B[p*ldb + j]);
+            }
+            C[i*ldc + j] = alpha * c + beta * C[i*ldc + j];
+        }
+    }
+}
+
+/////////////////////////////////////////
+// tGemm Fixture, parameterized by kernel
+/////////////////////////////////////////
+class tGemm : public TestWithLogging,
+              public testing::WithParamInterface<const char*> {
+ protected:
+    void SetUp() override {
+        _default = gemm::kernel();
+        if (!gemm::kernel(GetParam()))
+            GTEST_SKIP() << GetParam() << " unsupported on this host";
+    }
+    void TearDown() override {
+        gemm::kernel(_default.c_str());
+    }
+ private:
+    std::string _default;
+};
+
+INSTANTIATE_TEST_SUITE_P(Kernels, tGemm,
+                         testing::Values("generic", "avx2", "avx512"));
+
+/////////////////////////////////////////
+// C = alpha * op(A) * op(B) + beta * C
+/////////////////////////////////////////
+TEST_P(tGemm, AllTransposes) {
+    // Sizes straddle the register tiles and the mc/kc cache blocks
+    const ptrdiff_t sizes[][3] = {{1, 1, 1}, {7, 9, 5}, {13, 17, 300},
+                                  {150, 35, 260}, {64, 64, 64}};
+    for (const auto& s : sizes) {
+        const ptrdiff_t m = s[0], n = s[1], k = s[2];
+        for (int t = 0; t < 4; t++) {
+            const bool ta = t & 1, tb = t & 2;
+            const ptrdiff_t lda = ta ? m : k, ldb = tb ? k : n;
+            const ptrdiff_t ldc = n + 3;  // Padded leading dimension
+            std::vector<double> A = random(m * k), B = random(k * n);
+            std::vector<double> C = random(m * ldc), D(C);
+            gemm::dgemm(ta, tb, m, n, k, 0.5, A.data(), lda, B.data(), ldb,
+                        2.0, C.data(), ldc);
+            naive(ta, tb, m, n, k, 0.5, A.data(), lda, B.data(), ldb,
+                  2.0, D.data(), ldc);
+            for (ptrdiff_t i = 0; i < m * ldc; i++)
+                ASSERT_NEAR(C[i], D[i], 1e-12 * k) << m << "x" << n << "x" << k
+                                                   << " trans " << t;
+        }
+    }
+}
+
+/////////////////////////////////////////
+// beta == 0 ignores NaNs in C
+/////////////////////////////////////////
+TEST_P(tGemm, BetaZeroOverwrites) {
+    const ptrdiff_t m = 11, n = 13, k = 5;
+    std::vector<double> A = random(m * k), B = random(k * n);
+    std::vector<double> C(m * n, std::nan("")), D(m * n, 0);
+    gemm::dgemm(false, false, m, n, k, 1.0, A.data(), k, B.data(), n,
+                0.0, C.data(), n);
+    naive(false, false, m, n, k, 1.0, A.data(), k, B.data(), n,
+          0.0, D.data(), n);
+    for (ptrdiff_t i = 0; i < m * n; i++)
+        ASSERT_NEAR(C[i], D[i], 1e-12);
+}
+
+/////////////////////////////////////////
+// sgemm against the double reference on the same float inputs
+/////////////////////////////////////////
+TEST_P(tGemm, Single) {
+    // k = 600 spans two single precision k panels, n = 40 a partial nr tile
+    const ptrdiff_t sizes[][3] = {{1, 1, 1}, {7, 9, 5}, {13, 40, 600},
+                                  {150, 35, 260}};
+    for (const auto& s : sizes) {
+        const ptrdiff_t m = s[0], n = s[1], k = s[2], ldc = n + 3;
+        for (int t = 0; t < 4; t++) {
+            const bool ta = t & 1, tb = t & 2;
+            const ptrdiff_t lda = ta ? m : k, ldb = tb ? k : n;
+            const std::vector<double> a = random(m * k), b = random(k * n);
+            std::vector<double> D = random(m * ldc);
+            const std::vector<float> A(a.begin(), a.end());
+            const std::vector<float> B(b.begin(), b.end());
+            std::vector<float> C(D.begin(), D.end());
+            // Round the reference operands the same way
+            std::vector<double> Ad(A.begin(), A.end()), Bd(B.begin(), B.end());
+            D.assign(C.begin(), C.end());
+            gemm::sgemm(ta, tb, m, n, k, 0.5f, A.data(), lda, B.data(), ldb,
+                        2.0f, C.data(), ldc);
+            naive(ta, tb, m, n, k, 0.5, Ad.data(), lda, Bd.data(), ldb,
+                  2.0, D.data(), ldc);
+            for (ptrdiff_t i = 0; i < m * ldc; i++)
+                ASSERT_NEAR(C[i], D[i], 1e-6 * k) << m << "x" << n << "x" << k
+                                                  << " trans " << t;
+        }
+    }
+
+    // Row bias and a float callback
+    const ptrdiff_t m = 9, n = 37, k = 20;
+    const std::vector<double> a = random(m * k), b = random(k * n);
+    const std::vector<float> A(a.begin(), a.end()), B(b.begin(), b.end());
+    const std::vector<float> bias = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    auto negate = [](float* x, ptrdiff_t n, void*) {
+        for (ptrdiff_t j = 0; j < n; j++) x[j] = -x[j];
+    };
+    gemm::Epilogue e = gemm::Epilogue::custom(negate);
+    e.bias = gemm::Epilogue::ROW;
+    e.b = bias.data();
+    std::vector<float> C(m * n), D(m * n);
+    gemm::sgemm(false, false, m, n, k, 1.0f, A.data(), k, B.data(), n,
+                0.0f, C.data(), n, e);
+    gemm::sgemm(false, false, m, n, k, 1.0f, A.data(), k, B.data(), n,
+                0.0f, D.data(), n);
+    for (ptrdiff_t i = 0; i < m; i++)
+        for (ptrdiff_t j = 0; j < n; j++)
+            ASSERT_EQ(C[i*n + j], -(D[i*n + j] + bias[i]));
+}
+
+/////////////////////////////////////////
+// Fused bias and activation match separate passes over C
+/////////////////////////////////////////
+TEST_P(tGemm, Epilogue) {
+    // Clamps each element to [-0.5, 0.5]
+    auto clamp = [](double* x, ptrdiff_t n, void*) {
+        for (ptrdiff_t j = 0; j < n; j++) x[j] = std::clamp(x[j], -0.5, 0.5);
+    };
+    const gemm::Epilogue activations[] = {
+        gemm::Epilogue(), gemm::Epilogue::relu(), gemm::Epilogue::tanh(),
+        gemm::Epilogue::custom(clamp)};
+    // k = 300 spans two k panels, so only the last may run the epilogue
+    const ptrdiff_t sizes[][3] = {{1, 1, 1}, {13, 17, 300}, {150, 35, 20}};
+    for (const auto& s : sizes) {
+        const ptrdiff_t m = s[0], n = s[1], k = s[2], ldc = n + 3;
+        const std::vector<double> A = random(m * k), B = random(k * n);
+        const std::vector<double> C0 = random(m * ldc);
+        const std::vector<double> bias = random(2 * m * n);
+        for (auto bias_type : {gemm::Epilogue::NONE, gemm::Epilogue::ROW,
+                               gemm::Epilogue::COL}) {
+            for (gemm::Epilogue e : activations) {
+                e.bias = bias_type;
+                e.b = bias.data();
+                e.incb = 2;
+                std::vector<double> C(C0), D(C0);
+                gemm::dgemm(false, false, m, n, k, 0.5, A.data(), k,
+                            B.data(), n, 1.5, C.data(), ldc, e);
+                naive(false, false, m, n, k, 0.5, A.data(), k, B.data(), n,
+                      1.5, D.data(), ldc);
+                for (ptrdiff_t i = 0; i < m; i++) {
+                    double* d = D.data() + i*ldc;
+                    for (ptrdiff_t j = 0; j < n; j++) {
+                        if (bias_type == gemm::Epilogue::ROW) d[j] += bias[2*i];
+                        if (bias_type == gemm::Epilogue::COL) d[j] += bias[2*j];
+                        if (e.activation == gemm::Epilogue::RELU)
+                            d[j] = std::max(d[j], 0.0);
+                        if (e.activation == gemm::Epilogue::TANH)
+                            d[j] = std::tanh(d[j]);
+                    }
+                    if (e.activation == gemm::Epilogue::CUSTOM)
+                        clamp(d, n, nullptr);
+                }
+                for (ptrdiff_t i = 0; i < m * ldc; i++)
+                    ASSERT_NEAR(C[i], D[i], 1e-12 * k)
+                        << m << "x" << n << "x" << k << " bias " << bias_type
+                        << " activation " << e.activation;
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////
+// The standalone pass equals the fused one
+/////////////////////////////////////////
+TEST_P(tGemm, EpilogueStandalone) {
+    const ptrdiff_t m = 40, n = 30, k = 7;
+    const std::vector<double> A = random(m * k), B = random(k * n);
+    const std::vector<double> bias = random(n);
+    gemm::Epilogue e = gemm::Epilogue::tanh(vmath::LOW);
+    e.bias = gemm::Epilogue::COL;
+    e.b = bias.data();
+    std::vector<double> C(m * n), D(m * n);
+    gemm::dgemm(true, false, m, n, k, 1.0, A.data(), m, B.data(), n,
+                0.0, C.data(), n, e);
+    gemm::dgemm(true, false, m, n, k, 1.0, A.data(), m, B.data(), n,
+                0.0, D.data(), n);
+    gemm::epilogue(e, m, n, D.data(), n);
+    for (ptrdiff_t i = 0; i < m * n; i++)
+        ASSERT_NEAR(C[i], D[i], 1e-14);
+}
+
+/////////////////////////////////////////
+// y = alpha * op(A) * x + beta * y with strided and reversed vectors
+/////////////////////////////////////////
+TEST_P(tGemm, Gemv) {
+    const int threads = ThreadPool::instance().size();
+    ThreadPool::instance().resize(4);
+    // Row counts around the four-row blocks, columns around the SIMD
+    // widths, and one large enough to split across threads
+    const ptrdiff_t sizes[][2] = {{1, 1}, {3, 7}, {9, 16}, {13, 33},
+                                  {70, 301}, {300, 1001}};
+    for (const auto& s : sizes) {
+        const ptrdiff_t m = s[0], n = s[1], lda = n + 2;
+        const std::vector<double> A = random(m * lda);
+        const std::vector<float> Af(A.begin(), A.end());
+        for (bool trans : {false, true}) {
+            const ptrdiff_t lenx = trans ? m : n, leny = trans ? n : m;
+            for (ptrdiff_t inc : {1, 2, -3}) {
+                const ptrdiff_t a = std::abs(inc);
+                // Offset of element i of a vector of length len
+                auto at = [inc, a](ptrdiff_t len, ptrdiff_t i) {
+                    return inc > 0 ? i * inc : (len - 1 - i) * a;
+                };
+                const std::vector<double> x = random(1 + (lenx - 1) * a);
+                std::vector<double> y = random(1 + (leny - 1) * a), y0(y);
+                const std::vector<float> xf(x.begin(), x.end());
+                std::vector<float> yf(y.begin(), y.end());
+                gemm::dgemv(trans, m, n, 0.5, A.data(), lda, x.data(), inc,
+                            2.0, y.data(), inc);
+                gemm::sgemv(trans, m, n, 0.5f, Af.data(), lda, xf.data(),
+                            inc, 2.0f, yf.data(), inc);
+                for (ptrdiff_t i = 0; i < leny; i++) {
+                    double r = 0;
+                    for (ptrdiff_t p = 0; p < lenx; p++) {
+                        r += (trans ? A[p*lda + i] : A[i*lda + p])
+                           * x[at(lenx, p)];
+                    }
+                    const double ref = 0.5 * r + 2.0 * y0[at(leny, i)];
+                    ASSERT_NEAR(y[at(leny, i)], ref, 1e-13 * lenx)
+                        << m << "x" << n << " " << trans << " " << inc;
+                    ASSERT_NEAR(yf[at(leny, i)], ref, 1e-6 * lenx)
+                        << m << "x" << n << " " << trans << " " << inc;
+                }
+                // Elements between the strides are untouched
+                for (size_t k = 0; k < y.size(); k++) {
+                    if (k % a) {
+                        ASSERT_EQ(y[k], y0[k]);
+                    }
+                }
+            }
+            // beta == 0 ignores NaNs in y
+            const std::vector<double> x = random(lenx);
+            std::vector<double> y(leny, std::nan("")), z(leny, 0);
+            gemm::dgemv(trans, m, n, 1.0, A.data(), lda, x.data(), 1,
+                        0.0, y.data(), 1);
+            naive(trans, false, leny, 1, lenx, 1.0, A.data(), lda,
+                  x.data(), 1, 0.0, z.data(), 1);
+            for (ptrdiff_t i = 0; i < leny; i++)
+                ASSERT_NEAR(y[i], z[i], 1e-13 * lenx);
+        }
+    }
+    ThreadPool::instance().resize(threads);
+}
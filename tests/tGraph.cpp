@@ -0,0 +1,294 @@
+// Copyright 2023 Caleb Magruder
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Graph.h"
+#include "Instrument.h"
+#include "Matrix.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tGraph Fixture
+/////////////////////////////////////////
+template <typename T>
+class tGraph : public TestWithLogging {
+ protected:
+    // Tolerance for the precision of T
+    static constexpr double TOL = sizeof(typename T::Scalar) == 4 ? 1e-4
+                                                                  : 1e-10;
+
+    static void expectNear(const T& A, const T& B) {
+        ASSERT_EQ(A.rows(), B.rows());
+        ASSERT_EQ(A.cols(), B.cols());
+        for (ptrdiff_t i = 0; i < A.rows(); i++)
+            for (ptrdiff_t j = 0; j < A.cols(); j++)
+                ASSERT_NEAR(A[i][j], B[i][j], TOL) << i << ", " << j;
+    }
+};
+
+    using MyTypes = ::testing::Types
+            < Matrix<REF>
+            , Matrix<REF, float>
+            , Matrix<AUTO>
+            , Matrix<AUTO, float>
+        #if ACC_FOUND
+                , Matrix<ACC>
+                , Matrix<ACC, float>
+        #endif
+        #if OPB_FOUND
+                , Matrix<OPB>
+                , Matrix<OPB, float>
+        #endif
+        #if MKL_FOUND
+                , Matrix<MKL>
+                , Matrix<MKL, float>
+        #endif
+            >;
+
+TYPED_TEST_SUITE(tGraph, MyTypes);
+
+/////////////////////////////////////////
+// A training step replays like its eager equivalent
+/////////////////////////////////////////
+TYPED_TEST(tGraph, Replay) {
+    using T = TypeParam;
+    const double lr = 0.1;
+    T W = T::randn(8, 6), X = T::randn(6, 5), Y = T::randn(8, 5);
+    T V(W);
+
+    graph::Graph<T> g;
+    graph::Value w = g.input(&W), x = g.input(&X), y = g.input(&Y);
+    graph::Value h = g.tanh(g.mprod(w, x));
+    graph::Value e = g.msub(h, y);
+    graph::Value d = g.hprod(e, h);
+    g.output(e);
+    g.mprod(false, false, -lr, d, g.transpose(x), 1.0, w);
+    graph::Plan<T> plan = g.compile();
+
+    for (int step = 0; step < 3; step++) {
+        T H = V * X;
+        tanh(&H);
+        T E(8, 5), D(8, 5);
+        msub(H, Y, &E);
+        hprod(E, H, &D);
+        mprod(false, true, -lr, D, X, 1.0, &V);
+
+        plan.run();
+        this->expectNear(plan.view(e), E);
+        this->expectNear(W, V);
+    }
+    using S = typename T::Scalar;
+    EXPECT_EQ(static_cast<S*>(plan.view(w)), static_cast<S*>(W));
+    EXPECT_THROW(plan.view(d), int);
+}
+
+/////////////////////////////////////////
+// Transposes fold into the product's flags
+/////////////////////////////////////////
+TYPED_TEST(tGraph, Transpose) {
+    using T = TypeParam;
+    T A = T::randn(4, 3), B = T::randn(4, 5), C = T::randn(3, 5);
+    T E = T::randn(4, 4);
+
+    graph::Graph<T> g;
+    graph::Value a = g.input(&A), b = g.input(&B), c = g.input(&C);
+    graph::Value p = g.mprod(g.transpose(a), b);
+    graph::Value q = g.mprod(g.transpose(g.transpose(b)), g.transpose(c));
+    g.output(p);
+    g.output(q);
+    graph::Plan<T> plan = g.compile();
+    EXPECT_EQ(plan.steps(), 3);  // mprod, transpose, mprod
+    plan.run();
+
+    T P(3, 5), Q(4, 3);
+    mprod(true, false, 1.0, A, B, 0.0, &P);
+    mprod(false, true, 1.0, B, C, 0.0, &Q);
+    this->expectNear(plan.view(p), P);
+    this->expectNear(plan.view(q), Q);
+
+    // A transposed temporary also read element-wise is materialized
+    graph::Graph<T> h;
+    graph::Value u = h.input(&A), v = h.input(&E);
+    graph::Value t = h.transpose(u);
+    graph::Value r = h.add(h.mprod(t, v), t);
+    h.output(r);
+    graph::Plan<T> plan2 = h.compile();
+    EXPECT_EQ(plan2.steps(), 3);
+    plan2.run();
+    T R(3, 4);
+    mprod(true, false, 1.0, A, E, 0.0, &R);
+    R += transpose(A);
+    this->expectNear(plan2.view(r), R);
+
+    // W += A * W^T keeps the transpose, the product would alias W
+    T F = T::randn(96, 96), W = T::randn(96, 96), V(W);
+    graph::Graph<T> f;
+    graph::Value w = f.input(&W);
+    f.mprod(false, false, 1.0, f.input(&F), f.transpose(w), 1.0, w);
+    graph::Plan<T> plan3 = f.compile();
+    EXPECT_EQ(plan3.steps(), 2);  // transpose, mprod
+    plan3.run();
+    T Wt(transpose(V));
+    mprod(false, false, 1.0, F, Wt, 1.0, &V);
+    this->expectNear(W, V);
+}
+
+/////////////////////////////////////////
+// Element-wise chains run as one step
+/////////////////////////////////////////
+TYPED_TEST(tGraph, Fusion) {
+    using T = TypeParam;
+    T A = T::randn(30, 40), B = T::randn(30, 40), C = T::randn(30, 40);
+    T D(C);
+
+    graph::Graph<T> g;
+    graph::Value a = g.input(&A), b = g.input(&B), c = g.input(&C);
+    graph::Value s = g.add(g.hprod(a, b), g.scale(0.5, a));
+    graph::Value t = g.tanh(g.msub(s, b));
+    g.output(t);
+    g.maxpy(2.0, g.hprod(t, a), c);
+    graph::Plan<T> plan = g.compile();
+    EXPECT_EQ(plan.steps(), 2);  // t, then c += 2 * t .* a
+    plan.run();
+
+    T S(30, 40), U(30, 40), V(30, 40);
+    hprod(A, B, &S);
+    maxpy(0.5, A, 1, &S);
+    msub(S, B, &U);
+    tanh(&U);
+    hprod(U, A, &V);
+    maxpy(2.0, V, 1, &D);
+    this->expectNear(plan.view(t), U);
+    this->expectNear(C, D);
+
+    // Past the registers, a chain splits into several steps
+    graph::Graph<T> h;
+    graph::Value x = h.input(&A);
+    for (int i = 0; i < 20; i++) x = h.scale(0.9, x);
+    h.output(x);
+    graph::Plan<T> plan2 = h.compile();
+    EXPECT_GT(plan2.steps(), 1);
+    EXPECT_LT(plan2.steps(), 20);
+    plan2.run();
+    T X(A);
+    for (int i = 0; i < 20; i++) X = 0.9 * X;
+    this->expectNear(plan2.view(x), X);
+}
+
+/////////////////////////////////////////
+// A value is not fused past a write to its operands
+/////////////////////////////////////////
+TYPED_TEST(tGraph, Hazards) {
+    using T = TypeParam;
+    T A = T::randn(6, 7), B = T::randn(6, 7), Z = T::randn(6, 7);
+    T A0(A);
+
+    graph::Graph<T> g;
+    graph::Value a = g.input(&A), b = g.input(&B), z = g.input(&Z);
+    graph::Value p = g.hprod(a, b);        // Old A
+    g.mcopy(z, a);                         // A = Z
+    graph::Value r = g.add(p, a);          // Old A .* B + Z
+    g.output(r);
+    graph::Plan<T> plan = g.compile();
+    EXPECT_EQ(plan.steps(), 3);
+    plan.run();
+
+    T R(6, 7);
+    hprod(A0, B, &R);
+    R += Z;
+    this->expectNear(plan.view(r), R);
+    this->expectNear(A, Z);
+
+    // Two inputs of one matrix alias, P = M * M is a write to the first
+    T P = T::randn(6, 6), Q = T::randn(6, 6), M = T::randn(6, 6);
+    T P0(P);
+    graph::Graph<T> f;
+    graph::Value u = f.input(&P), v = f.input(&Q), m = f.input(&M);
+    graph::Value t = f.hprod(u, v);        // Old P
+    f.mprod(false, false, 1.0, m, m, 0.0, f.input(&P));
+    graph::Value w = f.add(t, v);          // Old P .* Q + Q
+    f.output(w);
+    graph::Plan<T> plan3 = f.compile();
+    EXPECT_EQ(plan3.steps(), 3);
+    plan3.run();
+
+    T W(6, 6);
+    hprod(P0, Q, &W);
+    W += Q;
+    this->expectNear(plan3.view(w), W);
+    T MM = M * M;
+    this->expectNear(P, MM);
+
+    // Writes to a temporary nothing reads afterwards are dropped with it
+    graph::Graph<T> h;
+    graph::Value x = h.input(&A), y = h.input(&B);
+    graph::Value s = h.scale(2.0, x);
+    h.mcopy(y, s);
+    graph::Value q = h.mprod(false, true, 1.0, y, x);
+    h.mprod(false, true, 1.0, x, y, 0.0, h.transpose(q));
+    graph::Plan<T> plan2 = h.compile();
+    EXPECT_EQ(plan2.steps(), 0);
+    EXPECT_NO_THROW(plan2.run());
+
+    // Mismatched shapes fail when recorded
+    EXPECT_THROW(g.add(a, g.transpose(b)), int);
+    EXPECT_THROW(g.mprod(a, b), int);
+}
+
+/////////////////////////////////////////
+// Temporaries share one arena, replay does not allocate
+/////////////////////////////////////////
+TYPED_TEST(tGraph, Memory) {
+    using T = TypeParam;
+    std::vector<T> W;
+    for (int i = 0; i < 6; i++) W.push_back(T::randn(32, 32));
+    T X = T::randn(32, 8);
+
+    graph::Graph<T> g;
+    graph::Value y = g.input(&X);
+    for (T& w : W) y = g.tanh(g.mprod(g.input(&w), y));
+    g.output(y);
+    graph::Plan<T> plan = g.compile();
+    EXPECT_EQ(plan.steps(), 6);
+    EXPECT_EQ(plan.temporaryBytes(), 6 * 32 * 8 * sizeof(typename T::Scalar));
+    EXPECT_LT(plan.arenaBytes(), plan.temporaryBytes());
+
+    T Y(X);
+    for (T& w : W) {
+        Y = w * Y;
+        tanh(&Y);
+    }
+    {
+        instrument::Scope scope;
+        plan.run();
+        EXPECT_EQ(scope.delta().allocations, 0);
+    }
+    this->expectNear(plan.view(y), Y);
+
+    // The plan moves without invalidating its steps
+    graph::Plan<T> moved(std::move(plan));
+    moved.run();
+    this->expectNear(moved.view(y), Y);
+}
+
+/////////////////////////////////////////
+// graph::pack(buffers, &offsets)
+/////////////////////////////////////////
+TEST(tGraphPack, Intervals) {
+    std::vector<ptrdiff_t> offsets;
+    EXPECT_EQ(graph::pack({}, &offsets), 0);
+
+    // 0 and 2 are never live together, 1 overlaps both
+    const std::vector<graph::Interval> buffers = {
+        {100, 0, 1}, {64, 1, 2}, {128, 2, 3}, {10, 4, 4}};
+    const ptrdiff_t size = graph::pack(buffers, &offsets);
+    ASSERT_EQ(offsets.size(), 4);
+    EXPECT_EQ(size, 192);
+    EXPECT_EQ(offsets[2], 0);
+    EXPECT_EQ(offsets[0], 0);
+    EXPECT_EQ(offsets[1], 128);
+    EXPECT_EQ(offsets[3], 0);
+    for (ptrdiff_t o : offsets) EXPECT_EQ(o % 64, 0);
+}
@@ -0,0 +1,214 @@
+// Copyright 2023 Caleb Magruder
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+#include "Instrument.h"
+#include "Matrix.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tInstrument Fixture
+/////////////////////////////////////////
+template <typename T>
+class tInstrument : public TestWithLogging {
+ protected:
+    // Bytes of a (3 x 4) matrix
+    static constexpr ptrdiff_t BYTES = 12 * sizeof(typename T::Scalar);
+};
+
+template <typename T>
+struct Backend;
+
+template <BLAS B, Real S>
+struct Backend<Matrix<B, S>> {
+    static constexpr BLAS value = B;
+};
+
+    using MyTypes = ::testing::Types
+            < Matrix<REF>
+            , Matrix<REF, float>
+            , Matrix<AUTO>
+            , Matrix<AUTO, float>
+        #if ACC_FOUND
+                , Matrix<ACC>
+                , Matrix<ACC, float>
+        #endif
+        #if OPB_FOUND
+                , Matrix<OPB>
+                , Matrix<OPB, float>
+        #endif
+        #if MKL_FOUND
+                , Matrix<MKL>
+                , Matrix<MKL, float>
+        #endif
+            >;
+
+TYPED_TEST_SUITE(tInstrument, MyTypes);
+
+/////////////////////////////////////////
+// README: Memory-Allocating Operations
+/////////////////////////////////////////
+TYPED_TEST(tInstrument, Allocating) {
+    using T = TypeParam;
+    const ptrdiff_t BYTES = this->BYTES;
+    T A = T::randn(3, 4), B = T::randn(3, 4), W = T::randn(4, 4);
+    {
+        instrument::Scope scope;
+        T C(3, 4);
+        EXPECT_EQ(scope.delta().allocations, 1);
+        EXPECT_EQ(scope.delta().bytes, BYTES);
+        EXPECT_EQ(scope.delta().copies, 0);
+    }
+    {
+        instrument::Scope scope;
+        T C(A);
+        EXPECT_EQ(scope.delta().allocations, 1);
+        EXPECT_EQ(scope.delta().copies, 1);
+        EXPECT_EQ(scope.delta().copiedBytes, BYTES);
+    }
+    {
+        T C(3, 4);
+        instrument::Scope scope;
+        C = A * W;
+        EXPECT_EQ(scope.delta().allocations, 1);
+        EXPECT_EQ(scope.delta().deallocations, 1);
+        EXPECT_EQ(scope.delta().copies, 0);
+    }
+    {
+        instrument::Scope scope;
+        T C = A + B;
+        EXPECT_EQ(scope.delta().allocations, 1);
+        EXPECT_EQ(scope.delta().copies, 0);
+    }
+}
+
+/////////////////////////////////////////
+// README: Allocation Moving and In Place Operations
+/////////////////////////////////////////
+TYPED_TEST(tInstrument, NonAllocating) {
+    using T = TypeParam;
+    T A = T::randn(3, 4), B = T::randn(3, 4), C(3, 4), S = T::randn(4, 4);
+    T Y(4, 3);
+    instrument::Scope scope;
+    {
+        T D(std::move(A));
+        A = std::move(D);
+    }
+    C = 2.0 * std::move(C);
+    C = std::move(C) + B;
+    C = B + std::move(C);
+    C = std::move(C) - B;
+    C += B;
+    C -= B;
+    C = A + B;
+    transpose(A, &Y);
+    transpose(&S);
+    tanh(&C);
+    EXPECT_EQ(scope.delta().allocations, 0);
+    EXPECT_EQ(scope.delta().deallocations, 0);
+    EXPECT_EQ(scope.delta().copies, 0);
+
+    mcopy(A, &C);
+    EXPECT_EQ(scope.delta().allocations, 0);
+    EXPECT_EQ(scope.delta().copies, 1);
+    EXPECT_EQ(scope.delta().copiedBytes, this->BYTES);
+}
+
+/////////////////////////////////////////
+// Gauges, per backend and per thread counters
+/////////////////////////////////////////
+TYPED_TEST(tInstrument, Gauges) {
+    using T = TypeParam;
+    const ptrdiff_t BYTES = this->BYTES;
+    instrument::reset();
+    const int64_t live = instrument::liveBytes();
+    const BLAS backend = Backend<T>::value;
+    instrument::Scope scope;
+    {
+        T A(3, 4), B(3, 4);
+        EXPECT_EQ(instrument::liveBytes(), live + 2 * BYTES);
+        {
+            T C(3, 4);
+        }
+        EXPECT_EQ(instrument::peakBytes(), live + 3 * BYTES);
+    }
+    EXPECT_EQ(instrument::liveBytes(), live);
+    EXPECT_EQ(scope.delta().freedBytes, 3 * BYTES);
+    EXPECT_GE(instrument::counters().allocations, 3);
+    EXPECT_EQ(scope.delta(backend).allocations, 3);
+    EXPECT_EQ(instrument::threadCounters(backend).allocations, 3);
+    EXPECT_EQ(instrument::liveBytes(backend), instrument::liveBytes());
+
+    // Another thread's events are not this thread's
+    std::thread([] {
+        instrument::Scope other;
+        T D(3, 4);
+    }).join();
+    EXPECT_EQ(scope.delta().allocations, 3);
+    EXPECT_GE(instrument::counters().allocations, 4);
+
+    std::ostringstream os;
+    instrument::write(os);
+    EXPECT_NE(os.str().find("matrix_live_bytes{backend=\"REF\"} "),
+              std::string::npos);
+    EXPECT_NE(os.str().find("matrix_allocations_total{backend=\"AUTO\"} "),
+              std::string::npos);
+}
+
+/////////////////////////////////////////
+// Counting is off outside a scope
+/////////////////////////////////////////
+TEST(tInstrumentScope, Enable) {
+    const bool on = instrument::enabled();
+    instrument::enable(false);
+    {
+        instrument::Scope scope;
+        EXPECT_TRUE(instrument::enabled());
+        const int64_t before = instrument::threadCounters().allocations;
+        {
+            instrument::Scope inner;
+            Matrix<REF> A(2, 2);
+            EXPECT_EQ(inner.delta().allocations, 1);
+        }
+        EXPECT_TRUE(instrument::enabled());
+        EXPECT_EQ(instrument::threadCounters().allocations, before + 1);
+    }
+    EXPECT_FALSE(instrument::enabled());
+    const instrument::Counters before = instrument::threadCounters();
+    Matrix<REF> A(2, 2), B(A);
+    EXPECT_EQ(instrument::threadCounters().allocations, before.allocations);
+    EXPECT_EQ(instrument::threadCounters().copies, before.copies);
+    instrument::enable(on);
+}
+
+/////////////////////////////////////////
+// A scope exiting on another thread leaves this one counting
+/////////////////////////////////////////
+TEST(tInstrumentScope, Threads) {
+    const bool on = instrument::enabled();
+    instrument::enable(false);
+    instrument::Scope scope;
+    std::thread([] {
+        instrument::Scope other;
+        EXPECT_TRUE(instrument::enabled());
+    }).join();
+    EXPECT_TRUE(instrument::enabled());
+    {
+        Matrix<REF> A(2, 2);
+    }
+    EXPECT_EQ(scope.delta().allocations, 1);
+
+    // Nor does another thread count without its own scope
+    std::thread([] {
+        EXPECT_FALSE(instrument::enabled());
+        const int64_t before = instrument::threadCounters().allocations;
+        Matrix<REF> A(2, 2);
+        EXPECT_EQ(instrument::threadCounters().allocations, before);
+    }).join();
+    instrument::enable(on);
+}
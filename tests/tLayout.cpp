@@ -0,0 +1,128 @@
+// Copyright 2023 Caleb Magruder
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Layout.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tLayout Fixture
+/////////////////////////////////////////
+class tLayout : public TestWithLogging {
+ protected:
+    void SetUp() override { _kernel = layout::kernel(); }
+    void TearDown() override { layout::kernel(_kernel); }
+
+    // Shapes around the register block, tile and recursion boundaries
+    const std::vector<ptrdiff_t> sizes = {1, 3, 4, 7, 8, 9, 31, 32, 33,
+                                          64, 65, 100, 257};
+
+    // Element (i, j) of an (m x n) matrix with leading dimension ld
+    static std::vector<double> iota(ptrdiff_t m, ptrdiff_t ld) {
+        std::vector<double> A(m * ld);
+        for (size_t k = 0; k < A.size(); k++) A[k] = k;
+        return A;
+    }
+
+ private:
+    const char* _kernel;
+};
+
+/////////////////////////////////////////
+// B = A^T with padded leading dimensions, every kernel
+/////////////////////////////////////////
+TEST_F(tLayout, Transpose) {
+    for (const char* name : {"avx512", "avx2", "generic"}) {
+        if (!layout::kernel(name)) continue;
+        for (ptrdiff_t m : sizes) {
+            for (ptrdiff_t n : sizes) {
+                const ptrdiff_t lda = n + 3, ldb = m + 1;
+                std::vector<double> A = iota(m, lda), B(n * ldb, -1);
+                layout::transpose(m, n, A.data(), lda, B.data(), ldb);
+                for (ptrdiff_t j = 0; j < n; j++) {
+                    for (ptrdiff_t i = 0; i < ldb; i++) {
+                        ASSERT_EQ(B[j*ldb + i], i < m ? A[i*lda + j] : -1)
+                            << name << " " << m << " x " << n;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////
+// A = A^T in place, square with a leading dimension
+/////////////////////////////////////////
+TEST_F(tLayout, TransposeSquare) {
+    for (const char* name : {"avx512", "avx2", "generic"}) {
+        if (!layout::kernel(name)) continue;
+        for (ptrdiff_t n : sizes) {
+            const ptrdiff_t lda = n + 2;
+            std::vector<double> A = iota(n, lda), A0(A);
+            layout::transposeSquare(n, A.data(), lda);
+            for (ptrdiff_t i = 0; i < n; i++) {
+                for (ptrdiff_t j = 0; j < lda; j++) {
+                    ASSERT_EQ(A[i*lda + j],
+                              j < n ? A0[j*lda + i] : A0[i*lda + j])
+                        << name << " " << n;
+                }
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////
+// Contiguous (m x n) -> (n x m) in place by cycle-following
+/////////////////////////////////////////
+TEST_F(tLayout, TransposeInPlace) {
+    for (ptrdiff_t m : sizes) {
+        for (ptrdiff_t n : {1, 2, 5, 33, 64}) {
+            std::vector<double> A = iota(m, n), A0(A);
+            layout::transposeInPlace(m, n, A.data());
+            for (ptrdiff_t j = 0; j < n; j++) {
+                for (ptrdiff_t i = 0; i < m; i++) {
+                    ASSERT_EQ(A[j*m + i], A0[i*n + j]) << m << " x " << n;
+                }
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////
+// Single precision transposes, every kernel
+/////////////////////////////////////////
+TEST_F(tLayout, TransposeFloat) {
+    for (const char* name : {"avx512", "avx2", "generic"}) {
+        if (!layout::kernel(name)) continue;
+        for (ptrdiff_t m : sizes) {
+            for (ptrdiff_t n : sizes) {
+                const ptrdiff_t lda = n + 3, ldb = m + 1;
+                const std::vector<double> a = iota(m, lda);
+                std::vector<float> A(a.begin(), a.end()), B(n * ldb, -1);
+                layout::transpose(m, n, A.data(), lda, B.data(), ldb);
+                for (ptrdiff_t j = 0; j < n; j++) {
+                    for (ptrdiff_t i = 0; i < ldb; i++) {
+                        ASSERT_EQ(B[j*ldb + i], i < m ? A[i*lda + j] : -1)
+                            << name << " " << m << " x " << n;
+                    }
+                }
+            }
+            // Square in place, and by cycles for a rectangle
+            const ptrdiff_t lda = m + 2;
+            const std::vector<double> a = iota(m, lda);
+            std::vector<float> A(a.begin(), a.end()), A0(A);
+            layout::transposeSquare(m, A.data(), lda);
+            for (ptrdiff_t i = 0; i < m; i++)
+                for (ptrdiff_t j = 0; j < m; j++)
+                    ASSERT_EQ(A[i*lda + j], A0[j*lda + i]) << name << " " << m;
+            const std::vector<double> r = iota(m, 5);
+            std::vector<float> R(r.begin(), r.end()), R0(R);
+            layout::transposeInPlace(m, 5, R.data());
+            for (ptrdiff_t j = 0; j < 5; j++)
+                for (ptrdiff_t i = 0; i < m; i++)
+                    ASSERT_EQ(R[j*m + i], R0[i*5 + j]) << m << " x 5";
+        }
+    }
+}
@@ -1,8 +1,10 @@
 // Copyright 2023 Caleb Magruder
 
+#include <algorithm>
 #include <cstdio>
 #include <list>
 #include <fstream>
+#include <type_traits>
 
 #include "gtest/gtest.h"
 
@@ -47,14 +49,20 @@ class tMatrixPtr : public TestWithLogging {};
 
     using MyTypes = ::testing::Types
             < Matrix<REF>
+            , Matrix<REF, float>
+            , Matrix<AUTO>
+            , Matrix<AUTO, float>
         #if ACC_FOUND
                 , Matrix<ACC>
+                , Matrix<ACC, float>
         #endif
         #if OPB_FOUND
                 , Matrix<OPB>
+                , Matrix<OPB, float>
         #endif
         #if MKL_FOUND
                 , Matrix<MKL>
+                , Matrix<MKL, float>
         #endif
             >;
 
@@ -98,6 +106,96 @@ TYPED_TEST(tMatrix, MatrixMultiplicationOperator) {
     Semantics::multiplication<TypeParam>(false, true, 2.0, C, C, 2*D);
 }
 
+/////////////////////////////////////////
+// C = act(alpha * op(A) * op(B) + beta * C + bias)
+/////////////////////////////////////////
+TYPED_TEST(tMatrix, MprodEpilogue) {
+    TypeParam A = TypeParam::randn(9, 5), B = TypeParam::randn(5, 7);
+    TypeParam C0 = TypeParam::randn(9, 7);
+    const double tol = std::is_same_v<typename TypeParam::Scalar, float>
+                     ? 1e-4 : 1e-12;
+
+    // beta accumulates into C without a temporary
+    TypeParam C(C0);
+    mprod(false, false, 2.0, A, B, -1.0, &C);
+    TypeParam AB = A * B;
+    for (ptrdiff_t i = 0; i < C.rows(); i++)
+        for (ptrdiff_t j = 0; j < C.cols(); j++)
+            EXPECT_NEAR(C[i][j], 2.0 * AB[i][j] - C0[i][j], tol);
+
+    // Column bias through a strided view, fused tanh
+    TypeParam W = TypeParam::randn(9, 3);
+    auto b = W.colBlock(1, 1);
+    TypeParam D(C0);
+    mprod(false, false, 1.0, A, B, 0.5, &D, b, gemm::Epilogue::tanh());
+    for (ptrdiff_t i = 0; i < D.rows(); i++)
+        for (ptrdiff_t j = 0; j < D.cols(); j++)
+            EXPECT_NEAR(D[i][j],
+                        std::tanh(AB[i][j] + 0.5 * C0[i][j] + W[i][1]), tol);
+
+    // Row bias added to every column, with relu
+    TypeParam r = TypeParam::randn(1, 7);
+    TypeParam E(9, 7);
+    mprod(false, false, 1.0, A, B, 0.0, &E, r, gemm::Epilogue::relu());
+    for (ptrdiff_t i = 0; i < E.rows(); i++)
+        for (ptrdiff_t j = 0; j < E.cols(); j++)
+            EXPECT_NEAR(E[i][j], std::max<double>(AB[i][j] + r[0][j], 0), tol);
+
+    // Bias matching neither dimension
+    TypeParam bad(7, 1);
+    EXPECT_THROW(mprod(false, false, 1.0, A, B, 0.0, &E, bad), int);
+}
+
+/////////////////////////////////////////
+// mprod with a vector operand, mgemv(trans, alpha, A, x, incx, beta, &y, incy)
+/////////////////////////////////////////
+TYPED_TEST(tMatrix, MatrixVector) {
+    TypeParam A = TypeParam::randn(13, 9), x = TypeParam::randn(9);
+    const double tol = std::is_same_v<typename TypeParam::Scalar, float>
+                     ? 1e-4 : 1e-12;
+    auto expectNear = [tol](const TypeParam& C, const TypeParam& D) {
+        ASSERT_EQ(C.rows(), D.rows());
+        ASSERT_EQ(C.cols(), D.cols());
+        for (ptrdiff_t i = 0; i < C.rows(); i++)
+            for (ptrdiff_t j = 0; j < C.cols(); j++)
+                EXPECT_NEAR(C[i][j], D[i][j], tol);
+    };
+    // Reference through the general product: x as two equal columns
+    TypeParam X(9, 2);
+    for (ptrdiff_t i = 0; i < 9; i++) X[i][0] = X[i][1] = x[i][0];
+    TypeParam AX = A * X;
+    auto Ax = AX.colBlock(0, 1);
+
+    // y = A * x, y^T = x^T * A^T, into a strided column
+    expectNear(A * x, TypeParam(Ax));
+    TypeParam xt = transpose(x), yt(1, 13);
+    mprod(false, true, 1.0, xt, A, 0.0, &yt);
+    expectNear(transpose(yt), TypeParam(Ax));
+    TypeParam Y(13, 3);
+    Y.fill(1);
+    auto y = Y.colBlock(1, 1);
+    mprod(false, false, 2.0, A, x, 0.5, &y);
+    for (ptrdiff_t i = 0; i < 13; i++) {
+        EXPECT_NEAR(Y[i][1], 2.0 * Ax[i][0] + 0.5, tol);
+        EXPECT_EQ(Y[i][0], 1);
+        EXPECT_EQ(Y[i][2], 1);
+    }
+
+    // z = A^T * w with every other element of w and z
+    TypeParam w = TypeParam::randn(26), z(18);
+    z.fill(7);
+    mgemv(true, 1.0, A, w, 2, 0.0, &z, 2);
+    for (ptrdiff_t j = 0; j < 9; j++) {
+        double r = 0;
+        for (ptrdiff_t i = 0; i < 13; i++) r += A[i][j] * w[2*i][0];
+        EXPECT_NEAR(z[2*j][0], r, tol);
+        EXPECT_EQ(z[2*j + 1][0], 7);
+    }
+    TypeParam small(16);
+    EXPECT_THROW(mgemv(true, 1.0, A, w, 2, 0.0, &small, 2), int);
+    EXPECT_THROW(mgemv(true, 1.0, A, w, 0, 0.0, &z, 2), int);
+}
+
 /////////////////////////////////////////
 // hprod(A, B, &C)
 /////////////////////////////////////////
@@ -105,8 +203,8 @@ TYPED_TEST(tMatrix, HadamardMultiplicationOperator) {
     TypeParam A = build2x2<TypeParam>();
     TypeParam B = TypeParam(2, 2);
     for (ptrdiff_t i = 0; i < numel(B); i++) {
-        static_cast<double*>(B)[i]
-            = static_cast<double*>(A)[i] * static_cast<double*>(A)[i];
+        typename TypeParam::Scalar* a = A;
+        static_cast<typename TypeParam::Scalar*>(B)[i] = a[i] * a[i];
     }
     Semantics::hadamardMultiplication<TypeParam>(A, A, B);
 }
@@ -183,6 +281,22 @@ TYPED_TEST(tMatrix, AdditionOperator) {
 TYPED_TEST(tMatrix, SubtractionOperator) {
     Semantics::subtraction<TypeParam>(build2x2<TypeParam>());
 }
+/////////////////////////////////////////
+// C = A + B
+// C = alpha * hprod(A, B) + tanh(A - B)
+/////////////////////////////////////////
+TYPED_TEST(tMatrix, Expression) {
+    Semantics::expression<TypeParam>(build2x2<TypeParam>());
+}
+
+/////////////////////////////////////////
+// A.block(i, j, m, n), A.row(i), A.col(j)
+// mprod(A.colBlock(0, k), W, &view)
+/////////////////////////////////////////
+TYPED_TEST(tMatrix, View) {
+    Semantics::view<TypeParam>();
+}
+
 /////////////////////////////////////////
 // A = std::move(B)
 /////////////////////////////////////////
@@ -259,6 +373,38 @@ TYPED_TEST(tMatrix, Tanh) {
     EXPECT_EQ(A[1][1], std::tanh(B[1][1]));
 }
 
+/////////////////////////////////////////
+// tanh(&A, mode), within each mode's error bound
+/////////////////////////////////////////
+TYPED_TEST(tMatrix, TanhAccuracy) {
+    const struct { vmath::Accuracy mode; double tol; } bounds[] = {
+        {vmath::HIGH, 1e-15}, {vmath::LOW, 1e-15}, {vmath::FAST, 1e-8}};
+    // Single precision is bounded by its own rounding
+    const double eps = std::is_same_v<typename TypeParam::Scalar, float>
+                     ? Semantics::eps<TypeParam>() : 0;
+    for (auto b : bounds) {
+        TypeParam A = TypeParam::randn(37, 11);
+        TypeParam B(A);
+        tanh(&A, b.mode);
+        for (ptrdiff_t i = 0; i < A.rows(); i++) {
+            for (ptrdiff_t j = 0; j < A.cols(); j++) {
+                const double ref = std::tanh(B[i][j]);
+                EXPECT_NEAR(A[i][j], ref,
+                            std::max(b.tol, eps) * std::fabs(ref));
+            }
+        }
+        // Strided view leaves the surrounding columns alone
+        TypeParam C(B);
+        auto V = B.colBlock(2, 5);
+        tanh(&V, b.mode);
+        for (ptrdiff_t i = 0; i < B.rows(); i++) {
+            EXPECT_EQ(B[i][1], C[i][1]);
+            EXPECT_EQ(B[i][7], C[i][7]);
+            EXPECT_EQ(B[i][3], A[i][3]);
+        }
+    }
+}
+
 /////////////////////////////////////////
 // dot(A,B)
 /////////////////////////////////////////
@@ -286,7 +432,7 @@ TYPED_TEST(tMatrix, Transpose) {
     ptrdiff_t m = 10, n = 5;
     TypeParam X(m, n);
     for (ptrdiff_t i = 0; i < m*n; i++) {
-        static_cast<double*>(X)[i] = i;
+        static_cast<typename TypeParam::Scalar*>(X)[i] = i;
     }
     TypeParam Y = transpose(X);
     for (ptrdiff_t i = 0; i < m; i++) {
@@ -294,6 +440,46 @@ TYPED_TEST(tMatrix, Transpose) {
             ASSERT_EQ(X[i][j], Y[j][i]);
         }
     }
+
+    // Into a view: Z[:, 1:11] = X^T
+    TypeParam Z(n, m + 2);
+    auto W = Z.colBlock(1, m);
+    transpose(X, &W);
+    for (ptrdiff_t i = 0; i < m; i++) {
+        for (ptrdiff_t j = 0; j < n; j++) {
+            ASSERT_EQ(X[i][j], Z[j][i + 1]);
+        }
+    }
+    EXPECT_ANY_THROW(transpose(X, &Z));
+}
+
+/////////////////////////////////////////
+// transpose(&X)
+/////////////////////////////////////////
+TYPED_TEST(tMatrix, TransposeInPlace) {
+    // Rectangular: (37 x 70) becomes (70 x 37)
+    TypeParam X = TypeParam::randn(37, 70);
+    TypeParam Y = transpose(X);
+    transpose(&X);
+    EXPECT_EQ(X.rows(), 70);
+    EXPECT_EQ(X.cols(), 37);
+    EXPECT_EQ(X, Y);
+
+    // Square block of a larger matrix, the rest is untouched
+    TypeParam A = TypeParam::randn(80, 90);
+    TypeParam B(A);
+    auto S = A.block(3, 5, 70, 70);
+    transpose(&S);
+    for (ptrdiff_t i = 0; i < 80; i++) {
+        for (ptrdiff_t j = 0; j < 90; j++) {
+            const bool inside = i >= 3 && i < 73 && j >= 5 && j < 75;
+            ASSERT_EQ(A[i][j], inside ? B[j - 5 + 3][i - 3 + 5] : B[i][j]);
+        }
+    }
+
+    // A rectangular view cannot change shape in place
+    auto R = A.block(0, 0, 3, 5);
+    EXPECT_ANY_THROW(transpose(&R));
 }
 
 /////////////////////////////////////////
@@ -329,9 +515,9 @@ TYPED_TEST(tMatrix, Serialize) {
 TYPED_TEST(tMatrixPtr, Constructor) {
     TypeParam* A = new TypeParam(build2x2<TypeParam>());
     typename TypeParam::Ptr ptr1(
-        static_cast<double*>(*A), A->rows(), A->cols());
+        static_cast<typename TypeParam::Scalar*>(*A), A->rows(), A->cols());
     typename TypeParam::Ptr* ptr2 = new typename TypeParam::Ptr(
-        static_cast<double*>(*A), A->rows(), A->cols());
+        static_cast<typename TypeParam::Scalar*>(*A), A->rows(), A->cols());
     delete ptr2;
     delete A;
 }
@@ -0,0 +1,260 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Matrix.h"
+#include "MatrixFile.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tMatrixFile Fixture
+/////////////////////////////////////////
+class tMatrixFile : public TestWithLogging {
+ protected:
+    const char* fileName = "TestMatrixFile.bin";
+
+    void SetUp() override { std::remove(fileName); }
+    void TearDown() override { std::remove(fileName); }
+
+    Matrix<REF> write(ptrdiff_t m, ptrdiff_t n) {
+        Matrix<REF> A = Matrix<REF>::randn(m, n);
+        std::ofstream ofile(fileName, std::ios::binary);
+        ofile << A;
+        return A;
+    }
+};
+
+/////////////////////////////////////////
+// Header layout and alignment
+/////////////////////////////////////////
+TEST_F(tMatrixFile, Header) {
+    Matrix<REF> A = write(7, 3);
+    std::ifstream ifile(fileName, std::ios::binary);
+    matrixfile::Header h;
+    ifile.read(reinterpret_cast<char*>(&h), sizeof(h));
+    EXPECT_TRUE(h.valid());
+    EXPECT_EQ(h.version, matrixfile::VERSION);
+    EXPECT_EQ(h.dtype, matrixfile::FLOAT64);
+    EXPECT_EQ(h.layout, matrixfile::ROW_MAJOR);
+    EXPECT_EQ(h.rows, 7);
+    EXPECT_EQ(h.cols, 3);
+    EXPECT_EQ(h.offset % h.alignment, 0u);
+    EXPECT_EQ(h.checksum, matrixfile::checksum(static_cast<double*>(A),
+                                               h.bytes()));
+}
+
+/////////////////////////////////////////
+// Checksum::update in pieces matches checksum()
+/////////////////////////////////////////
+TEST_F(tMatrixFile, ChecksumStreaming) {
+    std::vector<unsigned char> bytes(1001);
+    for (size_t i = 0; i < bytes.size(); i++) bytes[i] = i * 37;
+    const uint64_t whole = matrixfile::checksum(bytes.data(), bytes.size());
+    for (size_t split : {1, 3, 8, 31, 500}) {
+        matrixfile::Checksum c;
+        for (size_t i = 0; i < bytes.size(); i += split) {
+            c.update(bytes.data() + i, std::min(split, bytes.size() - i));
+        }
+        EXPECT_EQ(c.digest(), whole) << split;
+    }
+    bytes[500] ^= 1;
+    EXPECT_NE(matrixfile::checksum(bytes.data(), bytes.size()), whole);
+}
+
+/////////////////////////////////////////
+// Corrupt data is rejected by operator>>
+/////////////////////////////////////////
+TEST_F(tMatrixFile, Corrupt) {
+    write(4, 4);
+    {
+        std::fstream f(fileName, std::ios::in | std::ios::out |
+                                 std::ios::binary);
+        // Flip a bit so the byte changes whatever the data
+        f.seekg(matrixfile::ALIGN + 3);
+        const char b = f.get();
+        f.seekp(matrixfile::ALIGN + 3);
+        f.put(b ^ 1);
+    }
+    std::ifstream ifile(fileName, std::ios::binary);
+    Matrix<REF> B;
+    EXPECT_ANY_THROW(ifile >> B);
+    EXPECT_ANY_THROW(MappedFile(fileName, MappedFile::READ_ONLY,
+                                MappedFile::NORMAL, true));
+}
+
+/////////////////////////////////////////
+// [m, n, data] files still load
+/////////////////////////////////////////
+TEST_F(tMatrixFile, Legacy) {
+    ptrdiff_t m = 2, n = 3;
+    double data[6] = {1, 2, 3, 4, 5, 6};
+    {
+        std::ofstream ofile(fileName, std::ios::binary);
+        ofile.write(reinterpret_cast<const char*>(&m), sizeof(m));
+        ofile.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        ofile.write(reinterpret_cast<const char*>(data), sizeof(data));
+    }
+    std::ifstream ifile(fileName, std::ios::binary);
+    Matrix<REF> B;
+    ifile >> B;
+    ASSERT_EQ(B.rows(), m);
+    ASSERT_EQ(B.cols(), n);
+    EXPECT_EQ(B[1][2], 6);
+
+    // and convert to float
+    ifile.close();
+    ifile.open(fileName, std::ios::binary);
+    Matrix<REF, float> C;
+    ifile >> C;
+    ASSERT_EQ(C.rows(), m);
+    ASSERT_EQ(C.cols(), n);
+    EXPECT_EQ(C[1][2], 6.0f);
+}
+
+/////////////////////////////////////////
+// FLOAT32 files round-trip, and convert on load to the other precision
+/////////////////////////////////////////
+TEST_F(tMatrixFile, Float32) {
+    Matrix<REF, float> A = Matrix<REF, float>::randn(5, 4);
+    {
+        std::ofstream ofile(fileName, std::ios::binary);
+        ofile << A;
+    }
+    {
+        std::ifstream ifile(fileName, std::ios::binary);
+        matrixfile::Header h;
+        ifile.read(reinterpret_cast<char*>(&h), sizeof(h));
+        EXPECT_EQ(h.dtype, matrixfile::FLOAT32);
+        EXPECT_EQ(h.bytes(), 5u * 4u * sizeof(float));
+    }
+    std::ifstream ifile(fileName, std::ios::binary);
+    Matrix<REF, float> B;
+    ifile >> B;
+    EXPECT_EQ(A, B);
+
+    // float -> double is exact
+    ifile.close();
+    ifile.open(fileName, std::ios::binary);
+    Matrix<REF> D;
+    ifile >> D;
+    for (ptrdiff_t i = 0; i < 5; i++)
+        for (ptrdiff_t j = 0; j < 4; j++)
+            EXPECT_EQ(D[i][j], static_cast<double>(A[i][j]));
+
+    // Mapping needs a matching element type
+    EXPECT_ANY_THROW(Matrix<REF>::Mapped M(fileName));
+    Matrix<REF, float>::Mapped M(fileName);
+    EXPECT_EQ(M, A);
+
+    // double -> float rounds
+    Matrix<REF> E = write(3, 3);
+    std::ifstream efile(fileName, std::ios::binary);
+    Matrix<REF, float> F;
+    efile >> F;
+    EXPECT_EQ(F[2][1], static_cast<float>(E[2][1]));
+}
+
+/////////////////////////////////////////
+// Views serialize compactly
+/////////////////////////////////////////
+TEST_F(tMatrixFile, View) {
+    Matrix<REF> A = Matrix<REF>::randn(6, 5);
+    auto V = A.block(1, 1, 3, 3);
+    {
+        std::ofstream ofile(fileName, std::ios::binary);
+        ofile << V;
+    }
+    std::ifstream ifile(fileName, std::ios::binary);
+    Matrix<REF> B;
+    ifile >> B;
+    EXPECT_EQ(B, Matrix<REF>(V));
+}
+
+/////////////////////////////////////////
+// Matrix<T>::Mapped reads in place
+/////////////////////////////////////////
+TEST_F(tMatrixFile, MappedReadOnly) {
+    Matrix<REF> A = write(33, 17);
+    Matrix<REF>::Mapped M(fileName, MappedFile::READ_ONLY,
+                          MappedFile::WILLNEED, true);
+    EXPECT_EQ(M.rows(), 33);
+    EXPECT_EQ(M.cols(), 17);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(static_cast<double*>(M)) % 64, 0u);
+    EXPECT_EQ(M, A);
+    M.file().advise(MappedFile::RANDOM);
+
+    // Usable as an operand
+    Matrix<REF> x = Matrix<REF>::randn(17, 1);
+    Matrix<REF> y = M * x;
+    EXPECT_EQ(y, A * x);
+}
+
+/////////////////////////////////////////
+// COPY_ON_WRITE writes never reach the file
+/////////////////////////////////////////
+TEST_F(tMatrixFile, MappedCopyOnWrite) {
+    Matrix<REF> A = write(8, 8);
+    {
+        Matrix<REF>::Mapped M(fileName, MappedFile::COPY_ON_WRITE);
+        M.fill(0);
+        EXPECT_EQ(M[3][3], 0);
+
+        // The mapping cannot be replaced by a matrix of another shape
+        Matrix<REF> B(4, 4);
+        B.fill(1);
+        EXPECT_THROW(M = B + B, int);
+        EXPECT_EQ(M.rows(), 8);
+        M = A + A;
+        EXPECT_EQ(M[3][3], 2 * A[3][3]);
+    }
+    Matrix<REF>::Mapped M(fileName);
+    EXPECT_EQ(M, A);
+}
+
+/////////////////////////////////////////
+// Missing and non-matrix files throw
+/////////////////////////////////////////
+TEST_F(tMatrixFile, MappedInvalid) {
+    EXPECT_ANY_THROW(Matrix<REF>::Mapped("DoesNotExist.bin"));
+    {
+        std::ofstream ofile(fileName, std::ios::binary);
+        for (int i = 0; i < 100; i++) ofile.put('x');
+    }
+    EXPECT_ANY_THROW(MappedFile{fileName});
+
+    // An offset past the end must not wrap around when added to the size
+    write(4, 4);
+    {
+        std::fstream file(fileName, std::ios::binary | std::ios::in
+                                    | std::ios::out);
+        matrixfile::Header h;
+        file.read(reinterpret_cast<char*>(&h), sizeof(h));
+        h.offset = ~uint64_t(0) / h.alignment * h.alignment;
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+    EXPECT_ANY_THROW(MappedFile{fileName});
+
+    // So must a shape whose size in bytes overflows
+    write(4, 4);
+    {
+        std::fstream file(fileName, std::ios::binary | std::ios::in
+                                    | std::ios::out);
+        matrixfile::Header h;
+        file.read(reinterpret_cast<char*>(&h), sizeof(h));
+        h.rows = int64_t(1) << 61;
+        h.cols = 8;
+        EXPECT_FALSE(h.valid());
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+    EXPECT_ANY_THROW(MappedFile{fileName});
+    std::ifstream ifile(fileName, std::ios::binary);
+    Matrix<REF> B;
+    EXPECT_ANY_THROW(ifile >> B);
+}
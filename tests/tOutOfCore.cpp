@@ -0,0 +1,157 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cstdio>
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+#include "Matrix.h"
+#include "OutOfCore.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tOutOfCore Fixture
+/////////////////////////////////////////
+template <typename T>
+class tOutOfCore : public TestWithLogging {
+ protected:
+    void TearDown() override {
+        for (const char* f : {"TestA.bin", "TestB.bin", "TestC.bin"})
+            std::remove(f);
+    }
+
+    // Small budget so that every operand spans several 8 x 8 tiles
+    const size_t budget = 6 * 8 * 8 * sizeof(double);
+
+    T write(const char* fileName, ptrdiff_t m, ptrdiff_t n) {
+        T A = T::randn(m, n);
+        std::ofstream ofile(fileName, std::ios::binary);
+        ofile << A;
+        return A;
+    }
+};
+
+    using MyTypes = ::testing::Types
+            < Matrix<REF>
+        #if ACC_FOUND
+                , Matrix<ACC>
+        #endif
+        #if OPB_FOUND
+                , Matrix<OPB>
+        #endif
+        #if MKL_FOUND
+                , Matrix<MKL>
+        #endif
+            >;
+
+TYPED_TEST_SUITE(tOutOfCore, MyTypes);
+
+// Backend of a Matrix type, for the non-deducible DiskMatrix output form
+template <typename T> struct Backend;
+template <BLAS B> struct Backend<Matrix<B>> {
+    static constexpr BLAS value = B;
+};
+
+template <typename T>
+void expectNear(const T& A, const T& B) {
+    ASSERT_EQ(A.rows(), B.rows());
+    ASSERT_EQ(A.cols(), B.cols());
+    for (ptrdiff_t i = 0; i < A.rows(); i++)
+        for (ptrdiff_t j = 0; j < A.cols(); j++)
+            EXPECT_NEAR(A[i][j], B[i][j], 1e-12 * A.cols() * 10);
+}
+
+TEST(tOutOfCoreTile, Budget) {
+    EXPECT_EQ(outofcore::tile(6 * 8 * 8 * sizeof(double)), 8);
+    EXPECT_EQ(outofcore::tile(0), 1);
+}
+
+/////////////////////////////////////////
+// mprod(DiskMatrix, DiskMatrix, &C) == A * B
+/////////////////////////////////////////
+TYPED_TEST(tOutOfCore, Multiply) {
+    TypeParam A = this->write("TestA.bin", 37, 23);
+    TypeParam B = this->write("TestB.bin", 23, 19);
+    DiskMatrix dA("TestA.bin"), dB("TestB.bin");
+    TypeParam C(37, 19);
+    mprod(false, false, 2.0, dA, dB, &C, this->budget);
+    TypeParam D(37, 19);
+    mprod(false, false, 2.0, A, B, &D);
+    expectNear(C, D);
+}
+
+/////////////////////////////////////////
+// Gram matrix: mprod(true, false, X, X) and mprod(false, true, X, X)
+/////////////////////////////////////////
+TYPED_TEST(tOutOfCore, Transposed) {
+    TypeParam X = this->write("TestA.bin", 41, 13);
+    DiskMatrix dX("TestA.bin");
+    TypeParam G(13, 13), H(13, 13);
+    mprod(true, false, 1.0, dX, dX, &G, this->budget);
+    mprod(true, false, 1.0, X, X, &H);
+    expectNear(G, H);
+
+    TypeParam K(41, 41), L(41, 41);
+    mprod(false, true, 1.0, dX, dX, &K, this->budget);
+    mprod(false, true, 1.0, X, X, &L);
+    expectNear(K, L);
+}
+
+/////////////////////////////////////////
+// C written to disk tile by tile and sealed
+/////////////////////////////////////////
+TYPED_TEST(tOutOfCore, MultiplyToDisk) {
+    TypeParam A = this->write("TestA.bin", 20, 30);
+    TypeParam B = this->write("TestB.bin", 30, 17);
+    {
+        DiskMatrix dA("TestA.bin"), dB("TestB.bin");
+        DiskMatrix dC = DiskMatrix::create("TestC.bin", 20, 17);
+        mprod<Backend<TypeParam>::value>(false, false, 1.0, dA, dB, &dC,
+                                         this->budget);
+    }
+    // operator>> verifies the checksum
+    std::ifstream ifile("TestC.bin", std::ios::binary);
+    TypeParam C;
+    ifile >> C;
+    expectNear(C, TypeParam(A * B));
+}
+
+/////////////////////////////////////////
+// Mismatched dimensions throw
+/////////////////////////////////////////
+TYPED_TEST(tOutOfCore, Dimensions) {
+    this->write("TestA.bin", 5, 4);
+    DiskMatrix dA("TestA.bin");
+    TypeParam C(5, 5);
+    EXPECT_ANY_THROW(mprod(false, false, 1.0, dA, dA, &C, this->budget));
+}
+
+/////////////////////////////////////////
+// Prefetcher runs ahead and forwards errors
+/////////////////////////////////////////
+TEST(tPrefetcher, Order) {
+    Prefetcher io(10, 1, 3, [](ptrdiff_t s, double* buffer) {
+        buffer[0] = s;
+    });
+    for (ptrdiff_t s = 0; s < 10; s++) {
+        EXPECT_EQ(io.acquire(s)[0], s);
+        io.release(s);
+    }
+}
+
+TEST(tPrefetcher, Error) {
+    Prefetcher io(4, 1, 2, [](ptrdiff_t s, double*) {
+        if (s == 2) throw(1);
+    });
+    io.acquire(0);
+    io.release(0);
+    io.acquire(1);
+    io.release(1);
+    EXPECT_ANY_THROW(io.acquire(2));
+}
+
+TEST(tPrefetcher, EarlyExit) {
+    // Destroyed before every step is consumed
+    Prefetcher io(100, 1, 2, [](ptrdiff_t, double*) {});
+    io.acquire(0);
+}
@@ -0,0 +1,166 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Matrix.h"
+#include "Random.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tRandom Fixture
+/////////////////////////////////////////
+template <typename T>
+class tRandom : public TestWithLogging {
+ protected:
+    // Sample mean and variance of A's elements
+    static void moments(const T& A, double* mean, double* var) {
+        const typename T::Scalar* a = A;
+        double sum = 0, sq = 0;
+        for (ptrdiff_t i = 0; i < numel(A); i++) {
+            sum += a[i];
+            sq += double(a[i]) * a[i];
+        }
+        *mean = sum / numel(A);
+        *var = sq / numel(A) - *mean * *mean;
+    }
+};
+
+    using MyTypes = ::testing::Types
+            < Matrix<REF>
+            , Matrix<REF, float>
+            , Matrix<AUTO>
+            , Matrix<AUTO, float>
+        #if ACC_FOUND
+                , Matrix<ACC>
+                , Matrix<ACC, float>
+        #endif
+        #if OPB_FOUND
+                , Matrix<OPB>
+                , Matrix<OPB, float>
+        #endif
+        #if MKL_FOUND
+                , Matrix<MKL>
+                , Matrix<MKL, float>
+        #endif
+            >;
+
+TYPED_TEST_SUITE(tRandom, MyTypes);
+
+/////////////////////////////////////////
+// The same seed gives the same matrix for any thread count
+/////////////////////////////////////////
+TYPED_TEST(tRandom, Reproducible) {
+    using T = TypeParam;
+    const ptrdiff_t m = 300, n = 500;  // Several parallel tasks
+    const int threads = getNumThreads();
+
+    setNumThreads(1);
+    rng::Generator g(42);
+    T A = T::randn(m, n, g), B = T::randn(7, 3, g);
+    setNumThreads(4);
+    rng::Generator h(42);
+    T C = T::randn(m, n, h), D = T::randn(7, 3, h);
+    EXPECT_TRUE(A == C);
+    EXPECT_TRUE(B == D);
+    EXPECT_EQ(g.offset(), h.offset());
+    setNumThreads(threads);
+
+    // Replay from an offset
+    h.seek(0);
+    T E = T::randn(m, n, h);
+    EXPECT_TRUE(A == E);
+
+    // Other seeds, streams and draws differ
+    rng::Generator s(43), t(42, 1);
+    T F = T::randn(m, n, s), G = T::randn(m, n, t);
+    EXPECT_FALSE(A == F);
+    EXPECT_FALSE(A == G);
+    EXPECT_FALSE(A == T::randn(m, n, g));
+    EXPECT_FALSE(T::randn(m, n) == T::randn(m, n));
+}
+
+/////////////////////////////////////////
+// N(0, 1) moments
+/////////////////////////////////////////
+TYPED_TEST(tRandom, Normal) {
+    using T = TypeParam;
+    rng::Generator g(7);
+    T A = T::randn(1000, 1000, g);
+    double mean, var;
+    this->moments(A, &mean, &var);
+    EXPECT_NEAR(mean, 0, 0.005);
+    EXPECT_NEAR(var, 1, 0.005);
+
+    // Fraction within one standard deviation
+    const typename T::Scalar* a = A;
+    ptrdiff_t inside = 0;
+    for (ptrdiff_t i = 0; i < numel(A); i++) inside += std::abs(a[i]) < 1;
+    EXPECT_NEAR(inside / 1e6, 0.6826894921, 0.002);
+}
+
+/////////////////////////////////////////
+// rng::philox known answers (Random123)
+/////////////////////////////////////////
+TEST(tRandomPhilox, KnownAnswers) {
+    uint32_t out[4];
+    const uint32_t zero[4] = {0, 0, 0, 0};
+    rng::philox(zero, zero, out);
+    EXPECT_EQ(out[0], 0x6627e8d5u);
+    EXPECT_EQ(out[1], 0xe169c58du);
+    EXPECT_EQ(out[2], 0xbc57ac4cu);
+    EXPECT_EQ(out[3], 0x9b00dbd8u);
+
+    const uint32_t pi[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+    const uint32_t key[2] = {0xa4093822, 0x299f31d0};
+    rng::philox(pi, key, out);
+    EXPECT_EQ(out[0], 0xd16cfe09u);
+    EXPECT_EQ(out[1], 0x94fdccebu);
+    EXPECT_EQ(out[2], 0x5001e420u);
+    EXPECT_EQ(out[3], 0x24126ea1u);
+}
+
+/////////////////////////////////////////
+// Generator fills, counters and uniforms
+/////////////////////////////////////////
+TEST(tRandomPhilox, Generator) {
+    rng::Generator g(1, 2);
+    std::vector<double> x(1001);
+    g.normal(x.size(), x.data());
+    EXPECT_EQ(g.offset(), 501);  // Two doubles per counter
+
+    // A fill is its prefix of a longer fill
+    rng::Generator h(1, 2);
+    std::vector<double> y(10);
+    h.normal(y.size(), y.data());
+    for (size_t i = 0; i < y.size(); i++) EXPECT_EQ(x[i], y[i]);
+    h.seek(0);
+    EXPECT_EQ(h.normal(), x[0]);
+
+    std::vector<float> f(1001);
+    g.uniform(f.size(), f.data());
+    EXPECT_EQ(g.offset(), 501 + 251);  // Four floats per counter
+    double sum = 0;
+    for (float v : f) {
+        EXPECT_GE(v, 0);
+        EXPECT_LT(v, 1);
+        sum += v;
+    }
+    EXPECT_NEAR(sum / f.size(), 0.5, 0.05);
+
+    std::vector<double> u(100000);
+    g.uniform(u.size(), u.data());
+    sum = 0;
+    for (double v : u) sum += v;
+    EXPECT_NEAR(sum / u.size(), 0.5, 0.005);
+
+    // Reseeding the process-wide generator replays randn()
+    rng::seed(5);
+    const double first = Matrix<REF>::randn();
+    rng::seed(5);
+    EXPECT_EQ(Matrix<REF>::randn(), first);
+    EXPECT_EQ(rng::global().seed(), 5);
+}
@@ -0,0 +1,249 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Matrix.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tReduce Fixture
+/////////////////////////////////////////
+template <typename T>
+class tReduce : public TestWithLogging {
+ protected:
+    using S = typename T::Scalar;
+
+    // Relative tolerance of a sum of n elements
+    static double tol(ptrdiff_t n) {
+        return (std::is_same_v<S, float> ? 1e-6 : 1e-14) * n;
+    }
+
+    // A(i, j) = x
+    static void fill(T* A, double x) {
+        S a = static_cast<S>(x);
+        mcopy(&a, 0, A);
+    }
+};
+
+    using MyTypes = ::testing::Types
+            < Matrix<REF>
+            , Matrix<REF, float>
+            , Matrix<AUTO>
+            , Matrix<AUTO, float>
+        #if ACC_FOUND
+                , Matrix<ACC>
+                , Matrix<ACC, float>
+        #endif
+        #if OPB_FOUND
+                , Matrix<OPB>
+                , Matrix<OPB, float>
+        #endif
+        #if MKL_FOUND
+                , Matrix<MKL>
+                , Matrix<MKL, float>
+        #endif
+            >;
+
+TYPED_TEST_SUITE(tReduce, MyTypes);
+
+/////////////////////////////////////////
+// sum, asum and dot of matrices and strided views
+/////////////////////////////////////////
+TYPED_TEST(tReduce, Sums) {
+    using T = TypeParam;
+    T X = T::randn(123, 77);
+    auto V = X.block(3, 5, 100, 61);
+    const T* matrices[] = {&X, &V};
+    for (const T* A : matrices) {
+        double s = 0, a = 0, d = 0;
+        for (ptrdiff_t i = 0; i < A->rows(); i++) {
+            for (ptrdiff_t j = 0; j < A->cols(); j++) {
+                const double x = (*A)[i][j];
+                s += x;
+                a += std::fabs(x);
+                d += x * x;
+            }
+        }
+        const double tol = this->tol(numel(*A)) * a;
+        EXPECT_NEAR(sum(*A), s, tol);
+        EXPECT_NEAR(asum(*A), a, tol);
+        EXPECT_NEAR(dot(*A, *A), d, tol * a);
+    }
+    T E(0, 0);
+    EXPECT_EQ(sum(E), 0);
+    EXPECT_EQ(asum(E), 0);
+}
+
+/////////////////////////////////////////
+// iamax gives the row-major position of the first largest |x|
+/////////////////////////////////////////
+TYPED_TEST(tReduce, Iamax) {
+    using T = TypeParam;
+    T X = T::randn(40, 53);
+    X[7][11] = -100;
+    X[30][2] = 100;
+    EXPECT_EQ(iamax(X), 7 * 53 + 11);
+    auto V = X.block(10, 1, 25, 40);
+    EXPECT_EQ(iamax(V), 20 * 40 + 1);
+    V[2][3] = -200;
+    EXPECT_EQ(iamax(V), 2 * 40 + 3);
+    T E(0, 0);
+    EXPECT_EQ(iamax(E), 0);
+}
+
+/////////////////////////////////////////
+// Row and column reductions against a direct loop, over a strided view
+// wider than one block of columns
+/////////////////////////////////////////
+TYPED_TEST(tReduce, RowsAndColumns) {
+    using T = TypeParam;
+    using S = typename TestFixture::S;
+    T X = T::randn(40, 310);
+    auto A = X.block(2, 3, 37, 300);
+    const ptrdiff_t m = A.rows(), n = A.cols();
+    T rs(m, 1), rm(m, 1), rmax(m, 1), rmin(1, m);
+    T cs(1, n), cm(n, 1), cmax(1, n), cmin(1, n);
+    std::vector<ptrdiff_t> ramax(m), ramin(m), camax(n), camin(n);
+    rowSum(A, &rs);
+    rowMean(A, &rm);
+    rowMax(A, &rmax);
+    rowMin(A, &rmin);
+    rowArgmax(A, ramax.data());
+    rowArgmin(A, ramin.data());
+    colSum(A, &cs);
+    colMean(A, &cm);
+    colMax(A, &cmax);
+    colMin(A, &cmin);
+    colArgmax(A, camax.data());
+    colArgmin(A, camin.data());
+    const S* prs = rs, *prm = rm, *prmax = rmax, *prmin = rmin;
+    for (ptrdiff_t i = 0; i < m; i++) {
+        double s = 0;
+        ptrdiff_t hi = 0, lo = 0;
+        for (ptrdiff_t j = 0; j < n; j++) {
+            s += A[i][j];
+            if (A[i][j] > A[i][hi]) hi = j;
+            if (A[i][j] < A[i][lo]) lo = j;
+        }
+        EXPECT_NEAR(prs[i], s, this->tol(n) * n);
+        EXPECT_NEAR(prm[i], s / n, this->tol(n));
+        EXPECT_EQ(prmax[i], A[i][hi]);
+        EXPECT_EQ(prmin[i], A[i][lo]);
+        EXPECT_EQ(ramax[i], hi);
+        EXPECT_EQ(ramin[i], lo);
+    }
+    const S* pcs = cs, *pcm = cm, *pcmax = cmax, *pcmin = cmin;
+    for (ptrdiff_t j = 0; j < n; j++) {
+        double s = 0;
+        ptrdiff_t hi = 0, lo = 0;
+        for (ptrdiff_t i = 0; i < m; i++) {
+            s += A[i][j];
+            if (A[i][j] > A[hi][j]) hi = i;
+            if (A[i][j] < A[lo][j]) lo = i;
+        }
+        EXPECT_NEAR(pcs[j], s, this->tol(m) * m);
+        EXPECT_NEAR(pcm[j], s / m, this->tol(m));
+        EXPECT_EQ(pcmax[j], A[hi][j]);
+        EXPECT_EQ(pcmin[j], A[lo][j]);
+        EXPECT_EQ(camax[j], hi);
+        EXPECT_EQ(camin[j], lo);
+    }
+}
+
+/////////////////////////////////////////
+// Ties go to the first element, NaNs are skipped by max and min
+/////////////////////////////////////////
+TYPED_TEST(tReduce, TiesAndNaN) {
+    using T = TypeParam;
+    using S = typename TestFixture::S;
+    T A(3, 20);
+    this->fill(&A, 0);
+    A[0][4] = 5;
+    A[0][17] = 5;
+    A[1][2] = std::numeric_limits<S>::quiet_NaN();
+    A[1][9] = -3;
+    A[2][0] = std::numeric_limits<S>::quiet_NaN();
+    std::vector<ptrdiff_t> hi(3), lo(3), col(20);
+    rowArgmax(A, hi.data());
+    rowArgmin(A, lo.data());
+    EXPECT_EQ(hi[0], 4);
+    EXPECT_EQ(lo[0], 0);
+    EXPECT_EQ(hi[1], 0);
+    EXPECT_EQ(lo[1], 9);
+    EXPECT_EQ(hi[2], 1);
+    EXPECT_EQ(lo[2], 1);
+    T y(3, 1);
+    rowMax(A, &y);
+    EXPECT_EQ(y[0], 5);
+    EXPECT_EQ(y[1], 0);
+    colArgmin(A, col.data());
+    EXPECT_EQ(col[0], 0);
+    EXPECT_EQ(col[2], 0);
+    EXPECT_EQ(col[9], 1);
+}
+
+/////////////////////////////////////////
+// norm neither overflows nor underflows when the norm itself does not
+/////////////////////////////////////////
+TYPED_TEST(tReduce, ScaledNorm) {
+    using T = TypeParam;
+    using S = typename TestFixture::S;
+    const double big = std::is_same_v<S, float> ? 1e30 : 1e200;
+    const double small = std::is_same_v<S, float> ? 1e-30 : 1e-200;
+    T A(30, 40);
+    this->fill(&A, big);
+    EXPECT_NEAR(norm(A) / big, std::sqrt(1200.), 1e-5);
+    this->fill(&A, small);
+    EXPECT_NEAR(norm(A) / small, std::sqrt(1200.), 1e-5);
+    A[3][4] = 3 * small;
+    A[5][6] = 4 * small;
+    auto V = A.block(3, 4, 3, 3);
+    this->fill(&V, 0);
+    V[0][0] = 3 * small;
+    V[2][2] = 4 * small;
+    EXPECT_NEAR(norm(V) / small, 5, 1e-5);
+    this->fill(&A, 0);
+    EXPECT_EQ(norm(A), 0);
+    A[1][1] = std::numeric_limits<S>::infinity();
+    EXPECT_TRUE(std::isinf(norm(A)));
+}
+
+/////////////////////////////////////////
+// Row and column results do not depend on the thread count
+/////////////////////////////////////////
+TYPED_TEST(tReduce, Threads) {
+    using T = TypeParam;
+    const int threads = getNumThreads();
+    T A = T::randn(500, 700);
+    T r1(500, 1), c1(1, 700), r4(500, 1), c4(1, 700);
+    setNumThreads(1);
+    rowSum(A, &r1);
+    colMean(A, &c1);
+    setNumThreads(4);
+    rowSum(A, &r4);
+    colMean(A, &c4);
+    setNumThreads(threads);
+    EXPECT_EQ(r1, r4);
+    EXPECT_EQ(c1, c4);
+}
+
+/////////////////////////////////////////
+// Outputs must be contiguous vectors of the reduced length
+/////////////////////////////////////////
+TYPED_TEST(tReduce, Shapes) {
+    using T = TypeParam;
+    T A(4, 6), y(5, 1), Y(6, 2);
+    this->fill(&A, 1);
+    EXPECT_ANY_THROW(rowSum(A, &y));
+    EXPECT_ANY_THROW(colSum(A, &y));
+    auto c = Y.col(0);
+    EXPECT_ANY_THROW(colSum(A, &c));
+    T x(1, 6);
+    colSum(A, &x);
+    EXPECT_EQ(x[0][5], 4);
+}
@@ -0,0 +1,188 @@
+// Copyright 2023 Caleb Magruder
+
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Matrix.h"
+#include "Sparse.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tSparse Fixture
+/////////////////////////////////////////
+template <typename T>
+class tSparse : public TestWithLogging {
+ protected:
+    using Dense = typename T::Dense;
+
+    // Relative tolerance of the element type
+    const double tol = std::is_same_v<typename T::Scalar, float>
+                     ? 1e-4 : 1e-12;
+
+    // (m x n) with about density * m * n nonzeros
+    static T random(ptrdiff_t m, ptrdiff_t n, double density,
+                    sparse::Format format) {
+        std::mt19937 gen(m * 31 + n);
+        std::uniform_real_distribution<> u(0, 1);
+        std::normal_distribution<> d(0, 1);
+        std::vector<ptrdiff_t> rows, cols;
+        std::vector<typename T::Scalar> values;
+        for (ptrdiff_t i = 0; i < m; i++) {
+            for (ptrdiff_t j = 0; j < n; j++) {
+                if (u(gen) >= density) continue;
+                rows.push_back(i);
+                cols.push_back(j);
+                values.push_back(d(gen));
+            }
+        }
+        return T(m, n, rows, cols, values, format);
+    }
+
+    void expectNear(const Dense& A, const Dense& B) {
+        ASSERT_EQ(A.rows(), B.rows());
+        ASSERT_EQ(A.cols(), B.cols());
+        for (ptrdiff_t i = 0; i < A.rows(); i++)
+            for (ptrdiff_t j = 0; j < A.cols(); j++)
+                ASSERT_NEAR(A[i][j], B[i][j], tol * (1 + std::fabs(B[i][j])))
+                    << i << ", " << j;
+    }
+};
+
+    using MyTypes = ::testing::Types
+            < Sparse<REF>
+            , Sparse<REF, float>
+        #if ACC_FOUND
+                , Sparse<ACC>
+                , Sparse<ACC, float>
+        #endif
+        #if OPB_FOUND
+                , Sparse<OPB>
+                , Sparse<OPB, float>
+        #endif
+        #if MKL_FOUND
+                , Sparse<MKL>
+                , Sparse<MKL, float>
+        #endif
+            >;
+
+TYPED_TEST_SUITE(tSparse, MyTypes);
+
+/////////////////////////////////////////
+// Sparse<T> A(m, n, rows, cols, values)
+/////////////////////////////////////////
+TYPED_TEST(tSparse, FromTriplets) {
+    // Unsorted, with a duplicate at (2, 1)
+    const std::vector<ptrdiff_t> rows = {2, 0, 2, 1, 2};
+    const std::vector<ptrdiff_t> cols = {1, 3, 0, 1, 1};
+    const std::vector<typename TypeParam::Scalar> values = {1, 2, 3, 4, 5};
+    for (auto format : {sparse::CSR, sparse::CSC}) {
+        TypeParam A(3, 4, rows, cols, values, format);
+        EXPECT_EQ(A.nnz(), 4);
+        auto D = A.dense();
+        EXPECT_EQ(D[0][3], 2);
+        EXPECT_EQ(D[1][1], 4);
+        EXPECT_EQ(D[2][0], 3);
+        EXPECT_EQ(D[2][1], 6);
+        EXPECT_EQ(D[0][0], 0);
+        // Indices sorted within each slice
+        for (ptrdiff_t o = 0; o < A.outer(); o++)
+            for (ptrdiff_t k = A.ptr()[o] + 1; k < A.ptr()[o + 1]; k++)
+                EXPECT_LT(A.index()[k - 1], A.index()[k]);
+        // Round trip through the other format and a dense matrix
+        EXPECT_EQ(A.convert(sparse::CSR).dense(), D);
+        EXPECT_EQ(A.convert(sparse::CSC).dense(), D);
+        EXPECT_EQ(TypeParam(D, format).nnz(), 4);
+    }
+    EXPECT_THROW(TypeParam(3, 4, {3}, {0}, {1}), int);
+    EXPECT_THROW(TypeParam(3, 4, {0}, {-1}, {1}), int);
+    EXPECT_THROW(TypeParam(3, 4, {0, 1}, {0}, {1}), int);
+}
+
+/////////////////////////////////////////
+// C = alpha * op(A) * B + beta * C
+// C = alpha * B * op(A) + beta * C
+/////////////////////////////////////////
+TYPED_TEST(tSparse, Products) {
+    using Dense = typename TypeParam::Dense;
+    const ptrdiff_t m = 37, k = 23;
+    for (auto format : {sparse::CSR, sparse::CSC}) {
+        TypeParam A = this->random(m, k, 0.1, format);
+        Dense D = A.dense();
+        for (bool trans : {false, true}) {
+            const ptrdiff_t r = trans ? k : m, c = trans ? m : k;
+            for (ptrdiff_t n : {1, 3, 40}) {
+                Dense B = Dense::randn(c, n), C0 = Dense::randn(r, n);
+                Dense C(C0), E(C0);
+                mprod(trans, 0.5, A, B, -2.0, &C);
+                mprod(trans, false, 0.5, D, B, -2.0, &E);
+                this->expectNear(C, E);
+
+                Dense L = Dense::randn(n, r), F0 = Dense::randn(n, c);
+                Dense F(F0), G(F0);
+                mprod(trans, 0.5, L, A, -2.0, &F);
+                mprod(false, trans, 0.5, L, D, -2.0, &G);
+                this->expectNear(F, G);
+            }
+        }
+        // Operators, and a strided view as the output
+        Dense B = Dense::randn(k, 5), H = Dense::randn(4, m);
+        this->expectNear(A * B, D * B);
+        this->expectNear(H * A, H * D);
+        Dense W(m, 9);
+        auto V = W.colBlock(2, 5);
+        mprod(A, B, &V);
+        this->expectNear(Dense(W.colBlock(2, 5)), D * B);
+
+        Dense bad(m + 1, 5);
+        EXPECT_THROW(mprod(A, B, &bad), int);
+        EXPECT_THROW(mprod(true, 1.0, A, B, 0.0, &bad), int);
+    }
+}
+
+/////////////////////////////////////////
+// Parallel kernels, with enough nonzeros to split
+/////////////////////////////////////////
+TYPED_TEST(tSparse, Threaded) {
+    using Dense = typename TypeParam::Dense;
+    const int threads = getNumThreads();
+    setNumThreads(4);
+    const ptrdiff_t m = 700, k = 500;
+    TypeParam A = this->random(m, k, 0.2, sparse::CSR);
+    Dense D = A.dense();
+    for (bool trans : {false, true}) {
+        // SpMV, and a panel wide enough to split by columns
+        for (ptrdiff_t n : {1, 64}) {
+            Dense B = Dense::randn(trans ? m : k, n);
+            Dense C(trans ? k : m, n), E(trans ? k : m, n);
+            mprod(trans, 1.0, A, B, 0.0, &C);
+            mprod(trans, false, 1.0, D, B, 0.0, &E);
+            this->expectNear(C, E);
+        }
+    }
+    EXPECT_NEAR(dot(A, D), dot(D, D), this->tol * dot(D, D));
+    setNumThreads(threads);
+}
+
+/////////////////////////////////////////
+// maxpy(alpha, A, 1, &B), dot(A, B)
+/////////////////////////////////////////
+TYPED_TEST(tSparse, AxpyDot) {
+    using Dense = typename TypeParam::Dense;
+    for (auto format : {sparse::CSR, sparse::CSC}) {
+        TypeParam A = this->random(19, 13, 0.3, format);
+        Dense D = A.dense(), B = Dense::randn(19, 13);
+        Dense C(B);
+        maxpy(2.0, A, 1, &C);
+        maxpy(2.0, D, 1, &B);
+        this->expectNear(C, B);
+        EXPECT_NEAR(dot(A, B), dot(D, B), this->tol * norm(D) * norm(B));
+        EXPECT_NEAR(dot(B, A), dot(D, B), this->tol * norm(D) * norm(B));
+
+        Dense bad(19, 14);
+        EXPECT_THROW(maxpy(1.0, A, 1, &bad), int);
+        EXPECT_THROW(dot(A, bad), int);
+    }
+}
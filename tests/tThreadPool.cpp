@@ -0,0 +1,115 @@
+// Copyright 2023 Caleb Magruder
+
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include "TestWithLogging.h"
+
+/////////////////////////////////////////
+// tThreadPool Fixture, restores thread count
+/////////////////////////////////////////
+class tThreadPool : public TestWithLogging {
+ protected:
+    void SetUp() override { _threads = getNumThreads(); }
+    void TearDown() override { setNumThreads(_threads); }
+ private:
+    int _threads;
+};
+
+/////////////////////////////////////////
+// setNumThreads(n)
+/////////////////////////////////////////
+TEST_F(tThreadPool, SetNumThreads) {
+    setNumThreads(3);
+    EXPECT_EQ(getNumThreads(), 3);
+    EXPECT_EQ(ThreadPool::instance().size(), 3);
+    setNumThreads(1);
+    EXPECT_EQ(getNumThreads(), 1);
+}
+
+/////////////////////////////////////////
+// parallel_for visits every index once
+/////////////////////////////////////////
+TEST_F(tThreadPool, ParallelFor) {
+    setNumThreads(4);
+    const ptrdiff_t n = 100003;
+    std::vector<int> visits(n, 0);
+    std::atomic<int> calls = 0;
+    parallel_for(n, 1000, [&](ptrdiff_t i0, ptrdiff_t i1) {
+        calls++;
+        for (ptrdiff_t i = i0; i < i1; i++) visits[i]++;
+    });
+    EXPECT_EQ(calls, 4);
+    for (ptrdiff_t i = 0; i < n; i++) ASSERT_EQ(visits[i], 1);
+
+    // Below the grain, one serial call
+    calls = 0;
+    parallel_for(n, n, [&](ptrdiff_t i0, ptrdiff_t i1) {
+        calls++;
+        EXPECT_EQ(i0, 0);
+        EXPECT_EQ(i1, n);
+    });
+    EXPECT_EQ(calls, 1);
+}
+
+/////////////////////////////////////////
+// Nested parallel_for runs serially
+/////////////////////////////////////////
+TEST_F(tThreadPool, Nested) {
+    setNumThreads(4);
+    std::atomic<ptrdiff_t> sum = 0;
+    parallel_for(8, 1, [&](ptrdiff_t i0, ptrdiff_t i1) {
+        EXPECT_TRUE(ThreadPool::nested());
+        parallel_for(1000, 1, [&](ptrdiff_t j0, ptrdiff_t j1) {
+            EXPECT_EQ(j0, 0);
+            EXPECT_EQ(j1, 1000);
+            sum += (i1 - i0) * (j1 - j0);
+        });
+    });
+    EXPECT_EQ(sum, 8000);
+    EXPECT_FALSE(ThreadPool::nested());
+}
+
+/////////////////////////////////////////
+// parallel_reduce(n, grain, f)
+/////////////////////////////////////////
+TEST_F(tThreadPool, ParallelReduce) {
+    setNumThreads(4);
+    const ptrdiff_t n = 1 << 20;
+    double sum = parallel_reduce(n, 1 << 10, [](ptrdiff_t i0, ptrdiff_t i1) {
+        return static_cast<double>(i1 - i0);
+    });
+    EXPECT_EQ(sum, n);
+}
+
+/////////////////////////////////////////
+// REF kernels agree across thread counts
+/////////////////////////////////////////
+TEST_F(tThreadPool, MatrixKernels) {
+    Matrix<REF> A = Matrix<REF>::randn(300, 200);
+    Matrix<REF> B = Matrix<REF>::randn(200, 250);
+
+    setNumThreads(1);
+    Matrix<REF> C1 = A * B;
+    Matrix<REF> T1 = transpose(A);
+    double d1 = dot(A, A);
+
+    setNumThreads(4);
+    Matrix<REF> C4 = A * B;
+    Matrix<REF> T4 = transpose(A);
+    double d4 = dot(A, A);
+
+    EXPECT_EQ(C1, C4);
+    EXPECT_EQ(T1, T4);
+    EXPECT_NEAR(d1, d4, 1e-9 * d1);
+
+    Matrix<REF> X(1000, 100);
+    X.fill(2.0);
+    tanh(&X);
+    for (ptrdiff_t i = 0; i < numel(X); i++)
+        ASSERT_EQ(static_cast<double*>(X)[i], std::tanh(2.0));
+}
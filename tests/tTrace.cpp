@@ -0,0 +1,137 @@
+// Copyright 2023 Caleb Magruder
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Matrix.h"
+#include "TestWithLogging.h"
+#include "Trace.h"
+
+/////////////////////////////////////////
+// tTrace Fixture
+/////////////////////////////////////////
+class tTrace : public TestWithLogging {
+ protected:
+    void SetUp() override {
+        trace::enable();
+        trace::clear();
+    }
+    void TearDown() override { trace::clear(); }
+
+    // Recorded events named name
+    static std::vector<trace::Event> named(const std::string& name) {
+        std::vector<trace::Event> found;
+        for (const trace::Event& e : trace::events())
+            if (name == e.name) found.push_back(e);
+        return found;
+    }
+};
+
+/////////////////////////////////////////
+// trace::Span, events(), clear(), enable()
+/////////////////////////////////////////
+TEST_F(tTrace, Spans) {
+    {
+        trace::Span span("outer", REF, false, 4, 5, 6, 240);
+        trace::Span inner("inner", OPB, true, 1, 2, 0, 0);
+    }
+    std::thread([] { trace::Span span("worker", REF, false, 1, 1, 0, 1); })
+        .join();
+    std::vector<trace::Event> events = trace::events();
+    ASSERT_EQ(events.size(), 3);
+    EXPECT_STREQ(events[0].name, "outer");
+    EXPECT_STREQ(events[1].name, "inner");
+    EXPECT_STREQ(events[2].name, "worker");
+    EXPECT_EQ(events[0].backend, REF);
+    EXPECT_EQ(events[0].m * events[0].n * events[0].k, 120);
+    EXPECT_EQ(events[0].flops, 240);
+    EXPECT_TRUE(events[1].single);
+    EXPECT_GE(events[0].duration, events[1].duration);
+    EXPECT_LE(events[0].start, events[1].start);
+    EXPECT_EQ(events[0].thread, events[1].thread);
+    EXPECT_NE(events[0].thread, events[2].thread);
+
+    trace::clear();
+    EXPECT_TRUE(trace::events().empty());
+    trace::enable(false);
+    { trace::Span span("off", REF, false, 1, 1, 0, 0); }
+    trace::enable();
+    EXPECT_TRUE(trace::events().empty());
+
+    // Past the first chunk of a thread's buffer
+    for (int i = 0; i < 3000; i++) trace::Span span("many", REF, 0, 1, 1, 0, 0);
+    EXPECT_EQ(named("many").size(), 3000);
+}
+
+/////////////////////////////////////////
+// trace::writeChrome(os), writeSummary(os)
+/////////////////////////////////////////
+TEST_F(tTrace, Export) {
+    for (int i = 0; i < 2; i++)
+        trace::Span span("mprod", REF, false, 8, 8, 8, 1024);
+    { trace::Span span("tanh", OPB, true, 8, 1, 0, 8); }
+
+    std::ostringstream chrome;
+    trace::writeChrome(chrome);
+    const std::string json = chrome.str();
+    EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+    EXPECT_NE(json.find("\"name\":\"mprod\",\"cat\":\"REF\",\"ph\":\"X\""),
+              std::string::npos);
+    EXPECT_NE(json.find("\"dtype\":\"float\",\"m\":8,\"n\":1,\"k\":0,"
+                        "\"flops\":8}"), std::string::npos);
+    EXPECT_NE(json.find("\n],\"displayTimeUnit\":\"ms\"}"), std::string::npos);
+
+    std::ostringstream summary;
+    trace::writeSummary(summary);
+    std::istringstream lines(summary.str());
+    std::string line, op, backend, dtype;
+    int64_t calls = 0;
+    std::getline(lines, line);
+    EXPECT_EQ(line.rfind("op", 0), 0);
+    int rows = 0;
+    while (lines >> op >> backend >> dtype >> calls) {
+        std::getline(lines, line);
+        if (op == "mprod") {
+            EXPECT_EQ(backend, "REF");
+            EXPECT_EQ(dtype, "double");
+            EXPECT_EQ(calls, 2);
+        }
+        rows++;
+    }
+    EXPECT_EQ(rows, 2);
+}
+
+/////////////////////////////////////////
+// OperatorSet entry points, traced only when built with MATRIX_TRACE
+/////////////////////////////////////////
+TEST_F(tTrace, Operations) {
+    Matrix<REF, float> A = Matrix<REF, float>::randn(6, 4);
+    Matrix<REF, float> B = Matrix<REF, float>::randn(4, 3);
+    Matrix<REF, float> C = A * B, D(C), At(4, 6);
+    hprod(C, D, &D);
+    tanh(&D);
+    transpose(A, &At);
+    dot(C, D);
+    std::stringstream ss;
+    ss << C;
+    ss >> D;
+#if defined(MATRIX_TRACE)
+    const std::vector<trace::Event> mprod = named("mprod");
+    ASSERT_EQ(mprod.size(), 1);
+    EXPECT_EQ(mprod[0].backend, REF);
+    EXPECT_TRUE(mprod[0].single);
+    EXPECT_EQ(mprod[0].m, 6);
+    EXPECT_EQ(mprod[0].n, 3);
+    EXPECT_EQ(mprod[0].k, 4);
+    EXPECT_EQ(mprod[0].flops, 2 * 6 * 3 * 4);
+    for (const char* name : {"hprod", "tanh", "transpose", "dot", "write",
+                             "read"})
+        EXPECT_EQ(named(name).size(), 1) << name;
+#else
+    EXPECT_TRUE(trace::events().empty());
+#endif
+}
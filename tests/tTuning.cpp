@@ -0,0 +1,106 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "Layout.h"
+#include "Matrix.h"
+#include "TestWithLogging.h"
+#include "Tuning.h"
+
+/////////////////////////////////////////
+// tTuning Fixture
+/////////////////////////////////////////
+class tTuning : public TestWithLogging {
+ protected:
+    void SetUp() override { _params = tuning::current(); }
+    void TearDown() override {
+        tuning::apply(_params);
+        std::remove(path.c_str());
+    }
+
+    const std::string path = "tTuning.cache";
+
+ private:
+    tuning::Params _params;
+};
+
+/////////////////////////////////////////
+// tuning::heuristic(), apply(p), current()
+/////////////////////////////////////////
+TEST_F(tTuning, Parameters) {
+    const tuning::Params h = tuning::heuristic();
+    const gemm::Blocking d = gemm::blocking(false), s = gemm::blocking(true);
+    EXPECT_EQ(h.mc % d.mr, 0);
+    EXPECT_EQ(h.nc % d.nr, 0);
+    EXPECT_EQ(h.smc % s.mr, 0);
+    EXPECT_EQ(h.snc % s.nr, 0);
+    EXPECT_EQ(h.block % 8, 0);
+    EXPECT_GE(h.grain, 0);
+
+    // Blocks are rounded to the register tile, odd ones still multiply
+    tuning::Params p;
+    p.mc = d.mr + 1;
+    p.kc = 7;
+    p.nc = 1;
+    p.block = 13;
+    p.grain = 100;
+    ASSERT_TRUE(tuning::apply(p));
+    const tuning::Params q = tuning::current();
+    EXPECT_EQ(q.mc, 2 * d.mr);
+    EXPECT_EQ(q.kc, 7);
+    EXPECT_EQ(q.nc, d.nr);
+    EXPECT_EQ(q.block, 8);
+    EXPECT_EQ(q.grain, 100);
+    EXPECT_EQ(q.kernel, gemm::kernel());
+
+    Matrix<REF> A = Matrix<REF>::randn(37, 29), B = Matrix<REF>::randn(29, 41);
+    Matrix<REF> C = A * B;
+    for (ptrdiff_t i = 0; i < 37; i++) {
+        for (ptrdiff_t j = 0; j < 41; j++) {
+            double c = 0;
+            for (ptrdiff_t k = 0; k < 29; k++) c += A[i][k] * B[k][j];
+            ASSERT_NEAR(C[i][j], c, 1e-12);
+        }
+    }
+    Matrix<REF> At = transpose(A);
+    for (ptrdiff_t i = 0; i < 37; i++)
+        for (ptrdiff_t j = 0; j < 29; j++)
+            ASSERT_EQ(At[j][i], A[i][j]);
+
+    p.kernel = "unknown";
+    EXPECT_FALSE(tuning::apply(p));
+}
+
+/////////////////////////////////////////
+// tuning::save(p, path), load(path)
+/////////////////////////////////////////
+TEST_F(tTuning, Cache) {
+    EXPECT_FALSE(tuning::load("tTuning.missing"));
+
+    // Another host's entry survives, this host's is replaced
+    std::ofstream(path) << "[Other CPU]\ngemm 8 8 8\n["
+                        << tuning::cpuModel() << "]\nblock 8\n";
+    tuning::Params p = tuning::current();
+    p.kc = 96;
+    p.block = 48;
+    ASSERT_TRUE(tuning::save(p, path));
+    tuning::Params q = p;
+    q.kc = 128;
+    q.block = 16;
+    ASSERT_TRUE(tuning::apply(q));
+    ASSERT_TRUE(tuning::load(path));
+    EXPECT_EQ(tuning::current().kc, 96);
+    EXPECT_EQ(layout::block(), 48);
+
+    std::ifstream is(path);
+    std::stringstream contents;
+    contents << is.rdbuf();
+    EXPECT_NE(contents.str().find("[Other CPU]\ngemm 8 8 8\n"),
+              std::string::npos);
+    EXPECT_EQ(contents.str().find("block 8\n"), std::string::npos);
+}
@@ -0,0 +1,152 @@
+// Copyright 2023 Caleb Magruder
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "TestWithLogging.h"
+#include "VMath.h"
+
+/////////////////////////////////////////
+// tVMath Fixture
+/////////////////////////////////////////
+class tVMath : public TestWithLogging {
+ protected:
+    // Random arguments spanning 1e-8 to 40 in magnitude, both signs
+    std::vector<double> arguments(size_t count) {
+        std::mt19937_64 gen(7);
+        std::uniform_real_distribution<> sign(-1, 1), exponent(-8, 1.6);
+        std::vector<double> x(count);
+        for (double& xi : x) xi = sign(gen) * std::pow(10.0, exponent(gen));
+        return x;
+    }
+
+    // Distance from the long double reference in units of the last
+    // place of the correctly rounded result
+    static double ulps(double y, long double ref) {
+        const double r = std::fabs(static_cast<double>(ref));
+        const double ulp = r == 0 ? std::numeric_limits<double>::denorm_min()
+                    : std::nextafter(r, std::numeric_limits<double>::infinity())
+                      - r;
+        return static_cast<double>(std::fabs(y - ref) / ulp);
+    }
+
+    void SetUp() override { _kernel = vmath::kernel(); }
+    void TearDown() override { vmath::kernel(_kernel); }
+
+ private:
+    const char* _kernel;
+};
+
+/////////////////////////////////////////
+// Max ulp error of each accuracy mode, for every SIMD kernel
+/////////////////////////////////////////
+TEST_F(tVMath, TanhUlp) {
+    // Odd length exercises the padded tail
+    const std::vector<double> x = arguments(100001);
+    std::vector<double> y(x.size());
+    const struct { vmath::Accuracy mode; double ulp; } bounds[] = {
+        {vmath::HIGH, 3}, {vmath::LOW, 4}, {vmath::FAST, 1 << 26}};
+    for (const char* name : {"avx512", "avx2", "generic"}) {
+        if (!vmath::kernel(name)) continue;
+        for (auto b : bounds) {
+            vmath::tanh(x.size(), x.data(), y.data(), b.mode);
+            double worst = 0, relative = 0;
+            for (size_t i = 0; i < x.size(); i++) {
+                const long double ref = std::tanh(
+                    static_cast<long double>(x[i]));
+                worst = std::max(worst, ulps(y[i], ref));
+                relative = std::max(relative, static_cast<double>(
+                    std::fabs((y[i] - ref) / ref)));
+            }
+            EXPECT_LE(worst, b.ulp) << name << " mode " << b.mode;
+            if (b.mode == vmath::FAST) {
+                EXPECT_LT(relative, 1e-8) << name;
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////
+// Signed zeros, saturation, infinities, NaN and in-place calls
+/////////////////////////////////////////
+TEST_F(tVMath, TanhSpecial) {
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (const char* name : {"avx512", "avx2", "generic"}) {
+        if (!vmath::kernel(name)) continue;
+        for (vmath::Accuracy mode : {vmath::HIGH, vmath::LOW, vmath::FAST}) {
+            std::vector<double> x = {0.0, -0.0, 0.625, -0.625, 30, -1e300,
+                                     inf, -inf, nan, 1e-310, -1e-20};
+            vmath::tanh(x.size(), x.data(), x.data(), mode);
+            EXPECT_EQ(x[0], 0.0);
+            EXPECT_FALSE(std::signbit(x[0]));
+            EXPECT_TRUE(std::signbit(x[1]));
+            EXPECT_NEAR(x[2], std::tanh(0.625), 1e-8);
+            EXPECT_EQ(x[2], -x[3]);
+            EXPECT_EQ(x[4], 1.0);
+            EXPECT_EQ(x[5], -1.0);
+            EXPECT_EQ(x[6], 1.0);
+            EXPECT_EQ(x[7], -1.0);
+            EXPECT_TRUE(std::isnan(x[8]));
+            EXPECT_EQ(x[9], 1e-310);
+            EXPECT_EQ(x[10], -1e-20);
+        }
+    }
+}
+
+/////////////////////////////////////////
+// Single precision within a float ulp of the rounded reference
+/////////////////////////////////////////
+TEST_F(tVMath, TanhFloat) {
+    const std::vector<double> xd = arguments(10001);
+    const std::vector<float> x(xd.begin(), xd.end());
+    std::vector<float> y(x.size());
+    for (const char* name : {"avx512", "avx2", "generic"}) {
+        if (!vmath::kernel(name)) continue;
+        for (vmath::Accuracy mode : {vmath::HIGH, vmath::LOW, vmath::FAST}) {
+            vmath::tanh(x.size(), x.data(), y.data(), mode);
+            for (size_t i = 0; i < x.size(); i++) {
+                const float ref = std::tanh(static_cast<double>(x[i]));
+                const float ulp = std::fabs(ref)
+                                * std::numeric_limits<float>::epsilon();
+                ASSERT_LE(std::fabs(y[i] - ref), 2 * ulp)
+                    << name << " mode " << mode << " x " << x[i];
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////
+// Box-Muller pairs within a few ulp of the radius, for every SIMD kernel
+/////////////////////////////////////////
+TEST_F(tVMath, BoxMuller) {
+    std::mt19937_64 gen(11);
+    std::vector<double> u1 = {0x1p-53, 0x1p-30, 0.5, 0.70710678118654752440,
+                              1.0, 1.0, 1.0, 1.0, 0.1};
+    std::vector<double> u2 = {0.0, 0.125, 0.25, 0.375, 0.5, 0.75, 0.9999,
+                              1 - 0x1p-53, 0.6};
+    for (int i = 0; i < 50000; i++) {
+        u1.push_back(((gen() >> 11) + 1) * 0x1p-53);
+        u2.push_back((gen() >> 11) * 0x1p-53);
+    }
+    std::vector<double> z0(u1.size()), z1(u1.size());
+    const long double pi = 3.141592653589793238462643383279502884L;
+    for (const char* name : {"avx512", "avx2", "generic"}) {
+        if (!vmath::kernel(name)) continue;
+        vmath::boxMuller(u1.size(), u1.data(), u2.data(), z0.data(),
+                         z1.data());
+        for (size_t i = 0; i < u1.size(); i++) {
+            const long double r = std::sqrt(-2 * std::log(
+                static_cast<long double>(u1[i])));
+            const long double a = 2 * pi * u2[i];
+            const double tol = 4 * std::numeric_limits<double>::epsilon()
+                             * static_cast<double>(r) + 1e-300;
+            ASSERT_NEAR(z0[i], r * std::cos(a), tol) << name << " " << i;
+            ASSERT_NEAR(z1[i], r * std::sin(a), tol) << name << " " << i;
+        }
+    }
+}